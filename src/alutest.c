@@ -69,7 +69,8 @@ void check_result_16(TestResult16 *expected, TestResult16 *actual);
 unsigned char *memory_space = NULL;		// Since it's defined in global scope, it must be constant
 
 void main() {
-	memory_space = calloc(50, sizeof(char));
+	memory_space = calloc(MEMORY_SPACE_SIZE, sizeof(char));
+	map_memory();
 	
 	successes = 0;
 	failures = 0;
@@ -0,0 +1,161 @@
+/**
+ * This module contains the headless benchmark: the game is run frame after frame as quickly
+ * as the core can go, while a script presses the buttons.
+ *
+ * There is no PPU or timer yet, so this stands in for the little of them a game can't run
+ * without. Each frame is 154 scanlines of 456 cycles. LY is moved on at the start of each,
+ * STAT's mode shows HBlank or VBlank, and the VBlank interrupt is requested on reaching
+ * line 144. DIV is brought up to date along with LY, as games use it for random numbers.
+ * Between those the core runs until the CPU's cycle count reaches the end of the line, and
+ * no further than the instruction which gets it there. Games wait on LY or for VBlank to
+ * pace themselves, so they see time pass as they should.
+ *
+ * The script is the same every run, so every run does the same work: the copyright and
+ * title screens are let run their course, then Start and A are pressed through the menus,
+ * which starts a game in Tetris. After that a short pattern of moves is played over and
+ * over, which plays the game out and starts the next.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <limits.h>
+#include <stddef.h>
+
+#include "benchmark.h"
+#include "cpu/cycle_tables.h"
+#include "memory/memory.h"
+#include "memory/joypad.h"
+
+#define SCRIPT_PATTERN_START 	720		// The frame the repeating moves start on
+#define SCRIPT_PATTERN_FRAMES 	8		// Frames each move in the pattern is held for
+
+/*
+ * A change of buttons, on the frame it happens.
+ */
+typedef struct {
+	unsigned long frame;
+	unsigned char buttons;
+} ScriptedInput;
+
+/*
+ * Through the menus. Each press is held for a few frames, as a person would.
+ */
+static const ScriptedInput opening[] = {
+	{420, JOYPAD_START}, {426, 0},
+	{480, JOYPAD_A}, {486, 0},
+	{540, JOYPAD_A}, {546, 0},
+	{600, JOYPAD_A}, {606, 0},
+	{660, JOYPAD_START}, {666, 0},
+};
+
+/*
+ * Over and over from SCRIPT_PATTERN_START, each held for SCRIPT_PATTERN_FRAMES.
+ */
+static const unsigned char pattern[] = {
+	JOYPAD_LEFT, 0, JOYPAD_A, 0, JOYPAD_RIGHT, JOYPAD_RIGHT, 0, JOYPAD_DOWN,
+	0, JOYPAD_LEFT | JOYPAD_A, 0, JOYPAD_RIGHT, 0, JOYPAD_DOWN, JOYPAD_DOWN, 0,
+};
+
+#define OPENING_LENGTH (sizeof(opening) / sizeof(opening[0]))
+#define PATTERN_LENGTH (sizeof(pattern) / sizeof(pattern[0]))
+
+/**
+ * /brief Presses whatever the script has pressed on a frame.
+ *
+ * @param frame: The frame about to be run.
+ */
+static void press_scripted_buttons(unsigned long frame) {
+	unsigned int i;
+
+	if (frame >= SCRIPT_PATTERN_START) {
+		if ((frame - SCRIPT_PATTERN_START) % SCRIPT_PATTERN_FRAMES == 0) {
+			set_joypad_buttons(pattern[(frame - SCRIPT_PATTERN_START) / SCRIPT_PATTERN_FRAMES % PATTERN_LENGTH]);
+		}
+		return;
+	}
+
+	for (i = 0; i < OPENING_LENGTH; i++) {
+		if (opening[i].frame == frame) {
+			set_joypad_buttons(opening[i].buttons);
+		}
+	}
+}
+
+/**
+ * /brief Runs the core until the CPU's cycle count reaches a target.
+ *
+ * A core which can stop at a cycle count is simply told the target. The rest are given
+ * instructions rather than cycles to run, so each is handed as many as would fit in what's
+ * left were they all the longest there is, and the count checked again. That holds back
+ * skipped idle loops and sleeping through HALT too, as they are only let skip the
+ * instructions they were given. Either way the run stops with the instruction which reaches
+ * the target, so every core sees the line change at the same point. Only that instruction,
+ * or an interrupt taken after it, can pass the target, and the next line makes that up as
+ * the targets don't move.
+ *
+ * @param target: The cycle count to run up to.
+ * @param stuck: Set to 1 if the core ran nothing when asked to.
+ *
+ * @return The number of instructions executed. Stops early if the core can go no further.
+ */
+static unsigned long run_until(const Core *core, CPUState *state, unsigned long target, int *stuck) {
+	unsigned long executed = 0;
+
+	while (state->cycles < target) {
+		unsigned long ran;
+
+		if (core->run_until != NULL) {
+			ran = core->run_until(state, ULONG_MAX, target);
+		}
+		else {
+			ran = core->run(state, (target - state->cycles + LONGEST_INSTRUCTION_CYCLES - 1) /
+				LONGEST_INSTRUCTION_CYCLES);
+		}
+
+		if (ran == 0) {
+			*stuck = 1;
+			break;
+		}
+		executed += ran;
+	}
+	return executed;
+}
+
+/**
+ * /brief Runs the game for a number of frames, pressing the scripted buttons as it goes.
+ *
+ * Frames are numbered from the first this is called for, so the script should be started
+ * on a freshly booted game.
+ *
+ * @param core: The core to run the CPU on.
+ * @param state: The CPU we are running.
+ * @param frame_count: How many frames to run.
+ * @param instructions: Set to the number of instructions executed.
+ *
+ * @return The number of frames run. Less than asked if the core could go no further.
+ */
+unsigned long run_frames(const Core *core, CPUState *state, unsigned long frame_count, unsigned long *instructions) {
+	unsigned long frame, line, target = state->cycles;
+	int stuck = 0;
+
+	*instructions = 0;
+	for (frame = 0; frame < frame_count && !stuck; frame++) {
+		press_scripted_buttons(frame);
+
+		for (line = 0; line < SCANLINES_PER_FRAME && !stuck; line++) {
+			unsigned char mode = line < VBLANK_SCANLINE ? STAT_MODE_HBLANK : STAT_MODE_VBLANK;
+
+			memory_space[DIV_ADDRESS] = state->cycles >> DIV_CYCLE_SHIFT;
+			memory_space[LY_ADDRESS] = line;
+			memory_space[STAT_ADDRESS] = (memory_space[STAT_ADDRESS] & ~STAT_MODE_MASK) | mode;
+			if (line == VBLANK_SCANLINE) {
+				write_byte(INTERRUPT_FLAG_ADDRESS, read_byte(INTERRUPT_FLAG_ADDRESS) | INTERRUPT_VBLANK);
+			}
+
+			target += CYCLES_PER_SCANLINE;
+			*instructions += run_until(core, state, target, &stuck);
+		}
+	}
+
+	return stuck ? frame - 1 : frame;
+}
@@ -0,0 +1,32 @@
+/**
+ * A header file for the headless benchmark, which runs a game for a set number of frames
+ * with the same buttons pressed every time.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "cpu/register.h"
+#include "cpu/cores.h"
+
+#define FRAME_RATE 				59.73	// Frames a real Game Boy shows a second
+#define CYCLES_PER_SCANLINE 	456
+#define SCANLINES_PER_FRAME 	154
+#define VBLANK_SCANLINE 		144		// The first line of VBlank
+#define CYCLES_PER_FRAME 		(CYCLES_PER_SCANLINE * SCANLINES_PER_FRAME)
+
+#define LY_ADDRESS 				0xFF44	// The scanline being drawn
+#define STAT_ADDRESS 			0xFF41	// The low two bits are the PPU's mode
+#define STAT_MODE_MASK 			0x03
+#define STAT_MODE_HBLANK 		0x00
+#define STAT_MODE_VBLANK 		0x01
+
+#define DIV_ADDRESS 			0xFF04	// Counts up every 256 cycles. Games take it for random numbers
+#define DIV_CYCLE_SHIFT 		8
+
+// See benchmark.c for more thorough explination of these functions
+unsigned long run_frames(const Core *core, CPUState *state, unsigned long frame_count, unsigned long *instructions);
+
+#endif // BENCHMARK_H
@@ -0,0 +1,569 @@
+/*
+ * Runs every 8 bit ALU, rotate, shift, swap, BIT and DAA handler over every input it can
+ * be given: each accumulator, operand and incoming F (upper nibble, the lower one is never
+ * set on hardware), for the register, immediate and (HL) form of each. About 25 million
+ * cases, each checked against a model worked out straight from the Pan Docs descriptions
+ * below. It shares nothing with alu_reference.c or the lookup tables built from it, so a
+ * mistake in either shows up here rather than being copied into both sides.
+ *
+ * The cases are split into slices, one per operation and accumulator (or bit number), which
+ * worker threads take in turn until there are none left, one thread per processor. Each
+ * thread has its own CPUState and its own byte of memory for the (HL) forms. Give a number
+ * of threads as the only argument to use some other number.
+ *
+ * Any disagreement is printed with the exact inputs that caused it. Built both with and
+ * without LAZY_FLAGS, as the two keep F quite differently.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../util.h"
+#include "register.h"
+#include "instructions.h"
+#include "../memory/memory.h"
+
+#define REPORTED_MISMATCHES 	4
+#define MAX_THREADS 			64
+#define OPERAND_ADDRESS_BASE 	0xC000	// Work RAM. Each thread's (HL) gets its own line of it
+#define OPERAND_ADDRESS_SPACING 0x40
+#define FLAG_COMBINATIONS 		16		// Every value of the upper nibble of F
+
+/*
+ * Runs one handler on a state holding the incoming A and F.
+ *
+ * @param state: A, F and somewhere for HL to point.
+ * @param first: The bit number for BIT. Unused otherwise, A already holds the accumulator.
+ * @param second: The operand, or the value operated on for the single register forms.
+ *
+ * @return The register the handler leaves its result in: A, or the one operated on.
+ */
+typedef Register8 (*Subject)(CPUState *state, unsigned char first, unsigned char second);
+
+/*
+ * Works out what a handler should do, straight from the Pan Docs.
+ *
+ * @return The result and F the handler should leave, as AF.
+ */
+typedef Register16 (*Model)(unsigned char first, unsigned char second, unsigned char flags);
+
+typedef struct {
+	unsigned char first, second, flags;
+	Register16 expected, actual;
+} Mismatch;
+
+/*
+ * One handler in one form. The inputs named are what is printed against a mismatch, a
+ * NULL first meaning there is only the one (A, or nothing at all for the single register
+ * forms).
+ */
+typedef struct {
+	const char *name;
+	Subject subject;
+	Model model;
+	const char *first_input;	// "A", "bit" or NULL
+	int first_count;
+	const char *second_input;	// e.g. "B", "n8", "(HL)". NULL for none
+	int second_count;
+	const char *result;			// The register holding the result, as printed
+
+	unsigned long mismatch_count;
+	Mismatch mismatches[REPORTED_MISMATCHES];
+} Operation;
+
+int successes;
+int failures;
+
+unsigned char *memory_space = NULL;
+
+static pthread_mutex_t report_lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int next_slice;
+static atomic_ulong cases_run;
+
+/*** THE MODEL ***/
+
+#define Z(result) 	(((result) & 0xFF) == 0 ? 0x80 : 0)
+#define N 			0x40
+#define H 			0x20
+#define C 			0x10
+
+static Register16 outcome(int result, unsigned char flags) {
+	return ((result & 0xFF) << 8) | flags;
+}
+
+// An add or subtract with the carry fed in. H and C come from the widened sums
+static Register16 sum(unsigned char a, unsigned char b, int carry) {
+	int result = a + b + carry;
+	int half = (a & 0xF) + (b & 0xF) + carry;
+	return outcome(result, Z(result) | (half > 0xF ? H : 0) | (result > 0xFF ? C : 0));
+}
+
+static Register16 difference(unsigned char a, unsigned char b, int carry) {
+	int result = a - b - carry;
+	int half = (a & 0xF) - (b & 0xF) - carry;
+	return outcome(result, Z(result) | N | (half < 0 ? H : 0) | (result < 0 ? C : 0));
+}
+
+static Register16 model_add(unsigned char a, unsigned char b, unsigned char flags) {
+	return sum(a, b, 0);
+}
+
+static Register16 model_adc(unsigned char a, unsigned char b, unsigned char flags) {
+	return sum(a, b, (flags & C) != 0);
+}
+
+static Register16 model_sub(unsigned char a, unsigned char b, unsigned char flags) {
+	return difference(a, b, 0);
+}
+
+static Register16 model_sbc(unsigned char a, unsigned char b, unsigned char flags) {
+	return difference(a, b, (flags & C) != 0);
+}
+
+// CP is a SUB that throws the result away
+static Register16 model_cp(unsigned char a, unsigned char b, unsigned char flags) {
+	return (a << 8) | (difference(a, b, 0) & 0xFF);
+}
+
+static Register16 model_and(unsigned char a, unsigned char b, unsigned char flags) {
+	return outcome(a & b, Z(a & b) | H);
+}
+
+static Register16 model_or(unsigned char a, unsigned char b, unsigned char flags) {
+	return outcome(a | b, Z(a | b));
+}
+
+static Register16 model_xor(unsigned char a, unsigned char b, unsigned char flags) {
+	return outcome(a ^ b, Z(a ^ b));
+}
+
+// INC and DEC leave the carry as it was
+static Register16 model_inc(unsigned char unused, unsigned char value, unsigned char flags) {
+	return outcome(value + 1, Z(value + 1) | ((value & 0xF) == 0xF ? H : 0) | (flags & C));
+}
+
+static Register16 model_dec(unsigned char unused, unsigned char value, unsigned char flags) {
+	return outcome(value - 1, Z(value - 1) | N | ((value & 0xF) == 0 ? H : 0) | (flags & C));
+}
+
+// The rotates and shifts: Z from the result, N and H reset, C the bit shifted out
+static Register16 shifted(int result, int bit_out) {
+	return outcome(result, Z(result) | (bit_out ? C : 0));
+}
+
+static Register16 model_rlc(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted((value << 1) | (value >> 7), value & 0x80);
+}
+
+static Register16 model_rrc(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted((value >> 1) | (value << 7), value & 0x01);
+}
+
+static Register16 model_rl(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted((value << 1) | ((flags & C) != 0), value & 0x80);
+}
+
+static Register16 model_rr(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted((value >> 1) | ((flags & C) ? 0x80 : 0), value & 0x01);
+}
+
+static Register16 model_sla(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted(value << 1, value & 0x80);
+}
+
+static Register16 model_sra(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted((value >> 1) | (value & 0x80), value & 0x01);
+}
+
+static Register16 model_srl(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted(value >> 1, value & 0x01);
+}
+
+static Register16 model_swap(unsigned char unused, unsigned char value, unsigned char flags) {
+	return shifted((value << 4) | (value >> 4), 0);
+}
+
+// RLCA, RRCA, RLA and RRA are their CB counterparts with Z always reset
+#define ACCUMULATOR_ROTATE_MODEL(name) \
+	static Register16 model_##name##a(unsigned char a, unsigned char unused, unsigned char flags) { \
+		return model_##name(0, a, flags) & ~0x80; \
+	}
+
+ACCUMULATOR_ROTATE_MODEL(rlc)
+ACCUMULATOR_ROTATE_MODEL(rrc)
+ACCUMULATOR_ROTATE_MODEL(rl)
+ACCUMULATOR_ROTATE_MODEL(rr)
+
+// BIT sets Z if the bit is clear, resets N, sets H and leaves C. The value is untouched
+static Register16 model_bit(unsigned char bit, unsigned char value, unsigned char flags) {
+	return outcome(value, ((value >> bit) & 1 ? 0 : 0x80) | H | (flags & C));
+}
+
+/*
+ * DAA as the Pan Docs give it. After an add, corrects each digit that went past 9 or
+ * carried. After a subtract, undoes whichever digits borrowed. N is kept, H reset.
+ */
+static Register16 model_daa(unsigned char a, unsigned char unused, unsigned char flags) {
+	int result = a, carry = flags & C;
+
+	if (!(flags & N)) {
+		if (carry || a > 0x99) {
+			result += 0x60;
+			carry = C;
+		}
+		if ((flags & H) || (a & 0xF) > 0x9) {
+			result += 0x06;
+		}
+	}
+	else {
+		if (carry) {
+			result -= 0x60;
+		}
+		if (flags & H) {
+			result -= 0x06;
+		}
+	}
+
+	return outcome(result, Z(result) | (flags & N) | carry);
+}
+
+static Register16 model_cpl(unsigned char a, unsigned char unused, unsigned char flags) {
+	return outcome(~a, (flags & (0x80 | C)) | N | H);
+}
+
+static Register16 model_scf(unsigned char a, unsigned char unused, unsigned char flags) {
+	return outcome(a, (flags & 0x80) | C);
+}
+
+static Register16 model_ccf(unsigned char a, unsigned char unused, unsigned char flags) {
+	return outcome(a, (flags & 0x80) | ((flags & C) ^ C));
+}
+
+/*** THE HANDLERS ***/
+
+// Loads the (HL) operand into this thread's byte of memory, handing back HL for the handler
+static Register16 *indirect_operand(CPUState *state, unsigned char value) {
+	write_byte(state->HL, value);
+	return &state->HL;
+}
+
+// ADD A,B / ADD A,n8 / ADD A,(HL) and the like, for a handler named prefix_register suffix etc.
+#define BINARY_SUBJECTS(name, prefix, suffix) \
+	static Register8 subject_##name##_register(CPUState *state, unsigned char unused, unsigned char operand) { \
+		state->B = operand; \
+		prefix##_register##suffix(&state->A, &state->B, &state->F); \
+		return state->A; \
+	} \
+	static Register8 subject_##name##_immediate(CPUState *state, unsigned char unused, unsigned char operand) { \
+		prefix##_immediate##suffix(&state->A, operand, &state->F); \
+		return state->A; \
+	} \
+	static Register8 subject_##name##_indirect(CPUState *state, unsigned char unused, unsigned char operand) { \
+		indirect_operand(state, operand); \
+		prefix##_indirect##suffix(&state->A, &state->HL, &state->F); \
+		return state->A; \
+	}
+
+BINARY_SUBJECTS(add, add, )
+BINARY_SUBJECTS(adc, add, _with_carry)
+BINARY_SUBJECTS(sub, subtract, )
+BINARY_SUBJECTS(sbc, subtract, _with_carry)
+BINARY_SUBJECTS(and, bitwise_and, )
+BINARY_SUBJECTS(or, bitwise_or, )
+BINARY_SUBJECTS(xor, bitwise_xor, )
+BINARY_SUBJECTS(cp, compare, )
+
+// RLC B / RLC (HL) and the like, for the handlers taking just the register and F
+#define SINGLE_SUBJECTS(name, register_handler, indirect_handler) \
+	static Register8 subject_##name##_register(CPUState *state, unsigned char unused, unsigned char value) { \
+		state->B = value; \
+		register_handler(&state->B, &state->F); \
+		return state->B; \
+	} \
+	static Register8 subject_##name##_indirect(CPUState *state, unsigned char unused, unsigned char value) { \
+		indirect_handler(indirect_operand(state, value), &state->F); \
+		return read_byte(state->HL); \
+	}
+
+SINGLE_SUBJECTS(rlc, rotate_register_left_carry_archive, rotate_indirect_left_carry_archive)
+SINGLE_SUBJECTS(rrc, rotate_register_right_carry_archive, rotate_indirect_right_carry_archive)
+SINGLE_SUBJECTS(rl, rotate_register_left_through_carry, rotate_indirect_left_through_carry)
+SINGLE_SUBJECTS(rr, rotate_register_right_through_carry, rotate_indirect_right_through_carry)
+SINGLE_SUBJECTS(sla, shift_register_left, shift_indirect_left)
+SINGLE_SUBJECTS(sra, arithmetic_shift_register_right, arithmetic_shift_indirect_right)
+SINGLE_SUBJECTS(srl, logical_shift_register_right, logical_shift_indirect_right)
+SINGLE_SUBJECTS(swap, swap_nibble_register, swap_nibble_indirect)
+
+// INC and DEC share their handlers with ADD and SUB. Like their adapters, put the carry back
+#define STEP_SUBJECTS(name, register_handler, indirect_handler) \
+	static Register8 subject_##name##_register(CPUState *state, unsigned char unused, unsigned char value) { \
+		Register8 old_carry = carry_flag_set(&state->F) != 0; \
+		state->B = value; \
+		register_handler(&state->B, &state->F); \
+		keep_carry_flag(&state->F, old_carry); \
+		return state->B; \
+	} \
+	static Register8 subject_##name##_indirect(CPUState *state, unsigned char unused, unsigned char value) { \
+		Register8 old_carry = carry_flag_set(&state->F) != 0; \
+		indirect_handler(indirect_operand(state, value), &state->F); \
+		keep_carry_flag(&state->F, old_carry); \
+		return read_byte(state->HL); \
+	}
+
+STEP_SUBJECTS(inc, increment_register, increment_register_indirect)
+STEP_SUBJECTS(dec, decrement_register, decrement_register_indirect)
+
+static Register8 subject_bit_register(CPUState *state, unsigned char bit, unsigned char value) {
+	state->B = value;
+	test_bit_register(&state->B, bit, &state->F);
+	return state->B;
+}
+
+static Register8 subject_bit_indirect(CPUState *state, unsigned char bit, unsigned char value) {
+	test_bit_indirect(indirect_operand(state, value), bit, &state->F);
+	return read_byte(state->HL);
+}
+
+// Like their adapters, the accumulator rotates reset Z after the CB handler
+#define ACCUMULATOR_ROTATE_SUBJECT(name, handler) \
+	static Register8 subject_##name(CPUState *state, unsigned char unused, unsigned char unused_too) { \
+		handler(&state->A, &state->F); \
+		materialise_flags(&state->F); \
+		state->F &= ~0x80; \
+		return state->A; \
+	}
+
+ACCUMULATOR_ROTATE_SUBJECT(rlca, rotate_register_left_carry_archive)
+ACCUMULATOR_ROTATE_SUBJECT(rrca, rotate_register_right_carry_archive)
+ACCUMULATOR_ROTATE_SUBJECT(rla, rotate_register_left_through_carry)
+ACCUMULATOR_ROTATE_SUBJECT(rra, rotate_register_right_through_carry)
+
+static Register8 subject_daa(CPUState *state, unsigned char unused, unsigned char unused_too) {
+	decimal_adjust_accumulator(&state->A, &state->F);
+	return state->A;
+}
+
+static Register8 subject_cpl(CPUState *state, unsigned char unused, unsigned char unused_too) {
+	complement_accumulator(&state->A, &state->F);
+	return state->A;
+}
+
+static Register8 subject_scf(CPUState *state, unsigned char unused, unsigned char unused_too) {
+	set_carry_flag(&state->F);
+	return state->A;
+}
+
+static Register8 subject_ccf(CPUState *state, unsigned char unused, unsigned char unused_too) {
+	complement_carry_flag(&state->F);
+	return state->A;
+}
+
+/*** THE OPERATIONS ***/
+
+#define BINARY_OPERATIONS(mnemonic, name) \
+	{mnemonic "B", subject_##name##_register, model_##name, "A", 256, "B", 256, "A"}, \
+	{mnemonic "n8", subject_##name##_immediate, model_##name, "A", 256, "n8", 256, "A"}, \
+	{mnemonic "(HL)", subject_##name##_indirect, model_##name, "A", 256, "(HL)", 256, "A"},
+
+#define SINGLE_OPERATIONS(mnemonic, name) \
+	{mnemonic " B", subject_##name##_register, model_##name, NULL, 1, "B", 256, "B"}, \
+	{mnemonic " (HL)", subject_##name##_indirect, model_##name, NULL, 1, "(HL)", 256, "(HL)"},
+
+#define ACCUMULATOR_OPERATION(mnemonic, name) \
+	{mnemonic, subject_##name, model_##name, "A", 256, NULL, 1, "A"},
+
+static Operation operations[] = {
+	BINARY_OPERATIONS("ADD A,", add)
+	BINARY_OPERATIONS("ADC A,", adc)
+	BINARY_OPERATIONS("SUB ", sub)
+	BINARY_OPERATIONS("SBC A,", sbc)
+	BINARY_OPERATIONS("AND ", and)
+	BINARY_OPERATIONS("OR ", or)
+	BINARY_OPERATIONS("XOR ", xor)
+	BINARY_OPERATIONS("CP ", cp)
+	SINGLE_OPERATIONS("INC", inc)
+	SINGLE_OPERATIONS("DEC", dec)
+	SINGLE_OPERATIONS("RLC", rlc)
+	SINGLE_OPERATIONS("RRC", rrc)
+	SINGLE_OPERATIONS("RL", rl)
+	SINGLE_OPERATIONS("RR", rr)
+	SINGLE_OPERATIONS("SLA", sla)
+	SINGLE_OPERATIONS("SRA", sra)
+	SINGLE_OPERATIONS("SRL", srl)
+	SINGLE_OPERATIONS("SWAP", swap)
+	{"BIT u3,B", subject_bit_register, model_bit, "bit", 8, "B", 256, "B"},
+	{"BIT u3,(HL)", subject_bit_indirect, model_bit, "bit", 8, "(HL)", 256, "(HL)"},
+	ACCUMULATOR_OPERATION("RLCA", rlca)
+	ACCUMULATOR_OPERATION("RRCA", rrca)
+	ACCUMULATOR_OPERATION("RLA", rla)
+	ACCUMULATOR_OPERATION("RRA", rra)
+	ACCUMULATOR_OPERATION("DAA", daa)
+	ACCUMULATOR_OPERATION("CPL", cpl)
+	ACCUMULATOR_OPERATION("SCF", scf)
+	ACCUMULATOR_OPERATION("CCF", ccf)
+};
+
+#define OPERATION_COUNT ((int) (sizeof(operations) / sizeof(operations[0])))
+
+void *run_worker(void *argument);
+void run_slice(CPUState *state, Operation *operation, unsigned char first);
+void note_mismatch(Operation *operation, Mismatch *mismatch);
+void print_mismatch(Operation *operation, Mismatch *mismatch);
+void check_value(const char *description, unsigned long expected, unsigned long actual);
+
+int main(int argc, char **argv) {
+	pthread_t threads[MAX_THREADS];
+	struct timespec start, end;
+	long thread_count = argc > 1 ? atol(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+	long thread;
+	int i, j;
+
+	successes = 0;
+	failures = 0;
+	memory_space = calloc(MEMORY_SPACE_SIZE, sizeof(unsigned char));
+	map_memory();
+
+	if (thread_count < 1) {
+		thread_count = 1;
+	}
+	if (thread_count > MAX_THREADS) {
+		thread_count = MAX_THREADS;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (thread = 0; thread < thread_count; thread++) {
+		if (pthread_create(&threads[thread], NULL, run_worker, (void *) thread) != 0) {
+			fprintf(stderr, "ILLEGAL OPERATION: Couldn't start conformance thread %ld\n", thread);
+			abort();
+		}
+	}
+	for (thread = 0; thread < thread_count; thread++) {
+		pthread_join(threads[thread], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (i = 0; i < OPERATION_COUNT; i++) {
+		Operation *operation = &operations[i];
+
+		printf("Test: %s over every input\n", operation->name);
+		for (j = 0; j < REPORTED_MISMATCHES && j < operation->mismatch_count; j++) {
+			print_mismatch(operation, &operation->mismatches[j]);
+		}
+		check_value("Mismatches", 0, operation->mismatch_count);
+	}
+
+	printf("Ran %lu cases on %ld threads in %.2f seconds\n", atomic_load(&cases_run), thread_count,
+		(end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+	printf("\n\nTESTING COMPLETE!\n\t%d Successes\n\t%d Failures\n", successes, failures);
+
+	free(memory_space);
+	return failures != 0;
+}
+
+/**
+ * /brief Takes slices until there are none left.
+ *
+ * A slice is one operation with one value of its first input, so an 8 bit operation with
+ * all 256 accumulators is 256 slices and INC B is just the one.
+ *
+ * @param argument: The thread's number, which picks its byte of memory.
+ *
+ * @return Nothing.
+ */
+void *run_worker(void *argument) {
+	CPUState state = {0};
+	int slice, i;
+
+	state.HL = OPERAND_ADDRESS_BASE + (long) argument * OPERAND_ADDRESS_SPACING;
+
+	while ((slice = atomic_fetch_add(&next_slice, 1)) >= 0) {
+		for (i = 0; i < OPERATION_COUNT && slice >= operations[i].first_count; i++) {
+			slice -= operations[i].first_count;
+		}
+		if (i == OPERATION_COUNT) {
+			break;
+		}
+		run_slice(&state, &operations[i], slice);
+	}
+
+	return NULL;
+}
+
+/**
+ * /brief Runs an operation over every second input and F for one first input.
+ *
+ * @param state: This thread's CPU.
+ * @param operation: The operation to run.
+ * @param first: The accumulator, or bit number for BIT.
+ */
+void run_slice(CPUState *state, Operation *operation, unsigned char first) {
+	int second, flags;
+
+	for (second = 0; second < operation->second_count; second++) {
+		for (flags = 0; flags < FLAG_COMBINATIONS << 4; flags += 0x10) {
+			Mismatch mismatch = {first, second, flags};
+			Register8 result;
+
+			discard_pending_flags(&state->F);
+			state->A = first;
+			state->F = flags;
+			result = operation->subject(state, first, second);
+			materialise_flags(&state->F);
+
+			mismatch.expected = operation->model(first, second, flags);
+			mismatch.actual = (result << 8) | state->F;
+			if (mismatch.expected != mismatch.actual) {
+				note_mismatch(operation, &mismatch);
+			}
+		}
+	}
+
+	atomic_fetch_add(&cases_run, operation->second_count * FLAG_COMBINATIONS);
+}
+
+/**
+ * /brief Counts a disagreement, keeping the first few to print once every thread is done.
+ */
+void note_mismatch(Operation *operation, Mismatch *mismatch) {
+	pthread_mutex_lock(&report_lock);
+	if (operation->mismatch_count < REPORTED_MISMATCHES) {
+		operation->mismatches[operation->mismatch_count] = *mismatch;
+	}
+	++operation->mismatch_count;
+	pthread_mutex_unlock(&report_lock);
+}
+
+/**
+ * /brief Prints a disagreement with the inputs that caused it.
+ *
+ * e.g. "ADC A,(HL) with A=3F (HL)=01 F=10: expected A=41 F=20, got A=41 F=00"
+ */
+void print_mismatch(Operation *operation, Mismatch *mismatch) {
+	printf("\t%s with", operation->name);
+	if (operation->first_input) {
+		printf(" %s=%02X", operation->first_input, mismatch->first);
+	}
+	if (operation->second_input) {
+		printf(" %s=%02X", operation->second_input, mismatch->second);
+	}
+	printf(" F=%02X: expected %s=%02X F=%02X, got %s=%02X F=%02X\n", mismatch->flags,
+		operation->result, mismatch->expected >> 8, mismatch->expected & 0xFF,
+		operation->result, mismatch->actual >> 8, mismatch->actual & 0xFF);
+}
+
+void check_value(const char *description, unsigned long expected, unsigned long actual) {
+	if (expected != actual) {
+		++failures;
+		printf("\tFAILURE :_(\n");
+		printf("\t%s:\n\t\tExpected: %lu\n\t\tActual: %lu\n\n", description, expected, actual);
+	}
+	else {
+		++successes;
+		printf("\tSUCCESS!\n\n");
+	}
+}
@@ -0,0 +1,139 @@
+/**
+ * This module holds the long hand flag calculations for the 8 bit ALU.
+ *
+ * The instructions themselves no longer call these. alu_table_gen runs every possible
+ * operand through them at build time to produce the lookup tables in alu_tables.c, and
+ * alu_table_test checks the instructions against them. So these stay the definition of
+ * what the flags should be, and are written for clarity rather than speed.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "alu_reference.h"
+
+/**
+ * /brief Sets the flags after an 8bit addition operation
+ * 
+ * Per the specs of the Zilog z80 processor: Z will be set if result is 0, N will be reset
+ * H will be set if there's a carry out from bit 3 in the add and C will be set if there's
+ * a carry from bit 7.
+ *
+ * @param result: The result of the addition operation
+ * @param old_accumulator: The value in the accumulator before the add
+ * @param carry: The carry that was fed into the add (0 or 1). When a carry is fed in, 
+ * 		a result equal to the old accumulator means we wrapped all the way around.
+ *
+ * @return: The new value to be stored in the flags register. 
+ */
+Register8 reference_flags_add(Register8 result, Register8 old_accumulator, unsigned char carry) {
+	// Constructing the new flag values
+	Register8 new_flags = 0;
+	new_flags |= ((result == 0) << ZERO_FLAG_POS);				// Set Zero flag
+	new_flags |= ((result < old_accumulator) || (carry && result == old_accumulator)) << CARRY_FLAG_POS;	// Set Carry Flag
+
+	// The half carry flag is a bit more sophisticated. We must look at the 
+	// lower nibble of the both the result and the accumulator. If the result's 
+	// lower nibble is less than that of the accumulator then we know to set our 
+	// half carry flag. One should note the similarity to how we do the full 8-bit
+	// carry flag above.
+	Register8 lower_nibble_result = result & 0x0F;
+	Register8 lower_nibble_accumulator = old_accumulator & 0x0F;
+
+	// Useful output for debugging
+	#ifdef VERBOSE
+		printf("Result: %d, Old Accumulator: %d\n", result, old_accumulator);
+		printf("Lower Nibble Result: %d, Lower Nibble Accumulator: %d\n", lower_nibble_result, lower_nibble_accumulator);
+	#endif
+	
+	new_flags |= ((lower_nibble_result < lower_nibble_accumulator) || 
+		(carry && lower_nibble_result == lower_nibble_accumulator)) << HALF_CARRY_FLAG_POS;
+	return new_flags;
+}
+
+/**
+ * /brief Sets the flags after an 8bit subtraction operation
+ * 
+ * Per the specs of the Zilog z80 processor: Z will be set if the result is zero, 
+ * N will be set (as the operation was a subtraction), H will be set if there was no
+ * borrow from bit 4 while C will be set if there was no borrow in the overall operation
+ *
+ * @param reuslt: The result of the subtraction operation
+ * @param old_accumulator: The value in the accumulator before the subtraction
+ * @param carry: The carry (borrow) that was fed into the subtraction (0 or 1).
+ *
+ * @result: The new value to be stored in the flags register
+ */
+Register8 reference_flags_sub(Register8 result, Register8 old_accumulator, unsigned char carry) {
+	// Constructing the new flag values
+	Register8 new_flags = 0;
+
+	new_flags |= (result == 0) << ZERO_FLAG_POS;				// Set Zero Flag
+	new_flags |= 0x1 << SUB_FLAG_POS;							// Set Subtraction Flag
+	new_flags |= ((result > old_accumulator) || (carry && result == old_accumulator)) << CARRY_FLAG_POS;	// Set Carry Flag
+
+	// The half carry flag is a bit more sophisticated. We must look at the 
+	// lower nibble of the both the result and the accumulator. If the result's 
+	// lower nibble is greater than that of the accumulator then we know to set our 
+	// half carry flag. One should note the similarity to how we do the full 8-bit
+	// carry flag above.
+	Register8 lower_nibble_result = result & 0x0F;
+	Register8 lower_nibble_accumulator = old_accumulator & 0x0F;
+
+	// Useful output for debugging
+	#ifdef VERBOSE
+		printf("Result: %d, Old Accumulator: %d\n", result, old_accumulator);
+		printf("Lower Nibble Result: %d, Lower Nibble Accumulator: %d\n", lower_nibble_result, lower_nibble_accumulator);
+	#endif
+
+	new_flags |= ((lower_nibble_result > lower_nibble_accumulator) || 
+		(carry && lower_nibble_result == lower_nibble_accumulator)) << HALF_CARRY_FLAG_POS;
+	return new_flags;
+}
+
+/**
+ * /brief Converts a value to Binary Coded Decimal after an add or subtract
+ *
+ * The long hand version of DAA. I followed along with this explination of the operation:
+ * http://sgate.emt.bme.hu/patai/publications/z80guide/app1b.html
+ * The subtraction case (N set) follows the same table run backwards.
+ *
+ * @param accumulator: The value in the accumulator
+ * @param flags: The flags left by the add or subtract
+ *
+ * @return: The adjusted accumulator in the upper byte and the new flags in the lower byte,
+ * 		the same way round as AF.
+ */
+Register16 reference_decimal_adjust(Register8 accumulator, Register8 flags) {
+	unsigned char new_flags = flags & 0x40;		// Operation preserves the N bit
+
+	if (!(flags & 0x40)) {
+		// The last operation was an add. Deal with the upper nibble first as the 
+		// lower nibble's adjustment can't push it over 0x99 on its own.
+		if ((flags & 0x10) || accumulator > 0x99) {
+			accumulator += 0x60;	// Read as 0$60
+			new_flags |= 0x10;		// Per specifications, turn on carry bit
+		}
+
+		// Now we deal with the lower nibble of our value
+		if ((flags & 0x20) || (0x0F & accumulator) > 0x09) {
+			accumulator += 0x06;	// Read as 0$06
+		}
+	}
+	else {
+		// After a subtraction we can only undo borrows that actually happened.
+		if (flags & 0x10) {
+			accumulator -= 0x60;
+			new_flags |= 0x10;		// Carry stays set
+		}
+
+		if (flags & 0x20) {
+			accumulator -= 0x06;
+		}
+	}
+
+	// Now we set our flags. The half carry is always consumed.
+	new_flags |= ((accumulator == 0) << 7);
+	return (accumulator << 8) | new_flags;
+}
@@ -0,0 +1,18 @@
+/**
+ * A header file for the reference ALU flag calculations, which the lookup tables in
+ * alu_tables.h are generated from and checked against.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef ALU_REFERENCE_H
+#define ALU_REFERENCE_H
+
+#include "register.h"
+
+// See alu_reference.c for more thorough explination of these functions
+Register8 reference_flags_add(Register8 result, Register8 old_accumulator, unsigned char carry);
+Register8 reference_flags_sub(Register8 result, Register8 old_accumulator, unsigned char carry);
+Register16 reference_decimal_adjust(Register8 accumulator, Register8 flags);
+
+#endif // ALU_REFERENCE_H
@@ -0,0 +1,102 @@
+/**
+ * Writes out the 8 bit ALU lookup tables declared in alu_tables.h as C source.
+ *
+ * Run at build time: every operand, accumulator and carry is put through the long hand
+ * calculations in alu_reference.c and the result and flags are written out as const
+ * arrays. The output goes to stdout.
+ *
+ * Usage: alu_table_gen > alu_tables.c
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "alu_reference.h"
+
+#define ENTRIES_PER_LINE 	16
+
+void print_entry(Register16 entry, unsigned int index);
+Register16 add_entry(Register8 accumulator, Register8 operand, unsigned char carry);
+Register16 sub_entry(Register8 accumulator, Register8 operand, unsigned char carry);
+
+int main() {
+	unsigned int carry, accumulator, operand, flags;
+
+	printf("/*\n * Generated by alu_table_gen. Do not edit!\n */\n\n#include \"alu_tables.h\"\n\n");
+
+	printf("const Register16 alu_add_table[2][256][256] = {\n");
+	for (carry = 0; carry < 2; carry++) {
+		for (accumulator = 0; accumulator < 256; accumulator++) {
+			for (operand = 0; operand < 256; operand++) {
+				print_entry(add_entry(accumulator, operand, carry), (carry << 16) | (accumulator << 8) | operand);
+			}
+		}
+	}
+	printf("};\n\n");
+
+	printf("const Register16 alu_sub_table[2][256][256] = {\n");
+	for (carry = 0; carry < 2; carry++) {
+		for (accumulator = 0; accumulator < 256; accumulator++) {
+			for (operand = 0; operand < 256; operand++) {
+				print_entry(sub_entry(accumulator, operand, carry), (carry << 16) | (accumulator << 8) | operand);
+			}
+		}
+	}
+	printf("};\n\n");
+
+	printf("const Register16 alu_increment_table[256] = {\n");
+	for (operand = 0; operand < 256; operand++) {
+		print_entry(add_entry(operand, 1, 0), operand);
+	}
+	printf("};\n\n");
+
+	printf("const Register16 alu_decrement_table[256] = {\n");
+	for (operand = 0; operand < 256; operand++) {
+		print_entry(sub_entry(operand, 1, 0), operand);
+	}
+	printf("};\n\n");
+
+	printf("const Register16 alu_decimal_adjust_table[16][256] = {\n");
+	for (flags = 0; flags < 16; flags++) {
+		for (accumulator = 0; accumulator < 256; accumulator++) {
+			print_entry(reference_decimal_adjust(accumulator, flags << 4), (flags << 8) | accumulator);
+		}
+	}
+	printf("};\n");
+
+	return 0;
+}
+
+/**
+ * /brief Prints a table entry, starting a new line every so often.
+ *
+ * @param entry: The entry to print.
+ * @param index: Position of the entry in the table, flattened.
+ */
+void print_entry(Register16 entry, unsigned int index) {
+	printf("%s0x%04X,%s", index % ENTRIES_PER_LINE ? " " : "\t", entry,
+		index % ENTRIES_PER_LINE == ENTRIES_PER_LINE - 1 ? "\n" : "");
+}
+
+/**
+ * /brief Works out the table entry for an add.
+ *
+ * @param accumulator: The value in the accumulator before the add.
+ * @param operand: The value added to it.
+ * @param carry: The carry fed in (0 or 1).
+ *
+ * @return The result in the upper byte, the flags in the lower.
+ */
+Register16 add_entry(Register8 accumulator, Register8 operand, unsigned char carry) {
+	Register8 result = accumulator + operand + carry;
+	return (result << 8) | reference_flags_add(result, accumulator, carry);
+}
+
+/**
+ * /brief Works out the table entry for a subtract. See add_entry.
+ */
+Register16 sub_entry(Register8 accumulator, Register8 operand, unsigned char carry) {
+	Register8 result = accumulator - operand - carry;
+	return (result << 8) | reference_flags_sub(result, accumulator, carry);
+}
@@ -0,0 +1,153 @@
+/*
+ * Checks the 8 bit ALU instructions, which now get their answers from the lookup tables
+ * in alu_tables.c, against the long hand calculations in alu_reference.c. Every
+ * accumulator, operand and carry is tried, so between them alutest and this cover both
+ * what the answers should be and that the tables give them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "register.h"
+#include "instructions.h"
+#include "alu_reference.h"
+
+#define REPORTED_MISMATCHES 4
+
+typedef void (*RegisterOperation)(Register8 *accumulator, Register8 *other_register, Register8 *flags);
+
+int successes;
+int failures;
+
+unsigned char *memory_space = NULL;
+
+void test_operation(const char *description, RegisterOperation operation, int subtract, int with_carry, int keep_result);
+void test_step(const char *description, void (*step)(Register8 *target_register, Register8 *flags), int subtract);
+void test_decimal_adjust();
+void report_mismatch(int *mismatches, const char *description, unsigned int input, Register16 expected, Register16 actual);
+void check_value(const char *description, unsigned short expected, unsigned short actual);
+
+int main() {
+	successes = 0;
+	failures = 0;
+
+	test_operation("ADD", add_register, 0, 0, 1);
+	test_operation("ADC", add_register_with_carry, 0, 1, 1);
+	test_operation("SUB", subtract_register, 1, 0, 1);
+	test_operation("SBC", subtract_register_with_carry, 1, 1, 1);
+	test_operation("CP", compare_register, 1, 0, 0);
+	test_step("INC", increment_register, 0);
+	test_step("DEC", decrement_register, 1);
+	test_decimal_adjust();
+
+	printf("\n\nTESTING COMPLETE!\n\t%d Successes\n\t%d Failures\n", successes, failures);
+	return failures != 0;
+}
+
+/**
+ * /brief Runs an 8 bit add or subtract over every accumulator, operand and carry in.
+ *
+ * @param description: Name of the operation for the print out.
+ * @param operation: The instruction under test.
+ * @param subtract: 1 if the operation subtracts, 0 if it adds.
+ * @param with_carry: 1 if the carry flag is fed into the operation.
+ * @param keep_result: 0 if the accumulator should be left alone (CP).
+ */
+void test_operation(const char *description, RegisterOperation operation, int subtract, int with_carry, int keep_result) {
+	unsigned int accumulator, operand, carry;
+	int mismatches = 0;
+
+	printf("Test: %s over every operand\n", description);
+	for (carry = 0; carry < 2; carry++) {
+		for (accumulator = 0; accumulator < 256; accumulator++) {
+			for (operand = 0; operand < 256; operand++) {
+				unsigned char carry_in = carry && with_carry;
+				Register8 result = subtract ? accumulator - operand - carry_in : accumulator + operand + carry_in;
+				Register8 expected_flags = subtract ? reference_flags_sub(result, accumulator, carry_in) :
+					reference_flags_add(result, accumulator, carry_in);
+				Register8 a = accumulator, other = operand, flags = carry << CARRY_FLAG_POS;
+
+				operation(&a, &other, &flags);
+				if (!keep_result) {
+					result = accumulator;
+				}
+				report_mismatch(&mismatches, description, (carry << 16) | (accumulator << 8) | operand,
+					(result << 8) | expected_flags, (a << 8) | flags);
+			}
+		}
+	}
+	check_value("Mismatches", 0, mismatches);
+}
+
+/**
+ * /brief Runs an increment or decrement over every value.
+ *
+ * The handlers set the carry as an add or subtract of 1 would, the opcode adapters put the
+ * old one back afterwards.
+ *
+ * @param description: Name of the operation for the print out.
+ * @param step: The instruction under test.
+ * @param subtract: 1 for a decrement, 0 for an increment.
+ */
+void test_step(const char *description, void (*step)(Register8 *target_register, Register8 *flags), int subtract) {
+	unsigned int value;
+	int mismatches = 0;
+
+	printf("Test: %s over every value\n", description);
+	for (value = 0; value < 256; value++) {
+		Register8 result = subtract ? value - 1 : value + 1;
+		Register8 expected_flags = subtract ? reference_flags_sub(result, value, 0) : reference_flags_add(result, value, 0);
+		Register8 target = value, flags = 0;
+
+		step(&target, &flags);
+		report_mismatch(&mismatches, description, value, (result << 8) | expected_flags, (target << 8) | flags);
+	}
+	check_value("Mismatches", 0, mismatches);
+}
+
+/**
+ * /brief Runs DAA over every accumulator and combination of flags.
+ */
+void test_decimal_adjust() {
+	unsigned int accumulator, flags;
+	int mismatches = 0;
+
+	printf("Test: DAA over every accumulator and flag combination\n");
+	for (flags = 0; flags < 0x100; flags += 0x10) {
+		for (accumulator = 0; accumulator < 256; accumulator++) {
+			Register8 a = accumulator, f = flags;
+
+			decimal_adjust_accumulator(&a, &f);
+			report_mismatch(&mismatches, "DAA", (flags << 8) | accumulator,
+				reference_decimal_adjust(accumulator, flags), (a << 8) | f);
+		}
+	}
+	check_value("Mismatches", 0, mismatches);
+}
+
+/**
+ * /brief Counts a disagreement, printing the first few.
+ *
+ * @param mismatches: Running count for the operation.
+ * @param description: Name of the operation.
+ * @param input: The inputs, packed for printing.
+ * @param expected: Result and flags, as AF, per alu_reference.c.
+ * @param actual: Result and flags, as AF, the instruction gave.
+ */
+void report_mismatch(int *mismatches, const char *description, unsigned int input, Register16 expected, Register16 actual) {
+	if (expected != actual && (*mismatches)++ < REPORTED_MISMATCHES) {
+		printf("\t%s with input %05X: expected %04X, got %04X\n", description, input, expected, actual);
+	}
+}
+
+void check_value(const char *description, unsigned short expected, unsigned short actual) {
+	if (expected != actual) {
+		++failures;
+		printf("\tFAILURE :_(\n");
+		printf("\t%s:\n\t\tExpected: %X\n\t\tActual: %X\n\n", description, expected, actual);
+	}
+	else {
+		++successes;
+		printf("\tSUCCESS!\n\n");
+	}
+}
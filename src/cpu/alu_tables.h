@@ -0,0 +1,24 @@
+/**
+ * A header file for the 8 bit ALU lookup tables.
+ *
+ * Each entry holds the result of the operation in its upper byte and the flags it leaves
+ * in its lower byte, the same way round as AF. So an add is one load, whatever the
+ * operands. The tables are written out at build time by alu_table_gen from the long hand
+ * calculations in alu_reference.c. Together they come to a little over 512KB, the bulk of
+ * it being the add and subtract tables. A game only ever touches a small corner of them.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef ALU_TABLES_H
+#define ALU_TABLES_H
+
+#include "register.h"
+
+extern const Register16 alu_add_table[2][256][256];			// [carry in][accumulator][operand]
+extern const Register16 alu_sub_table[2][256][256];			// [carry (borrow) in][accumulator][operand]
+extern const Register16 alu_increment_table[256];			// [value]. Carry as an add of 1 would leave it
+extern const Register16 alu_decrement_table[256];			// [value]. Carry as a subtract of 1 would leave it
+extern const Register16 alu_decimal_adjust_table[16][256];	// [upper nibble of F][accumulator]
+
+#endif // ALU_TABLES_H
@@ -0,0 +1,157 @@
+/**
+ * This module contains the ahead of time core: it runs the C the recompiler wrote out for
+ * one particular ROM, and the interpreter whenever that C hands back.
+ *
+ * The generated code hands back when the programme counter lands somewhere that wasn't
+ * recompiled (most often the target of a JP (HL)), when there isn't enough of the budget
+ * left to run a whole block, or when recompiled code has been written over. In each case
+ * the interpreter runs a single instruction and we try the recompiled code again.
+ *
+ * Recompiled ROM pages are flagged in code_pages, just like the block cache does for the
+ * code it holds. A write to one marks it dirty and the blocks on it are never run again,
+ * the interpreter seeing to them from then on. Should the ROM in memory not be the one
+ * that was recompiled, everything is interpreted.
+ *
+ * Interrupts are taken by the generated code itself, which then carries on at the vector
+ * (recompiled along with everything else).
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "aot.h"
+#include "dispatch.h"
+#include "idle.h"
+#include "disassembler.h"
+#include "../memory/cart.h"
+
+#define HOT_SPOTS_REPORTED 	8
+
+unsigned char aot_dirty_pages[CODE_PAGE_COUNT];
+unsigned char aot_code_written;
+
+AotStats aot_stats;
+
+static unsigned long interpreted_at[MEMORY_SPACE_SIZE];		// Instructions the interpreter ran, by address
+
+/**
+ * /brief Notes that recompiled code has been written over.
+ *
+ * Called by write_byte. The generated code checks aot_code_written after anything which
+ * writes to memory and leaves if it was set.
+ *
+ * @param page: The code page that was written to.
+ */
+static void dirty_code_page(unsigned short page) {
+	aot_dirty_pages[page] = 1;
+	aot_code_written = 1;
+	code_pages[page] = 0;
+	++aot_stats.invalidations;
+}
+
+/**
+ * /brief Checks the ROM in memory is the one that was recompiled.
+ *
+ * @return 1 if it is. 0 otherwise.
+ */
+static int rom_matches() {
+	unsigned short global_checksum = (read_byte(GLOBAL_CHECKSUM_ADDRESS) << 8) | read_byte(GLOBAL_CHECKSUM_ADDRESS + 1);
+
+	return read_byte(HEADER_CHECKSUM_ADDRESS) == aot_rom.header_checksum && global_checksum == aot_rom.global_checksum;
+}
+
+/**
+ * /brief Runs the CPU for a set number of instructions out of the recompiled ROM.
+ *
+ * Behaves exactly like run_instructions in dispatch.c.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions_aot(CPUState *state, unsigned long instruction_count) {
+	static int checked = 0, matches = 0;
+	unsigned long executed = 0;
+	int page;
+
+	if (!checked) {
+		checked = 1;
+		matches = rom_matches();
+		if (!matches) {
+			fprintf(stderr, "The aot core was recompiled from %s. Interpreting this ROM instead\n", aot_rom.game_name);
+		}
+		else {
+			for (page = 0; page < CODE_PAGE_COUNT; page++) {
+				if (aot_code_pages[page]) {
+					flag_code_page(page);
+				}
+			}
+			code_page_written = dirty_code_page;
+		}
+	}
+
+	if (!matches) {
+		aot_stats.interpreted_executed += instruction_count;
+		return run_instructions(state, instruction_count);
+	}
+
+	while (executed < instruction_count) {
+		unsigned long compiled = aot_run_compiled(state, instruction_count - executed);
+		executed += compiled;
+		aot_stats.compiled_executed += compiled;
+		aot_code_written = 0;
+
+		if (state->halted) {
+			executed += sleep_while_halted(state, instruction_count - executed);
+		}
+
+		if (executed < instruction_count) {
+			unsigned long window = run_ei_window(state, instruction_count - executed);
+
+			if (window == 0) {
+				++interpreted_at[state->PC];		// Not for an EI's, which is no hot spot
+				window = run_instructions(state, 1);
+			}
+			executed += window;
+			++aot_stats.interpreted_executed;
+		}
+	}
+
+	return executed;
+}
+
+/**
+ * /brief Prints how much was run from recompiled code, and where the interpreter spent its time.
+ *
+ * Hot spots in ROM are likely jump table targets the recompiler couldn't see. Passing
+ * them to the recompiler with -e brings them into the recompiled code.
+ */
+void print_aot_stats() {
+	AotStats *stats = &aot_stats;
+	unsigned long total = stats->compiled_executed + stats->interpreted_executed;
+	int i, address;
+	char text[DISASSEMBLY_MAX];
+
+	printf("Ahead of time core (%s):\n", aot_rom.game_name);
+	printf("\tRecompiled: %u blocks, %u instructions\n", aot_rom.block_count, aot_rom.instruction_count);
+	printf("\tRun from recompiled code: %.4f%%\n", total ? 100.0 * stats->compiled_executed / total : 0.0);
+	printf("\tInterpreted: %lu instructions\n", stats->interpreted_executed);
+	printf("\tInvalidated pages: %lu\n", stats->invalidations);
+
+	for (i = 0; i < HOT_SPOTS_REPORTED; i++) {
+		int hottest = -1;
+		for (address = 0; address < MEMORY_SPACE_SIZE; address++) {
+			if (interpreted_at[address] && (hottest < 0 || interpreted_at[address] > interpreted_at[hottest])) {
+				hottest = address;
+			}
+		}
+		if (hottest < 0) {
+			break;
+		}
+		disassemble_at(hottest, text, sizeof(text));
+		printf("\tInterpreted hot spot: %04X %-16s (%lu times)\n", hottest, text, interpreted_at[hottest]);
+		interpreted_at[hottest] = 0;
+	}
+}
@@ -0,0 +1,50 @@
+/**
+ * A header file for the ahead of time core, which runs C recompiled from one particular
+ * ROM by the recompiler (see recompiler.c) and falls back on the interpreter for anything
+ * the recompiler couldn't find.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef AOT_H
+#define AOT_H
+
+#include "register.h"
+#include "../memory/memory.h"
+
+/**
+ * Describes the ROM the generated code came from, so it is never run against another.
+ */
+typedef struct {
+	const char *game_name;				/** As it appears in the cart header */
+	unsigned char header_checksum;		/** From the cart header */
+	unsigned short global_checksum;		/** From the cart header */
+	unsigned int block_count;			/** Blocks recompiled */
+	unsigned int instruction_count;		/** Instructions in all of those blocks */
+} AotRom;
+
+/**
+ * Running totals for seeing how much of a game the recompiler found.
+ */
+typedef struct {
+	unsigned long compiled_executed;		/** Instructions run from recompiled code */
+	unsigned long interpreted_executed;		/** Instructions the interpreter had to run */
+	unsigned long invalidations;			/** Pages of recompiled code that were written to */
+} AotStats;
+
+// Written out by the recompiler
+extern const AotRom aot_rom;
+extern const unsigned char aot_code_pages[CODE_PAGE_COUNT];
+unsigned long aot_run_compiled(CPUState *state, unsigned long budget);
+
+// Checked by the generated code. A page is dirty once recompiled code on it was written to
+extern unsigned char aot_dirty_pages[CODE_PAGE_COUNT];
+extern unsigned char aot_code_written;
+
+extern AotStats aot_stats;
+
+// See aot.c for more thorough explination of these functions
+unsigned long run_instructions_aot(CPUState *state, unsigned long instruction_count);
+void print_aot_stats();
+
+#endif // AOT_H
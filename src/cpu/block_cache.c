@@ -0,0 +1,282 @@
+/**
+ * This module contains the basic block cache core.
+ *
+ * The first time the CPU arrives at an address the instructions from there up to the
+ * next jump, call, return or interrupt toggle are run through the opcode tables once
+ * and stored as a block of handler/operand pairs. From then on the block is replayed
+ * without looking at the bytes again.
+ *
+ * Common runs of instructions are decoded into a single fused operation, see fusion.c.
+ *
+ * A block which jumps back to its own start without writing anything may be an idle loop.
+ * If a trip round it leaves the registers as they were, the trips up to the next hardware
+ * event are skipped, see idle.c.
+ *
+ * Each block is charged its cycles in one go once it has run, branches not taken. The
+ * adapters charge for a branch taken themselves.
+ *
+ * Blocks are looked up by address and ROM bank, as the same address in 0x4000 - 0x7FFF
+ * holds different code depending on the bank mapped in. The cache is direct mapped, so
+ * a new block simply replaces whatever was in its slot.
+ *
+ * Every page a block sits on is flagged in code_pages. write_byte calls back in here when
+ * it hits one of those pages and any block on the page is thrown away. This is how code
+ * copied into WRAM or HRAM (the OAM DMA routine for one) is kept honest. If a block
+ * writes over itself the rest of it is abandoned and the remainder decoded afresh.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "block_cache.h"
+#include "fusion.h"
+#include "idle.h"
+#include "instructions.h"
+#include "cycle_tables.h"
+#include "interrupts.h"
+#include "../memory/memory.h"
+
+static BasicBlock block_cache[BLOCK_CACHE_SIZE];
+
+BlockCacheStats block_cache_stats;
+
+/**
+ * /brief Throws away every block sitting on a code page.
+ *
+ * Called by write_byte. Only pages holding cached code get here, so scanning the whole
+ * cache is a price paid rarely.
+ *
+ * @param page: The code page that was written to.
+ */
+static void invalidate_code_page(unsigned short page) {
+	int i;
+
+	for (i = 0; i < BLOCK_CACHE_SIZE; i++) {
+		BasicBlock *block = &block_cache[i];
+		if (block->valid && block->first_page <= page && page <= block->last_page) {
+			block->valid = 0;
+			++block_cache_stats.invalidations;
+		}
+	}
+
+	code_pages[page] = 0;
+}
+
+/**
+ * /brief Decodes the block of instructions starting at an address.
+ *
+ * Stops after the first instruction which ends a block, when the block is full or
+ * when the next instruction would cross into another 16KB region (and so possibly
+ * another bank).
+ *
+ * @param block: Where to put the block.
+ * @param address: Address of the first instruction.
+ * @param bank: ROM bank the address is in.
+ */
+static void decode_block(BasicBlock *block, unsigned short address, unsigned short bank) {
+	unsigned short page, end;
+	int i;
+	unsigned char opcode;
+
+	block->start = address;
+	block->bank = bank;
+	block->length = 0;
+
+	do {
+		DecodedInstruction *instruction = &block->instructions[block->length++];
+		const Fusion *fusion = find_fusion(address, &instruction->operand);
+		const Opcode *entry;
+
+		if (fusion != NULL && ((address + fusion->length - 1) & 0xC000) == (block->start & 0xC000)) {
+			instruction->execute = fusion->execute;
+			instruction->length = fusion->length;
+			instruction->count = fusion->count;
+			instruction->cycles = fusion_cycles(address, fusion);
+			address += fusion->length;
+			opcode = fusion->ends_block ? 0x18 : 0x00;		// As good as a JR or a NOP for ending the block
+			block_cache_stats.fused_decoded += fusion->count;
+			continue;
+		}
+
+		opcode = read_byte(address);
+		entry = &primary_opcodes[opcode];
+		if (opcode == 0xCB) {
+			// Skip the prefix adapter and go straight to the second table
+			instruction->operand = read_byte(address + 1);
+			instruction->execute = cb_opcodes[instruction->operand].execute;
+		}
+		else {
+			instruction->operand = fetch_operand(address, entry->length);
+			instruction->execute = entry->execute;
+		}
+		instruction->length = entry->length;
+		instruction->count = 1;
+		instruction->cycles = instruction_cycles(address);
+		address += entry->length;
+	} while (!ends_block(opcode) && block->length < MAX_BLOCK_LENGTH &&
+			((address + 2) & 0xC000) == (block->start & 0xC000) && address > block->start);
+
+	block->first_page = block->start >> CODE_PAGE_SHIFT;
+	block->last_page = (unsigned short) (address - 1) >> CODE_PAGE_SHIFT;
+	for (page = block->first_page; page <= block->last_page; page++) {
+		flag_code_page(page);
+	}
+	code_page_written = invalidate_code_page;
+	block->valid = 1;
+
+	// Whether it does loop back to its start is only known once it has run
+	block->service_point = ends_block(opcode);
+	block->may_idle = ends_block(opcode);
+	for (end = address, address = block->start; block->may_idle && address != end; address += primary_opcodes[read_byte(address)].length) {
+		block->may_idle = idle_safe_instruction(address);
+	}
+
+	++block_cache_stats.blocks_decoded;
+	block->instruction_count = 0;
+	block->cycles = 0;
+	for (i = 0; i < block->length; i++) {
+		block->instruction_count += block->instructions[i].count;
+		block->cycles += block->instructions[i].cycles;
+	}
+	block_cache_stats.instructions_decoded += block->instruction_count;
+}
+
+/**
+ * /brief Finds the block starting at an address, decoding it if need be.
+ *
+ * @param address: Address of the first instruction.
+ *
+ * @return The block.
+ */
+static BasicBlock* find_block(unsigned short address) {
+	unsigned short bank = bank_of(address);
+	BasicBlock *block = &block_cache[(address ^ (bank << 7)) & (BLOCK_CACHE_SIZE - 1)];
+
+	++block_cache_stats.lookups;
+	if (block->valid && block->start == address && block->bank == bank) {
+		++block_cache_stats.hits;
+		return block;
+	}
+
+	decode_block(block, address, bank);
+	return block;
+}
+
+/**
+ * /brief Empties the cache and zeroes the statistics.
+ *
+ * Needed whenever memory is changed behind write_byte's back, e.g. when loading a ROM.
+ */
+void flush_block_cache() {
+	memset(block_cache, 0, sizeof(block_cache));
+	memset(code_pages, 0, sizeof(code_pages));
+	memset(&block_cache_stats, 0, sizeof(block_cache_stats));
+}
+
+/**
+ * /brief Runs the CPU for a set number of instructions out of the block cache.
+ *
+ * Behaves exactly like run_instructions in dispatch.c. The programme counter is kept
+ * up to date after every instruction, so a block can be left part way through when
+ * the instruction count runs out.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions_cached(CPUState *state, unsigned long instruction_count) {
+	unsigned long executed = 0;
+
+	while (executed < instruction_count) {
+		BasicBlock *block;
+		const DecodedInstruction *instruction, *end;
+		CPUState before;
+		unsigned long window = run_ei_window(state, instruction_count - executed);
+
+		if (window != 0) {
+			executed += window;
+			continue;
+		}
+
+		block = find_block(state->PC);
+		instruction = block->instructions;
+		end = instruction + block->length;
+
+		if (block->may_idle) {
+			materialise_flags(&state->F);
+			before = *state;
+		}
+
+		while (instruction < end) {
+			// A fused operation can't be split, so the interpreter sees out the budget
+			if (instruction->count > instruction_count - executed) {
+				executed += run_instructions(state, instruction_count - executed);
+				break;
+			}
+
+			state->PC += instruction->length;
+			instruction->execute(state, instruction->operand);
+			executed += instruction->count;
+			++instruction;
+
+			// The block may have just written over itself
+			if (!block->valid) {
+				break;
+			}
+		}
+
+		// Charge for the instructions run, all in one go if that's the whole block
+		if (instruction == end) {
+			state->cycles += block->cycles;
+		}
+		else {
+			const DecodedInstruction *run;
+			for (run = block->instructions; run < instruction; run++) {
+				state->cycles += run->cycles;
+			}
+		}
+
+		if (block->service_point && instruction == end) {
+			check_interrupts(state);
+		}
+
+		if (block->may_idle && instruction == end && state->PC == block->start) {
+			materialise_flags(&state->F);
+			if (same_registers(&before, state)) {
+				executed += skip_idle_loop(state, block->instruction_count, state->cycles - before.cycles,
+					instruction_count - executed);
+			}
+		}
+
+		if (state->halted) {
+			executed += sleep_while_halted(state, instruction_count - executed);
+		}
+	}
+
+	block_cache_stats.instructions_executed += executed;
+	return executed;
+}
+
+/**
+ * /brief Prints how well the cache has done so far.
+ */
+void print_block_cache_stats() {
+	BlockCacheStats *stats = &block_cache_stats;
+
+	printf("Block cache:\n");
+	printf("\tLookups: %lu\n", stats->lookups);
+	printf("\tHit rate: %.4f%%\n", stats->lookups ? 100.0 * stats->hits / stats->lookups : 0.0);
+	printf("\tBlocks decoded: %lu\n", stats->blocks_decoded);
+	printf("\tAverage block length (decoded): %.2f\n",
+		stats->blocks_decoded ? (double) stats->instructions_decoded / stats->blocks_decoded : 0.0);
+	printf("\tAverage block length (executed): %.2f\n",
+		stats->lookups ? (double) stats->instructions_executed / stats->lookups : 0.0);
+	printf("\tInvalidations: %lu\n", stats->invalidations);
+	printf("\tFused (decoded): %.2f%%\n",
+		stats->instructions_decoded ? 100.0 * stats->fused_decoded / stats->instructions_decoded : 0.0);
+	print_fusion_stats();
+	print_idle_stats();
+}
@@ -0,0 +1,111 @@
+/**
+ * A header file for the basic block cache core, which decodes straight line runs of
+ * instructions once and replays them from then on.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include "register.h"
+#include "dispatch.h"
+#include "../memory/memory.h"
+
+#define BLOCK_CACHE_SIZE 	4096	// Number of blocks held. Must be a power of two
+#define MAX_BLOCK_LENGTH 	32		// Most instructions a single block will hold
+
+/**
+ * An instruction which has already been through the opcode tables.
+ */
+typedef struct {
+	OpcodeHandler execute;		/** Adapter for the opcode. CB prefixed opcodes go straight to theirs */
+	unsigned short operand;		/** Immediate operand, already assembled. The CB opcode for those */
+	unsigned char length;		/** Length of the instruction in bytes */
+	unsigned char count;		/** Instructions it stands for. More than 1 when fused, see fusion.c */
+	unsigned char cycles;		/** Cycles they take, branches not taken */
+} DecodedInstruction;
+
+/**
+ * A run of instructions ending at the first jump, call, return or anything else
+ * which might leave the straight line.
+ */
+typedef struct {
+	unsigned short start;			/** Address of the first instruction */
+	unsigned short bank;			/** ROM bank the block was decoded from. 0 outside 0x4000 - 0x7FFF */
+	unsigned short first_page;		/** First code page the block's bytes sit on */
+	unsigned short last_page;		/** Last code page the block's bytes sit on */
+	unsigned char valid;			/** Cleared when the block's bytes are written to */
+	unsigned char length;			/** Number of instructions in the block */
+	unsigned char may_idle;			/** Loops back to its start without writing anything, see idle.c */
+	unsigned char service_point;	/** Ends with an instruction which ends a block, so interrupts are checked after it */
+	unsigned short instruction_count;	/** Instructions in the block, counting fused ones in full */
+	unsigned short cycles;			/** Cycles the whole block takes, branches not taken */
+	DecodedInstruction instructions[MAX_BLOCK_LENGTH];
+} BasicBlock;
+
+/**
+ * Running totals for tuning the cache.
+ */
+typedef struct {
+	unsigned long lookups;					/** Times a block was asked for */
+	unsigned long hits;						/** Times it was already there */
+	unsigned long blocks_decoded;			/** Blocks decoded, whether new or replacing another */
+	unsigned long instructions_decoded;		/** Instructions in all of those blocks */
+	unsigned long instructions_executed;	/** Instructions run from the cache */
+	unsigned long fused_decoded;			/** Decoded instructions which were part of a fused operation */
+	unsigned long invalidations;			/** Blocks thrown away because their code was written to */
+} BlockCacheStats;
+
+extern BlockCacheStats block_cache_stats;
+
+/**
+ * /brief Works out which bank of ROM an address falls in.
+ *
+ * @param address: The address in question.
+ *
+ * @return The bank mapped in if the address is in switchable ROM. 0 otherwise.
+ */
+static inline unsigned short bank_of(unsigned short address) {
+	if (address >= 0x4000 && address < 0x8000) {
+		return current_rom_bank;
+	}
+	return 0;
+}
+
+/**
+ * /brief Whether an opcode must be the last instruction of a block.
+ *
+ * Anything which can change the programme counter, or stop the CPU, ends a block. As do
+ * DI and EI, as they change whether interrupts are taken. Interrupts are checked for
+ * straight after any of these, in every core (see interrupts.c). Shared with the
+ * recompilers, which carve code up the same way.
+ *
+ * @param opcode: The primary opcode.
+ *
+ * @return 1 if the block ends with this opcode. 0 otherwise.
+ */
+static inline int ends_block(unsigned char opcode) {
+	switch (opcode) {
+		case 0x10: case 0x76: 									// STOP, HALT
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: 	// JR
+		case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: 	// JP
+		case 0xE9: 												// JP (HL)
+		case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: 	// CALL
+		case 0xC0: case 0xC8: case 0xC9: case 0xD0: case 0xD8: 	// RET
+		case 0xD9: 												// RETI
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: 			// RST
+		case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+		case 0xF3: case 0xFB: 									// DI, EI
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+// See block_cache.c for more thorough explination of these functions
+void flush_block_cache();
+unsigned long run_instructions_cached(CPUState *state, unsigned long instruction_count);
+void print_block_cache_stats();
+
+#endif // BLOCK_CACHE_H
@@ -0,0 +1,476 @@
+/**
+ * This module contains the guest call graph profiler, kept by PROFILE_COUNTS builds.
+ *
+ * call(), restart() and return_unconditional() in instructions.c are the only places the
+ * game's call stack changes (the conditional calls and returns go through them, as do
+ * interrupts), so that's where the profiler keeps its shadow of it. Each call moves to a
+ * node for the function called from the current one, making a tree of every chain of
+ * calls seen. A return pops back to the frame it returns to, found by its return address.
+ * Games which push an address and RET to it, or drop a return address and jump, leave the
+ * shadow stack as it was, as no frame matches.
+ *
+ * Cycles are charged as each instruction starts: everything since the last one started
+ * goes to the function that one ran in. The interpreters call call_graph_charge from the
+ * same hook that counts instructions (see profile.h), so like the rest of the profile
+ * the call graph is only kept by the table, threaded and pinned cores.
+ *
+ * At exit the tree is written out twice over:
+ * 	<prefix>_calls.folded: One line per chain of calls with its cycles, semicolons between
+ * 		the functions. What flamegraph.pl and speedscope read.
+ * 	<prefix>_calls.pb: A pprof profile (profile.proto), uncompressed.
+ *
+ * Functions are named from an RGBDS .sym file alongside the ROM if there is one, and by
+ * bank and address otherwise.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifdef PROFILE_COUNTS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "call_graph.h"
+#include "block_cache.h"
+
+#define SYMBOL_NAME_MAX 	64
+#define FUNCTION_NAME_MAX 	(SYMBOL_NAME_MAX + 16)
+#define ROOT_NAME 			"(root)"
+
+CallGraph call_graph = {.node_count = 1};
+
+/**
+ * A label from a .sym file.
+ */
+typedef struct {
+	unsigned long key;				/** Bank and address, as make_key builds them */
+	char name[SYMBOL_NAME_MAX];
+} Symbol;
+
+static Symbol *symbols = NULL;
+static int symbol_count = 0;
+
+/**
+ * A growing run of bytes, for building up the pprof profile.
+ */
+typedef struct {
+	unsigned char *data;
+	size_t length;
+	size_t capacity;
+} Buffer;
+
+/**
+ * /brief Puts a bank and address together so they sort bank first.
+ */
+static inline unsigned long make_key(unsigned short bank, unsigned short address) {
+	return ((unsigned long) bank << 16) | address;
+}
+
+/**
+ * /brief Finds the node for a function called from the current one, adding it if need be.
+ *
+ * @param bank: Bank of the function called.
+ * @param address: Where it starts.
+ *
+ * @return The node. The current one if there's no room left for another.
+ */
+static int find_callee(unsigned short bank, unsigned short address) {
+	CallNode *caller = &call_graph.nodes[call_graph.current];
+	int child;
+
+	for (child = caller->first_child; child != 0; child = call_graph.nodes[child].next_sibling) {
+		if (call_graph.nodes[child].address == address && call_graph.nodes[child].bank == bank) {
+			return child;
+		}
+	}
+
+	if (call_graph.node_count == CALL_GRAPH_MAX_NODES) {
+		return call_graph.current;
+	}
+	child = call_graph.node_count++;
+	call_graph.nodes[child] = (CallNode) {bank, address, call_graph.current, 0, caller->first_child, 0, 0};
+	caller->first_child = child;
+	return child;
+}
+
+/**
+ * /brief Pushes a frame for a call, restart or interrupt.
+ *
+ * @param return_address: Where the call will return to.
+ * @param target: The function called.
+ */
+void call_graph_call(unsigned short return_address, unsigned short target) {
+	int callee;
+
+	if (call_graph.depth == CALL_GRAPH_MAX_DEPTH) {
+		++call_graph.overflow;
+		return;
+	}
+
+	callee = find_callee(bank_of(target), target);
+	call_graph.stack[call_graph.depth].node = call_graph.current;
+	call_graph.stack[call_graph.depth].return_address = return_address;
+	++call_graph.depth;
+	++call_graph.nodes[callee].calls;
+	call_graph.current = callee;
+}
+
+/**
+ * /brief Pops back to the frame a return lands in.
+ *
+ * The nearest frame returning to the address wins, dropping any above it. If none does the
+ * RET wasn't a return as far as the shadow stack is concerned, and it is left alone.
+ *
+ * @param address: Where the return went.
+ */
+void call_graph_return(unsigned short address) {
+	int frame;
+
+	if (call_graph.overflow > 0) {
+		--call_graph.overflow;
+		return;
+	}
+
+	for (frame = call_graph.depth - 1; frame >= 0; frame--) {
+		if (call_graph.stack[frame].return_address == address) {
+			call_graph.current = call_graph.stack[frame].node;
+			call_graph.depth = frame;
+			return;
+		}
+	}
+}
+
+/*** SYMBOLS ***/
+
+/**
+ * /brief Orders symbols by bank then address.
+ */
+static int compare_symbols(const void *a, const void *b) {
+	unsigned long first = ((const Symbol *) a)->key, second = ((const Symbol *) b)->key;
+
+	return (first > second) - (first < second);
+}
+
+/**
+ * /brief Loads the RGBDS .sym file sitting alongside a ROM, if there is one.
+ *
+ * The file is the ROM's name with .sym in place of its extension. Each line is a bank and
+ * address in hex then a label, e.g. "01:4a2f Main.loop". Anything after a ';' is a comment.
+ *
+ * @param rom_path: Where the ROM was loaded from.
+ *
+ * @return How many symbols were loaded. 0 if there was no file.
+ */
+int load_symbols(const char *rom_path) {
+	char path[FILENAME_MAX], line[256], name[SYMBOL_NAME_MAX];
+	char *extension;
+	unsigned int bank, address;
+	int capacity = 0;
+	FILE *file;
+
+	snprintf(path, sizeof(path) - 4, "%s", rom_path);
+	extension = strrchr(path, '.');
+	if (extension == NULL || strchr(extension, '/') != NULL) {
+		extension = path + strlen(path);
+	}
+	strcpy(extension, ".sym");
+
+	file = fopen(path, "r");
+	if (file == NULL) {
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char *comment = strchr(line, ';');
+		if (comment != NULL) {
+			*comment = '\0';
+		}
+		if (sscanf(line, "%x:%x %63s", &bank, &address, name) != 3) {
+			continue;
+		}
+
+		if (symbol_count == capacity) {
+			capacity = capacity ? 2 * capacity : 256;
+			symbols = realloc(symbols, capacity * sizeof(Symbol));
+			if (symbols == NULL) {
+				fprintf(stderr, "ILLEGAL OPERATION: Out of memory loading %s\n", path);
+				abort();
+			}
+		}
+		symbols[symbol_count].key = make_key(bank, address);
+		strcpy(symbols[symbol_count].name, name);
+		++symbol_count;
+	}
+	fclose(file);
+
+	qsort(symbols, symbol_count, sizeof(Symbol), compare_symbols);
+	printf("Loaded %d symbols from %s\n", symbol_count, path);
+	return symbol_count;
+}
+
+/**
+ * /brief Names a function.
+ *
+ * The label at its address if there is one, or the nearest label before it in the same bank
+ * plus an offset. Failing that, its bank and address.
+ *
+ * @param node: The function's node.
+ * @param text: Where the name goes.
+ * @param size: Size of text.
+ */
+static void function_name(const CallNode *node, char *text, size_t size) {
+	unsigned long key = make_key(node->bank, node->address);
+	int low = 0, high = symbol_count - 1, found = -1;
+
+	if (node == &call_graph.nodes[0]) {
+		snprintf(text, size, "%s", ROOT_NAME);
+		return;
+	}
+
+	while (low <= high) {
+		int middle = (low + high) / 2;
+		if (symbols[middle].key <= key) {
+			found = middle;
+			low = middle + 1;
+		}
+		else {
+			high = middle - 1;
+		}
+	}
+
+	if (found >= 0 && symbols[found].key >> 16 == node->bank) {
+		if (symbols[found].key == key) {
+			snprintf(text, size, "%s", symbols[found].name);
+		}
+		else {
+			snprintf(text, size, "%s+0x%lX", symbols[found].name, key - symbols[found].key);
+		}
+	}
+	else {
+		snprintf(text, size, "%02X:%04X", node->bank, node->address);
+	}
+}
+
+/*** OUTPUT ***/
+
+/**
+ * /brief Writes out each chain of calls that was charged anything, root first.
+ *
+ * @param file: Where to write.
+ */
+static void write_folded(FILE *file) {
+	char name[FUNCTION_NAME_MAX];
+	int chain[CALL_GRAPH_MAX_DEPTH + 1];
+	int node, length, i;
+
+	for (node = 0; node < call_graph.node_count; node++) {
+		if (call_graph.nodes[node].cycles == 0) {
+			continue;
+		}
+
+		length = 0;
+		for (i = node; i != 0 && length < CALL_GRAPH_MAX_DEPTH; i = call_graph.nodes[i].parent) {
+			chain[length++] = i;
+		}
+		chain[length++] = 0;
+
+		while (length > 0) {
+			function_name(&call_graph.nodes[chain[--length]], name, sizeof(name));
+			fprintf(file, "%s%c", name, length > 0 ? ';' : ' ');
+		}
+		fprintf(file, "%lu\n", call_graph.nodes[node].cycles);
+	}
+}
+
+/**
+ * /brief Adds bytes to the end of a buffer.
+ */
+static void put_bytes(Buffer *buffer, const void *bytes, size_t length) {
+	if (buffer->length + length > buffer->capacity) {
+		buffer->capacity = 2 * (buffer->length + length);
+		buffer->data = realloc(buffer->data, buffer->capacity);
+		if (buffer->data == NULL) {
+			fprintf(stderr, "ILLEGAL OPERATION: Out of memory writing the call graph\n");
+			abort();
+		}
+	}
+	memcpy(buffer->data + buffer->length, bytes, length);
+	buffer->length += length;
+}
+
+/**
+ * /brief Adds a protobuf varint.
+ */
+static void put_varint(Buffer *buffer, unsigned long value) {
+	unsigned char byte;
+
+	do {
+		byte = value & 0x7F;
+		value >>= 7;
+		if (value) {
+			byte |= 0x80;
+		}
+		put_bytes(buffer, &byte, 1);
+	} while (value);
+}
+
+/**
+ * /brief Adds a protobuf integer field.
+ */
+static void put_integer_field(Buffer *buffer, int field, unsigned long value) {
+	put_varint(buffer, field << 3);
+	put_varint(buffer, value);
+}
+
+/**
+ * /brief Adds a protobuf length delimited field: a string, packed integers or a message.
+ */
+static void put_bytes_field(Buffer *buffer, int field, const void *bytes, size_t length) {
+	put_varint(buffer, (field << 3) | 2);
+	put_varint(buffer, length);
+	put_bytes(buffer, bytes, length);
+}
+
+/**
+ * /brief Adds a message field, built up in another buffer which is then emptied.
+ */
+static void put_message_field(Buffer *buffer, int field, Buffer *message) {
+	put_bytes_field(buffer, field, message->data, message->length);
+	message->length = 0;
+}
+
+/**
+ * /brief Orders bank and address keys.
+ */
+static int compare_keys(const void *a, const void *b) {
+	unsigned long first = *(const unsigned long *) a, second = *(const unsigned long *) b;
+
+	return (first > second) - (first < second);
+}
+
+/**
+ * /brief Writes out the tree as a pprof profile.
+ *
+ * Each function, the root included, becomes a Function and a Location with the same id,
+ * ids going in bank and address order from 1. Each chain of calls charged anything becomes
+ * a Sample, leaf first, with its cycles as the one value.
+ *
+ * @param file: Where to write.
+ */
+static void write_pprof(FILE *file) {
+	// String table indices. Function names follow, in id order
+	enum { EMPTY_STRING, CYCLES_STRING, COUNT_STRING, FIRST_NAME };
+
+	Buffer profile = {0}, message = {0}, inner = {0};
+	unsigned long *keys = malloc(call_graph.node_count * sizeof(unsigned long));
+	char name[FUNCTION_NAME_MAX];
+	int node, i, key_count = 0;
+
+	if (keys == NULL) {
+		fprintf(stderr, "ILLEGAL OPERATION: Out of memory writing the call graph\n");
+		abort();
+	}
+
+	// One function per distinct bank and address. The root's key, 0, sorts first
+	keys[key_count++] = 0;
+	for (node = 1; node < call_graph.node_count; node++) {
+		keys[key_count++] = make_key(call_graph.nodes[node].bank, call_graph.nodes[node].address) + 1;
+	}
+	qsort(keys, key_count, sizeof(unsigned long), compare_keys);
+	for (node = 1, i = 1; node < key_count; node++) {
+		if (keys[node] != keys[i - 1]) {
+			keys[i++] = keys[node];		// Dropping the repeats
+		}
+	}
+	key_count = i;
+
+	// One sample_type: type "cycles", unit "count"
+	put_integer_field(&message, 1, CYCLES_STRING);
+	put_integer_field(&message, 2, COUNT_STRING);
+	put_message_field(&profile, 1, &message);
+
+	for (node = 0; node < call_graph.node_count; node++) {
+		if (call_graph.nodes[node].cycles == 0) {
+			continue;
+		}
+
+		for (i = node; ; i = call_graph.nodes[i].parent) {
+			unsigned long key = i == 0 ? 0 : make_key(call_graph.nodes[i].bank, call_graph.nodes[i].address) + 1;
+			unsigned long *found = bsearch(&key, keys, key_count, sizeof(unsigned long), compare_keys);
+			put_varint(&inner, found - keys + 1);
+			if (i == 0) {
+				break;
+			}
+		}
+		put_message_field(&message, 1, &inner);		// location_id, packed
+		put_varint(&inner, call_graph.nodes[node].cycles);
+		put_message_field(&message, 2, &inner);		// value, packed
+		put_message_field(&profile, 2, &message);
+	}
+
+	for (i = 0; i < key_count; i++) {
+		put_integer_field(&inner, 1, i + 1);		// Line.function_id
+		put_integer_field(&message, 1, i + 1);		// Location.id
+		put_integer_field(&message, 3, keys[i] ? keys[i] - 1 : 0);	// Location.address, bank in the upper bits
+		put_message_field(&message, 4, &inner);
+		put_message_field(&profile, 4, &message);
+
+		put_integer_field(&message, 1, i + 1);		// Function.id
+		put_integer_field(&message, 2, FIRST_NAME + i);
+		put_integer_field(&message, 3, FIRST_NAME + i);
+		put_message_field(&profile, 5, &message);
+	}
+
+	put_bytes_field(&profile, 6, "", 0);
+	put_bytes_field(&profile, 6, "cycles", strlen("cycles"));
+	put_bytes_field(&profile, 6, "count", strlen("count"));
+	for (i = 0; i < key_count; i++) {
+		CallNode function = {(keys[i] - 1) >> 16, (keys[i] - 1) & 0xFFFF};
+		if (keys[i] == 0) {
+			snprintf(name, sizeof(name), "%s", ROOT_NAME);
+		}
+		else {
+			function_name(&function, name, sizeof(name));
+		}
+		put_bytes_field(&profile, 6, name, strlen(name));
+	}
+
+	fwrite(profile.data, 1, profile.length, file);
+	free(profile.data);
+	free(message.data);
+	free(inner.data);
+	free(keys);
+}
+
+/**
+ * /brief Writes the call graph out as <prefix>_calls.folded and <prefix>_calls.pb.
+ *
+ * @param prefix: Start of the file names.
+ */
+void write_call_graph(const char *prefix) {
+	char path[FILENAME_MAX];
+	FILE *file;
+
+	snprintf(path, sizeof(path), "%s_calls.folded", prefix);
+	file = fopen(path, "w");
+	if (file == NULL) {
+		perror(path);
+		return;
+	}
+	write_folded(file);
+	fclose(file);
+
+	snprintf(path, sizeof(path), "%s_calls.pb", prefix);
+	file = fopen(path, "wb");
+	if (file == NULL) {
+		perror(path);
+		return;
+	}
+	write_pprof(file);
+	fclose(file);
+
+	printf("Call graph: %d chains of calls, %d calls too deep to follow\n", call_graph.node_count, call_graph.overflow);
+}
+
+#endif // PROFILE_COUNTS
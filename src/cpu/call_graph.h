@@ -0,0 +1,83 @@
+/**
+ * A header file for the guest call graph profiler: a shadow of the game's call stack,
+ * kept at every CALL, RST, interrupt and return, which emulated cycles are charged to.
+ *
+ * Only built with PROFILE_COUNTS, along with the rest of the execution profile (see
+ * profile.h). Otherwise the hooks below expand to nothing.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef CALL_GRAPH_H
+#define CALL_GRAPH_H
+
+#define CALL_GRAPH_MAX_DEPTH 	256		// Deeper calls are charged to the frame at this depth
+#define CALL_GRAPH_MAX_NODES 	65536	// Chains of calls past this many are charged to the caller
+
+#ifdef PROFILE_COUNTS
+
+/**
+ * A function as reached by one particular chain of calls. Node 0, the root, stands for
+ * whatever runs outside any call, starting with the entry point. As the root can't be
+ * anybody's child, 0 doubles as "none" below.
+ */
+typedef struct {
+	unsigned short bank;		/** ROM bank the function sits in. 0 outside 0x4000 - 0x7FFF */
+	unsigned short address;		/** Where the function starts */
+	int parent;					/** The caller's node */
+	int first_child;			/** First function called from here */
+	int next_sibling;			/** Next function called from the parent */
+	unsigned long cycles;		/** Cycles spent in the function itself, not its callees */
+	unsigned long calls;		/** Times it was called through this chain */
+} CallNode;
+
+/**
+ * Everything the profiler keeps.
+ */
+typedef struct {
+	CallNode nodes[CALL_GRAPH_MAX_NODES];	/** Every node so far, the root first */
+	int node_count;
+	int current;				/** Node of the function running now */
+	int charged;				/** Node the cycles since last_cycles go to */
+	unsigned long last_cycles;	/** Cycle count when the last instruction started */
+	int depth;					/** Frames on the shadow stack */
+	int overflow;				/** Calls past CALL_GRAPH_MAX_DEPTH not given frames of their own */
+	struct {
+		int node;					/** Node of the caller */
+		unsigned short return_address;	/** Where the call will return to */
+	} stack[CALL_GRAPH_MAX_DEPTH];
+} CallGraph;
+
+extern CallGraph call_graph;
+
+// See call_graph.c for more thorough explination of these functions
+void call_graph_call(unsigned short return_address, unsigned short target);
+void call_graph_return(unsigned short address);
+int load_symbols(const char *rom_path);
+void write_call_graph(const char *prefix);
+
+/**
+ * /brief Charges the cycles since the last instruction started to the function it ran in.
+ *
+ * Called by the interpreters as each instruction starts, so a CALL is charged to the
+ * caller and a RET to the callee.
+ *
+ * @param now: Cycle count as the instruction starts.
+ */
+static inline void call_graph_charge(unsigned long now) {
+	call_graph.nodes[call_graph.charged].cycles += now - call_graph.last_cycles;
+	call_graph.last_cycles = now;
+	call_graph.charged = call_graph.current;
+}
+
+#define PROFILE_CALL(return_address, target) 	call_graph_call(return_address, target)
+#define PROFILE_RETURN(address) 				call_graph_return(address)
+
+#else
+
+#define PROFILE_CALL(return_address, target) 	((void) 0)
+#define PROFILE_RETURN(address) 				((void) 0)
+
+#endif // PROFILE_COUNTS
+
+#endif // CALL_GRAPH_H
@@ -0,0 +1,50 @@
+/**
+ * This module keeps the list of CPU cores the emulator can be run with.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <string.h>
+
+#include "cores.h"
+#include "dispatch.h"
+#include "threaded.h"
+#include "pinned.h"
+#include "block_cache.h"
+#include "jit.h"
+#ifdef AOT_ROM
+	#include "aot.h"
+#endif
+
+const Core cores[] = {
+	{"table", run_instructions, "Plain table driven fetch/decode/execute loop", NULL},
+	{"threaded", run_instructions_threaded, "Computed goto interpreter with inlined handlers", NULL},
+	{"pinned", run_instructions_pinned, "Threaded interpreter with the registers held in locals", NULL, run_instructions_pinned_until},
+	{"cached", run_instructions_cached, "Replays pre-decoded basic blocks", print_block_cache_stats},
+	{"jit", run_instructions_jit, "Compiles hot blocks to x86-64", print_jit_stats},
+	{"jit-lockstep", run_instructions_jit_lockstep, "JIT checked against the table core after every block", print_jit_stats},
+#ifdef AOT_ROM
+	{"aot", run_instructions_aot, "Runs the ROM recompiled ahead of time, see recompiler.c", print_aot_stats},
+#endif
+};
+
+const int core_count = sizeof(cores) / sizeof(Core);
+
+/**
+ * /brief Looks up a core by name.
+ *
+ * @param name: Name of the core, as it would be given on the command line.
+ *
+ * @return The core with the given name, or NULL if there is no such core.
+ */
+const Core* find_core(const char *name) {
+	int i;
+
+	for (i = 0; i < core_count; i++) {
+		if (strcmp(cores[i].name, name) == 0) {
+			return &cores[i];
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,34 @@
+/**
+ * A header file listing the interchangeable CPU cores, so the front end (and the tests)
+ * can pick one by name at startup.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef CORES_H
+#define CORES_H
+
+#include "register.h"
+
+// Every core runs a given number of instructions and reports how many it executed.
+typedef unsigned long (*CoreRunner)(CPUState *state, unsigned long instruction_count);
+
+// Some can also stop once the cycle count reaches a limit, finishing the instruction which
+// reaches it.
+typedef unsigned long (*CoreSlicer)(CPUState *state, unsigned long instruction_count, unsigned long cycle_limit);
+
+typedef struct {
+	const char *name;			/** What the core is called on the command line */
+	CoreRunner run;				/** Runs the core */
+	const char *description;	/** One line summary for usage messages */
+	void (*print_stats)();		/** Prints anything the core kept count of. May be NULL */
+	CoreSlicer run_until;		/** Runs the core up to a cycle count as well. May be NULL */
+} Core;
+
+extern const Core cores[];
+extern const int core_count;
+
+// See cores.c for more thorough explination of these functions
+const Core* find_core(const char *name);
+
+#endif // CORES_H
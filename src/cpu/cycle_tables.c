@@ -0,0 +1,24 @@
+/**
+ * This module contains the cycle tables declared in cycle_tables.h, filled in from the
+ * cycles and taken columns of the opcode lists in opcodes.h.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "cycle_tables.h"
+#include "opcodes.h"
+
+#define CYCLES_ENTRY(code, adapter, length, cycles, taken, flags, mnemonic) [code] = cycles,
+#define TAKEN_ENTRY(code, adapter, length, cycles, taken, flags, mnemonic) [code] = taken,
+
+const unsigned char primary_cycles[256] = {
+	PRIMARY_OPCODES(CYCLES_ENTRY)
+};
+
+const unsigned char primary_cycles_taken[256] = {
+	PRIMARY_OPCODES(TAKEN_ENTRY)
+};
+
+const unsigned char cb_cycles[256] = {
+	CB_OPCODES(CYCLES_ENTRY)
+};
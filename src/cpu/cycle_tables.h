@@ -0,0 +1,42 @@
+/**
+ * A header file for the cycle tables: how long each opcode takes, in T-cycles (ticks of
+ * the 4.19MHz clock, so a NOP is 4).
+ *
+ * The tables are filled in from the cycles and taken columns of the opcode lists in
+ * opcodes.h, see cycle_tables.c.
+ *
+ * Conditional jumps, calls and returns cost primary_cycles when they fall through and
+ * primary_cycles_taken on top of that when they go. The cores charge the first a block at
+ * a time, while the adapters charge the second as the branch is taken.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef CYCLE_TABLES_H
+#define CYCLE_TABLES_H
+
+#include "../memory/memory.h"
+
+#define LONGEST_INSTRUCTION_CYCLES 24	// CALL taken. Nothing the CPU runs takes longer
+
+extern const unsigned char primary_cycles[256];			// 0 for the CB prefix, cb_cycles has it
+extern const unsigned char primary_cycles_taken[256];	// Extra for a branch taken. 0 for the rest
+extern const unsigned char cb_cycles[256];				// Prefix included
+
+/**
+ * /brief The cost of the instruction at an address, branches not taken.
+ *
+ * @param address: Address of the instruction.
+ *
+ * @return T-cycles it takes.
+ */
+static inline unsigned int instruction_cycles(unsigned short address) {
+	unsigned char opcode = read_byte(address);
+
+	if (opcode == 0xCB) {
+		return cb_cycles[read_byte(address + 1)];
+	}
+	return primary_cycles[opcode];
+}
+
+#endif // CYCLE_TABLES_H
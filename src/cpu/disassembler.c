@@ -0,0 +1,118 @@
+/**
+ * This module contains the disassembler.
+ *
+ * Every mnemonic in the opcode lists names its operand the way Pan Docs does: n8 and n16
+ * for immediates, a8 and a16 for addresses (a8 being an offset into 0xFF00 - 0xFFFF) and
+ * e8 for a signed offset. Disassembling an instruction is a matter of copying its
+ * mnemonic and filling in the operand where the placeholder sits. Relative jumps show
+ * the address they go to rather than the offset, which is what anyone reading a trace
+ * wants to know.
+ *
+ * disassemble only has the opcode lists to go on, so the recompiler can use it on the ROM
+ * it has loaded as well as the emulator on its memory.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "disassembler.h"
+#include "opcodes.h"
+
+typedef struct {
+	const char *mnemonic;
+	unsigned char length;
+} Disassembly;
+
+#define DISASSEMBLY_ENTRY(code, adapter, length, cycles, taken, flags, mnemonic) [code] = {mnemonic, length},
+
+static const Disassembly primary_disassembly[256] = {
+	PRIMARY_OPCODES(DISASSEMBLY_ENTRY)
+	[0xCB] = {"PREFIX CB", 2},
+};
+
+static const Disassembly cb_disassembly[256] = {
+	CB_OPCODES(DISASSEMBLY_ENTRY)
+};
+
+/**
+ * /brief Writes out the operand a placeholder stands for.
+ *
+ * @param placeholder: Start of the placeholder within the mnemonic.
+ * @param bytes: The instruction, opcode first.
+ * @param address: Where the instruction sits.
+ * @param text: Where the operand goes.
+ * @param size: Room left in text.
+ *
+ * @return Characters the placeholder took up in the mnemonic. 0 if it isn't one.
+ */
+static int write_operand(const char *placeholder, const unsigned char *bytes, unsigned short address, char *text, size_t size) {
+	unsigned short word = bytes[1] | (bytes[2] << 8);
+	signed char offset = (signed char) bytes[1];
+
+	if (strncmp(placeholder, "n16", 3) == 0 || strncmp(placeholder, "a16", 3) == 0) {
+		snprintf(text, size, "$%04X", word);
+		return 3;
+	}
+	if (strncmp(placeholder, "n8", 2) == 0) {
+		snprintf(text, size, "$%02X", bytes[1]);
+		return 2;
+	}
+	if (strncmp(placeholder, "a8", 2) == 0) {
+		snprintf(text, size, "$FF%02X", bytes[1]);
+		return 2;
+	}
+	if (strncmp(placeholder, "e8", 2) == 0) {
+		if (bytes[0] == 0x18 || (bytes[0] & 0xE7) == 0x20) {
+			snprintf(text, size, "$%04X", (unsigned short) (address + 2 + offset));	// JR, from the next instruction
+		}
+		else {
+			snprintf(text, size, "%d", offset);
+		}
+		return 2;
+	}
+	return 0;
+}
+
+/**
+ * /brief Disassembles a single instruction.
+ *
+ * @param bytes: The instruction, opcode first. Three bytes are always looked at.
+ * @param address: Where the instruction sits, for working out where relative jumps go.
+ * @param text: Where the text goes. DISASSEMBLY_MAX is always enough.
+ * @param size: Size of text.
+ *
+ * @return Length of the instruction in bytes.
+ */
+int disassemble(const unsigned char *bytes, unsigned short address, char *text, size_t size) {
+	const Disassembly *opcode = &primary_disassembly[bytes[0]];
+	const char *mnemonic;
+	size_t written = 0;
+
+	if (bytes[0] == 0xCB) {
+		opcode = &cb_disassembly[bytes[1]];
+	}
+
+	if (size == 0) {
+		return opcode->length;
+	}
+
+	for (mnemonic = opcode->mnemonic; *mnemonic != '\0' && written + 1 < size; ) {
+		int taken = write_operand(mnemonic, bytes, address, text + written, size - written);
+		if (taken) {
+			if (written > 0 && text[written - 1] == '+' && text[written] == '-') {
+				memmove(text + written - 1, text + written, strlen(text + written) + 1);	// SP+-2 reads better as SP-2
+				--written;
+			}
+			mnemonic += taken;
+			written += strlen(text + written);
+		}
+		else {
+			text[written++] = *mnemonic++;
+		}
+	}
+	text[written] = '\0';
+
+	return opcode->length;
+}
@@ -0,0 +1,35 @@
+/**
+ * A header file for the disassembler, which turns the bytes of an instruction back into
+ * text using the mnemonics in the opcode lists of opcodes.h.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <stddef.h>
+
+#include "../memory/memory.h"
+
+#define DISASSEMBLY_MAX 	24		// Room enough for the longest instruction, e.g. "LD HL,SP-128"
+
+// See disassembler.c for more thorough explination of these functions
+int disassemble(const unsigned char *bytes, unsigned short address, char *text, size_t size);
+
+/**
+ * /brief Disassembles the instruction at an address in memory.
+ *
+ * @param address: Where the instruction sits.
+ * @param text: Where the text goes. DISASSEMBLY_MAX is always enough.
+ * @param size: Size of text.
+ *
+ * @return Length of the instruction in bytes.
+ */
+static inline int disassemble_at(unsigned short address, char *text, size_t size) {
+	unsigned char bytes[3] = {read_byte(address), read_byte(address + 1), read_byte(address + 2)};
+
+	return disassemble(bytes, address, text, size);
+}
+
+#endif // DISASSEMBLER_H
@@ -0,0 +1,110 @@
+/**
+ * This module contains the plain opcode tables of the Z80-GB and the fetch/decode/execute
+ * loop that walks them.
+ *
+ * There is a 256 entry table for the primary opcodes and another 256 entry table for those
+ * behind the 0xCB prefix. Both are built from the opcode lists in opcodes.h, so each entry
+ * points at the adapter which calls the handler in instructions.c for that opcode. The run 
+ * loop then becomes a simple fetch, look up and call.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "dispatch.h"
+#include "opcodes.h"
+#include "idle.h"
+#include "interrupts.h"
+#include "block_cache.h"
+#include "profile.h"
+
+static void prefix_cb(CPUState *state, unsigned short operand) {
+	PROFILE_CB(operand);
+	cb_opcodes[operand].execute(state, operand);
+}
+
+/*** OPCODE TABLES ***/
+
+#define OPCODE_ENTRY(code, adapter, length, cycles, taken, flags, mnemonic) [code] = {adapter, length, flags, mnemonic},
+
+const Opcode primary_opcodes[256] = {
+	PRIMARY_OPCODES(OPCODE_ENTRY)
+	[0xCB] = {prefix_cb, 2, "----", "PREFIX CB"},
+};
+
+const Opcode cb_opcodes[256] = {
+	CB_OPCODES(OPCODE_ENTRY)
+};
+
+/*** RUN LOOP ***/
+
+/**
+ * /brief Fetches the immediate operand of an instruction.
+ *
+ * Reads the bytes that follow an opcode. Single byte operands are returned as is
+ * while two byte operands (stored little endian in memory) are assembled into the
+ * value they represent.
+ *
+ * @param address: Address of the opcode whose operand we are fetching.
+ * @param length: Length of the instruction in bytes, opcode included.
+ *
+ * @return The operand of the instruction. 0 if the instruction has none.
+ */
+unsigned short fetch_operand(unsigned short address, unsigned char length) {
+	switch (length) {
+		case 2:
+			return read_byte(address + 1);
+		case 3:
+			return read_byte(address + 1) | (read_byte(address + 2) << 8);
+		default:
+			return 0;
+	}
+}
+
+/**
+ * /brief Executes the instruction at the programme counter.
+ *
+ * Fetches the opcode at the programme counter, along with any operand it might have,
+ * advances the programme counter past the instruction, charges its cycles and then calls
+ * the appropriate handler. CB prefixed instructions are handled by the prefix adapter which looks up
+ * the second table.
+ *
+ * @param state: The CPU whose next instruction we are executing.
+ */
+void execute_instruction(CPUState *state) {
+	const Opcode *opcode = &primary_opcodes[read_byte(state->PC)];
+	unsigned short operand = fetch_operand(state->PC, opcode->length);
+
+	PROFILE_INSTRUCTION(state->PC, opcode - primary_opcodes, state->cycles);
+	state->cycles += instruction_cycles(state->PC);
+	state->PC += opcode->length;
+	opcode->execute(state, operand);
+}
+
+/**
+ * /brief Runs the CPU for a set number of instructions.
+ *
+ * The plain fetch/decode/execute loop. Note: a CB prefixed instruction counts as
+ * a single instruction. Interrupts are taken after instructions which end a block,
+ * as in every other core, and after the instruction following an EI. A halted CPU sleeps up to the next hardware event.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions(CPUState *state, unsigned long instruction_count) {
+	unsigned long executed;
+
+	for (executed = 0; executed < instruction_count; executed++) {
+		unsigned char opcode = read_byte(state->PC);
+		execute_instruction(state);
+		if (ends_block(opcode) || interrupt_controller.enable_delay) {
+			check_interrupts(state);
+		}
+		if (state->halted) {
+			executed += sleep_while_halted(state, instruction_count - executed - 1);
+		}
+	}
+
+	return executed;
+}
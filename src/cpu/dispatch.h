@@ -0,0 +1,62 @@
+/**
+ * A header file containing the opcode tables which tie each opcode byte to the
+ * handler in instructions.c that implements it, along with the fetch/decode/execute
+ * loop that walks them.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include "register.h"
+#include "interrupts.h"
+
+/*
+ * Every opcode is executed through an adapter with this signature. By the time
+ * the adapter is called the programme counter already points at the next instruction
+ * and any immediate operand has been fetched. 16 bit operands are supplied as the
+ * value they represent (i.e. they have already been through to_little_endian).
+ */
+typedef void (*OpcodeHandler)(CPUState *state, unsigned short operand);
+
+/**
+ * Everything the run loop needs to know about an opcode.
+ */
+typedef struct {
+	OpcodeHandler execute;		/** Adapter which calls into instructions.c */
+	unsigned char length;		/** Length of the instruction in bytes, opcode included */
+	const char *flags;			/** Effect on Z, N, H and C. See opcodes.h */
+	const char *mnemonic;		/** Human readable form of the instruction. Handy for debugging */
+} Opcode;
+
+extern const Opcode primary_opcodes[256];
+extern const Opcode cb_opcodes[256];
+
+// See dispatch.c for more thorough explination of these functions
+unsigned short fetch_operand(unsigned short address, unsigned char length);
+void execute_instruction(CPUState *state);
+unsigned long run_instructions(CPUState *state, unsigned long instruction_count);
+
+/**
+ * /brief Runs the instruction after an EI on its own, if an EI is waiting on it.
+ *
+ * That instruction needs a service point straight after it, as that's when IME is set.
+ * EI ends a block, so it's always the first of the next one. Rather than have every
+ * instruction check, the cores call this before starting a block, or straight after the
+ * service point following EI, and the table core runs it, as it services after anything
+ * while an EI is waiting.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: Most instructions we may execute.
+ *
+ * @return The number of instructions executed. 0 if no EI was waiting, or there's no budget.
+ */
+static inline unsigned long run_ei_window(CPUState *state, unsigned long instruction_count) {
+	if (interrupt_controller.enable_delay == 0 || instruction_count == 0) {
+		return 0;
+	}
+	return run_instructions(state, 1);
+}
+
+#endif // DISPATCH_H
@@ -0,0 +1,761 @@
+/*
+ * A little test programme to make sure the opcode tables send each opcode to the
+ * right place. Each test assembles a short programme into memory, runs it through
+ * the dispatch loop and checks the registers it leaves behind.
+ *
+ * Every test is run once per core listed in cores.c. On top of that, every ALU
+ * opcode is run on each core over a spread of operands and compared against the
+ * plain table core, so a core can't quietly disagree with the handlers alutest checks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "register.h"
+#include "instructions.h"
+#include "dispatch.h"
+#include "cores.h"
+#include "block_cache.h"
+#include "jit.h"
+#include "fusion.h"
+#include "idle.h"
+#include "pinned.h"
+#include "cycle_tables.h"
+#include "interrupts.h"
+#include "disassembler.h"
+#include "lockstep.h"
+#include "../memory/memory.h"
+#include "../memory/mapper.h"
+#include "../memory/mbc2.h"
+#include "../memory/mbc3.h"
+#include "../memory/mbc5.h"
+
+#define PROGRAMME_START 0x100
+
+int successes;
+int failures;
+
+unsigned char *memory_space = NULL;
+int rumble_changes = 0;
+int rumble_motor = 0;
+
+void run_programme_tests(const Core *core);
+void run_alu_comparison(const Core *core);
+void run_flags_column_check(const Opcode *opcodes, int prefixed);
+void check_disassembly(const unsigned char *bytes, const char *expected);
+unsigned long run_instructions_faulty(CPUState *state, unsigned long instruction_count);
+void run_programme(const Core *core, CPUState *state, unsigned long instruction_count);
+CPUState *load_programme(const unsigned char *programme, int length);
+void check_value(const char *description, unsigned short expected, unsigned short actual);
+void record_rumble(int motor_on);
+
+int main() {
+	int i;
+	memory_space = calloc(0x10000, sizeof(unsigned char));
+	map_memory();		// Every core runs over the memory map, as in the emulator
+
+	successes = 0;
+	failures = 0;
+	jit_threshold = 0;		// Compile everything on sight so the tests exercise compiled code
+
+	for (i = 0; i < core_count; i++) {
+		printf("\n*** CORE: %s ***\n\n", cores[i].name);
+		run_programme_tests(&cores[i]);
+		run_alu_comparison(&cores[i]);
+	}
+
+	printf("\nTest: The cached core fused the loops above\n");
+	for (i = 0; i < fusion_count && fusion_stats[i].executed == 0; i++);
+	check_value("Some fused operation ran", 1, i < fusion_count);
+
+	printf("Test: Cycle tables (NOP, LD (nn),SP, CALL Z taken, RET, LD B,(HL), RLC (HL), BIT 0,(HL))\n");
+	check_value("NOP", 4, primary_cycles[0x00]);
+	check_value("LD (nn),SP", 20, primary_cycles[0x08]);
+	check_value("CALL Z", 24, primary_cycles[0xCC] + primary_cycles_taken[0xCC]);
+	check_value("RET", 16, primary_cycles[0xC9]);
+	check_value("LD B,(HL)", 8, primary_cycles[0x46]);
+	check_value("RLC (HL)", 16, cb_cycles[0x06]);
+	check_value("BIT 0,(HL)", 12, cb_cycles[0x46]);
+
+	printf("Test: Flags column of the opcode lists agrees with the handlers\n");
+	run_flags_column_check(primary_opcodes, 0);
+	run_flags_column_check(cb_opcodes, 1);
+
+	printf("Test: Disassembler (JR e8, LD HL,SP+e8, LDH (a8),A, CALL a16, LD A,n8, BIT 7,H)\n");
+	check_disassembly((const unsigned char[]) {0x18, 0xFE, 0x00}, "JR $0100");
+	check_disassembly((const unsigned char[]) {0xF8, 0xFE, 0x00}, "LD HL,SP-2");
+	check_disassembly((const unsigned char[]) {0xE0, 0x40, 0x00}, "LDH ($FF40),A");
+	check_disassembly((const unsigned char[]) {0xCD, 0x34, 0x12}, "CALL $1234");
+	check_disassembly((const unsigned char[]) {0x3E, 0x05, 0x00}, "LD A,$05");
+	check_disassembly((const unsigned char[]) {0xCB, 0x7C, 0x00}, "BIT 7,H");
+
+	printf("Test: run_cycles finishes the instruction which reaches the budget (NOPs, 10 cycles)\n");
+	const unsigned char nops[] = {0x00, 0x00, 0x00, 0x00};
+	CPUState *state = load_programme(nops, sizeof(nops));
+	check_value("Cycles used", 12, run_cycles(state, 10));
+	check_value("PC", PROGRAMME_START + 3, state->PC);
+	free(state);
+
+	printf("Test: run_cycles charges a branch taken (LD B,5; DEC B; JR NZ,-3, 20 cycles)\n");
+	const unsigned char countdown[] = {0x06, 0x05, 0x05, 0x20, 0xFD};
+	state = load_programme(countdown, sizeof(countdown));
+	check_value("Cycles used", 8 + 4 + 12, run_cycles(state, 20));
+	check_value("PC", PROGRAMME_START + 2, state->PC);
+	free(state);
+
+	printf("Test: Lockstep agrees on a loop of stores, then catches a core getting one wrong\n");
+	const Core faulty_core = {"faulty", run_instructions_faulty, "Stores 33 where it should store 03", NULL};
+	const unsigned char stores[] = {0x3E, 0x05, 0x21, 0x00, 0xC0, 0x22, 0x3D, 0x20, 0xFC};
+	int diverged;
+	state = load_programme(stores, sizeof(stores));
+	check_value("Instructions run in lockstep", 30, run_lockstep(find_core("pinned"), find_core("table"), state, 30, 1, &diverged));
+	check_value("Diverged", 0, diverged);
+	free(state);
+	state = load_programme(stores, sizeof(stores));
+	check_value("Instructions up to the bad store", 9, run_lockstep(&faulty_core, find_core("table"), state, 30, 1, &diverged));
+	check_value("Diverged", 1, diverged);
+	free(state);
+
+	printf("Test: Memory map (echo RAM both ways, ROM writes, a page of cached code written to)\n");
+	write_byte(0xC123, 0x5A);
+	check_value("Work RAM read through echo RAM", 0x5A, read_byte(0xE123));
+	write_byte(0xFD00, 0xA5);
+	check_value("Work RAM written through echo RAM", 0xA5, read_byte(0xDD00));
+	cart_written = ignore_cart_write;
+	write_byte(0x2000, 0x01);
+	check_value("ROM left as it was", 0x00, read_byte(0x2000));
+	cart_written = NULL;
+	flag_code_page(0xC040 >> CODE_PAGE_SHIFT);
+	check_value("Page with code taken out of the map", 1, memory_map.write[0xC0] == NULL);
+	write_byte(0xC050, 0x77);		// Whoever cached code last throws it away
+	check_value("Write to it", 0x77, read_byte(0xC050));
+	check_value("Page back in the map", 1, memory_map.write[0xC0] == memory_space + 0xC000);
+
+	printf("Test: MBC1 (ROM banks in both modes, RAM turned on and off, RAM banks)\n");
+	unsigned long cycles = 0;
+	MapperOptions mapper_options = {&cycles, RTC_SOURCE_EMULATED, record_rumble};
+	CartMetaData cart = {.cart_type = ROM_MBC1_RAM, .rom_size = 64 * ROM_BANK_SIZE, .ram_size = 4 * RAM_BANK_SIZE};
+	cart.rom = calloc(cart.rom_size, sizeof(unsigned char));
+	for (i = 0; i < 64; i++) {
+		cart.rom[i * ROM_BANK_SIZE] = i;		// Each bank starts with its number
+	}
+	insert_cart(find_mapper(cart.cart_type), &cart, &mapper_options);
+	check_value("Bank 1 at power on", 1, read_byte(0x4000));
+	write_byte(0x2000, 0x05);
+	check_value("Bank 5", 5, read_byte(0x4000));
+	check_value("Mapped straight out of the ROM", 1, memory_map.read[0x40] == cart.rom + 5 * ROM_BANK_SIZE);
+	write_byte(0x2000, 0x00);
+	check_value("Bank 0 picks 1", 1, read_byte(0x4000));
+	write_byte(0x4000, 0x01);
+	check_value("BANK2 picks the top bits", 0x21, read_byte(0x4000));
+	check_value("Bank 0 below in mode 0", 0x00, read_byte(0x0000));
+	write_byte(0x6000, 0x01);
+	check_value("BANK2 picks the bank below in mode 1", 0x20, read_byte(0x0000));
+	check_value("RAM turned off reads 0xFF", 0xFF, read_byte(0xA000));
+	write_byte(0xA000, 0x12);
+	write_byte(0x0000, 0x0A);
+	check_value("Write while turned off dropped", 0x00, read_byte(0xA000));
+	write_byte(0xA000, 0x34);
+	check_value("RAM bank 1 in mode 1", 0x34, cart_ram[RAM_BANK_SIZE]);
+	write_byte(0x6000, 0x00);
+	check_value("RAM bank 0 in mode 0", 0x00, read_byte(0xA000));
+	free(cart.rom);
+
+	printf("Test: MBC2 (ROM banks by address bit 8, half bytes of RAM over and over)\n");
+	cart = (CartMetaData) {.cart_type = ROM_MBC2_BATTERY, .rom_size = 16 * ROM_BANK_SIZE};
+	cart.rom = calloc(cart.rom_size, sizeof(unsigned char));
+	for (i = 0; i < 16; i++) {
+		cart.rom[i * ROM_BANK_SIZE] = i;
+	}
+	insert_cart(find_mapper(cart.cart_type), &cart, &mapper_options);
+	write_byte(0x2100, 0x07);
+	check_value("Bank 7", 7, read_byte(0x4000));
+	write_byte(0x0100, 0x00);
+	check_value("Bank 0 picks 1", 1, read_byte(0x4000));
+	write_byte(0x2000, 0x0A);		// Bit 8 clear, so that's the RAM
+	check_value("Still bank 1", 1, read_byte(0x4000));
+	write_byte(0xA005, 0x3C);
+	check_value("Low half kept", 0xFC, read_byte(0xA005));
+	check_value("Repeated through the area", 0xFC, read_byte(0xBE05));
+	write_byte(0x0000, 0x00);
+	check_value("RAM off", 0xFF, read_byte(0xA005));
+	free(cart.rom);
+
+	printf("Test: MBC3 (ROM and RAM banks, the clock halted, set, carried and saved)\n");
+	unsigned char saved_clock[RTC_SAVE_SIZE];
+	cart = (CartMetaData) {.cart_type = ROM_MBC3_TIMER_RAM_BATT, .rom_size = 128 * ROM_BANK_SIZE, .ram_size = 4 * RAM_BANK_SIZE};
+	cart.rom = calloc(cart.rom_size, sizeof(unsigned char));
+	for (i = 0; i < 128; i++) {
+		cart.rom[i * ROM_BANK_SIZE] = i;
+	}
+	insert_cart(find_mapper(cart.cart_type), &cart, &mapper_options);
+	write_byte(0x2000, 0x45);
+	check_value("Bank 0x45", 0x45, read_byte(0x4000));
+	write_byte(0x0000, 0x0A);
+	write_byte(0x4000, 0x02);
+	write_byte(0xA000, 0x56);
+	check_value("RAM bank 2", 0x56, cart_ram[2 * RAM_BANK_SIZE]);
+	cycles = (86400UL + 3600 + 60 + 1) * CPU_CLOCK_RATE;		// 1 day, 01:01:01
+	write_byte(0x4000, RTC_SECONDS);
+	check_value("Nothing latched yet", 0x00, read_byte(0xA000));
+	write_byte(0x4000, RTC_DAYS_HIGH);
+	write_byte(0xA000, RTC_HALT);
+	cycles += 10 * CPU_CLOCK_RATE;
+	write_byte(0x4000, RTC_SECONDS);
+	write_byte(0xA000, 30);
+	write_byte(0x6000, 0x00);
+	write_byte(0x6000, 0x01);
+	check_value("Set while halted", 30, read_byte(0xA000));
+	write_byte(0x4000, RTC_DAYS_HIGH);
+	write_byte(0xA000, 0x00);
+	cycles += 5 * CPU_CLOCK_RATE;
+	write_byte(0x6000, 0x00);
+	write_byte(0x6000, 0x01);
+	check_value("Day counter flags", 0x00, read_byte(0xA000));
+	write_byte(0x4000, RTC_SECONDS);
+	check_value("Running again", 35, read_byte(0xA000));
+	save_mbc3_clock(saved_clock);
+	cycles += 512 * 86400UL * CPU_CLOCK_RATE;
+	write_byte(0x6000, 0x00);
+	write_byte(0x6000, 0x01);
+	write_byte(0x4000, RTC_DAYS_HIGH);
+	check_value("Day counter carried", RTC_DAY_CARRY, read_byte(0xA000) & RTC_DAY_CARRY);
+	insert_cart(find_mapper(cart.cart_type), &cart, &mapper_options);
+	load_mbc3_clock(saved_clock);
+	write_byte(0x0000, 0x0A);
+	write_byte(0x4000, RTC_SECONDS);
+	write_byte(0x6000, 0x00);
+	write_byte(0x6000, 0x01);
+	check_value("Saved and loaded", 35, read_byte(0xA000));
+	free(cart.rom);
+
+	printf("Test: MBC5 (9 bit ROM banks, bank 0 switchable, the rumble motor)\n");
+	cart = (CartMetaData) {.cart_type = ROM_MBC5_RUMBLE_SRAM, .rom_size = 512 * ROM_BANK_SIZE, .ram_size = 0x20000};
+	cart.rom = calloc(cart.rom_size, sizeof(unsigned char));
+	for (i = 0; i < 512; i++) {
+		cart.rom[i * ROM_BANK_SIZE] = i & 0xFF;
+		cart.rom[i * ROM_BANK_SIZE + 1] = i >> 8;
+	}
+	insert_cart(find_mapper(cart.cart_type), &cart, &mapper_options);
+	check_value("Bank 1 at power on", 1, read_byte(0x4000));
+	write_byte(0x2000, 0x00);
+	check_value("Bank 0 switched in", 0, read_byte(0x4000) | (read_byte(0x4001) << 8));
+	write_byte(0x3000, 0x01);
+	write_byte(0x2000, 0x23);
+	check_value("Bank 0x123", 0x123, read_byte(0x4000) | (read_byte(0x4001) << 8));
+	write_byte(0x3000, 0x00);
+	check_value("Bank 0x23", 0x23, read_byte(0x4000) | (read_byte(0x4001) << 8));
+	write_byte(0x0000, 0x0A);
+	write_byte(0x4000, MBC5_RUMBLE_MOTOR | 0x0A);
+	write_byte(0xA000, 0x56);
+	check_value("RAM bank 2 on a rumble cart", 0x56, cart_ram[2 * RAM_BANK_SIZE]);
+	check_value("Motor on", 1, rumble_motor);
+	write_byte(0x4000, MBC5_RUMBLE_MOTOR | 0x02);
+	write_byte(0x4000, 0x02);
+	check_value("Motor off", 0, rumble_motor);
+	check_value("Only told when the motor changed", 2, rumble_changes);
+	write_byte(0x0000, 0x1A);
+	check_value("RAM off for anything but 0x0A", 0xFF, read_byte(0xA000));
+	check_value("No mapper for a HuC3", 1, find_mapper(ROM_HUDSON_HUC3) == NULL);
+	check_value("Nor an unknown type", 1, find_mapper(0x42) == NULL);
+	map_memory();
+	cart_written = NULL;
+	free(cart_ram);
+	cart_ram = NULL;
+	cart_ram_size = 0;
+	free(cart.rom);
+
+	printf("Test: The cached core skipped the idle loops above\n");
+	check_value("Idle loops detected", 1, idle_stats.loops_detected > 0);
+	check_value("Slept through HALT", 1, idle_stats.halted_skipped > 0);
+
+	free(memory_space);
+	printf("\n\nTESTING COMPLETE!\n\t%d Successes\n\t%d Failures\n", successes, failures);
+	return failures != 0;
+}
+
+/**
+ * /brief Runs each of the little test programmes on the given core.
+ *
+ * @param core: The core to run them on.
+ */
+void run_programme_tests(const Core *core) {
+	CPUState *state;
+
+	printf("Test: Count B down from 5 (LD B,5; DEC B; JR NZ,-3)\n");
+	const unsigned char countdown[] = {0x06, 0x05, 0x05, 0x20, 0xFD};
+	state = load_programme(countdown, sizeof(countdown));
+	run_programme(core, state, 1 + 2 * 5);
+	check_value("B", 0x00, state->B);
+	check_value("PC", PROGRAMME_START + 5, state->PC);
+	check_value("F", 0xC0, state->F);
+	check_value("Cycles (8 + 5 * 4 + 4 * 12 + 8)", 84, state->cycles);
+	free(state);
+
+	printf("Test: 16 bit immediates are little endian (LD HL,0xC123; LD (HL+),A)\n");
+	const unsigned char store[] = {0x21, 0x23, 0xC1, 0x3E, 0x42, 0x22};
+	state = load_programme(store, sizeof(store));
+	run_programme(core, state, 3);
+	check_value("H", 0xC1, state->H);
+	check_value("L", 0x24, state->L);
+	check_value("(0xC123)", 0x42, read_byte(0xC123));
+	free(state);
+
+	printf("Test: CALL and RET round trip through the stack\n");
+	const unsigned char call_return[] = {0xCD, 0x10, 0x01, 0x00, [0x10] = 0x3C, 0xC9};
+	state = load_programme(call_return, sizeof(call_return));
+	state->SP = 0xFFFE;
+	run_programme(core, state, 3);
+	check_value("A", 0x01, state->A);
+	check_value("PC", PROGRAMME_START + 3, state->PC);
+	check_value("SP", 0xFFFE, state->SP);
+	check_value("Return address low byte", 0x03, read_byte(0xFFFC));
+	check_value("Cycles (24 + 4 + 16)", 44, state->cycles);
+	free(state);
+
+	printf("Test: PUSH BC; POP AF masks the lower nibble of F\n");
+	const unsigned char push_pop[] = {0x01, 0xFF, 0x12, 0xC5, 0xF1};
+	state = load_programme(push_pop, sizeof(push_pop));
+	state->SP = 0xFFFE;
+	run_programme(core, state, 3);
+	check_value("A", 0x12, state->A);
+	check_value("F", 0xF0, state->F);
+	free(state);
+
+	printf("Test: INC leaves the carry flag alone (SCF; LD A,0xFF; INC A)\n");
+	const unsigned char increment[] = {0x37, 0x3E, 0xFF, 0x3C};
+	state = load_programme(increment, sizeof(increment));
+	run_programme(core, state, 3);
+	check_value("A", 0x00, state->A);
+	check_value("F", 0xB0, state->F);
+	free(state);
+
+	printf("Test: CB prefixed opcodes (LD A,0x81; RLC A; BIT 7,A; SET 3,A)\n");
+	const unsigned char prefixed[] = {0x3E, 0x81, 0xCB, 0x07, 0xCB, 0x7F, 0xCB, 0xDF};
+	state = load_programme(prefixed, sizeof(prefixed));
+	run_programme(core, state, 4);
+	check_value("A", 0x0B, state->A);
+	check_value("F", 0xB0, state->F);
+	free(state);
+
+	printf("Test: Self modifying code (LD A,1; LD HL,0x101; LD (HL),5; JP 0x100)\n");
+	const unsigned char self_modifying[] = {0x3E, 0x01, 0x21, 0x01, 0x01, 0x36, 0x05, 0xC3, 0x00, 0x01};
+	state = load_programme(self_modifying, sizeof(self_modifying));
+	run_programme(core, state, 5);
+	check_value("A", 0x05, state->A);
+	check_value("PC", PROGRAMME_START + 2, state->PC);
+	free(state);
+
+	// The next few are the idioms fusion.c fuses. Every core has to agree on them regardless
+	printf("Test: Copy loop (LD A,(HL+); LD (DE),A; INC DE; DEC BC; LD A,B; OR C; JR NZ) copying 3 bytes\n");
+	const unsigned char copy_loop[] = {0x21, 0x00, 0xC0, 0x11, 0x00, 0xC1, 0x01, 0x03, 0x00,
+		0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8};
+	state = load_programme(copy_loop, sizeof(copy_loop));
+	memory_space[0xC000] = 0x11;
+	memory_space[0xC001] = 0x22;
+	memory_space[0xC002] = 0x33;
+	run_programme(core, state, 3 + 7 * 3);
+	check_value("(0xC100 - 0xC101)", 0x1122, (read_byte(0xC100) << 8) | read_byte(0xC101));
+	check_value("(0xC102)", 0x33, read_byte(0xC102));
+	check_value("DE", 0xC103, state->DE);
+	check_value("BC", 0x0000, state->BC);
+	check_value("F", 0x80, state->F);
+	check_value("PC", PROGRAMME_START + sizeof(copy_loop), state->PC);
+	free(state);
+
+	printf("Test: Running out of instructions part way through the copy loop\n");
+	state = load_programme(copy_loop, sizeof(copy_loop));
+	run_programme(core, state, 3 + 7 + 4);
+	check_value("BC", 0x0001, state->BC);
+	check_value("PC", PROGRAMME_START + 13, state->PC);
+	free(state);
+
+	printf("Test: Copy loop storing over its own INC DE\n");
+	const unsigned char copy_over_itself[] = {0x21, 0x00, 0xC0, 0x11, 0x0B, 0x01, 0x01, 0x01, 0x00,
+		0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8};
+	state = load_programme(copy_over_itself, sizeof(copy_over_itself));		// (0xC000) is a NOP
+	run_programme(core, state, 3 + 7);
+	check_value("DE", 0x010B, state->DE);
+	check_value("PC", PROGRAMME_START + sizeof(copy_over_itself), state->PC);
+	check_value("Cycles (3 * 12 + 8 + 8 + 4 + 8 + 4 + 4 + 8)", 80, state->cycles);
+	free(state);
+
+	printf("Test: Poll loop (LDH A,(0x80); CP 3; JR NZ) going round twice\n");
+	const unsigned char poll_loop[] = {0xF0, 0x80, 0xFE, 0x03, 0x20, 0xFA};
+	state = load_programme(poll_loop, sizeof(poll_loop));
+	memory_space[0xFF80] = 0x01;
+	run_programme(core, state, 3 * 2);
+	check_value("A", 0x01, state->A);
+	check_value("F", 0x70, state->F);
+	check_value("PC", PROGRAMME_START, state->PC);
+	free(state);
+
+	// Long enough that running them out in full would show, and stopping part way round
+	printf("Test: Polling a RAM flag (LD A,(0xC000); AND A; JR Z) a million times and a bit\n");
+	const unsigned char flag_loop[] = {0xFA, 0x00, 0xC0, 0xA7, 0x28, 0xFA};
+	state = load_programme(flag_loop, sizeof(flag_loop));
+	run_programme(core, state, 3 * 1000000 + 2);
+	check_value("A", 0x00, state->A);
+	check_value("F", 0xA0, state->F);
+	check_value("PC", PROGRAMME_START + 4, state->PC);
+	free(state);
+
+	printf("Test: A loop which only reads but moves HL along (LD A,(HL+); AND A; JR Z)\n");
+	const unsigned char scan_loop[] = {0x2A, 0xA7, 0x28, 0xFC};
+	state = load_programme(scan_loop, sizeof(scan_loop));
+	state->HL = 0xC000;
+	run_programme(core, state, 3 * 1000);
+	check_value("HL", 0xC000 + 1000, state->HL);
+	check_value("PC", PROGRAMME_START, state->PC);
+	free(state);
+
+	printf("Test: HALT with nothing to wake it sleeps (HALT; INC A)\n");
+	const unsigned char halt_wake[] = {0x76, 0x3C};
+	state = load_programme(halt_wake, sizeof(halt_wake));
+	memory_space[INTERRUPT_ENABLE_ADDRESS] = INTERRUPT_TIMER;
+	run_programme(core, state, 1000000);
+	check_value("Halted", 1, state->halted);
+	check_value("A", 0x00, state->A);
+	check_value("PC", PROGRAMME_START, state->PC);
+
+	printf("Test: HALT wakes once an enabled interrupt is requested\n");
+	memory_space[INTERRUPT_FLAG_ADDRESS] = INTERRUPT_TIMER;
+	run_programme(core, state, 2);
+	check_value("Halted", 0, state->halted);
+	check_value("A", 0x01, state->A);
+	check_value("PC", PROGRAMME_START + 2, state->PC);
+	free(state);
+
+	printf("Test: HALT bug runs the next opcode twice (IE = IF = VBlank, IME clear; HALT; INC A)\n");
+	state = load_programme(halt_wake, sizeof(halt_wake));
+	memory_space[INTERRUPT_ENABLE_ADDRESS] = INTERRUPT_VBLANK;
+	memory_space[INTERRUPT_FLAG_ADDRESS] = INTERRUPT_VBLANK;
+	run_programme(core, state, 2);
+	check_value("A", 0x02, state->A);
+	check_value("PC", PROGRAMME_START + 2, state->PC);
+	free(state);
+
+	printf("Test: HALT bug reads the opcode as its own operand (HALT; LD A,0x14 becomes LD A,0x3E; INC D)\n");
+	const unsigned char halt_bug_operand[] = {0x76, 0x3E, 0x14};
+	state = load_programme(halt_bug_operand, sizeof(halt_bug_operand));
+	memory_space[INTERRUPT_ENABLE_ADDRESS] = INTERRUPT_VBLANK;
+	memory_space[INTERRUPT_FLAG_ADDRESS] = INTERRUPT_VBLANK;
+	run_programme(core, state, 2);
+	check_value("A", 0x3E, state->A);
+	check_value("D", 0x01, state->D);
+	check_value("PC", PROGRAMME_START + 3, state->PC);
+	free(state);
+
+	printf("Test: No HALT bug with IME set, the interrupt is taken instead (EI; HALT; INC A, RETI at 0x40)\n");
+	const unsigned char halt_enabled[] = {0xFB, 0x76, 0x3C};
+	state = load_programme(halt_enabled, sizeof(halt_enabled));
+	state->SP = 0xFFFE;
+	write_byte(INTERRUPT_VECTOR_BASE, 0xD9);
+	write_byte(INTERRUPT_ENABLE_ADDRESS, INTERRUPT_VBLANK);
+	write_byte(INTERRUPT_FLAG_ADDRESS, INTERRUPT_VBLANK);
+	run_programme(core, state, 2);
+	check_value("PC", INTERRUPT_VECTOR_BASE, state->PC);
+	check_value("IME", 0, interrupt_controller.master_enable);
+	run_programme(core, state, 2);
+	check_value("IME", 1, interrupt_controller.master_enable);
+	check_value("IF", 0x00, read_byte(INTERRUPT_FLAG_ADDRESS));
+	check_value("A", 0x01, state->A);
+	check_value("PC", PROGRAMME_START + 3, state->PC);
+	check_value("SP", 0xFFFE, state->SP);
+	free(state);
+
+	printf("Test: Interrupts are taken in priority order, one instruction after EI (EI; NOP; JR -2)\n");
+	const unsigned char interrupt_loop[] = {0xFB, 0x00, 0x18, 0xFE};
+	state = load_programme(interrupt_loop, sizeof(interrupt_loop));
+	state->SP = 0xFFFE;
+	write_byte(INTERRUPT_VECTOR_BASE, 0x04);		// VBlank: INC B; RETI
+	write_byte(INTERRUPT_VECTOR_BASE + 1, 0xD9);
+	write_byte(INTERRUPT_VECTOR_BASE + 2 * INTERRUPT_VECTOR_SPACING, 0x0C);		// Timer: INC C; RETI
+	write_byte(INTERRUPT_VECTOR_BASE + 2 * INTERRUPT_VECTOR_SPACING + 1, 0xD9);
+	write_byte(INTERRUPT_ENABLE_ADDRESS, INTERRUPT_VBLANK | INTERRUPT_TIMER);
+	write_byte(INTERRUPT_FLAG_ADDRESS, INTERRUPT_TIMER | INTERRUPT_VBLANK);
+	run_programme(core, state, 1);
+	check_value("PC after EI", PROGRAMME_START + 1, state->PC);
+	run_programme(core, state, 1);
+	check_value("PC after NOP", INTERRUPT_VECTOR_BASE, state->PC);
+	check_value("IF", INTERRUPT_TIMER, read_byte(INTERRUPT_FLAG_ADDRESS));
+	check_value("Return address low byte", 0x02, read_byte(0xFFFC));
+	run_programme(core, state, 2);
+	check_value("PC after RETI", INTERRUPT_VECTOR_BASE + 2 * INTERRUPT_VECTOR_SPACING, state->PC);
+	run_programme(core, state, 2);
+	check_value("B", 0x01, state->B);
+	check_value("C", 0x01, state->C);
+	check_value("PC", PROGRAMME_START + 2, state->PC);
+	check_value("SP", 0xFFFE, state->SP);
+	check_value("Cycles (4 + 4 + 2 * (20 + 4 + 16))", 88, state->cycles);
+	free(state);
+
+	printf("Test: DI straight after EI means nothing is taken (EI; DI; JR -2)\n");
+	const unsigned char enable_disable[] = {0xFB, 0xF3, 0x18, 0xFE};
+	state = load_programme(enable_disable, sizeof(enable_disable));
+	write_byte(INTERRUPT_ENABLE_ADDRESS, INTERRUPT_VBLANK);
+	write_byte(INTERRUPT_FLAG_ADDRESS, INTERRUPT_VBLANK);
+	run_programme(core, state, 100);
+	check_value("IME", 0, interrupt_controller.master_enable);
+	check_value("PC", PROGRAMME_START + 2, state->PC);
+	check_value("IF", INTERRUPT_VBLANK, read_byte(INTERRUPT_FLAG_ADDRESS));
+	free(state);
+
+	printf("Test: DI one instruction after EI is too late (EI; NOP; DI; JR -2, INC B; RETI at 0x40)\n");
+	const unsigned char enable_nop_disable[] = {0xFB, 0x00, 0xF3, 0x18, 0xFE};
+	state = load_programme(enable_nop_disable, sizeof(enable_nop_disable));
+	state->SP = 0xFFFE;
+	write_byte(INTERRUPT_VECTOR_BASE, 0x04);
+	write_byte(INTERRUPT_VECTOR_BASE + 1, 0xD9);
+	write_byte(INTERRUPT_ENABLE_ADDRESS, INTERRUPT_VBLANK);
+	write_byte(INTERRUPT_FLAG_ADDRESS, INTERRUPT_VBLANK);
+	run_programme(core, state, 100);
+	check_value("Handler ran", 0x01, state->B);
+	check_value("IF", 0x00, read_byte(INTERRUPT_FLAG_ADDRESS));
+	check_value("IME", 0, interrupt_controller.master_enable);
+	check_value("PC", PROGRAMME_START + 3, state->PC);
+	check_value("SP", 0xFFFE, state->SP);
+	free(state);
+
+	printf("Test: STOP sleeps until the joypad interrupt is requested (STOP; INC A)\n");
+	const unsigned char stop_wake[] = {0x10, 0x00, 0x3C};
+	state = load_programme(stop_wake, sizeof(stop_wake));
+	run_programme(core, state, 1000000);
+	check_value("Halted", 1, state->halted);
+	check_value("PC", PROGRAMME_START, state->PC);
+	memory_space[INTERRUPT_FLAG_ADDRESS] = INTERRUPT_JOYPAD;
+	run_programme(core, state, 2);
+	check_value("A", 0x01, state->A);
+	check_value("PC", PROGRAMME_START + 3, state->PC);
+	free(state);
+
+	printf("Test: MBC3 clock latched by a programme after crossing a second (wait, latch, read)\n");
+	const unsigned char read_clock[] = {0x06, 0x32, 0x05, 0x20, 0xFD,	// 804 cycles of LD B,50; DEC B; JR NZ,-3
+		0x3E, 0x0A, 0xEA, 0x00, 0x00, 0x3E, RTC_SECONDS, 0xEA, 0x00, 0x40,	// RAM on, seconds picked
+		0xAF, 0xEA, 0x00, 0x60, 0x3C, 0xEA, 0x00, 0x60,						// Latch
+		0xFA, 0x00, 0xA0, 0x5F, 0x3E, RTC_MINUTES, 0xEA, 0x00, 0x40,		// LD E,seconds
+		0xFA, 0x00, 0xA0, 0x57, 0x3E, RTC_HOURS, 0xEA, 0x00, 0x40,			// LD D,minutes
+		0xFA, 0x00, 0xA0, 0x4F, 0x3E, RTC_DAYS_LOW, 0xEA, 0x00, 0x40,		// LD C,hours
+		0xFA, 0x00, 0xA0, 0x6F};											// LD L,days
+	CartMetaData cart = {.cart_type = ROM_MBC3_TIMER_RAM_BATT, .rom_size = 2 * ROM_BANK_SIZE, .ram_size = RAM_BANK_SIZE};
+	state = load_programme(read_clock, sizeof(read_clock));
+	MapperOptions mapper_options = {&state->cycles, RTC_SOURCE_EMULATED, record_rumble};
+	cart.rom = calloc(cart.rom_size, sizeof(unsigned char));
+	memcpy(cart.rom + PROGRAMME_START, read_clock, sizeof(read_clock));
+	insert_cart(find_mapper(cart.cart_type), &cart, &mapper_options);		// The clock reads 0 at 0 cycles
+	state->cycles = (86400UL + 3600 + 60 + 2) * CPU_CLOCK_RATE - 200;		// 200 cycles short of 1 day, 01:01:02
+	run_programme(core, state, 1 + 2 * 50 + 8 + 14);
+	check_value("Seconds", 2, state->E);
+	check_value("Minutes", 1, state->D);
+	check_value("Hours", 1, state->C);
+	check_value("Days", 1, state->L);
+	check_value("PC", PROGRAMME_START + sizeof(read_clock), state->PC);
+	map_memory();
+	cart_written = NULL;
+	free(cart_ram);
+	cart_ram = NULL;
+	cart_ram_size = 0;
+	free(cart.rom);
+	free(state);
+}
+
+/**
+ * /brief Runs every ALU opcode (0x80 - 0xBF and the immediate forms) on the given core and
+ * compares the result with the table core's.
+ *
+ * Each opcode is tried with a spread of accumulator and operand values and with the carry
+ * both set and clear. The operand sits in B through E, behind (HL) and after the opcode at once,
+ * so most register forms and the immediate forms all see the same value. Mismatches are tallied
+ * per opcode so a broken core doesn't bury the summary.
+ *
+ * @param core: The core to check.
+ */
+void run_alu_comparison(const Core *core) {
+	static const unsigned char values[] = {0x00, 0x01, 0x0F, 0x10, 0x7F, 0x80, 0x99, 0xF0, 0xFF};
+	static const unsigned char immediates[] = {0xC6, 0xCE, 0xD6, 0xDE, 0xE6, 0xEE, 0xF6, 0xFE};
+	const int value_count = sizeof(values) / sizeof(values[0]);
+	int opcode, a, b, carry, mismatches;
+
+	printf("Test: ALU opcodes agree with the table core\n");
+	mismatches = 0;
+	for (opcode = 0x80; opcode < 0xC8; opcode++) {
+		unsigned char code = opcode < 0xC0 ? opcode : immediates[opcode - 0xC0];
+		for (a = 0; a < value_count; a++) {
+			for (b = 0; b < value_count; b++) {
+				for (carry = 0; carry < 2; carry++) {
+					// The opcode, its operand if it has one, then JR -2 to close the block
+					unsigned char programme[4];
+					int length = 0;
+					CPUState *expected, *actual;
+
+					programme[length++] = code;
+					if (primary_opcodes[code].length == 2) {
+						programme[length++] = values[b];
+					}
+					programme[length++] = 0x18;
+					programme[length++] = 0xFE;
+
+					expected = load_programme(programme, length);
+					expected->A = values[a];
+					expected->B = expected->C = expected->D = expected->E = values[b];
+					expected->HL = 0xC000;
+					expected->F = carry ? 0x10 : 0x00;
+					memory_space[0xC000] = values[b];
+					actual = initialise_registers();
+					*actual = *expected;
+
+					run_instructions(expected, 2);
+					core->run(actual, 2);
+					materialise_flags(&expected->F);
+					materialise_flags(&actual->F);
+
+					if (expected->AF != actual->AF || expected->PC != actual->PC) {
+						if (mismatches++ < 4) {
+							printf("\t%s with A=%02X, operand=%02X, carry=%d: expected AF=%04X, got AF=%04X\n",
+								primary_opcodes[code].mnemonic, values[a], values[b], carry,
+								expected->AF, actual->AF);
+						}
+					}
+
+					free(expected);
+					free(actual);
+				}
+			}
+		}
+	}
+	check_value("ALU mismatches", 0, mismatches);
+}
+
+/**
+ * /brief Runs every opcode in a list on the table core and checks F against its flags column.
+ *
+ * Each opcode is run with F all set and all clear and a spread of register values. A '0' or
+ * '1' in the column must always come out that way, a '-' must be left as it was. Illegal
+ * opcodes, HALT and STOP are left out.
+ *
+ * @param opcodes: primary_opcodes or cb_opcodes.
+ * @param prefixed: 1 for cb_opcodes.
+ */
+void run_flags_column_check(const Opcode *opcodes, int prefixed) {
+	static const unsigned char values[] = {0x00, 0x0F, 0x80, 0xFF};
+	static const unsigned char flags_in[] = {0x00, 0xF0};
+	const int value_count = sizeof(values) / sizeof(values[0]);
+	int code, v, f, bit, mismatches = 0;
+
+	for (code = 0; code < 256; code++) {
+		if (!prefixed && (code == 0xCB || code == 0x10 || code == 0x76 || opcodes[code].execute == opcodes[0xD3].execute)) {
+			continue;
+		}
+		for (v = 0; v < value_count; v++) {
+			for (f = 0; f < 2; f++) {
+				unsigned char programme[3] = {prefixed ? 0xCB : code, prefixed ? code : values[v], values[v]};
+				CPUState *state = load_programme(programme, sizeof(programme));
+				state->A = state->B = state->C = state->D = state->E = values[v];
+				state->HL = 0xC000;
+				state->F = flags_in[f];
+				memory_space[0xC000] = values[v];
+
+				run_instructions(state, 1);
+				materialise_flags(&state->F);
+
+				for (bit = 0; bit < 4; bit++) {
+					unsigned char mask = 0x80 >> bit, out = state->F & mask;
+					char column = opcodes[code].flags[bit];
+					if ((column == '0' && out) || (column == '1' && !out) || (column == '-' && out != (flags_in[f] & mask))) {
+						if (mismatches++ < 4) {
+							printf("\t%s with %02X, F=%02X: flag %c gave F=%02X\n",
+								opcodes[code].mnemonic, values[v], flags_in[f], "ZNHC"[bit], state->F);
+						}
+					}
+				}
+				free(state);
+			}
+		}
+	}
+	check_value(prefixed ? "CB flags mismatches" : "Primary flags mismatches", 0, mismatches);
+}
+
+/**
+ * /brief Checks the disassembly of an instruction placed at PROGRAMME_START.
+ *
+ * @param bytes: The instruction.
+ * @param expected: The text we expect.
+ */
+void check_disassembly(const unsigned char *bytes, const char *expected) {
+	char text[DISASSEMBLY_MAX];
+
+	disassemble(bytes, PROGRAMME_START, text, sizeof(text));
+	if (strcmp(text, expected) != 0) {
+		printf("\tExpected \"%s\", got \"%s\"\n", expected, text);
+	}
+	check_value(expected, 0, strcmp(text, expected) != 0);
+}
+
+/**
+ * /brief Runs a loaded programme and brings F up to date so the tests can look at it.
+ *
+ * @param core: The core to run it on.
+ * @param state: Registers returned by load_programme.
+ * @param instruction_count: How many instructions to execute.
+ */
+void run_programme(const Core *core, CPUState *state, unsigned long instruction_count) {
+	core->run(state, instruction_count);
+	materialise_flags(&state->F);
+}
+
+/**
+ * /brief The table core, except that it turns the 03 stored by the lockstep test into a 33.
+ */
+unsigned long run_instructions_faulty(CPUState *state, unsigned long instruction_count) {
+	unsigned long executed = run_instructions(state, instruction_count);
+
+	if (memory_space[0xC002] == 0x03) {
+		memory_space[0xC002] = 0x33;
+	}
+	return executed;
+}
+
+/**
+ * /brief Copies a programme into memory and hands back fresh registers to run it with.
+ *
+ * @param programme: The bytes making up our programme.
+ * @param length: Length of the programme in bytes.
+ *
+ * @return Freshly initialised registers with the PC at the start of the programme.
+ */
+CPUState *load_programme(const unsigned char *programme, int length) {
+	memset(memory_space, 0, 0x10000);
+	memcpy(memory_space + PROGRAMME_START, programme, length);
+	flush_block_cache();
+	flush_jit();
+	reset_interrupts();
+	return initialise_registers();
+}
+
+/**
+ * /brief Stands in for the front end, noting what the MBC5 test's rumble cart told it.
+ */
+void record_rumble(int motor_on) {
+	rumble_changes++;
+	rumble_motor = motor_on;
+}
+
+/**
+ * /brief Checks a register or memory value after a test programme has run.
+ *
+ * @param description: What is being checked. Printed on failure.
+ * @param expected: The value we expect.
+ * @param actual: The value we got.
+ */
+void check_value(const char *description, unsigned short expected, unsigned short actual) {
+	if (expected != actual) {
+		++failures;
+		printf("\tFAILURE :_(\n");
+		printf("\t%s:\n\t\tExpected: %X\n\t\tActual: %X\n\n", description, expected, actual);
+	}
+	else {
+		++successes;
+		printf("\tSUCCESS!\n\n");
+	}
+}
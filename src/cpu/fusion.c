@@ -0,0 +1,234 @@
+/**
+ * This module contains the fused operations used by the block cache.
+ *
+ * Game Boy code leans on a handful of idioms: copy and fill loops, testing a 16 bit
+ * counter for zero, polling an I/O register until it reads a certain value. When the
+ * block cache decodes one of these it stores a single fused operation in place of the
+ * instructions, saving a trip round the run loop for each one folded in.
+ *
+ * A fused operation simply calls the adapters for its instructions one after the other,
+ * so the result is exactly as if they had been run separately. It counts as all of its
+ * instructions as far as the budget goes. The one thing that could tell the difference is
+ * a fused store writing over the instructions after it, so a fused operation about to
+ * store to a page holding cached code rewinds and lets the interpreter run the real bytes.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "fusion.h"
+#include "opcodes.h"
+#include "cycle_tables.h"
+
+// Positions in fusions[] and fusion_stats[]
+enum {
+	COPY_LOOP,
+	FILL_LOOP_DECREMENT,
+	FILL_LOOP_INCREMENT,
+	POLL_LOOP,
+	COPY_BYTE,
+	COUNTER_TEST,
+	POLL_COMPARE,
+	FUSION_COUNT
+};
+
+FusionStats fusion_stats[FUSION_COUNT];
+int fusion_enabled = 1;
+
+/**
+ * /brief Whether a store is about to land on a page holding cached code.
+ *
+ * If it is the fused operation can't assume the instructions after the store are the ones
+ * it was decoded from. So it rewinds the programme counter and has the interpreter run the
+ * instructions instead, which picks up whatever is there by the time it gets to them.
+ *
+ * The interpreter charges for the instructions as it goes, so what the block cache will
+ * charge for the fused operation is taken back first. They're executed one by one rather
+ * than through run_instructions, as the block cache takes the service point at the end of
+ * the block itself. Taking the table core's as well would count down a waiting EI twice.
+ *
+ * @param state: The CPU we are running.
+ * @param address: Where the store will go.
+ * @param fusion: The fused operation about to run.
+ *
+ * @return 1 if the interpreter ran the instructions. 0 if the fused operation should go ahead.
+ */
+static inline int store_hits_code(CPUState *state, unsigned short address, const Fusion *fusion) {
+	int i;
+
+	if (code_pages[address >> CODE_PAGE_SHIFT]) {
+		state->PC -= fusion->length;
+		state->cycles -= fusion_cycles(state->PC, fusion);
+		for (i = 0; i < fusion->count; i++) {
+			execute_instruction(state);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+// LD A,(HL+); LD (DE),A; INC DE; DEC BC; LD A,B; OR C; JR NZ back to the start
+static void fused_copy_loop(CPUState *state, unsigned short operand) {
+	++fusion_stats[COPY_LOOP].executed;
+	if (store_hits_code(state, state->DE, &fusions[COPY_LOOP])) {
+		return;
+	}
+	ldi_A_HL(state, 0);
+	ld_DE_A(state, 0);
+	inc_DE(state, 0);
+	dec_BC(state, 0);
+	ld_A_B(state, 0);
+	or_C(state, 0);
+	jr_NZ(state, fusions[COPY_LOOP].pattern[7]);
+}
+
+// LD (HL-),A; DEC B; JR NZ back to the start
+static void fused_fill_loop_decrement(CPUState *state, unsigned short operand) {
+	++fusion_stats[FILL_LOOP_DECREMENT].executed;
+	if (store_hits_code(state, state->HL, &fusions[FILL_LOOP_DECREMENT])) {
+		return;
+	}
+	ldd_HL_A(state, 0);
+	dec_B(state, 0);
+	jr_NZ(state, fusions[FILL_LOOP_DECREMENT].pattern[3]);
+}
+
+// LD (HL+),A; DEC B; JR NZ back to the start
+static void fused_fill_loop_increment(CPUState *state, unsigned short operand) {
+	++fusion_stats[FILL_LOOP_INCREMENT].executed;
+	if (store_hits_code(state, state->HL, &fusions[FILL_LOOP_INCREMENT])) {
+		return;
+	}
+	ldi_HL_A(state, 0);
+	dec_B(state, 0);
+	jr_NZ(state, fusions[FILL_LOOP_INCREMENT].pattern[3]);
+}
+
+// LDH A,(n); CP m; JR NZ back to the start. operand is n | m << 8
+static void fused_poll_loop(CPUState *state, unsigned short operand) {
+	++fusion_stats[POLL_LOOP].executed;
+	ldh_A_n(state, operand & 0xFF);
+	cp_n(state, operand >> 8);
+	jr_NZ(state, fusions[POLL_LOOP].pattern[5]);
+}
+
+// LD A,(HL+); LD (DE),A; INC DE
+static void fused_copy_byte(CPUState *state, unsigned short operand) {
+	++fusion_stats[COPY_BYTE].executed;
+	if (store_hits_code(state, state->DE, &fusions[COPY_BYTE])) {
+		return;
+	}
+	ldi_A_HL(state, 0);
+	ld_DE_A(state, 0);
+	inc_DE(state, 0);
+}
+
+// DEC BC; LD A,B; OR C
+static void fused_counter_test(CPUState *state, unsigned short operand) {
+	++fusion_stats[COUNTER_TEST].executed;
+	dec_BC(state, 0);
+	ld_A_B(state, 0);
+	or_C(state, 0);
+}
+
+// LDH A,(n); CP m. operand is n | m << 8
+static void fused_poll_compare(CPUState *state, unsigned short operand) {
+	++fusion_stats[POLL_COMPARE].executed;
+	ldh_A_n(state, operand & 0xFF);
+	cp_n(state, operand >> 8);
+}
+
+// Longest first, so a loop is preferred over the pieces of it
+const Fusion fusions[FUSION_COUNT] = {
+	[COPY_LOOP] = {"LD A,(HL+); LD (DE),A; INC DE; DEC BC; LD A,B; OR C; JR NZ", 8, 7, 1,
+		{0x2A, 0x12, 0x13, 0x0B, 0x78, 0xB1, 0x20, 0xF8}, {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, fused_copy_loop},
+	[FILL_LOOP_DECREMENT] = {"LD (HL-),A; DEC B; JR NZ", 4, 3, 1,
+		{0x32, 0x05, 0x20, 0xFC}, {0xFF, 0xFF, 0xFF, 0xFF}, fused_fill_loop_decrement},
+	[FILL_LOOP_INCREMENT] = {"LD (HL+),A; DEC B; JR NZ", 4, 3, 1,
+		{0x22, 0x05, 0x20, 0xFC}, {0xFF, 0xFF, 0xFF, 0xFF}, fused_fill_loop_increment},
+	[POLL_LOOP] = {"LDH A,(a8); CP n8; JR NZ", 6, 3, 1,
+		{0xF0, 0x00, 0xFE, 0x00, 0x20, 0xFA}, {0xFF, 0x00, 0xFF, 0x00, 0xFF, 0xFF}, fused_poll_loop},
+	[COPY_BYTE] = {"LD A,(HL+); LD (DE),A; INC DE", 3, 3, 0,
+		{0x2A, 0x12, 0x13}, {0xFF, 0xFF, 0xFF}, fused_copy_byte},
+	[COUNTER_TEST] = {"DEC BC; LD A,B; OR C", 3, 3, 0,
+		{0x0B, 0x78, 0xB1}, {0xFF, 0xFF, 0xFF}, fused_counter_test},
+	[POLL_COMPARE] = {"LDH A,(a8); CP n8", 4, 2, 0,
+		{0xF0, 0x00, 0xFE, 0x00}, {0xFF, 0x00, 0xFF, 0x00}, fused_poll_compare},
+};
+
+const int fusion_count = FUSION_COUNT;
+
+/**
+ * /brief Looks for a run of instructions which can be fused starting at an address.
+ *
+ * The loops only match when their jump goes back to their first instruction.
+ *
+ * @param address: Where the run would start.
+ * @param operand: Filled in with the run's operands, low byte first.
+ *
+ * @return The fusion, or NULL if there isn't one (or fusion is switched off).
+ */
+const Fusion* find_fusion(unsigned short address, unsigned short *operand) {
+	int i, j;
+
+	if (!fusion_enabled) {
+		return NULL;
+	}
+
+	for (i = 0; i < FUSION_COUNT; i++) {
+		const Fusion *fusion = &fusions[i];
+		int operand_bytes = 0;
+
+		*operand = 0;
+		for (j = 0; j < fusion->length; j++) {
+			unsigned char byte = read_byte(address + j);
+			if (fusion->mask[j] == 0) {
+				*operand |= byte << (8 * operand_bytes++);
+			}
+			else if (byte != fusion->pattern[j]) {
+				break;
+			}
+		}
+
+		if (j == fusion->length) {
+			++fusion_stats[i].sites;
+			return fusion;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * /brief Works out the cycles a fused operation takes, branches not taken.
+ *
+ * @param address: Where the run starts.
+ * @param fusion: The fused operation decoded there.
+ *
+ * @return T-cycles its instructions take between them.
+ */
+unsigned int fusion_cycles(unsigned short address, const Fusion *fusion) {
+	unsigned int cycles = 0;
+	int i;
+
+	for (i = 0; i < fusion->count; i++) {
+		cycles += instruction_cycles(address);
+		address += primary_opcodes[read_byte(address)].length;
+	}
+
+	return cycles;
+}
+
+/**
+ * /brief Prints how often each fusion was found and run.
+ */
+void print_fusion_stats() {
+	int i;
+
+	printf("Fusions:\n");
+	for (i = 0; i < FUSION_COUNT; i++) {
+		printf("\t%-60s %6lu sites, %12lu runs, %12lu instructions\n", fusions[i].name,
+			fusion_stats[i].sites, fusion_stats[i].executed, fusion_stats[i].executed * fusions[i].count);
+	}
+}
@@ -0,0 +1,47 @@
+/**
+ * A header file for macro-op fusion: common runs of instructions which the block cache
+ * decodes into a single operation.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef FUSION_H
+#define FUSION_H
+
+#include "register.h"
+#include "dispatch.h"
+
+#define MAX_FUSION_LENGTH 	8		// Most bytes a fused run of instructions can span
+
+/**
+ * A run of instructions which can be fused, and the operation which replaces it.
+ */
+typedef struct {
+	const char *name;							/** Shown in the statistics */
+	unsigned char length;						/** Bytes the run spans */
+	unsigned char count;						/** Instructions in the run */
+	unsigned char ends_block;					/** The run finishes with a jump */
+	unsigned char pattern[MAX_FUSION_LENGTH];	/** The bytes of the run. Operands are left as 0 */
+	unsigned char mask[MAX_FUSION_LENGTH];		/** 0xFF where a byte must match the pattern, 0 for operands */
+	OpcodeHandler execute;						/** Runs the whole lot. Operands are packed low byte first */
+} Fusion;
+
+/**
+ * How often each fusion was found and run.
+ */
+typedef struct {
+	unsigned long sites;			/** Times the run was decoded into a fused operation */
+	unsigned long executed;			/** Times the fused operation was run */
+} FusionStats;
+
+extern const Fusion fusions[];
+extern const int fusion_count;
+extern FusionStats fusion_stats[];
+extern int fusion_enabled;			// Set to 0 to decode every instruction on its own
+
+// See fusion.c for more thorough explination of these functions
+const Fusion* find_fusion(unsigned short address, unsigned short *operand);
+unsigned int fusion_cycles(unsigned short address, const Fusion *fusion);
+void print_fusion_stats();
+
+#endif // FUSION_H
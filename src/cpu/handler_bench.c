@@ -0,0 +1,398 @@
+/*
+ * Times every handler in instructions.h, built the way the emulator is, and writes out the
+ * nanoseconds each took per call as JSON: the minimum, median and 99th percentile over
+ * BENCH_SAMPLES batches of BENCH_BATCH calls. materialise_flags and discard_pending_flags
+ * are left out, being empty unless built with LAZY_FLAGS.
+ *
+ * The operands are random, drawn once from a fixed seed so runs compare, and the memory
+ * the handlers read is filled the same way. Handlers whose work depends on the flags (the
+ * conditional jumps, calls and returns) are timed with the condition met and not, as
+ * separate entries. Timings include the loop around the call and loading its operands;
+ * the "(loop)" entry times just those for comparison.
+ *
+ * The process is pinned to one processor (0 unless given another as the only argument)
+ * and every handler is run for BENCH_WARMUP batches before timing starts.
+ *
+ * Usage: handler_bench [processor] > handlers.json, or `make bench`.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+
+#include "register.h"
+#include "instructions.h"
+#include "../memory/memory.h"
+
+#define BENCH_BATCH 		1024	// Calls timed together
+#define BENCH_SAMPLES 		301		// Batches timed per handler
+#define BENCH_WARMUP 		50		// Batches run untimed first
+#define BENCH_SEED 			0x2545F491
+
+#define STACK_START 		0xD000	// Enough room either side for a batch of pushes or pops
+#define RAM_ADDRESS(operand) 	(0xC000 | ((operand) & 0x0FFF))		// Somewhere in work RAM
+#define HRAM_OFFSET(operand) 	(0x80 | ((operand) & 0x7F) % 0x7F)		// 0x80 - 0xFE. Keeps away from IF and IE
+
+#define Z_SET 				0x80
+#define C_SET 				0x10
+
+/*
+ * Runs a handler BENCH_BATCH times, once per operand.
+ */
+typedef void (*BenchBody)(CPUState *state, const unsigned short *operands);
+
+typedef struct {
+	const char *name;
+	BenchBody body;
+	Register8 flags;		// F at the start of each batch
+} Bench;
+
+unsigned char *memory_space = NULL;
+
+static unsigned short operands[BENCH_BATCH];
+
+/*
+ * Declares the body of a benchmark: statement is run once per operand, with the operand
+ * to hand as operand. Bodies which don't need it leave it unused. Kept out of line so each
+ * is timed on its own.
+ */
+#define BENCH_BODY(name, statement) \
+	static __attribute__((noinline)) void bench_##name(CPUState *state, const unsigned short *operands) { \
+		int i; \
+		for (i = 0; i < BENCH_BATCH; i++) { \
+			unsigned short operand = operands[i]; \
+			(void) operand; \
+			statement; \
+		} \
+	}
+
+// An 8 bit operation on A with the operand in B, as an immediate and behind HL
+#define ALU_BODIES(prefix, suffix) \
+	BENCH_BODY(prefix##_register##suffix, state->B = operand; prefix##_register##suffix(&state->A, &state->B, &state->F)) \
+	BENCH_BODY(prefix##_immediate##suffix, prefix##_immediate##suffix(&state->A, operand, &state->F)) \
+	BENCH_BODY(prefix##_indirect##suffix, state->HL = RAM_ADDRESS(operand); prefix##_indirect##suffix(&state->A, &state->HL, &state->F))
+
+// An operation on B and the same behind HL
+#define SINGLE_BODIES(register_handler, indirect_handler) \
+	BENCH_BODY(register_handler, state->B = operand; register_handler(&state->B, &state->F)) \
+	BENCH_BODY(indirect_handler, state->HL = RAM_ADDRESS(operand); indirect_handler(&state->HL, &state->F))
+
+// SET and RES, picking the bit from the operand
+#define BIT_BODIES(register_handler, indirect_handler) \
+	BENCH_BODY(register_handler, state->B = operand; register_handler(&state->B, (operand >> 8) & 7)) \
+	BENCH_BODY(indirect_handler, state->HL = RAM_ADDRESS(operand); indirect_handler(&state->HL, (operand >> 12) & 7))
+
+BENCH_BODY(loop, state->B = operand)
+
+/*** 8 BIT LOADS ***/
+
+BENCH_BODY(load_immediate_byte, load_immediate_byte(&state->B, operand))
+BENCH_BODY(load_register, state->C = operand; load_register(&state->B, &state->C))
+BENCH_BODY(load_register_indirect_destination, state->HL = RAM_ADDRESS(operand); load_register_indirect_destination(&state->HL, &state->B))
+BENCH_BODY(load_register_indirect_source, state->HL = RAM_ADDRESS(operand); load_register_indirect_source(&state->B, &state->HL))
+BENCH_BODY(load_accumulator_from_address, load_accumulator_from_address(&state->A, RAM_ADDRESS(operand)))
+BENCH_BODY(write_accumulator_to_address, write_accumulator_to_address(RAM_ADDRESS(operand), &state->A))
+BENCH_BODY(load_accumulator_decrement_address_register, state->HL = RAM_ADDRESS(operand);
+	load_accumulator_decrement_address_register(&state->A, &state->HL))
+BENCH_BODY(load_accumulator_increment_address_register, state->HL = RAM_ADDRESS(operand);
+	load_accumulator_increment_address_register(&state->A, &state->HL))
+BENCH_BODY(write_accumulator_decrement_address_register, state->HL = RAM_ADDRESS(operand);
+	write_accumulator_decrement_address_register(&state->HL, &state->A))
+BENCH_BODY(write_accumulator_increment_address_register, state->HL = RAM_ADDRESS(operand);
+	write_accumulator_increment_address_register(&state->HL, &state->A))
+BENCH_BODY(load_from_io_port_c, state->C = HRAM_OFFSET(operand); load_from_io_port_c(&state->A, &state->C))
+BENCH_BODY(write_to_io_port_c, state->C = HRAM_OFFSET(operand); write_to_io_port_c(&state->C, &state->A))
+BENCH_BODY(load_from_io_port_n, load_from_io_port_n(&state->A, HRAM_OFFSET(operand)))
+BENCH_BODY(write_to_io_port_n, write_to_io_port_n(HRAM_OFFSET(operand), &state->A))
+
+/*** 16 BIT LOADS ***/
+
+BENCH_BODY(load_immediate_short, load_immediate_short(&state->BC, operand))
+BENCH_BODY(load_stack_pointer, state->HL = operand; load_stack_pointer(&state->DE, &state->HL))
+BENCH_BODY(load_stack_pointer_offset, state->DE = state->SP; load_stack_pointer_offset(&state->DE, (signed char) operand, &state->F))
+BENCH_BODY(write_stack_pointer_to_address, write_stack_pointer_to_address(&state->SP, RAM_ADDRESS(operand)))
+BENCH_BODY(push, state->BC = operand; push(&state->SP, &state->BC))
+BENCH_BODY(pop, pop(&state->SP, &state->BC))
+
+/*** 8 BIT ALU ***/
+
+ALU_BODIES(add, )
+ALU_BODIES(add, _with_carry)
+ALU_BODIES(subtract, )
+ALU_BODIES(subtract, _with_carry)
+ALU_BODIES(bitwise_and, )
+ALU_BODIES(bitwise_or, )
+ALU_BODIES(bitwise_xor, )
+ALU_BODIES(compare, )
+SINGLE_BODIES(increment_register, increment_register_indirect)
+SINGLE_BODIES(decrement_register, decrement_register_indirect)
+
+/*** 16 BIT ALU ***/
+
+BENCH_BODY(indirect_register_add, state->BC = operand; indirect_register_add(&state->HL, &state->BC, &state->F))
+BENCH_BODY(stack_pointer_add, state->DE = state->SP; stack_pointer_add(&state->DE, operand, &state->F))
+BENCH_BODY(increment_register_16, state->BC = operand; increment_register_16(&state->BC))
+BENCH_BODY(decrement_register_16, state->BC = operand; decrement_register_16(&state->BC))
+
+/*** ROTATES, SHIFTS, SWAPS AND BITS ***/
+
+SINGLE_BODIES(rotate_register_left_carry_archive, rotate_indirect_left_carry_archive)
+SINGLE_BODIES(rotate_register_left_through_carry, rotate_indirect_left_through_carry)
+SINGLE_BODIES(rotate_register_right_carry_archive, rotate_indirect_right_carry_archive)
+SINGLE_BODIES(rotate_register_right_through_carry, rotate_indirect_right_through_carry)
+SINGLE_BODIES(shift_register_left, shift_indirect_left)
+SINGLE_BODIES(arithmetic_shift_register_right, arithmetic_shift_indirect_right)
+SINGLE_BODIES(logical_shift_register_right, logical_shift_indirect_right)
+SINGLE_BODIES(swap_nibble_register, swap_nibble_indirect)
+BENCH_BODY(test_bit_register, state->B = operand; test_bit_register(&state->B, (operand >> 8) & 7, &state->F))
+BENCH_BODY(test_bit_indirect, state->HL = RAM_ADDRESS(operand); test_bit_indirect(&state->HL, (operand >> 12) & 7, &state->F))
+BIT_BODIES(set_bit_register, set_bit_indirect)
+BIT_BODIES(reset_bit_register, reset_bit_indirect)
+
+/*** JUMPS, CALLS AND RETURNS ***/
+
+// The flags decide whether the conditional ones are taken, see the list of benchmarks
+#define CONDITIONAL_BODY(handler, ...) \
+	BENCH_BODY(handler, handler(__VA_ARGS__, &state->F))
+
+BENCH_BODY(jump_unconditional, jump_unconditional(&state->PC, operand))
+BENCH_BODY(jump_indirect, state->HL = operand; jump_indirect(&state->PC, &state->HL))
+BENCH_BODY(jump_relative_pos, jump_relative_pos(&state->PC, operand))
+CONDITIONAL_BODY(jump_zero_reset, &state->PC, operand)
+CONDITIONAL_BODY(jump_zero_set, &state->PC, operand)
+CONDITIONAL_BODY(jump_carry_reset, &state->PC, operand)
+CONDITIONAL_BODY(jump_carry_set, &state->PC, operand)
+CONDITIONAL_BODY(jump_relative_zero_reset, &state->PC, operand)
+CONDITIONAL_BODY(jump_relative_zero_set, &state->PC, operand)
+CONDITIONAL_BODY(jump_relative_carry_reset, &state->PC, operand)
+CONDITIONAL_BODY(jump_relative_carry_set, &state->PC, operand)
+BENCH_BODY(restart, restart(&state->SP, &state->PC, operand & 0x38))
+BENCH_BODY(call, call(&state->SP, &state->PC, operand))
+CONDITIONAL_BODY(call_zero_reset, &state->SP, &state->PC, operand)
+CONDITIONAL_BODY(call_zero_set, &state->SP, &state->PC, operand)
+CONDITIONAL_BODY(call_carry_reset, &state->SP, &state->PC, operand)
+CONDITIONAL_BODY(call_carry_set, &state->SP, &state->PC, operand)
+BENCH_BODY(return_unconditional, return_unconditional(&state->SP, &state->PC))
+CONDITIONAL_BODY(return_zero_reset, &state->SP, &state->PC)
+CONDITIONAL_BODY(return_zero_set, &state->SP, &state->PC)
+CONDITIONAL_BODY(return_carry_reset, &state->SP, &state->PC)
+CONDITIONAL_BODY(return_carry_set, &state->SP, &state->PC)
+
+/*** MISCELLANEOUS ***/
+
+BENCH_BODY(decimal_adjust_accumulator, state->A = operand; decimal_adjust_accumulator(&state->A, &state->F))
+BENCH_BODY(complement_accumulator, complement_accumulator(&state->A, &state->F))
+BENCH_BODY(complement_carry_flag, complement_carry_flag(&state->F))
+BENCH_BODY(set_carry_flag, set_carry_flag(&state->F))
+BENCH_BODY(keep_carry_flag, keep_carry_flag(&state->F, operand & 1))
+
+/*** THE BENCHMARKS ***/
+
+#define BENCH(name) 				{#name, bench_##name, 0},
+#define BENCH_ALU(prefix, suffix) 	BENCH(prefix##_register##suffix) BENCH(prefix##_immediate##suffix) BENCH(prefix##_indirect##suffix)
+#define BENCH_PAIR(first, second) 	BENCH(first) BENCH(second)
+
+// Once with the condition met and once without
+#define BENCH_CONDITIONAL(name, taken_flags, not_taken_flags) \
+	{#name " (taken)", bench_##name, taken_flags}, \
+	{#name " (not taken)", bench_##name, not_taken_flags},
+
+static const Bench benches[] = {
+	BENCH(loop)
+
+	BENCH(load_immediate_byte)
+	BENCH(load_register)
+	BENCH(load_register_indirect_destination)
+	BENCH(load_register_indirect_source)
+	BENCH(load_accumulator_from_address)
+	BENCH(write_accumulator_to_address)
+	BENCH(load_accumulator_decrement_address_register)
+	BENCH(load_accumulator_increment_address_register)
+	BENCH(write_accumulator_decrement_address_register)
+	BENCH(write_accumulator_increment_address_register)
+	BENCH(load_from_io_port_c)
+	BENCH(write_to_io_port_c)
+	BENCH(load_from_io_port_n)
+	BENCH(write_to_io_port_n)
+
+	BENCH(load_immediate_short)
+	BENCH(load_stack_pointer)
+	BENCH(load_stack_pointer_offset)
+	BENCH(write_stack_pointer_to_address)
+	BENCH(push)
+	BENCH(pop)
+
+	BENCH_ALU(add, )
+	BENCH_ALU(add, _with_carry)
+	BENCH_ALU(subtract, )
+	BENCH_ALU(subtract, _with_carry)
+	BENCH_ALU(bitwise_and, )
+	BENCH_ALU(bitwise_or, )
+	BENCH_ALU(bitwise_xor, )
+	BENCH_ALU(compare, )
+	BENCH_PAIR(increment_register, increment_register_indirect)
+	BENCH_PAIR(decrement_register, decrement_register_indirect)
+
+	BENCH(indirect_register_add)
+	BENCH(stack_pointer_add)
+	BENCH(increment_register_16)
+	BENCH(decrement_register_16)
+
+	BENCH_PAIR(rotate_register_left_carry_archive, rotate_indirect_left_carry_archive)
+	BENCH_PAIR(rotate_register_left_through_carry, rotate_indirect_left_through_carry)
+	BENCH_PAIR(rotate_register_right_carry_archive, rotate_indirect_right_carry_archive)
+	BENCH_PAIR(rotate_register_right_through_carry, rotate_indirect_right_through_carry)
+	BENCH_PAIR(shift_register_left, shift_indirect_left)
+	BENCH_PAIR(arithmetic_shift_register_right, arithmetic_shift_indirect_right)
+	BENCH_PAIR(logical_shift_register_right, logical_shift_indirect_right)
+	BENCH_PAIR(swap_nibble_register, swap_nibble_indirect)
+	BENCH_PAIR(test_bit_register, test_bit_indirect)
+	BENCH_PAIR(set_bit_register, set_bit_indirect)
+	BENCH_PAIR(reset_bit_register, reset_bit_indirect)
+
+	BENCH(jump_unconditional)
+	BENCH(jump_indirect)
+	BENCH(jump_relative_pos)
+	BENCH_CONDITIONAL(jump_zero_reset, 0, Z_SET)
+	BENCH_CONDITIONAL(jump_zero_set, Z_SET, 0)
+	BENCH_CONDITIONAL(jump_carry_reset, 0, C_SET)
+	BENCH_CONDITIONAL(jump_carry_set, C_SET, 0)
+	BENCH_CONDITIONAL(jump_relative_zero_reset, 0, Z_SET)
+	BENCH_CONDITIONAL(jump_relative_zero_set, Z_SET, 0)
+	BENCH_CONDITIONAL(jump_relative_carry_reset, 0, C_SET)
+	BENCH_CONDITIONAL(jump_relative_carry_set, C_SET, 0)
+	BENCH(restart)
+	BENCH(call)
+	BENCH_CONDITIONAL(call_zero_reset, 0, Z_SET)
+	BENCH_CONDITIONAL(call_zero_set, Z_SET, 0)
+	BENCH_CONDITIONAL(call_carry_reset, 0, C_SET)
+	BENCH_CONDITIONAL(call_carry_set, C_SET, 0)
+	BENCH(return_unconditional)
+	BENCH_CONDITIONAL(return_zero_reset, 0, Z_SET)
+	BENCH_CONDITIONAL(return_zero_set, Z_SET, 0)
+	BENCH_CONDITIONAL(return_carry_reset, 0, C_SET)
+	BENCH_CONDITIONAL(return_carry_set, C_SET, 0)
+
+	BENCH(decimal_adjust_accumulator)
+	BENCH(complement_accumulator)
+	BENCH(complement_carry_flag)
+	BENCH(set_carry_flag)
+	BENCH(keep_carry_flag)
+};
+
+#define BENCH_COUNT ((int) (sizeof(benches) / sizeof(benches[0])))
+
+void pin_to_processor(int processor);
+void fill_random(unsigned int seed);
+void time_bench(const Bench *bench, CPUState *state, double *nanoseconds);
+int compare_doubles(const void *a, const void *b);
+
+int main(int argc, char *argv[]) {
+	int processor = argc > 1 ? atoi(argv[1]) : 0;
+	CPUState *state;
+	double nanoseconds[BENCH_SAMPLES];
+	int i;
+
+	memory_space = calloc(MEMORY_SPACE_SIZE, sizeof(unsigned char));
+	map_memory();		// Memory accesses as quick as the emulator's
+	state = initialise_registers();
+	pin_to_processor(processor);
+	fill_random(BENCH_SEED);
+
+	printf("{\n\t\"processor\": %d,\n\t\"batch\": %d,\n\t\"samples\": %d,\n\t\"handlers\": [\n",
+		processor, BENCH_BATCH, BENCH_SAMPLES);
+	for (i = 0; i < BENCH_COUNT; i++) {
+		time_bench(&benches[i], state, nanoseconds);
+		qsort(nanoseconds, BENCH_SAMPLES, sizeof(double), compare_doubles);
+		printf("\t\t{\"name\": \"%s\", \"min_ns\": %.3f, \"median_ns\": %.3f, \"p99_ns\": %.3f}%s\n", benches[i].name,
+			nanoseconds[0], nanoseconds[BENCH_SAMPLES / 2], nanoseconds[BENCH_SAMPLES * 99 / 100],
+			i + 1 < BENCH_COUNT ? "," : "");
+	}
+	printf("\t]\n}\n");
+
+	free(state);
+	free(memory_space);
+	return 0;
+}
+
+/**
+ * /brief Keeps the process on one processor, so the timings aren't thrown by migrations.
+ *
+ * @param processor: Which one. Carries on unpinned, with a warning, if it can't be had.
+ */
+void pin_to_processor(int processor) {
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(processor, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+		fprintf(stderr, "Couldn't pin to processor %d, timing unpinned\n", processor);
+	}
+#else
+	fprintf(stderr, "Pinning isn't supported here, timing unpinned\n");
+#endif
+}
+
+/**
+ * /brief Fills the operands and memory with random values.
+ *
+ * A xorshift generator, so every run and every machine sees the same values.
+ *
+ * @param seed: Where to start. Must not be 0.
+ */
+void fill_random(unsigned int seed) {
+	int i;
+
+	for (i = 0; i < BENCH_BATCH + MEMORY_SPACE_SIZE; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		if (i < BENCH_BATCH) {
+			operands[i] = seed;
+		}
+		else {
+			memory_space[i - BENCH_BATCH] = seed;
+		}
+	}
+	memory_space[INTERRUPT_FLAG_ADDRESS] = 0;		// Nothing to be done with these, as no core runs
+	memory_space[INTERRUPT_ENABLE_ADDRESS] = 0;
+}
+
+/**
+ * /brief Times a benchmark, after warming it up.
+ *
+ * Each batch starts from the same registers, bar A and F, so the stack never runs off the
+ * end of work RAM.
+ *
+ * @param bench: What to time.
+ * @param state: Registers to run it on.
+ * @param nanoseconds: Filled with the time per call of each of BENCH_SAMPLES batches.
+ */
+void time_bench(const Bench *bench, CPUState *state, double *nanoseconds) {
+	struct timespec start, end;
+	int i;
+
+	for (i = -BENCH_WARMUP; i < BENCH_SAMPLES; i++) {
+		state->SP = STACK_START;
+		state->HL = RAM_ADDRESS(0);
+		discard_pending_flags(&state->F);
+		state->F = bench->flags;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		bench->body(state, operands);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+
+		if (i >= 0) {
+			nanoseconds[i] = ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / BENCH_BATCH;
+		}
+	}
+}
+
+int compare_doubles(const void *a, const void *b) {
+	double difference = *(const double *) a - *(const double *) b;
+	return (difference > 0) - (difference < 0);
+}
@@ -0,0 +1,159 @@
+/**
+ * This module contains the pieces used to fast forward through idle loops.
+ *
+ * A lot of Game Boy code is spent waiting: spinning on LY or STAT for the PPU to reach a
+ * certain line, or on a RAM flag for the VBlank interrupt to set it. Such a loop reads
+ * memory and compares, but writes nothing. So if one trip round it leaves every register
+ * exactly as it found them, the next trip will too and so will every trip after, right up
+ * until something other than the CPU changes memory.
+ *
+ * A core using this checks the instructions of a loop with idle_safe_instruction once, and
+ * compares the registers before and after a trip round it. If they match, skip_idle_loop
+ * works out how many whole trips can be skipped: as many as fit in the budget without
+ * passing the next hardware event. The instruction count moves on exactly as if the trips
+ * had been made, so anything clocked off it lands exactly where it would have.
+ *
+ * HALT and STOP are the sanctioned way to wait. A halted CPU sits going round its HALT
+ * (see opcodes.h), so sleep_while_halted skips those trips the same way.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "idle.h"
+#include "cycle_tables.h"
+#include "../memory/memory.h"
+
+IdleStats idle_stats;
+int idle_skipping_enabled = 1;
+
+/**
+ * /brief Whether an instruction can be part of an idle loop.
+ *
+ * That is anything which doesn't write to memory, touch the stack or change how the CPU
+ * runs (HALT, STOP, DI, EI). Loads into registers and arithmetic are fine, as whether
+ * they change anything is down to the register comparison.
+ *
+ * @param address: Address of the instruction.
+ *
+ * @return 1 if it may be part of an idle loop. 0 otherwise.
+ */
+int idle_safe_instruction(unsigned short address) {
+	unsigned char opcode = read_byte(address);
+
+	if (opcode == 0xCB) {
+		// BIT on anything, the rest only on registers
+		unsigned char cb_opcode = read_byte(address + 1);
+		return (cb_opcode >= 0x40 && cb_opcode < 0x80) || (cb_opcode & 0x07) != 0x06;
+	}
+
+	if (opcode >= 0x40 && opcode < 0x80) {
+		return opcode < 0x70 || opcode > 0x77;		// Not LD (HL),r or HALT
+	}
+	if (opcode >= 0x80 && opcode < 0xC0) {
+		return 1;		// 8 bit arithmetic
+	}
+
+	switch (opcode) {
+		case 0x00: 																	// NOP
+		case 0x01: case 0x11: case 0x21: case 0x31: 								// LD rr,nn
+		case 0x03: case 0x13: case 0x23: case 0x33: case 0x0B: case 0x1B: case 0x2B: case 0x3B: 	// INC/DEC rr
+		case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C: 	// INC r
+		case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D: 	// DEC r
+		case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E: 	// LD r,n
+		case 0x09: case 0x19: case 0x29: case 0x39: 								// ADD HL,rr
+		case 0x0A: case 0x1A: case 0x2A: case 0x3A: 								// LD A,(BC), (DE), (HL+), (HL-)
+		case 0x07: case 0x0F: case 0x17: case 0x1F: 								// Rotates on A
+		case 0x27: case 0x2F: case 0x37: case 0x3F: 								// DAA, CPL, SCF, CCF
+		case 0xC6: case 0xCE: case 0xD6: case 0xDE: case 0xE6: case 0xEE: case 0xF6: case 0xFE: 	// Arithmetic with n
+		case 0xF0: case 0xF2: case 0xFA: 											// LDH A,(n), LD A,(C), LD A,(nn)
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: 						// JR
+		case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: case 0xE9: 			// JP
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * /brief Whether a trip round a loop left the registers as it found them.
+ *
+ * F must already be up to date in both (see materialise_flags).
+ *
+ * @param before: The registers at the top of the loop.
+ * @param after: The registers back at the top of the loop.
+ *
+ * @return 1 if they are the same. 0 otherwise.
+ */
+int same_registers(const CPUState *before, const CPUState *after) {
+	return before->AF == after->AF && before->BC == after->BC && before->DE == after->DE &&
+		before->HL == after->HL && before->SP == after->SP && before->PC == after->PC;
+}
+
+/**
+ * /brief Works out how far to skip ahead through a loop found to be idling.
+ *
+ * Only whole trips round the loop are skipped, so the core is left at the top of the loop
+ * as it was. Any instructions left over are for the core to run as normal. The cycles
+ * the skipped trips would have taken are charged all the same.
+ *
+ * @param state: The CPU, at the top of the loop.
+ * @param iteration_length: Instructions in one trip round the loop.
+ * @param iteration_cycles: Cycles one trip round the loop takes.
+ * @param budget: Instructions the core has left to run.
+ *
+ * @return The number of instructions skipped.
+ */
+unsigned long skip_idle_loop(CPUState *state, unsigned long iteration_length, unsigned long iteration_cycles, unsigned long budget) {
+	unsigned long horizon = instructions_until_next_event();
+	unsigned long iterations;
+
+	if (!idle_skipping_enabled || iteration_length == 0) {
+		return 0;
+	}
+
+	iterations = (budget < horizon ? budget : horizon) / iteration_length;
+	if (iterations > 0) {
+		++idle_stats.loops_detected;
+		idle_stats.iterations_skipped += iterations;
+		idle_stats.instructions_skipped += iterations * iteration_length;
+		state->cycles += iterations * iteration_cycles;
+	}
+	return iterations * iteration_length;
+}
+
+/**
+ * /brief Works out how far to sleep through HALT or STOP.
+ *
+ * The CPU is left sat on its HALT or STOP, to check for itself whether it has been woken
+ * when it next runs.
+ *
+ * @param state: The CPU, which must be halted.
+ * @param budget: Instructions the core has left to run.
+ *
+ * @return The number of instructions slept through.
+ */
+unsigned long sleep_while_halted(CPUState *state, unsigned long budget) {
+	unsigned long horizon = instructions_until_next_event();
+	unsigned long slept = budget < horizon ? budget : horizon;
+
+	if (!idle_skipping_enabled || !state->halted) {
+		return 0;
+	}
+
+	idle_stats.halted_skipped += slept;
+	state->cycles += slept * instruction_cycles(state->PC);		// A trip round the HALT or STOP each
+	return slept;
+}
+
+/**
+ * /brief Prints how much waiting was skipped.
+ */
+void print_idle_stats() {
+	printf("Idle loops:\n");
+	printf("\tDetected: %lu\n", idle_stats.loops_detected);
+	printf("\tIterations skipped: %lu\n", idle_stats.iterations_skipped);
+	printf("\tInstructions skipped: %lu\n", idle_stats.instructions_skipped);
+	printf("\tInstructions slept through halted: %lu\n", idle_stats.halted_skipped);
+}
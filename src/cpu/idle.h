@@ -0,0 +1,50 @@
+/**
+ * A header file for skipping idle time: loops which do nothing but wait for the hardware,
+ * and the CPU sat halted, are skipped ahead rather than run round and round.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <limits.h>
+
+#include "register.h"
+
+/**
+ * Running totals for seeing how much time a game spends waiting.
+ */
+typedef struct {
+	unsigned long loops_detected;			/** Times a loop was found to be idling */
+	unsigned long iterations_skipped;		/** Trips round those loops we didn't have to make */
+	unsigned long instructions_skipped;		/** Instructions in those trips */
+	unsigned long halted_skipped;			/** Instructions slept through on HALT or STOP */
+} IdleStats;
+
+extern IdleStats idle_stats;
+extern int idle_skipping_enabled;		// Set to 0 to run every idle loop out in full
+
+/**
+ * /brief How many instructions until something other than the CPU could change memory.
+ *
+ * That's the furthest an idle loop or a halted CPU can be skipped ahead, as whatever it's polling can't
+ * change before then. Nothing but the CPU touches memory while a core runs yet, so the answer
+ * is never. The benchmark moves LY on between runs, and gives a core no more instructions than
+ * can reach the next line (see run_until in benchmark.c), which holds the skipping back to it.
+ * The PPU, timers and interrupts each bring it in once they exist.
+ *
+ * @return Instructions until the next hardware event.
+ */
+static inline unsigned long instructions_until_next_event() {
+	return ULONG_MAX;
+}
+
+// See idle.c for more thorough explination of these functions
+int idle_safe_instruction(unsigned short address);
+int same_registers(const CPUState *before, const CPUState *after);
+unsigned long skip_idle_loop(CPUState *state, unsigned long iteration_length, unsigned long iteration_cycles, unsigned long budget);
+unsigned long sleep_while_halted(CPUState *state, unsigned long budget);
+void print_idle_stats();
+
+#endif // IDLE_H
@@ -10,17 +10,26 @@
  * 		add C
  *
  * Where as in this implimentation we simply would have one function with varying arguments.
- * To ease development, as much as possible I will try to annotate each function with the 
- * op codes that would result in such a function being called. 
+ * Which opcodes end up calling each function is down to the adapters in opcodes.h. Rather
+ * than keep lists of them by hand here, `make listing` writes out build/gen/opcodes.txt
+ * from the opcode lists, giving every opcode's adapter alongside its mnemonic and timing.
  *
  * Other important note: Unless specified otherwise, it will be assumed that pointers to 
  * register values are being passed in. this will allow for values to be manipulated in place 
  * This decision does lead to the implimentation of seperate functions for working with 
  * immediate values and those already stored in registers. 
  *
- * Note: The following instructions are not implemented in this file:
+ * Note: The following instructions are not implemented in this file, as they work on the CPU
+ * 		as a whole rather than its registers. Their adapters in opcodes.h see to them:
  * 		NOP, HALT, STOP, DI, EI, 
  *
+ * Note: Built with LAZY_FLAGS, the 8 bit arithmetic and logic instructions only note down
+ * 		their operands and F is worked out by materialise_flags when something reads it.
+ * 		Conditional jumps get Z and C through zero_flag_set and carry_flag_set without
+ * 		ever building F. It is off by default: on Tetris it came out 2-7% slower on the
+ * 		interpreters and about half the speed on the JIT, which must settle F after every
+ * 		adapter it calls.
+ *
  * Authors: Rocky Petkov
  */
 
@@ -30,12 +39,89 @@
 
 #include "../util.h"
 #include "instructions.h"
+#include "alu_tables.h"
+#include "call_graph.h"
 #include "../memory/memory.h"
 
 // Here's some functions we don't want to be visible!
 // Flag Management
-Register8 set_flags_add(Register8 result, Register8 old_accumulator);
-Register8 set_flags_sub(Register8 result, Register8 old_accumulator);
+Register8 set_flags_add(Register8 result, Register8 old_accumulator, unsigned char carry);
+Register8 set_flags_sub(Register8 result, Register8 old_accumulator, unsigned char carry);
+
+/**
+ * /brief Adds to the accumulator and updates the flags.
+ *
+ * Looks the result and flags up in alu_add_table, or with LAZY_FLAGS notes down the
+ * operands so that materialise_flags can work F out if anyone ever asks.
+ *
+ * @param accumulator: Pointer to the accumulator
+ * @param value: What to add to it
+ * @param carry: The carry to feed into the add (0 or 1)
+ * @param flags: Pointer to the flags register
+ */
+static inline void add_to_accumulator(Register8 *accumulator, Register8 value, unsigned char carry, Register8 *flags) {
+#ifdef LAZY_FLAGS
+	Register8 result = *accumulator + value + carry;
+	*PENDING_FLAGS(flags) = (PendingFlags){FLAGS_ADD, result, *accumulator, carry};
+	*accumulator = result;
+#else
+	Register16 entry = alu_add_table[carry][*accumulator][value];
+	*accumulator = entry >> 8;
+	*flags = entry;
+#endif
+}
+
+/**
+ * /brief Subtracts from the accumulator and updates the flags. See add_to_accumulator.
+ */
+static inline void subtract_from_accumulator(Register8 *accumulator, Register8 value, unsigned char carry, Register8 *flags) {
+#ifdef LAZY_FLAGS
+	Register8 result = *accumulator - value - carry;
+	*PENDING_FLAGS(flags) = (PendingFlags){FLAGS_SUB, result, *accumulator, carry};
+	*accumulator = result;
+#else
+	Register16 entry = alu_sub_table[carry][*accumulator][value];
+	*accumulator = entry >> 8;
+	*flags = entry;
+#endif
+}
+
+/**
+ * /brief Increments or decrements a register and updates the flags as an add or subtract of 1 would.
+ *
+ * @param target_register: Pointer to the register
+ * @param table: alu_increment_table or alu_decrement_table
+ * @param operation: FLAGS_ADD or FLAGS_SUB to match
+ * @param flags: Pointer to the flags register
+ */
+static inline void step_register(Register8 *target_register, const Register16 *table, unsigned char operation, Register8 *flags) {
+#ifdef LAZY_FLAGS
+	Register8 result = table[*target_register] >> 8;
+	*PENDING_FLAGS(flags) = (PendingFlags){operation, result, *target_register, 0};
+	*target_register = result;
+#else
+	Register16 entry = table[*target_register];
+	*target_register = entry >> 8;
+	*flags = entry;
+#endif
+}
+
+/**
+ * /brief Updates the flags after a bitwise operation.
+ *
+ * Z is set if the result is 0. N and C are always reset while H is fixed by the operation.
+ *
+ * @param flags: Pointer to the flags register
+ * @param result: The result of the operation
+ * @param half_carry: 0x20 for AND, 0 for OR and XOR
+ */
+static inline void update_flags_logic(Register8 *flags, Register8 result, Register8 half_carry) {
+#ifdef LAZY_FLAGS
+	*PENDING_FLAGS(flags) = (PendingFlags){half_carry ? FLAGS_AND : FLAGS_LOGIC, result, 0, 0};
+#else
+	*flags = half_carry | ((result == 0) << ZERO_FLAG_POS);
+#endif
+}
 
 /*** 8-BIT LOADS  ***/
 
@@ -49,9 +135,6 @@ Register8 set_flags_sub(Register8 result, Register8 old_accumulator);
  * to the flags register, thus it will be incumbent upon the calling
  * environment to ensure that this is adhered to.
  *
- * This instruction implements opcodes:
- * 		0x06, 0x0E, 0x16, 0x1E, 0x26, 0x2E, Ox3E
- * 
  * @param: destination: The register we will load a value into.
  * @param: value: An 8 bit immediate value which we will load into
  * 			said register
@@ -65,15 +148,6 @@ void load_immediate_byte(Register8 *destination, unsigned char value) {
  * 
  * A standard register load. The value in source is loaded into destination.
  * 
- * This function implements the following opcodes:
- * 		7F, 78, 79, 7A, 7B, 7C, 7D, 7F
- * 		40, 41, 42, 42, 44, 45, 47
- * 		48, 49, 4A, 4B, 4C, 4D, 4F
- * 		50, 51, 52, 53, 54, 55, 57
- * 		58, 59, 5A, 5B, 5C, 5D, 5F
- * 		60, 61, 62, 63, 64, 65, 67
- * 		68, 69, 6A, 6B, 6C, 6D, 6F
- * 
  * @param destination: Pointer to the destination register
  * @param source: Pointer to the source register
  */
@@ -90,9 +164,6 @@ void load_register(Register8 *destination, Register8 *source) {
  * 
  * TODO: Consider renaming this function to something clearer.
  * 
- * This function implements the following opcodes:
- * 		70, 71, 72, 73, 74, 75, 02, 12, 77
- * 
 * @param adress_register: The register that contains the address of our operand. 
 * 		Unlike a lot of other instructions which utilise indirect addressing in the 
 * 		Z80GB, it is legal to supply some of the other 16 bit register pairs (BC, DE, HL),
@@ -111,9 +182,6 @@ void load_register_indirect_destination(Register16 *address_register, Register8
  * Reads the value stored at a given memory address (referenced in the address register)
  * 		into the supplied destination register. 
  * 
- * This function implements the following opcodes: 
- * 		7E, 46, 4E, 56, 5E, 66, 6E, 0A, 1A
- * 
  *@param destination: The 8-bit register that will be the destination of the load.
 * @param adress_register: The register that contains the address of our operand. 
 * 		Unlike a lot of other instructions which utilise indirect addressing in the 
@@ -131,9 +199,6 @@ void load_register_indirect_source(Register8 *destination, Register16 *address_r
  * 
  * Loads the accumulator with a value stored at the supplied memory address.
  * 
- * This function implements the following opcodes: 
- * 		3E
- * 
  * @param accumulator: Pointer to the accumulator register.
  * @param memory_address: The memory address of the value we are loading into the 
  * 		accumulator. We treat this value in a similar way we do indirect addressing.
@@ -147,9 +212,6 @@ void load_accumulator_from_address(Register8 *accumultator, unsigned short memor
  * 
  * Writes the value in the accumulator to the supplied memory address
  * 
- * This function implements the following opcodes:
- * 		EA
- * 
  * @param memory_address: The memory address of the value we wish to store the value of the 
  * 		accumulator in.
  * @param accumulator: Pointer to the accumulator
@@ -163,15 +225,12 @@ void write_accumulator_to_address(unsigned short memory_address, Register8 *accu
  * 
  * Loads the accumulator with a value at the address in the address register. The address register is then decremented.
  * 
- * This function implements the following opcodes: 
- * 		3A
- * 
  * @param accumulator: Pointer to the accumulator.
  * @param address_register: Pointer to the (HL) address register. Decremented as part of the operation.
  */
 void load_accumulator_decrement_address_register(Register8 *accumulator, Register16 *address_register) {
 	load_register_indirect_source(accumulator, address_register);
-	--address_register;
+	--(*address_register);
 }
 
 /**
@@ -179,15 +238,12 @@ void load_accumulator_decrement_address_register(Register8 *accumulator, Registe
  * 
  * Loads the accumulator with a value at the address in the address register. The address register is then incremented
  * 
- * This function implements the following opcodes:
- * 		2A
- * 
  * @param accumulator: Pointer to the accumulator.
  * @param address_register: Pointer to the (HL) address register. Incremented after load.
  */
 void load_accumulator_increment_address_register(Register8 *accumulator, Register16 *address_register) {
 	load_register_indirect_source(accumulator, address_register);
-	++address_register;
+	++(*address_register);
 }
 
 /**
@@ -195,15 +251,12 @@ void load_accumulator_increment_address_register(Register8 *accumulator, Registe
  * 
  * Saves the accumulator to the memory address referenced in the address register. The address register is then decremented.
  * 
- * This function implements the following opcodes:
- * 		32
- * 
  * @param address_register: Pointer to the address register. Decremented after load.
  * @param accumulator: Pointer to the accumulator
  */
 void write_accumulator_decrement_address_register(Register16 *address_register, Register8 *accumulator) {
 	load_register_indirect_destination(address_register, accumulator);
-	--address_register;
+	--(*address_register);
 }
 
 /**
@@ -211,15 +264,12 @@ void write_accumulator_decrement_address_register(Register16 *address_register,
  * 
  * Saves the accumulator to the memory address referenced in the address register. The address register is then incremented.
  * 
- * This function implements the following opcodes: 
- * 		22
- * 
  * @param address_register: Pointer to the address register. Incremented after load.
  * @param accumulator: Pointer to the accumulator
  */
 void write_accumulator_increment_address_register(Register16 *address_register, Register8 *accumulator) {
 	load_register_indirect_destination(address_register, accumulator);
-	++address_register;
+	++(*address_register);
 }
 
 /**
@@ -229,9 +279,6 @@ void write_accumulator_increment_address_register(Register16 *address_register,
  * Used to load values from an IO port into the accumulator. The IO port we read from is 
  * the C'th IO port where C is the value stored within the "C" register/
  * 
- * This function implements the following opcodes: 
- * 		F2
- * 
  * @param accumulator: Pointer to the accumulator.
  * @param offset_register: Pointer to the register with the value used as our offset. 
  * 		This will only be called with the offset_register being Register C.
@@ -247,9 +294,6 @@ void load_from_io_port_c(Register8 *accumulator, Register8 *offset_register) {
  * Used to write values to an IO port. The IO port we write to is 
  * the C'th IO port where C is the value stored within the "C" register/
  * 
- * This function implements the following opcodes: 
- * 		E2
- * 
  * @param offset_register: Pointer to the register with the value used as our offset. 
  * 		This will only be called with the offset_register being Register C.
  * @param accumulator: Pointer to the accumulator.
@@ -266,9 +310,6 @@ void write_to_io_port_c(Register8 *offset_register, Register8 *accumulator) {
  * the N'th IO port where N is an 8 bit value representing the offset (in the memory address space)
  * from 0xFF00.
  * 
- * This function implements the following opcodes: 
- * 		E0
- * 
  * @param accumulator: Pointer to the accumulator register.
  * @param offset: Specifies the IO port we are reading form
  */
@@ -284,9 +325,6 @@ void load_from_io_port_n(Register8 *accumulator, unsigned char offset) {
  * the N'th IO port where N is an 8 bit value representing the offset (in the memory address space)
  * from 0xFF00.
  * 
- * This function implements the following opcodes
- * 		F0
- * 
  * @param offset: Specifies the IO port we are writing to.
  * @param accumulator: Pointer to the accumulator register.
  */
@@ -303,9 +341,6 @@ void write_to_io_port_n(unsigned char offset, Register8 *accumulator) {
  * 
  * Loads a 16 bit value to a 16 bit register pair.
  * 
- * This function implements the following opcodes:
- * 		01, 11, 21, 31
- * 
  * @param destination: Pointer to the destination register
  * @param value: A 16 bit immediate value
  */
@@ -322,9 +357,6 @@ void load_immediate_short(Register16 *destination, unsigned short value) {
  * Note: unlike most uses of the HL register, this does not use indirect 
  * addressing.
  * 
- * This function implements the following opcodes: 
- *		F9
- * 
  * @param stack_pointer: Pointer to the stack... erm... pointer
  * @param source_register: Pointer to register we are loading from. Only legal if 
  * 		the HL register
@@ -336,19 +368,25 @@ void load_stack_pointer(Register16 *stack_pointer, Register16 *source_register)
 /**
  * /brief Adds Offset to the current value of the stack pointer
  * 
- * Adds the value of offset to the current value of the stack pointer
+ * Adds the value of offset to the current value of the stack pointer. The flags
+ * follow the Z80GB convention for SP arithmetic: Z and N are reset while H and C
+ * come from the unsigned add of the lower byte of the stack pointer and the offset.
  * 
- * This function implements the following opcodes: 
- *		F8
+ * Note: F8 (LD HL, SP+n) stores the result in HL instead. The calling environment 
+ * can simply supply a copy of the stack pointer in that case.
  *
  * @param stack_pointer: Pointer to the... stack pointer
  * @param offset: The amount we are adding/subtracting (if negative) to the stack pointer
- * @param flags: Pointer to the flags register. Due to ambigious specifications we assume that
- * 		we are to reset the flags register.
+ * @param flags: Pointer to the flags register.
  */
 void load_stack_pointer_offset(Register16 *stack_pointer, short offset, Register8 *flags) {
-	*stack_pointer + offset;
-	*flags = 0x00;
+	discard_pending_flags(flags);
+	unsigned char lower_byte = *stack_pointer & 0xFF;
+	unsigned char offset_byte = offset & 0xFF;
+
+	*flags = (((lower_byte & 0x0F) + (offset_byte & 0x0F)) > 0x0F) << HALF_CARRY_FLAG_POS;
+	*flags |= ((lower_byte + offset_byte) > 0xFF) << CARRY_FLAG_POS;
+	*stack_pointer += offset;
 }
 
 /**
@@ -356,23 +394,20 @@ void load_stack_pointer_offset(Register16 *stack_pointer, short offset, Register
  * 
  * Writes the stack pointer to an address. Since the stack pointer is a 16 bit value 
  * and our typical memory values are 8 bits, we will write the value in  an 
- * ascending manner. This means that the upper byte will be placed at the address
- * "address". We will then increment the address and then write the lower byte.
- * 
- * This function implements the following opcodes: 
- * 		08
+ * ascending manner. This means that the lower byte will be placed at the address
+ * "address". We will then increment the address and then write the upper byte.
  * 
  * @param stack_pointer: Pointer to the stack pointer.
- * @param address: The address we will write the stack pointer to. Technically the 
+ * @param address: The address we will write the stack pointer to. Technically only the 
  * 		lower byte of the stack pointer will be written here.
  */
 void write_stack_pointer_to_address(Register16 *stack_pointer, unsigned short address) {
-	unsigned char lower_byte = (unsigned char) *stack_pointer & 0x0F;
-	unsigned char upper_byte = (unsigned char) (*stack_pointer >> 4) & 0x0F;
+	unsigned char lower_byte = (unsigned char) (*stack_pointer & 0xFF);
+	unsigned char upper_byte = (unsigned char) (*stack_pointer >> 8);
 
-	// Assuming memory, like most things is going to be little endian...
-	write_byte(address, upper_byte);
-	write_byte(++address, lower_byte);
+	// Game Boy memory is little endian, so the lower byte goes first.
+	write_byte(address, lower_byte);
+	write_byte(++address, upper_byte);
 }
 
 
@@ -380,21 +415,19 @@ void write_stack_pointer_to_address(Register16 *stack_pointer, unsigned short ad
  * /brief Pushes 16 bit value in supplied register to stack
  * 
  * Pushes the value in the source register to the stack. The stack pointer
- * is then decremented twice.
- * 
- * This function implements the following opcodes:
- * 		F5, C5, D5, E5
+ * is decremented before each byte is written, upper byte first, so the 
+ * value ends up little endian in memory just like everything else.
  * 
  * @param stack_pointer: Pointer to the... stack pointer. Decremented twice in the 
  * 		operation.
  * @param source_register: The register we are pushing onto the stack
  */
 void push(Register16 *stack_pointer, Register16 *source_register) {
-	unsigned char lower_byte = (unsigned char) *source_register & 0x0F;
-	unsigned char upper_byte = (unsigned char) (*source_register >> 4) & 0x0F;
+	unsigned char lower_byte = (unsigned char) (*source_register & 0xFF);
+	unsigned char upper_byte = (unsigned char) (*source_register >> 8);
 
-	write_byte((*stack_pointer)--, lower_byte);
-	write_byte((*stack_pointer)--, upper_byte);
+	write_byte(--(*stack_pointer), upper_byte);
+	write_byte(--(*stack_pointer), lower_byte);
 }
 
 /**
@@ -403,17 +436,14 @@ void push(Register16 *stack_pointer, Register16 *source_register) {
  * Pops the value at the "top" of the stack into the supplied 16 bit destination 
  * register. The SP is incremented twice.
  * 
- * This function implements the following opcodes:
- * 		F1, C1, D1, E1
- *
  * @param stack_pointer: Pointer to the stack pointer. Incremented twice during 
  * 		the operation
  * @param destination_register: The 16 bit register where the value will be stored.
  */
 void pop(Register16 *stack_pointer, Register16 *destination_register) {
-	// We store the old PC s.t. the MSNibble will be read first.
-	unsigned short new_destination_value = read_byte((*stack_pointer)++) << 4; 	// Stack is descending
-	new_destination_value = read_byte((*stack_pointer)++) | new_destination_value;	// Read LSB, mask with MSB.
+	// Push leaves the lower byte on top of the stack so it comes off first.
+	unsigned short new_destination_value = read_byte((*stack_pointer)++); 		// Stack is descending
+	new_destination_value |= read_byte((*stack_pointer)++) << 8;				// Read MSB, mask with LSB.
 
 	*destination_register = new_destination_value;
 }
@@ -426,8 +456,6 @@ void pop(Register16 *stack_pointer, Register16 *destination_register) {
  * /brief 8 bit add To be used when the operand is a register
  *
  * The standard 8 bit add. All changes to values are done in place.
- * This function will be used to implement the following opcodes:
- * 		0x87, 0x80, 0x81, 0x82, 0x83, 0x84, 0x85
  * 
  * @param accumulator: Pointer to the accumulator register: A.
  * @param other_register: Pointer to the other register we wish to add to the 
@@ -435,19 +463,13 @@ void pop(Register16 *stack_pointer, Register16 *destination_register) {
  * @param flags: Pointer to the status flags register. 
  */
 void add_register(Register8 *accumulator, Register8 *other_register, Register8 *flags) {
-	unsigned char result = *accumulator + *other_register;		// I opt not to immediately store to make the rest of this code cleaner to follow!
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_add(result, *accumulator);
-	*accumulator = result;
+	add_to_accumulator(accumulator, *other_register, 0, flags);
 }
 
 /**
  * /brief 8 bit add. To be used when the operand is an immediate 8 bit value.
  *
  * The standard 8 bit add. All changes to values are done in place.
- * This function will be used to implement the following opcodes:
- * 		0xC6. 
  *
  * Note: the second operand will be expected to be found in the next byte in the 
  *		game's source code.
@@ -457,11 +479,7 @@ void add_register(Register8 *accumulator, Register8 *other_register, Register8 *
  * @param flags: Pointer to the status flags register. 
  */
 void add_immediate(Register8 *accumulator, unsigned char value, Register8 *flags) {
-	unsigned char result = *accumulator + value;	// Like above, we are not doing immediate storage
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_add(result, *accumulator);
-	*accumulator = result;
+	add_to_accumulator(accumulator, value, 0, flags);
 }
 
 /**
@@ -470,8 +488,6 @@ void add_immediate(Register8 *accumulator, unsigned char value, Register8 *flags
  * A standard 8 bit add, this time with a twist. The value passed in is simply an address
  * in a register and we have to fetch the actual value from memory and then perform the 
  * add. 
- * This function is used to impliment the following opcode:
- *		0x86
  *
  * @param accumulator: Pointer to the accumulator register: A.
  * @param address_register: Pointer to the "16 bit register" HL. This will tell us where 
@@ -480,19 +496,13 @@ void add_immediate(Register8 *accumulator, unsigned char value, Register8 *flags
  */
 void add_indirect(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
 	unsigned char value_at_address = read_byte(*address_register);
-	unsigned char result = *accumulator + value_at_address;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_add(result, *accumulator);
-	*accumulator = result;
+	add_to_accumulator(accumulator, value_at_address, 0, flags);
 }
 
 /**
  * /brief 8 bit add. This time with carry To be used when the operand is a register
  *
  * An 8 bit add with carry. The result is A -> A + R2 + carry.
- * This function will be used to implement the following opcodes:
- * 		0x8F, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D
  * 
  * @param accumulator: Pointer to the accumulator register: A.
  * @param other_register: Pointer to the other register we wish to add to the 
@@ -500,12 +510,8 @@ void add_indirect(Register8 *accumulator, Register16 *address_register, Register
  * @param flags: Pointer to the status flags register. 
  */
 void add_register_with_carry(Register8 *accumulator, Register8 *other_register, Register8 *flags) {
-	unsigned char carry = (*flags & 0x10) >> 4;
-	unsigned char result = carry + *accumulator + *other_register;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_add(result, *accumulator);
-	*accumulator = result;
+	unsigned char carry = carry_flag_set(flags) != 0;
+	add_to_accumulator(accumulator, *other_register, carry, flags);
 }
 
 /**
@@ -513,8 +519,6 @@ void add_register_with_carry(Register8 *accumulator, Register8 *other_register,
  *
  * An 8 bit add with carry, where we use an immediate result.
  * The result is A -> A + Value + carry.
- * This function will be used to implement the following opcodes:
- * 		0xCE
  * 
  * Note: the second operand will be expected to be found in the next byte in the 
  *		game's source code.
@@ -524,12 +528,8 @@ void add_register_with_carry(Register8 *accumulator, Register8 *other_register,
  * @param flags: Pointer to the status flags register. 
  */
 void add_immediate_with_carry(Register8 *accumulator, unsigned char value, Register8 *flags) {
-	unsigned char carry = (*flags & 0x10) >> 4;
-	unsigned char result = carry + *accumulator + value;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_add(result, *accumulator);
-	*accumulator = result;
+	unsigned char carry = carry_flag_set(flags) != 0;
+	add_to_accumulator(accumulator, value, carry, flags);
 }
 
 /**
@@ -539,21 +539,15 @@ void add_immediate_with_carry(Register8 *accumulator, unsigned char value, Regis
  * in a register and we have to fetch the actual value from memory and then perform the 
  * add. 
  * The result is A -> A + *address_register + carry.
- * This function will be used to implement the following opcodes:
- * 		0x8e
  * 
  * @param accumulator: Pointer to the accumulator register: A.
  * @param address_register: Pointer to 16 bit register. Value in this register will be stored used in calculation 
  * @param flags: Pointer to the status flags register. 
  */
 void add_indirect_with_carry(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
-	unsigned char carry = (*flags & 0x10) >> 4;
+	unsigned char carry = carry_flag_set(flags) != 0;
 	unsigned char value_at_address = read_byte(*address_register);
-	unsigned char result = carry + *accumulator + value_at_address;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_add(result, *accumulator);
-	*accumulator = result;
+	add_to_accumulator(accumulator, value_at_address, carry, flags);
 }
 
 /**
@@ -563,27 +557,18 @@ void add_indirect_with_carry(Register8 *accumulator, Register16 *address_registe
  *
  * As with everything else, the operartion is done in place.
  * 
- * This function implements the opcodes:
- *		0x97, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95
- *
  * @param: accumulator: A pointer to the accumulator register
  * @param: other_register: Pointer to the other register being used
  * @param: flags: Pointer to the flags register
  */
 void subtract_register(Register8 *accumulator, Register8 *other_register, Register8 *flags) {
-	unsigned char result = *accumulator - *other_register;	// Like above, we are not doing immediate storage
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_sub(result, *accumulator);
-	*accumulator = result;
+	subtract_from_accumulator(accumulator, *other_register, 0, flags);
 }
 
 /**
  * /brief 8 bit subtract. To be used when the operand is an immediate 8 bit value.
  *
  * The standard 8 bit subtract. All changes to values are done in place.
- * This function will be used to implement the following opcodes:
- * 		0xD6. 
  *
  * Note: the second operand will be expected to be found in the next byte in the 
  *		game's source code.
@@ -593,11 +578,7 @@ void subtract_register(Register8 *accumulator, Register8 *other_register, Regist
  * @param flags: Pointer to the status flags register. 
  */
 void subtract_immediate(Register8 *accumulator, unsigned char value, Register8 *flags) {
-	unsigned char result = *accumulator - value;	// Like above, we are not doing immediate storage
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_sub(result, *accumulator);
-	*accumulator = result;
+	subtract_from_accumulator(accumulator, value, 0, flags);
 }
 
 /**
@@ -606,8 +587,6 @@ void subtract_immediate(Register8 *accumulator, unsigned char value, Register8 *
  * A standard 8 bit subtract, this time with a twist. The value passed in is simply an address
  * in a register and we have to fetch the actual value from memory and then perform the 
  * subtract. 
- * This function is used to impliment the following opcode:
- *		0x96
  *
  * @param accumulator: Pointer to the accumulator register: A.
  * @param address_register: Pointer to the "16 bit register" HL. This will tell us where 
@@ -616,19 +595,13 @@ void subtract_immediate(Register8 *accumulator, unsigned char value, Register8 *
  */
 void subtract_indirect(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
 	unsigned char value_at_address = read_byte(*address_register);
-	unsigned char result = *accumulator - value_at_address;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_sub(result, *accumulator);
-	*accumulator = result;
+	subtract_from_accumulator(accumulator, value_at_address, 0, flags);
 }
 
 /**
  * /brief 8 bit subtract. This time with carry To be used when the operand is a register
  *
  * An 8 bit subtract with carry. The result is A -> A - R2 - carry.
- * This function will be used to implement the following opcodes:
- * 		0x9F, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D
  * 
  * @param accumulator: Pointer to the accumulator register: A.
  * @param other_register: Pointer to the other register we wish to subtract ffom the 
@@ -636,12 +609,8 @@ void subtract_indirect(Register8 *accumulator, Register16 *address_register, Reg
  * @param flags: Pointer to the status flags register. 
  */
 void subtract_register_with_carry(Register8 *accumulator, Register8 *other_register, Register8 *flags) {
-	unsigned char carry = (*flags & 0x10) >> 4;
-	unsigned char result = *accumulator - *other_register - carry;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_sub(result, *accumulator);
-	*accumulator = result;
+	unsigned char carry = carry_flag_set(flags) != 0;
+	subtract_from_accumulator(accumulator, *other_register, carry, flags);
 }
 
 /**
@@ -649,8 +618,6 @@ void subtract_register_with_carry(Register8 *accumulator, Register8 *other_regis
  *
  * An 8 bit subtract with carry, where we use an immediate result.
  * The result is A -> A - Value - carry.
- * This function will be used to implement the following opcodes:
- * 		0x96
  * 
  * Note: the second operand will be expected to be found in the next byte in the 
  *		game's source code.
@@ -660,12 +627,8 @@ void subtract_register_with_carry(Register8 *accumulator, Register8 *other_regis
  * @param flags: Pointer to the status flags register. 
  */
 void subtract_immediate_with_carry(Register8 *accumulator, unsigned char value, Register8 *flags) {
-	unsigned char carry = (*flags & 0x10) >> 4;
-	unsigned char result = *accumulator - value - carry;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_sub(result, *accumulator);
-	*accumulator = result;
+	unsigned char carry = carry_flag_set(flags) != 0;
+	subtract_from_accumulator(accumulator, value, carry, flags);
 }
 
 /**
@@ -675,21 +638,15 @@ void subtract_immediate_with_carry(Register8 *accumulator, unsigned char value,
  * in a register and we have to fetch the actual value from memory and then perform the 
  * subtract. 
  * The result is A -> A - *address_register - carry.
- * This function will be used to implement the following opcodes:
- * 		0x96
  * 
  * @param accumulator: Pointer to the accumulator register: A.
  * @param address_register: Pointer to 16 bit register. Value in this register will be stored used in calculation 
  * @param flags: Pointer to the status flags register. 
  */
 void subtract_indirect_with_carry(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
-	unsigned char carry = (*flags & 0x10) >> 4;
+	unsigned char carry = carry_flag_set(flags) != 0;
 	unsigned char value_at_address = read_byte(*address_register);
-	unsigned char result = *accumulator - value_at_address - carry;
-
-	// Set flags and accumulator and be done
-	*flags = set_flags_sub(result, *accumulator);
-	*accumulator = result;
+	subtract_from_accumulator(accumulator, value_at_address, carry, flags);
 }
 
 // Bitwise Operators //
@@ -698,8 +655,6 @@ void subtract_indirect_with_carry(Register8 *accumulator, Register16 *address_re
  * /brief A bitwise AND where the operand is stored within a register
  * 
  * Performs a bitwise AND where the operand is stored within a register
- * This function implements the following opcodes:
- *		A7, A0, A1, A2, A3, A4, A5
  *
  * @param: accumulaor: Pointer to the accumulator. This is one operand. 
  * 		The result is also stored within this register. 
@@ -708,15 +663,13 @@ void subtract_indirect_with_carry(Register8 *accumulator, Register16 *address_re
  */
 void bitwise_and_register(Register8 *accumulator, Register8 *other_register, Register8 *flags) {
 	*accumulator = *accumulator & *other_register;
-	*flags = 0x20 | ((*accumulator == 0) << 7);	// We always set the half carry. Only throw the Z flag if result is 0
+	update_flags_logic(flags, *accumulator, 0x20);	// We always set the half carry. Only throw the Z flag if result is 0
 }
 
 /**
  * /brief Performs a bitwise and where the other operand is an immediate operand
  * 
  * Performs a bitwise and where the other operand is an immediate operand
- * This function implements the following opcodes: 
- *		E6
  * 
  * @param: accumulator: Pointer to the accumulator. This is both the first operand 
  * 		as well as where the result of the operation will be stored
@@ -725,7 +678,7 @@ void bitwise_and_register(Register8 *accumulator, Register8 *other_register, Reg
  */
 void bitwise_and_immediate(Register8 *accumulator, unsigned char value, Register8 *flags) {
 	*accumulator = *accumulator & value;
-	*flags = 0x20 | ((*accumulator == 0) << 7);	// We always set the half carry. Only throw the Z flag if result is 0
+	update_flags_logic(flags, *accumulator, 0x20);	// We always set the half carry. Only throw the Z flag if result is 0
 }
 
 /**
@@ -733,8 +686,6 @@ void bitwise_and_immediate(Register8 *accumulator, unsigned char value, Register
  * 
  * Performs a bitwise AND with indirect addressing. Per the specs of the z80,
  * the other operand is found within the HL register.
- * This function implements the following opcodes: 
- * 		A6
  *
  * @param: accumulator: Pointer to the accumulator. This is both the first operand 
  * 		as well as where the result of the operation will be stored
@@ -745,15 +696,13 @@ void bitwise_and_immediate(Register8 *accumulator, unsigned char value, Register
 void bitwise_and_indirect(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
 	unsigned char value_at_address = read_byte(*address_register);
 	*accumulator = *accumulator & value_at_address;
-	*flags = 0x20 | ((*accumulator == 0) << 7);	// We always set the half carry. Only throw the Z flag if result is 0
+	update_flags_logic(flags, *accumulator, 0x20);	// We always set the half carry. Only throw the Z flag if result is 0
 }
 
 /**
  * /brief Bitwise OR with second operand within a register
  * 
  * Performs a bitwise OR with the second operand found in a register specified by the supplied opcode
- * This function implements the following opcodes:
- *		B7, B0, B1, B2, B3, B4, B5
  *
  * @param: accumulaor: Pointer to the accumulator. This is one operand. 
  * 		The result is also stored within this register. 
@@ -762,15 +711,13 @@ void bitwise_and_indirect(Register8 *accumulator, Register16 *address_register,
  */
 void bitwise_or_register(Register8 *accumulator, Register8 *other_register, Register8 *flags) {
 	*accumulator = *accumulator | *other_register;
-	*flags = (*accumulator == 0) << 7;		// Set 0 flag if result is 0
+	update_flags_logic(flags, *accumulator, 0);		// Set 0 flag if result is 0
 }
 
 /**
  * /brief Bitwise OR with second operand is an immediate value
  * 
  * Performs a bitwise OR with the second operand is an immediate value
- * This function implements the following opcodes:
- *		F6
  *
  * @param: accumulaor: Pointer to the accumulator. This is one operand. 
  * 		The result is also stored within this register. 
@@ -779,7 +726,7 @@ void bitwise_or_register(Register8 *accumulator, Register8 *other_register, Regi
  */
 void bitwise_or_immediate(Register8 *accumulator, unsigned char value, Register8 *flags) {
 	*accumulator = *accumulator | value;
-	*flags = (*accumulator == 0) << 7;		// Set 0 flag if result is 0
+	update_flags_logic(flags, *accumulator, 0);		// Set 0 flag if result is 0
 }
 
 /**
@@ -787,8 +734,6 @@ void bitwise_or_immediate(Register8 *accumulator, unsigned char value, Register8
  * 
  * Performs a bitwise OR with indirect addressing. Per the specs of the z80,
  * the other operand is found within the HL register.
- * This function implements the following opcodes: 
- * 		F6
  *
  * @param: accumulator: Pointer to the accumulator. This is both the first operand 
  * 		as well as where the result of the operation will be stored
@@ -799,15 +744,13 @@ void bitwise_or_immediate(Register8 *accumulator, unsigned char value, Register8
 void bitwise_or_indirect(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
 	unsigned char value_at_address = read_byte(*address_register);
 	*accumulator = *accumulator | value_at_address;
-	*flags = (*accumulator == 0) << 7;	// We always set the half carry. Only throw the Z flag if result is 0
+	update_flags_logic(flags, *accumulator, 0);	// We always set the half carry. Only throw the Z flag if result is 0
 }
 
 /**
  * /brief Bitwise XOR with second operand within a register
  * 
  * Performs a bitwise XOR with the second operand found in a register specified by the supplied opcode
- * This function implements the following opcodes:
- *		AF, A8, A9, AA, AB, AC, AD
  *
  * @param: accumulaor: Pointer to the accumulator. This is one operand. 
  * 		The result is also stored within this register. 
@@ -816,15 +759,13 @@ void bitwise_or_indirect(Register8 *accumulator, Register16 *address_register, R
  */
 void bitwise_xor_register(Register8 *accumulator, Register8 *other_register, Register8 *flags)  {
 	*accumulator = *accumulator ^ *other_register;
-	*flags = (*accumulator == 0) << 7;
+	update_flags_logic(flags, *accumulator, 0);
 }
 
 /**
  * /brief Bitwise XOR with second operand is an immediate value
  * 
  * Performs a bitwise XOR with the second operand is an immediate value
- * This function implements the following opcodes:
- *		EE
  *
  * @param: accumulaor: Pointer to the accumulator. This is one operand. 
  * 		The result is also stored within this register. 
@@ -833,7 +774,7 @@ void bitwise_xor_register(Register8 *accumulator, Register8 *other_register, Reg
  */
 void bitwise_xor_immediate(Register8 *accumulator, unsigned char value, Register8 *flags) {
 	*accumulator = *accumulator ^ value;
-	*flags = (*accumulator == 0) << 7;
+	update_flags_logic(flags, *accumulator, 0);
 }
 
 /**
@@ -841,8 +782,6 @@ void bitwise_xor_immediate(Register8 *accumulator, unsigned char value, Register
  * 
  * Performs a bitwise XOR with indirect addressing. Per the specs of the z80,
  * the other operand is found within the HL register.
- * This function implements the following opcodes: 
- * 		AE
  *
  * @param: accumulator: Pointer to the accumulator. This is both the first operand 
  * 		as well as where the result of the operation will be stored
@@ -853,7 +792,7 @@ void bitwise_xor_immediate(Register8 *accumulator, unsigned char value, Register
 void bitwise_xor_indirect(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
 	unsigned char value_at_address = read_byte(*address_register);
 	*accumulator = *accumulator ^ value_at_address;
-	*flags = (*accumulator == 0) << 7;	// We always set the half carry. Only throw the Z flag if result is 0
+	update_flags_logic(flags, *accumulator, 0);	// We always set the half carry. Only throw the Z flag if result is 0
 }
 
 // COMPARISONS 
@@ -864,18 +803,15 @@ void bitwise_xor_indirect(Register8 *accumulator, Register16 *address_register,
  * Performs a comparison between the value in the accumulator and a value 
  * stored within another register. Essentially it does A - R but the result is not 
  * stored within the accumulator.
- * This function implements the following opcodes: 
- *		BF, B8, B9, BA, BC, BD
  *
  * @param accumulator: Pointer to the accumulator register: A.
  * @param value: 8-bit value we wish to compare with the accumulator. Unsigned
  * @param flags: Pointer to the status flags register. 
  */
 void compare_register(Register8 *accumulator, Register8 *other_register, Register8 *flags) { 
-	unsigned char result = *accumulator - *other_register;	// Like above, we are not doing immediate storage
-
 	// Set flags but disregard the result
-	*flags = set_flags_sub(result, *accumulator);
+	Register8 result = *accumulator;
+	subtract_from_accumulator(&result, *other_register, 0, flags);
 }
 
 /**
@@ -883,8 +819,6 @@ void compare_register(Register8 *accumulator, Register8 *other_register, Registe
  *
  * Compares the value stored in the accumulator with a directly supplied
  * immediate value.
- * This function implements the following opcodes: 
- *		FE
  *
  * Note: the second operand will be expected to be found in the next byte in the 
  *		game's source code.
@@ -894,10 +828,9 @@ void compare_register(Register8 *accumulator, Register8 *other_register, Registe
  * @param flags: Pointer to the status flags register. 
  */
 void compare_immediate(Register8 *accumulator, unsigned char value, Register8 *flags) {
-	unsigned char result = *accumulator - value;	// Like above, we are not doing immediate storage
-
-	// Set flags but disregard result. 
-	*flags = set_flags_sub(result, *accumulator);
+	// Set flags but disregard the result
+	Register8 result = *accumulator;
+	subtract_from_accumulator(&result, value, 0, flags);
 }
 
 /** 
@@ -905,8 +838,6 @@ void compare_immediate(Register8 *accumulator, unsigned char value, Register8 *f
  * 
  * A comparison of the value in the accumulator with a value stored in memory. This value 
  * is accessed using indirect addressing using the value stored within the HL register. 
- * This function implements the following opcodes: 
- * 		BE
  * @param accumulator: Pointer to the accumulator register: A.
  * @param address_register: Pointer to the "16 bit register" HL. This will tell us where 
  * 		to find our operand in memory.
@@ -914,24 +845,22 @@ void compare_immediate(Register8 *accumulator, unsigned char value, Register8 *f
  */
 void compare_indirect(Register8 *accumulator, Register16 *address_register, Register8 *flags) {
 	unsigned char value_at_address = read_byte(*address_register);
-	unsigned char result = *accumulator - value_at_address;
 
 	// Set flags, disregard accumulator
-	*flags = set_flags_sub(result, *accumulator);
+	Register8 result = *accumulator;
+	subtract_from_accumulator(&result, value_at_address, 0, flags);
 }
 
 /**
  * /brief Increments the value found within a given register.
  *
  * Increments the value stored in the provided register by one.
- * This function implements the following opcodes: 
- * 		3C, 04, 0C, 14, 1C, 24, 2C
  *
  * @param: target_register: A pointer to the register being incremented
  * @param: flags: Pointer to the flags register
  */
 void increment_register(Register8 *target_register, Register8 *flags) {
-	add_immediate(target_register, 1, flags);
+	step_register(target_register, alu_increment_table, FLAGS_ADD, flags);
 }
 
 /**
@@ -939,8 +868,6 @@ void increment_register(Register8 *target_register, Register8 *flags) {
  *
  * Increments a value stored in memory and then saves the updated value back to 
  * memory.
- * This function implements the following opcodes: 
- *		34
  *
  * @param address_register: The HL register where the memory address we will access 
  * 		is stored as a value.
@@ -951,7 +878,7 @@ void increment_register_indirect(Register16 *address_register, Register8 *flags)
 	
 	// Creating a pseudo register we can call the "accumulator" for this operation
 	Register8 pseudo_accumulator = value_at_address;
-	add_immediate(&pseudo_accumulator, 1, flags);
+	step_register(&pseudo_accumulator, alu_increment_table, FLAGS_ADD, flags);
 	write_byte(*address_register, pseudo_accumulator);
 }
 
@@ -959,14 +886,12 @@ void increment_register_indirect(Register16 *address_register, Register8 *flags)
  * /brief Decrements the value found within a given register.
  *
  * Decrements the value stored in the provided register by one.
- * This function implements the following opcodes: 
- * 		3C, 04, 0C, 14, 1C, 24, 2C
  *
  * @param: target_register: A pointer to the register being decremented
  * @param: flags: Pointer to the flags register
  */
 void decrement_register(Register8 *target_register, Register8 *flags) {
-	subtract_immediate(target_register, 1, flags);
+	step_register(target_register, alu_decrement_table, FLAGS_SUB, flags);
 }
 
 /**
@@ -974,8 +899,6 @@ void decrement_register(Register8 *target_register, Register8 *flags) {
  *
  * Decrements a value stored in memory and then saves the updated value back to 
  * memory.
- * This function implements the following opcodes: 
- *		35
  * @param address_register: The HL register where the memory address we will access 
  * 		is stored as a value.
  * @param flags: Pointer to the flags register
@@ -985,83 +908,103 @@ void decrement_register_indirect(Register16 *address_register, Register8 *flags)
 	
 	// Creating a pseudo register we can call the "accumulator" for this operation
 	Register8 pseudo_accumulator = value_at_address;
-	subtract_immediate(&pseudo_accumulator, 1, flags);
+	step_register(&pseudo_accumulator, alu_decrement_table, FLAGS_SUB, flags);
 	write_byte(*address_register, pseudo_accumulator);
 }
 
 /**
- * /brief Sets the flags after an 8bit addition operation
- * 
- * Per the specs of the Zilog z80 processor: Z will be set if result is 0, N will be reset
- * H will be set if there's a carry out from bit 3 in the add and C will be set if there's
- * a carry from bit 7.
+ * /brief Works out the flags after an 8bit addition operation
+ *
+ * See reference_flags_add in alu_reference.c for the long hand version. This one simply
+ * recovers the operand and looks the flags up.
  *
  * @param result: The result of the addition operation
  * @param old_accumulator: The value in the accumulator before the add
+ * @param carry: The carry that was fed into the add (0 or 1)
  *
  * @return: The new value to be stored in the flags register. 
  */
-Register8 set_flags_add(Register8 result, Register8 old_accumulator) {
-	// Constructing the new flag values
-	Register8 new_flags = 0;
-	new_flags |= ((result == 0) << ZERO_FLAG_POS);				// Set Zero flag
-	new_flags |= ((result < old_accumulator)) << CARRY_FLAG_POS;	// Set Carry Flag
-
-	// The half carry flag is a bit more sophisticated. We must look at the 
-	// lower nibble of the both the result and the accumulator. If the result's 
-	// lower nibble is less than that of the accumulator then we know to set our 
-	// half carry flag. One should note the similarity to how we do the full 8-bit
-	// carry flag above.
-	Register8 lower_nibble_result = result & 0x0F;
-	Register8 lower_nibble_accumulator = old_accumulator & 0x0F;
-
-	// Useful output for debugging
-	#ifdef VERBOSE
-		printf("Result: %d, Old Accumulator: %d\n", result, old_accumulator);
-		printf("Lower Nibble Result: %d, Lower Nibble Accumulator: %d\n", lower_nibble_result, lower_nibble_accumulator);
-	#endif
-	
-	new_flags |= ((lower_nibble_result < lower_nibble_accumulator) << HALF_CARRY_FLAG_POS);
-	return new_flags;
+Register8 set_flags_add(Register8 result, Register8 old_accumulator, unsigned char carry) {
+	Register8 operand = result - old_accumulator - carry;
+	return alu_add_table[carry][old_accumulator][operand];
 }
 
 /**
- * /brief Sets the flags after an 8bit subtraction operation
- * 
- * Per the specs of the Zilog z80 processor: Z will be set if the result is zero, 
- * N will be set (as the operation was a subtraction), H will be set if there was no
- * borrow from bit 4 while C will be set if there was no borrow in the overall operation
- *
- * @param reuslt: The result of the subtraction operation
- * @param old_accumulator: The value in the accumulator before the subtraction
- *
- * @result: The new value to be stored in the flags register
+ * /brief Works out the flags after an 8bit subtraction operation. See set_flags_add.
  */
-Register8 set_flags_sub(Register8 result, Register8 old_accumulator) {
-	// Constructing the new flag values
-	Register8 new_flags = 0;
-
-	new_flags |= (result == 0) << ZERO_FLAG_POS;				// Set Zero Flag
-	new_flags |= 0x1 << SUB_FLAG_POS;							// Set Subtraction Flag
-	new_flags |= (result > old_accumulator) << CARRY_FLAG_POS;	// Set Carry Flag
+Register8 set_flags_sub(Register8 result, Register8 old_accumulator, unsigned char carry) {
+	Register8 operand = old_accumulator - result - carry;
+	return alu_sub_table[carry][old_accumulator][operand];
+}
 
-	// The half carry flag is a bit more sophisticated. We must look at the 
-	// lower nibble of the both the result and the accumulator. If the result's 
-	// lower nibble is greater than that of the accumulator then we know to set our 
-	// half carry flag. One should note the similarity to how we do the full 8-bit
-	// carry flag above.
-	Register8 lower_nibble_result = result & 0x0F;
-	Register8 lower_nibble_accumulator = old_accumulator & 0x0F;
+/**
+ * /brief Puts the carry flag back to what it was before an operation.
+ *
+ * INC and DEC share their handlers with ADD and SUB but must leave C alone. With
+ * LAZY_FLAGS the pending update is simply marked as keeping the old carry.
+ *
+ * @param flags: Pointer to the flags register
+ * @param carry: The carry flag to keep (0 or 1)
+ */
+void keep_carry_flag(Register8 *flags, unsigned char carry) {
+#ifdef LAZY_FLAGS
+	PendingFlags *pending = PENDING_FLAGS(flags);
+	if (pending->operation == FLAGS_ADD || pending->operation == FLAGS_SUB) {
+		pending->operation |= FLAGS_KEEP_CARRY;
+		pending->carry = carry;
+		return;
+	}
+	materialise_flags(flags);
+#endif
+	*flags = (*flags & ~0x10) | (carry << CARRY_FLAG_POS);
+}
 
-	// Useful output for debugging
-	#ifdef VERBOSE
-		printf("Result: %d, Old Accumulator: %d\n", result, old_accumulator);
-		printf("Lower Nibble Result: %d, Lower Nibble Accumulator: %d\n", lower_nibble_result, lower_nibble_accumulator);
-	#endif
+#ifdef LAZY_FLAGS
+/**
+ * /brief Works out F from the last ALU operation, if it hasn't been already.
+ *
+ * Must be called before anything reads F directly rather than through zero_flag_set
+ * and friends. e.g. pushing AF, DAA or printing the registers.
+ *
+ * @param flags: Pointer to the flags register
+ */
+void materialise_flags(Register8 *flags) {
+	PendingFlags *pending = PENDING_FLAGS(flags);
+
+	switch (pending->operation) {
+		case FLAGS_SETTLED:
+			return;
+		case FLAGS_ADD:
+			*flags = set_flags_add(pending->result, pending->operand, pending->carry);
+			break;
+		case FLAGS_SUB:
+			*flags = set_flags_sub(pending->result, pending->operand, pending->carry);
+			break;
+		case FLAGS_ADD | FLAGS_KEEP_CARRY:
+			*flags = (set_flags_add(pending->result, pending->operand, 0) & ~0x10) | (pending->carry << CARRY_FLAG_POS);
+			break;
+		case FLAGS_SUB | FLAGS_KEEP_CARRY:
+			*flags = (set_flags_sub(pending->result, pending->operand, 0) & ~0x10) | (pending->carry << CARRY_FLAG_POS);
+			break;
+		case FLAGS_AND:
+			*flags = 0x20 | ((pending->result == 0) << ZERO_FLAG_POS);
+			break;
+		case FLAGS_LOGIC:
+			*flags = (pending->result == 0) << ZERO_FLAG_POS;
+			break;
+	}
+	pending->operation = FLAGS_SETTLED;
+}
 
-	new_flags |= ((lower_nibble_result > lower_nibble_accumulator) << HALF_CARRY_FLAG_POS);
-	return new_flags;
+/**
+ * /brief Forgets the last ALU operation as F is about to be overwritten outright.
+ *
+ * @param flags: Pointer to the flags register
+ */
+void discard_pending_flags(Register8 *flags) {
+	PENDING_FLAGS(flags)->operation = FLAGS_SETTLED;
 }
+#endif
 
 
 /*** 16-BIT ARITHMETIC ***/
@@ -1073,8 +1016,6 @@ Register8 set_flags_sub(Register8 result, Register8 old_accumulator) {
  * This function performs a 16 bit add operation where the HL register is the destination
  * of the result. The second operand is the value stored in one of the other 
  * 16 bit "registers".
- * This function implements the following opcodes:
- *		09, 19, 29, 39
  *
  * @param indirirect_address_register: Pointer to the HL register. Nothing actually enforces this, so it must 
  * 		be ensured by the programmer in the calling environment
@@ -1082,6 +1023,7 @@ Register8 set_flags_sub(Register8 result, Register8 old_accumulator) {
  * @param flags: Pointer to the flags register
  */
 void indirect_register_add(Register16 *indirect_address_register, Register16 *other_register, Register8 *flags) {
+	materialise_flags(flags);
 	unsigned short result = *indirect_address_register + *other_register;
 
 	// Setting flags
@@ -1107,8 +1049,6 @@ void indirect_register_add(Register16 *indirect_address_register, Register16 *ot
  * /brief Adds an 8 bit immediate value to the stack pointer
  *
  * Performs an 8 bit add to value contained in the stack pointer.
- * This function implements the following opcodes:
- *		E8
  *
  * @param indirirect_address_register: Pointer to the stack pointer. Nothing actually enforces this, so it must 
  * 		be ensured by the programmer in the calling environment
@@ -1116,6 +1056,7 @@ void indirect_register_add(Register16 *indirect_address_register, Register16 *ot
  * @param flags: Pointer to the flags register
  */
 void stack_pointer_add(Register16 *stack_pointer, unsigned char value, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned short result = *stack_pointer + value;
 
 	// Setting flags
@@ -1139,8 +1080,6 @@ void stack_pointer_add(Register16 *stack_pointer, unsigned char value, Register8
  *
  * Increments a value found within a 16 bit register.
  * This function does not make any changes to the flags.
- * Thus function implements the following opcodes: 
- * 		03, 13, 23, 33
  *
  * @param target_register: Pointer to 16 bit register whose 
  * 		value we are incrementing
@@ -1154,8 +1093,6 @@ void increment_register_16(Register16 *target_register) {
  *
  * Decrements a value found within a 16 bit register.
  * This function does not make any changes to the flags.
- * This function implements the following opcodes: 
- * 		0B, 1B, 2B, 3B
  *
  * @param target_register: Pointer to 16 bit register whose 
  * 		value we are decrementing
@@ -1171,13 +1108,12 @@ void decrement_register_16(Register16 *target_register) {
  * 
  * Rotates the supplied register left by one. 7 bit to carry 
  * register where it's archived.
- * This function implements the following opcodes:
- *		07, CB 07, CB 00, CB 01, CB 02, CB 03, CB 04, CB 05
  *
  * @param target_register: The register whose value we will be rotating
  * @param flags: Pointer to the flags register
  */
 void rotate_register_left_carry_archive(Register8 *target_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	// Do the rotate
 	*target_register = ((*target_register << 1) | (*target_register >> 7));
 
@@ -1192,12 +1128,11 @@ void rotate_register_left_carry_archive(Register8 *target_register, Register8 *f
  * 
  * Rotates the value stored in the supplied memory address
  * left by one. 7 bit to carry register where it's archived.
- * This function implements the following opcodes:
- *		CB 06
  * @param address_register: Address register. Contains address of value we wish to manipulate
  * @param flags: Pointer to the flags register
  */
 void rotate_indirect_left_carry_archive(Register16 *address_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	// Do the rotate
@@ -1216,13 +1151,12 @@ void rotate_indirect_left_carry_archive(Register16 *address_register, Register8
  * 
  * Rotates the supplied register left by one. This rotate
  * goes through the carry bit. 
- * This function implements the following opcodes:
- *		17, CB 17, CB 10, CB 11, CB 12, CB 13, CB 14, CB 15
  *
  * @param target_register: The register whose value we will be rotating
  * @param flags: Pointer to the flags register
  */
 void rotate_register_left_through_carry(Register8 *target_register, Register8 *flags) {
+	materialise_flags(flags);
 	unsigned char old_carry = (*flags & 0x10) >> 4;
 	unsigned char new_carry = (*target_register & 0x80) >> 3;	// Move bit 7 into carry flag pos
 
@@ -1236,12 +1170,11 @@ void rotate_register_left_through_carry(Register8 *target_register, Register8 *f
  * 
  * Rotates the value stored in the supplied memory address
  * right by one. 7 bit to carry register where it's archived.
- * This function implements the following opcodes:
- *		CB 16
  * @param address_register: Address register. Contains address of value we wish to manipulate
  * @param flags: Pointer to the flags register
  */
 void rotate_indirect_left_through_carry(Register16 *address_register, Register8 *flags) {
+	materialise_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	unsigned char old_carry = (*flags & 0x10) >> 4;
@@ -1257,13 +1190,12 @@ void rotate_indirect_left_through_carry(Register16 *address_register, Register8
  * 
  * Rotates the supplied register right by one. 0 bit to carry 
  * register where it's archived.
- * This function implements the following opcodes:
- *		0F, CB 0F, CB 08, CB 09, CB 0A, CB 0B, CB 0C, CB 0D
  *
  * @params target_register: The register whose value we will be rotating
  * @params flags: Pointer to the flags register
  */
 void rotate_register_right_carry_archive(Register8 *target_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	// Do the rotate
 	*target_register = ((*target_register >> 1) | (*target_register << 7));
 
@@ -1278,12 +1210,11 @@ void rotate_register_right_carry_archive(Register8 *target_register, Register8 *
  * 
  * Rotates the value stored in the supplied memory address
  * right by one. 0 bit to carry register where it's archived.
- * This function implements the following opcodes:
- *		CB 0E
  * @param address_register: Address register. Contains address of value we wish to manipulate
  * @param flags: Pointer to the flags register
  */
 void rotate_indirect_right_carry_archive(Register16 *address_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	// Do the rotate
@@ -1302,13 +1233,12 @@ void rotate_indirect_right_carry_archive(Register16 *address_register, Register8
  * 
  * Rotates the supplied register right by one. This rotate
  * goes through the carry bit. 
- * This function implements the following opcodes:
- *		1F, CB 1F, CB 18, CB 19, CB 1A, CB 1B, CB 1C, CB 1D
  *
  * @param target_register: The register whose value we will be rotating
  * @param flags: Pointer to the flags register
  */
 void rotate_register_right_through_carry(Register8 *target_register, Register8 *flags) {
+	materialise_flags(flags);
 	unsigned char old_carry = (*flags & 0x10) << 3;				// Move old carry to 7 position
 	unsigned char new_carry = (*target_register & 0x01) << 4;	// Move bit 0 into carry flag pos
 
@@ -1322,12 +1252,11 @@ void rotate_register_right_through_carry(Register8 *target_register, Register8 *
  * 
  * Rotates the value stored in the supplied memory address
  * right by one. 7 bit to carry register where it's archived.
- * This function implements the following opcodes:
- *		CB 1E
  * @param address_register: Address register. Contains address of value we wish to manipulate
  * @param flags: Pointer to the flags register
  */
 void rotate_indirect_right_through_carry(Register16 *address_register, Register8 *flags) {
+	materialise_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	unsigned char old_carry = (*flags & 0x10) << 3;				// Move old carry to 7 position
@@ -1345,13 +1274,12 @@ void rotate_indirect_right_through_carry(Register16 *address_register, Register8
  * Shifts a value stored in a register one position to the left.
  * The MSB of the previous word is stored in the carry bit of the 
  * flags register.
- * This function implements the following opcodes:
- * 		CB 27, CB 20, CB 21, CB 22, CB 23, CB 24, CB 25 
  *
  * @param target_register: The register with the operand of the operation
  * @param flags: Pointer to the flags register
  */
 void shift_register_left(Register8 *target_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	// Preserving the MSB in the carry flag
 	*flags = (*target_register & 0x80) >> 3;	// Move MSB to the carry position
 	*target_register = *target_register << 1;	// Perform the shift
@@ -1365,13 +1293,12 @@ void shift_register_left(Register8 *target_register, Register8 *flags) {
  * The MSB of the previous word is stored in the carry bit of the 
  * flags register. The location of the value is pointed to by the 
  * "HL" register.
- * This function implements the following opcodes:
- * 		CB 26
  * 
  * @param address_register: Contains the address of our operand
  * @param flags: Pointer to the flags register
  */
 void shift_indirect_left(Register16 *address_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	// Preserving the MSB in the carry flag
@@ -1388,13 +1315,12 @@ void shift_indirect_left(Register16 *address_register, Register8 *flags) {
  * Shifts a value stored in a register one position to the right.
  * The LSB of the previous word is stored in the carry bit of the 
  * flags register. Remember, the MSB is propagated
- * This function implements the following opcodes:
- * 		CB 2F, CB 28. CB 29, CB 2A, CB 2B, CB 2C, CB 2D 
  *
  * @param address_register: Contains the address of our operand
  * @param flags: Pointer to the flags register
  */
 void arithmetic_shift_register_right(Register8 *target_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	// Since we want to do an arithmetic shift we have to beat around the 
 	// bush..
 	unsigned char most_sig_bit = *target_register & 0x80;
@@ -1412,13 +1338,12 @@ void arithmetic_shift_register_right(Register8 *target_register, Register8 *flag
  * Arithmetically Shifts a value stored in a register one position to the right.
  * The LSB of the previous word is stored in the carry bit of the 
  * flags register. Remember, the MSB propagated
- * This function implements the following opcodes:
- * 		CB 2E 
  *
  * @param target_register: The register with the operand of the operation
  * @param flags: Pointer to the flags register
  */
 void arithmetic_shift_indirect_right(Register16 *address_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	// Since we want to do an arithmetic shift we have to beat around the 
@@ -1440,13 +1365,12 @@ void arithmetic_shift_indirect_right(Register16 *address_register, Register8 *fl
  * Shifts a value stored in a register one position to the right.
  * The LSB of the previous word is stored in the carry bit of the 
  * flags register.
- * This function implements the following opcodes:
- * 		CB 3F, CB CB 38, CB 39, CB 3A, CB 3B, CB 3C, CB 3D
  *
  * @param target_register: The register with the operand of the operation
  * @param flags: Pointer to the flags register
  */
 void logical_shift_register_right(Register8 *target_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	// Preserving the LSB in the carry flag
 	*flags = (*target_register & 0x01) << 4;	// Move >SB to the carry position
 	*target_register = *target_register >> 1;	// Perform the shift
@@ -1461,13 +1385,12 @@ void logical_shift_register_right(Register8 *target_register, Register8 *flags)
  * The LSB of the previous word is stored in the carry bit of the 
  * flags register. The location of the value is pointed to by the 
  * "HL" register.
- * This function implements the following opcodes:
- * 		CB 3E
  * 
  * @param address_register: Contains the address of our operand
  * @param flags: Pointer to the flags register
  */
 void logical_shift_indirect_right(Register16 *address_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 
 	// Preserving the LSB in the carry flag
@@ -1488,16 +1411,15 @@ void logical_shift_indirect_right(Register16 *address_register, Register8 *flags
  * between 0 and 7 (inclusive), this function will cause the 
  * programme to abort. 
  * 
- * Regardless of the operation's result, the half carry is always thrown
- * 
- * This function implements the following op codes
- * CB 47, CB 40, CB 41, CB 42, CB 43, CB 44, CB 45
+ * Regardless of the operation's result, the half carry is always thrown 
+ * while the carry flag is left as it was.
  * 
  * @param target_value: The register containing the value we are testing
  * @param bit: The bit we wish to test. Must be between 0-7 (inclusive)
  * @param flags: Pointer to the flags register
  */
 void test_bit_register(Register8 *target_register, unsigned char bit, Register8 *flags) {
+	materialise_flags(flags);
 	// As mentioned previously, we abort if we've erroneous operands.
 	if (bit < 0 || 7 < bit) {
 		fprintf(stderr, "ILLEGAL OPERATION: Called BIT %d, %d\n", *target_register, bit);
@@ -1505,7 +1427,7 @@ void test_bit_register(Register8 *target_register, unsigned char bit, Register8
 	}
 	// implicit else. 
 	unsigned char isolated_test_bit = *target_register << (7 - bit); 		// Assummes bit 0 is LSB
-	*flags = 0x20 | (isolated_test_bit ^ (0x80 | isolated_test_bit));		// X xor 1 is true iff X == 0
+	*flags = (*flags & 0x10) | 0x20 | (isolated_test_bit ^ (0x80 | isolated_test_bit));	// X xor 1 is true iff X == 0. Carry is untouched
 }
 
 /*
@@ -1516,8 +1438,6 @@ void test_bit_register(Register8 *target_register, unsigned char bit, Register8
  * is accessed through indirect addressing! Note, if bit is 
  * between 0 and 7 (inclusive), this function will cause the 
  * programme to abort. 
- * This function implements the following op codes
- * CB 3E
  * 
  * @param address_register: A register containing an indirect reference to the
  * 						value we wish to modify.
@@ -1525,6 +1445,7 @@ void test_bit_register(Register8 *target_register, unsigned char bit, Register8
  * @param flags: Pointer to the flags register
  */
 void test_bit_indirect(Register16 *address_register, unsigned char bit, Register8 *flags) {
+	materialise_flags(flags);
 	
 	// As mentioned previously, we abort if we've erroneous operands.
 	if (bit < 0 || 7 < bit) {
@@ -1535,15 +1456,13 @@ void test_bit_indirect(Register16 *address_register, unsigned char bit, Register
 	unsigned char target_value = read_byte(*address_register);
 	 
 	unsigned char isolated_test_bit = target_value << (7 - bit);  		// Assummes bit 0 is LSB
-	*flags = 0x20 | (isolated_test_bit ^ (0x80 | isolated_test_bit));	// X xor 1 is true iff X == 0
+	*flags = (*flags & 0x10) | 0x20 | (isolated_test_bit ^ (0x80 | isolated_test_bit));	// X xor 1 is true iff X == 0. Carry is untouched
 }
 
 /**
  * /brief Sets the bit-th bit in the target register to one.
  * 
  * Sets the bit at position "bit" in the target register to one.
- * This function implements the following op codes:
- *		CB C7, CB C0, CB C1, CB C2, CB C3, CB C4, CB C5
  *
  * @param target_register: Pointer to the register with the value we wish to 
  * 		manipulate.
@@ -1565,8 +1484,6 @@ void set_bit_register(Register8 *target_register, unsigned char bit) {
  * /brief Sets the bit-th bit at the memory address in the address_register to one.
  * 
  * Leverages indirect addressing to set a given bit at a target memory address to one. 
- * This function implements the following opcodes:
- * 		CB C6
  * 
  * @param address_register: HL register. Contains the bit we wish to set
  * @param bit: The bit we wish to set. If this value is not between 0-7 (inclusive),
@@ -1588,8 +1505,6 @@ void set_bit_indirect(Register16 *address_register, unsigned char bit) {
  * /brief Resets the bit-th bit in the value at the target register
  *
  * Resets the bit-th bit in the value at the supplied register.
- * This function implements the following opcodes:
- * 		CB 87, CB 80, CB 81, CB 82, CB 83, CB 84, CB 85 
  *
  * @param target_register: Pointer to the register whose value we wish to reset
  * @param bit: The bit we wish to manipulate. If this value is not between 0-7 (inclusive),
@@ -1610,8 +1525,6 @@ void reset_bit_register(Register8 *target_register, unsigned char bit) {
  * /brief Resets the bit-th bit at the memory address in the address_register to zero.
  * 
  * Leverages indirect addressing to set a given bit at a target memory address to zero.
- * This function implements the following opcodes:
- * 		CB 86 
  *
  * @param address_register: HL register. Contains the bit we wish to reset
  * @param bit: The bit we wish to reset. If this value is not between 0-7 (inclusive),
@@ -1640,9 +1553,6 @@ void reset_bit_indirect(Register16 *address_register, unsigned char bit) {
  * of this emulator is little endian. Thus a conversion where the LSB and MSB of the 
  * supplied operand will have to be swapped.
  * 
- * This function implements the following opcodes:
- * 		C3
- *
  * @param programme_counter: Pointer to the programme counter
  * @param address_little_endian: The new value of the programme counter. Big endian.
  */
@@ -1659,20 +1569,21 @@ void jump_unconditional(Register16 *programme_counter, unsigned short address_bi
  * address is big-endian while the programme's own memory interface is little endian.
  * Thus the MSB and LSB must be swapped. 
  * 
- * This function implements the following opcodes:
- *		C2
- *
  * @param programe_counter: Pointer to the programme counter
  * @param address_little_endian: The new value of the programme counter. Big endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_zero_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
+int jump_zero_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
 	unsigned short address = to_little_endian(address_big_endian);
 	
 	// Flip bits and then mask for Zero. 
 	if (!zero_flag_set(flags)) {
 		*programme_counter = address;		// Update our programme counter
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1683,21 +1594,22 @@ void jump_zero_reset(Register16 *programme_counter, unsigned short address_big_e
  * address is big-endian while the programme's own memory interface is little endian.
  * Thus the MSB and LSB must be swapped. 
  * 
- * This function implements the following opcodes:
- *		CA
- *
  * @param programe_counter: Pointer to the programme counter
  * @param address_little_endian: The new value of the programme counter. Big endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_zero_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
+int jump_zero_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
 	unsigned short address = to_little_endian(address_big_endian);
 	
 	// Mask out everything but the Zero Flag. 
 	// if the number is non zero, jump
 	if (zero_flag_set(flags)) {
 		*programme_counter = address;		// Update our programme counter
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1708,20 +1620,21 @@ void jump_zero_set(Register16 *programme_counter, unsigned short address_big_end
  * address is big-endian while the programme's own memory interface is little endian.
  * Thus the MSB and LSB must be swapped. 
  * 
- * This function implements the following opcodes:
- *		D2
- *
  * @param programe_counter: Pointer to the programme counter
  * @param address_little_endian: The new value of the programme counter. Big endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_carry_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
+int jump_carry_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
 	unsigned short address = to_little_endian(address_big_endian);
 	
 	// Flip bits and then mask for carry
 	if (!carry_flag_set(flags)) {
 		*programme_counter = address;		// Update our programme counter
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1732,20 +1645,21 @@ void jump_carry_reset(Register16 *programme_counter, unsigned short address_big_
  * address is big-endian while the programme's own memory interface is little endian.
  * Thus the MSB and LSB must be swapped. 
  * 
- * This function implements the following opcodes:
- *		DA
- *
  * @param programe_counter: Pointer to the programme counter
  * @param address_little_endian: The new value of the programme counter. Big endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_carry_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
+int jump_carry_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags) {
 	unsigned short address = to_little_endian(address_big_endian);
 	
 	// Mask out everything but the Carry Flag. 
 	if (carry_flag_set(flags)) {
 		*programme_counter = address;		// Update our programme counter
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1756,9 +1670,6 @@ void jump_carry_set(Register16 *programme_counter, unsigned short address_big_en
  * register. Unlike the other jumps, the address stored in this register is little-endian
  * so no conversion is necessary.
  * 
- * This function implements the following opcodes: 
- * 		E9
- *
  * @param programme_counter: Pointer to the programme counter. 
  * @param address_register: Pointer to the address register. The value in this 
  * 		register will be the new value of the programme counter.
@@ -1773,15 +1684,12 @@ void jump_indirect(Register16 *programme_counter, Register16 *address_register)
  * Performs a jump to a position relative to the current position of the programme 
  * counter.
  * 
- * This function implements the following opcodes:
- * 		18
- *
  * @param programme_counter: Pointer to the programme counter.
  * @param offset: The amount we will add to our programme counter to get 
- * 		our new PC value
+ * 		our new PC value. This is a signed (two's complement) byte.
  */
 void jump_relative_pos(Register16 *programme_counter, unsigned char offset) {
-	*programme_counter += offset;
+	*programme_counter += (signed char) offset;
 }
 
 /**
@@ -1791,19 +1699,20 @@ void jump_relative_pos(Register16 *programme_counter, unsigned char offset) {
  * Performs a jump to a position relative to the current programme counter.
  *		The jump is only made if the Zero flag is not set.
  *
- * This function implements the following opcodes: 
- * 		20
- *
  * @param programme_counter: Pointer to the programme counter
  * @param offset: The amount we will add to the programme coiunter to get the 
- *		our new value.
+ *		our new value. This is a signed (two's complement) byte.
  * @param flags: Pointer to the flags register.
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_relative_zero_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
+int jump_relative_zero_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
 	// Flip bits, mask for zero
 	if (!zero_flag_set(flags)) {
-		*programme_counter += offset;
+		*programme_counter += (signed char) offset;
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1813,19 +1722,20 @@ void jump_relative_zero_reset(Register16 *programme_counter, unsigned char offse
  * Performs a jump to a position relative to the current programme counter.
  *		The jump is only made if the Zero flag is set.
  *
- * This function implements the following opcodes:
- * 		28
- * 
  * @param programme_counter: Pointer to the programme counter
  * @param offset: The amount we will add to the programme coiunter to get the 
- *		our new value.
+ *		our new value. This is a signed (two's complement) byte.
  * @param flags: Pointer to the flags register.
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_relative_zero_set(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
+int jump_relative_zero_set(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
 	// Flip bits, mask for zero
 	if (zero_flag_set(flags)) {
-		*programme_counter += offset;
+		*programme_counter += (signed char) offset;
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1835,19 +1745,20 @@ void jump_relative_zero_set(Register16 *programme_counter, unsigned char offset,
  * Performs a jump to a position relative to the current programme counter.
  *		The jump is only made if the carry flag is not set.
  *
- * This function implements the following opcodes
- *		30
- *
  * @param programme_counter: Pointer to the programme counter
  * @param offset: The amount we will add to the programme coiunter to get the 
- *		our new value.
+ *		our new value. This is a signed (two's complement) byte.
  * @param flags: Pointer to the flags register.
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_relative_carry_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
+int jump_relative_carry_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
 	// Flip bits, mask for carry
 	if (!carry_flag_set(flags)) {
-		*programme_counter += offset;
+		*programme_counter += (signed char) offset;
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1857,19 +1768,20 @@ void jump_relative_carry_reset(Register16 *programme_counter, unsigned char offs
  * Performs a jump to a position relative to the current programme counter.
  *		The jump is only made if the carry flag is set.
  *
- * This function implements the following op codes:
- *		38
- *
  * @param programme_counter: Pointer to the programme counter
  * @param offset: The amount we will add to the programme coiunter to get the 
- *		our new value.
+ *		our new value. This is a signed (two's complement) byte.
  * @param flags: Pointer to the flags register.
+ *
+ * @return 1 if the jump was taken. 0 otherwise.
  */
-void jump_relative_carry_set(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
+int jump_relative_carry_set(Register16 *programme_counter, unsigned char offset, Register8 *flags) {
 	// Flip bits, mask for carry
 	if (carry_flag_set(flags)) {
-		*programme_counter += offset;
+		*programme_counter += (signed char) offset;
+		return 1;
 	}
+	return 0;
 }
 
 
@@ -1884,9 +1796,6 @@ void jump_relative_carry_set(Register16 *programme_counter, unsigned char offset
  * The supplied call address is loaded into the programme counter, and the function begins from the 
  * beginning of the new routine.
  *
- * This function implements the following opcodes: 
- * 		CD
- *
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter. At the beginning of execution, it will have 
  * the address of the CALL instruction. At the end it will be plaved at what ever address is supplied by 
@@ -1896,6 +1805,7 @@ void jump_relative_carry_set(Register16 *programme_counter, unsigned char offset
  * with C which assumes numbers are little endian. 
  */
 void call(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian) {
+	PROFILE_CALL(*programme_counter, to_little_endian(call_address_big_endian));
 	push(stack_pointer, programme_counter);
 	
 	unsigned short call_address = to_little_endian(call_address_big_endian);
@@ -1911,9 +1821,6 @@ void call(Register16 *stack_pointer, Register16 *programme_counter, unsigned sho
  * in the call_address_big_endian parameter. Otherwise execution will continue
  * at the current location of the programme counter. 
  * 
- * This function implements the following opcodes:
- * 		C4
- * 
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter. At the beginning of execution, it will have 
  * the address of the CALL instruction. At the end it will be plaved at what ever address is supplied by 
@@ -1922,11 +1829,15 @@ void call(Register16 *stack_pointer, Register16 *programme_counter, unsigned sho
  * address is supplied to us in a big endian format so some rearranging has to be done to make it compatable
  * with C which assumes numbers are little endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the call was made. 0 otherwise.
  */ 
-void call_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
+int call_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
 	if (!zero_flag_set(flags)) {
 		call(stack_pointer, programme_counter, call_address_big_endian);
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1936,9 +1847,6 @@ void call_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, u
  * in the call_address_big_endian parameter. Otherwise execution will continue
  * at the current location of the programme counter. 
  * 
- * This function implements the following opcodes:
- * 		CC
- * 
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter. At the beginning of execution, it will have 
  * the address of the CALL instruction. At the end it will be plaved at what ever address is supplied by 
@@ -1947,11 +1855,15 @@ void call_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, u
  * address is supplied to us in a big endian format so some rearranging has to be done to make it compatable
  * with C which assumes numbers are little endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the call was made. 0 otherwise.
  */ 
-void call_zero_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
+int call_zero_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
 	if (zero_flag_set(flags)) {
 		call(stack_pointer, programme_counter, call_address_big_endian);
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1961,9 +1873,6 @@ void call_zero_set(Register16 *stack_pointer, Register16 *programme_counter, uns
  * in the call_address_big_endian parameter. Otherwise execution will continue
  * at the current location of the programme counter. 
  * 
- * This function implements the following opcodes:
- * 		D4
- * 
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter. At the beginning of execution, it will have 
  * the address of the CALL instruction. At the end it will be plaved at what ever address is supplied by 
@@ -1972,11 +1881,15 @@ void call_zero_set(Register16 *stack_pointer, Register16 *programme_counter, uns
  * address is supplied to us in a big endian format so some rearranging has to be done to make it compatable
  * with C which assumes numbers are little endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the call was made. 0 otherwise.
  */ 
-void call_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
+int call_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
 	if (!carry_flag_set(flags)) {
 		call(stack_pointer, programme_counter, call_address_big_endian);
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -1986,9 +1899,6 @@ void call_carry_reset(Register16 *stack_pointer, Register16 *programme_counter,
  * in the call_address_big_endian parameter. Otherwise execution will continue
  * at the current location of the programme counter. 
  * 
- * This function implements the following opcodes:
- * 		DC
- * 
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter. At the beginning of execution, it will have 
  * the address of the CALL instruction. At the end it will be plaved at what ever address is supplied by 
@@ -1997,11 +1907,15 @@ void call_carry_reset(Register16 *stack_pointer, Register16 *programme_counter,
  * address is supplied to us in a big endian format so some rearranging has to be done to make it compatable
  * with C which assumes numbers are little endian.
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if the call was made. 0 otherwise.
  */ 
-void call_carry_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
+int call_carry_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags) {
 	if (carry_flag_set(flags)) {
 		call(stack_pointer, programme_counter, call_address_big_endian);
+		return 1;
 	}
+	return 0;
 }
 
 
@@ -2016,9 +1930,6 @@ void call_carry_set(Register16 *stack_pointer, Register16 *programme_counter, un
  * then begins executing from the memory address 0x0000 + offset. These offsets correspond to 
  * the locations of different interrupt vectors within the Z80GB memory space.  
  * 
- * This function implements the following opcodes
- * 		C7, CF, D7, DF, E7, EF, F7, FF
- * 
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter. At the beginning of execution, it will have 
  * the address of the RESTART instruction. At the end it will be placed at the address 0x0000 + offset. 
@@ -2026,6 +1937,7 @@ void call_carry_set(Register16 *stack_pointer, Register16 *programme_counter, un
  * @param offset: The offset from 0x0000 the programme will resume execution at. 
  */
 void restart(Register16 *stack_pointer, Register16 *programme_counter, unsigned char offset) {
+	PROFILE_CALL(*programme_counter, offset);
 	push(stack_pointer, programme_counter);
 
 	*programme_counter = offset;	// The offset is from 0x0000 so we can simply supply the offset.
@@ -2040,14 +1952,12 @@ void restart(Register16 *stack_pointer, Register16 *programme_counter, unsigned
  * then begins at that address.
  * 
  * 
- * This function implements the following opcodes:
- * 		C9, D9
- * 
  * @param stack_pointer: Pointer to the stack pointer.
  * @param programme_counter: Pointer to the programme counter 
  */
 void return_unconditional(Register16 *stack_pointer, Register16 *programme_counter) {
 	pop(stack_pointer, programme_counter);
+	PROFILE_RETURN(*programme_counter);
 }
 
 /**
@@ -2056,17 +1966,18 @@ void return_unconditional(Register16 *stack_pointer, Register16 *programme_count
  * Pops two bytes from the stack and sets the programme counter to that address. We do this 
  * only if the zero flag is not set.
  * 
- * This function implements the following opcodes:
- * 		C0
- * 
  * @param stack_pointer: Pointer to the SP register.
  * @param programme_counter: Pointer to the programme counter 
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if we returned. 0 otherwise.
  */
-void return_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
+int return_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
 	if (!zero_flag_set(flags)) {
-		pop(stack_pointer, programme_counter);
+		return_unconditional(stack_pointer, programme_counter);
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -2075,17 +1986,18 @@ void return_zero_reset(Register16 *stack_pointer, Register16 *programme_counter,
  * Pops two bytes from the stack and sets the programme counter to that address. We do this 
  * only if the zero flag is set.
  * 
- * This function implements the following opcodes:
- * 		C8
- * 
  * @param stack_pointer: Pointer to the SP register.
  * @param programme_counter: Pointer to the programme counter 
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if we returned. 0 otherwise.
  */
-void return_zero_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
+int return_zero_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
 	if (zero_flag_set(flags)) {
-		pop(stack_pointer, programme_counter);
+		return_unconditional(stack_pointer, programme_counter);
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -2094,17 +2006,18 @@ void return_zero_set(Register16 *stack_pointer, Register16 *programme_counter, R
  * Pops two bytes from the stack and sets the programme counter to that address. We do this 
  * only if the carry flag is not set.
  * 
- * This function implements the following opcodes:
- * 		D0
- * 
  * @param stack_pointer: Pointer to the SP register.
  * @param programme_counter: Pointer to the programme counter 
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if we returned. 0 otherwise.
  */
-void return_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
+int return_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
 	if (!carry_flag_set(flags)) {
-		pop(stack_pointer, programme_counter);
+		return_unconditional(stack_pointer, programme_counter);
+		return 1;
 	}
+	return 0;
 }
 
 /**
@@ -2113,17 +2026,18 @@ void return_carry_reset(Register16 *stack_pointer, Register16 *programme_counter
  * Pops two bytes from the stack and sets the programme counter to that address. We do this 
  * only if the carry flag is set.
  * 
- * This function implements the following opcodes:
- * 		D8
- * 
  * @param stack_pointer: Pointer to the SP register.
  * @param programme_counter: Pointer to the programme counter 
  * @param flags: Pointer to the flags register
+ *
+ * @return 1 if we returned. 0 otherwise.
  */
-void return_carry_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
+int return_carry_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags) {
 	if (carry_flag_set(flags)) {
-		pop(stack_pointer, programme_counter);
+		return_unconditional(stack_pointer, programme_counter);
+		return 1;
 	}
+	return 0;
 }
 
 /*** MISC ***/
@@ -2133,14 +2047,13 @@ void return_carry_set(Register16 *stack_pointer, Register16 *programme_counter,
  * 
  * Swaps the upper and lower nibbles of a value stored within an 8 bit
  * register.
- * This function implements the following opcodes:
- *		37, 30, 31, 32, 33, 34, 35,
  *
  * @param target_register: The register containing the value we 
  * 		are doing a nibble swap for
  * @param flags: Pointer to the flags register
  */
 void swap_nibble_register(Register8 *target_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char result = (*target_register >> 4) | (*target_register << 4);
 	*flags = (result == 0) << 7;
 
@@ -2152,14 +2065,13 @@ void swap_nibble_register(Register8 *target_register, Register8 *flags) {
  * 		through indirect addressing,
  * Swaps the upper and lower nibbles of a value found at the memory address
  * contained in the HL address register.
- * This function implements the following opcodes:
- *		36
  *
  * @param target_register: The register containing memory address containing the
  *		value we are doing the swap for. 
  * @param flags: Pointer to the flags register
  */
 void swap_nibble_indirect(Register16 *address_register, Register8 *flags) {
+	discard_pending_flags(flags);
 	unsigned char value_at_address = read_byte(*address_register);
 	unsigned char result = (value_at_address >> 4) | (value_at_address << 4);
 	*flags = (result == 0) << 7;
@@ -2173,36 +2085,18 @@ void swap_nibble_indirect(Register16 *address_register, Register8 *flags) {
  *
  * This operation converts the value in the accumulator into a
  * binary coded decimal. (Gosh, who EVER thought this was a sound 
- * idea).
- * To be honest, I'm not 100% sure if this is a correct implementation
- * as there is very little in the way of sound documentation for this 
- * functionality on the z80GB processor. For tractability, it should be
- * noted that I followed along with this explination of the operation:
- * http://sgate.emt.bme.hu/patai/publications/z80guide/app1b.html
- *
- * This operation implements the following opcodes:
- * 		27
+ * idea). The adjustment only depends on the accumulator and the upper 
+ * nibble of F, so it is looked up in alu_decimal_adjust_table. See 
+ * reference_decimal_adjust in alu_reference.c for how it's worked out.
  *
  * @param accumulator: Pointer to the accumulator
  * @param flags: Pointer to the flags register
  */
 void decimal_adjust_accumulator(Register8 *accumulator, Register8 *flags) {
-	unsigned char new_flags = *flags & 0x40;		// Operation preserves the N bit
-
-	// First we deal with the lower nibble of our value=
-	if ((*flags & 0x20) || (0x0F & *accumulator) > 0x09) {
-		*accumulator += 0x06;	// Read as 0$06
-	}
-
-	// Now we deal with the upper nibble
-	if ((*flags & 0x10) || (0xF0 & *accumulator) > 0x90) {
-		*accumulator += 0x60;	// Read as 0$60
-		new_flags |= 0x10;		// Per specifications, turn on carry bit
-	}
-
-	// Now we set our flags
-	new_flags |= ((*accumulator == 0) << 7);
-	*flags = new_flags;
+	materialise_flags(flags);
+	Register16 entry = alu_decimal_adjust_table[*flags >> 4][*accumulator];
+	*accumulator = entry >> 8;
+	*flags = entry;
 }
 
 /**
@@ -2210,26 +2104,24 @@ void decimal_adjust_accumulator(Register8 *accumulator, Register8 *flags) {
  *
  * Complements the value in the accumulator. The value will
  * thus feel a bit better about itself!
- * This operation implements the following opcodes:
- * 		2F
  *
  * @param *accumulator: Pointer to the accumulator register
  */
 void complement_accumulator(Register8 *accumulator, Register8 *flags) {
+	materialise_flags(flags);
 	*accumulator = ~(*accumulator);
-	*flags = 0x60;				// Flags set according to Z80gb specifications
+	*flags |= 0x60;				// Flags set according to Z80gb specifications. Z & C are untouched
 }
 
 /**
  * /brief Complements the carry bit in the flags register.
  *
  * Complements carry flag. The other flags will feel jealous.
- * This operation implements the following opcodes:
- * 		3F
  *
  * @param *accumulator: Pointer to the flags register
  */
 void complement_carry_flag(Register8 *flags) {
+	materialise_flags(flags);
 	*flags &= 0x90;		// Clear the N & H bits
 	*flags ^= 0x10;		// Toggle the carry bit.
 }
@@ -2239,12 +2131,11 @@ void complement_carry_flag(Register8 *flags) {
  * /brief Unconditionally sets the carry flag.
  *
  * Sets the carry flag.
- * This operation implements the following opcodes:
- * 		37
  *
  * @param *accumulator: Pointer to the flags register
  */
 void set_carry_flag(Register8 *flags) {
+	materialise_flags(flags);
 	*flags &= 0x90;		// Reset N & H bits
 	*flags |= 0x10;		// Set the carry flag
 }
@@ -150,15 +150,15 @@ void jump_indirect(Register16 *programme_counter, Register16 *address_register);
 void jump_relative_pos(Register16 *programme_counter, unsigned char offset);
 
 // Conditional Jumps
-void jump_zero_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
-void jump_zero_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
-void jump_carry_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
-void jump_carry_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
+int jump_zero_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
+int jump_zero_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
+int jump_carry_reset(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
+int jump_carry_set(Register16 *programme_counter, unsigned short address_big_endian, Register8 *flags);
 
-void jump_relative_zero_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags);
-void jump_relative_zero_set(Register16 *programme_counter, unsigned char offset, Register8 *flags);
-void jump_relative_carry_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags);
-void jump_relative_carry_set(Register16 *programme_counter, unsigned char offset, Register8 *flags);
+int jump_relative_zero_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags);
+int jump_relative_zero_set(Register16 *programme_counter, unsigned char offset, Register8 *flags);
+int jump_relative_carry_reset(Register16 *programme_counter, unsigned char offset, Register8 *flags);
+int jump_relative_carry_set(Register16 *programme_counter, unsigned char offset, Register8 *flags);
 
 // CALLS //
 void restart(Register16 *stack_pointer, Register16 *programme_counter, unsigned char offset);
@@ -167,10 +167,10 @@ void restart(Register16 *stack_pointer, Register16 *programme_counter, unsigned
 void call(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian);
 
 // Conditional
-void call_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
-void call_zero_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
-void call_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
-void call_carry_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
+int call_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
+int call_zero_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
+int call_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
+int call_carry_set(Register16 *stack_pointer, Register16 *programme_counter, unsigned short call_address_big_endian, Register8 *flags);
 
 // RESTARTS //
 void restart(Register16 *stack_pointer, Register16 *programme_counter, unsigned char offset);
@@ -181,10 +181,10 @@ void restart(Register16 *stack_pointer, Register16 *programme_counter, unsigned
 void return_unconditional(Register16 *stack_pointer, Register16 *programme_counter);
 
 // Conditional
-void return_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
-void return_zero_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
-void return_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
-void return_carry_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
+int return_zero_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
+int return_zero_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
+int return_carry_reset(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
+int return_carry_set(Register16 *stack_pointer, Register16 *programme_counter, Register8 *flags);
 
 // MISC //
 
@@ -197,6 +197,19 @@ void complement_accumulator(Register8 *accumulator, Register8 *flags);
 void complement_carry_flag(Register8 *flags);
 void set_carry_flag(Register8 *flags);
 
+// FLAG MANAGEMENT //
+
+void keep_carry_flag(Register8 *flags, unsigned char carry);
+
+#ifdef LAZY_FLAGS
+void materialise_flags(Register8 *flags);
+void discard_pending_flags(Register8 *flags);
+#else
+// F is always up to date, so there is never anything to work out
+static inline void materialise_flags(Register8 *flags) {}
+static inline void discard_pending_flags(Register8 *flags) {}
+#endif
+
 
 #endif
 
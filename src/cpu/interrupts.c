@@ -0,0 +1,120 @@
+/**
+ * This module contains the interrupt controller.
+ *
+ * An interrupt is taken when IME is set and some bit is set in both IF and IE. Rather than
+ * read all three after every instruction, the controller keeps the answer in a single
+ * byte, interrupt_controller.pending, worked out afresh only when one of them changes:
+ * write_byte lets us know about IF and IE, while IME only changes in here. The run loops
+ * test that byte and call service_interrupts when it is set, which is rare.
+ *
+ * Interrupts are only taken at service points: straight after an instruction which ends a
+ * block (see ends_block in block_cache.h). Every core can check there for nothing, being at
+ * the end of a block anyway, and checking in the same places keeps them in step with each
+ * other. A request made part way through a block waits for the end of it.
+ *
+ * EI takes effect after the instruction following it. As EI ends a block, the service
+ * point straight after it just counts down enable_delay. The instruction after it is then
+ * a service point of its own, whatever it is, and that one sets IME and takes anything
+ * due. The table core services after any instruction while enable_delay is set, and the
+ * other cores hand it that one instruction, see run_ei_window in dispatch.h. That keeps
+ * EI; RETI, EI; DI and EI; NOP; DI behaving.
+ *
+ * Taking an interrupt pushes the programme counter and jumps to the vector, just like a
+ * restart, so restart() in instructions.c does the work. The highest priority interrupt
+ * (the lowest bit) goes first and the rest wait for the handler to reenable them.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "interrupts.h"
+#include "instructions.h"
+
+InterruptController interrupt_controller;
+
+/**
+ * /brief Works out interrupt_controller.pending afresh.
+ *
+ * Called whenever IME, IE or IF changes. Set if an interrupt is requested, enabled and IME
+ * lets it through, or if an EI is waiting to take effect.
+ */
+void update_interrupts_pending() {
+	InterruptController *controller = &interrupt_controller;
+
+	controller->pending = (controller->master_enable ? interrupt_requested() : 0) |
+		(controller->enable_delay ? INTERRUPT_EI_PENDING : 0);
+}
+
+/**
+ * /brief Deals with whatever made interrupt_controller.pending nonzero.
+ *
+ * Counts down an EI, then takes the highest priority interrupt due. A halted CPU is left
+ * for its HALT to wake, after which the next service point takes the interrupt.
+ *
+ * @param state: The CPU we are running.
+ */
+void service_interrupts(CPUState *state) {
+	InterruptController *controller = &interrupt_controller;
+	unsigned char requested, interrupt;
+	unsigned char vector = INTERRUPT_VECTOR_BASE;
+
+	if (controller->enable_delay && --controller->enable_delay == 0) {
+		controller->master_enable = 1;
+		update_interrupts_pending();
+	}
+
+	requested = controller->pending & INTERRUPT_MASK;
+	if (!requested || state->halted) {
+		return;
+	}
+
+	for (interrupt = INTERRUPT_VBLANK; !(requested & interrupt); interrupt <<= 1) {
+		vector += INTERRUPT_VECTOR_SPACING;
+	}
+
+	controller->master_enable = 0;
+	write_byte(INTERRUPT_FLAG_ADDRESS, read_byte(INTERRUPT_FLAG_ADDRESS) & ~interrupt);	// Updates pending
+	restart(&state->SP, &state->PC, vector);
+	state->cycles += INTERRUPT_DISPATCH_CYCLES;
+}
+
+/**
+ * /brief Sets IME straight away. What RETI does.
+ */
+void enable_interrupts() {
+	interrupt_controller.master_enable = 1;
+	interrupt_controller.enable_delay = 0;
+	update_interrupts_pending();
+}
+
+/**
+ * /brief Sets IME once the instruction after this one has run. What EI does.
+ *
+ * An EI straight after another is the instruction the first was waiting on, so it leaves
+ * the first to set IME after it rather than putting it off again.
+ */
+void enable_interrupts_delayed() {
+	if (!interrupt_controller.master_enable && !interrupt_controller.enable_delay) {
+		interrupt_controller.enable_delay = 2;		// The service point straight after EI, then the instruction after
+		update_interrupts_pending();
+	}
+}
+
+/**
+ * /brief Clears IME, along with any EI yet to take effect. What DI does.
+ */
+void disable_interrupts() {
+	interrupt_controller.master_enable = 0;
+	interrupt_controller.enable_delay = 0;
+	update_interrupts_pending();
+}
+
+/**
+ * /brief Puts the controller back as it is at power on, with IME clear.
+ *
+ * Needed whenever IE or IF are changed behind write_byte's back, e.g. when loading a ROM.
+ */
+void reset_interrupts() {
+	interrupt_controller.master_enable = 0;
+	interrupt_controller.enable_delay = 0;
+	update_interrupts_pending();
+}
@@ -0,0 +1,58 @@
+/**
+ * A header file for the interrupt controller: IME, IE and IF, and the taking of
+ * interrupts between blocks.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include "register.h"
+#include "../memory/memory.h"
+
+#define INTERRUPT_VECTOR_BASE 		0x40	// VBlank's handler. Each one after sits 8 bytes on
+#define INTERRUPT_VECTOR_SPACING 	0x08
+#define INTERRUPT_DISPATCH_CYCLES 	20		// Two idle machine cycles, the push and the jump
+#define INTERRUPT_EI_PENDING 		0x80	// Set in pending while an EI waits to take effect
+
+/**
+ * Everything the CPU knows about interrupts beyond IE and IF themselves, which live in memory.
+ */
+typedef struct {
+	unsigned char master_enable;	/** IME. Set by RETI and (after a delay) EI. Cleared by DI and taking an interrupt */
+	unsigned char enable_delay;		/** Service points to go before an EI sets IME. 1 while the instruction after it is due */
+	unsigned char pending;			/** Nonzero when the run loops must call service_interrupts */
+} InterruptController;
+
+extern InterruptController interrupt_controller;
+
+/**
+ * /brief Whether any interrupt is both requested and enabled, IME regardless.
+ *
+ * @return The interrupts in question, 0 if there are none.
+ */
+static inline unsigned char interrupt_requested() {
+	return read_byte(INTERRUPT_FLAG_ADDRESS) & read_byte(INTERRUPT_ENABLE_ADDRESS) & INTERRUPT_MASK;
+}
+
+// See interrupts.c for more thorough explination of these functions
+void update_interrupts_pending();
+void service_interrupts(CPUState *state);
+void enable_interrupts();
+void enable_interrupts_delayed();
+void disable_interrupts();
+void reset_interrupts();
+
+/**
+ * /brief Takes an interrupt if one is due. Called by the cores at each service point.
+ *
+ * @param state: The CPU we are running.
+ */
+static inline void check_interrupts(CPUState *state) {
+	if (interrupt_controller.pending) {
+		service_interrupts(state);
+	}
+}
+
+#endif // INTERRUPTS_H
@@ -0,0 +1,1103 @@
+/**
+ * This module contains the dynamic recompiler (JIT) core.
+ *
+ * Blocks of Game Boy code are interpreted to begin with. Once a block has been run
+ * jit_threshold times it is translated into x86-64 machine code, by hand, into a buffer
+ * of executable memory. Blocks are tracked by address and ROM bank like the block cache.
+ *
+ * For the length of a compiled block the Game Boy's 8 bit registers live in host registers:
+ *
+ * 		A -> r8		F -> r9		B -> r10	C -> r11
+ * 		D -> r12	E -> r13	H -> r14	L -> r15
+ *
+ * with rbp holding the CPUState. Loads, ALU operations on A, 8 bit INC/DEC, 16 bit INC/DEC,
+ * jumps and memory accesses through HL, BC, DE or a fixed address are emitted natively. x86
+ * computes Z, H and C the same way the Game Boy does, so F is rebuilt from LAHF through a
+ * lookup table. Everything else is handed to the opcode's adapter, with the registers
+ * written back around the call.
+ *
+ * Interrupts are checked by the run loop once a block which ends with a jump (or anything
+ * else ending a block) has run through. A block looping back on itself only goes round
+ * again while none are pending.
+ *
+ * Cycles are added to the CPUState once per pass, on the way out of the block, for all the
+ * instructions run up to that exit. Native conditional jumps add the extra for a branch
+ * taken on that side of the exit; the adapters see to it for everything else.
+ *
+ * Memory accesses go through memory_map natively, just as read_byte and write_byte do, so
+ * they follow the cart's bank switches. Reads are always native. Writes are native where the
+ * map has somewhere to write; the I/O ports, the cart, echo RAM and pages holding compiled
+ * code fall back to the interpreter, which goes through write_byte. That in turn throws away
+ * any compiled block on the page. If the running block was one of them it bails out
+ * straight after the write.
+ *
+ * run_instructions_jit_lockstep runs the table core on a copy of the machine alongside,
+ * comparing registers and memory after every block, and aborts on the first difference.
+ *
+ * Hosts other than x86-64 simply interpret everything.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "jit.h"
+#include "instructions.h"
+#include "dispatch.h"
+#include "block_cache.h"
+#include "idle.h"
+#include "cycle_tables.h"
+#include "interrupts.h"
+#include "disassembler.h"
+#include "../memory/memory.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+	#define JIT_X86_64
+	#include <sys/mman.h>
+#endif
+
+#define JIT_MAX_BLOCK_BYTES 	(JIT_MAX_BLOCK_LENGTH * 320)	// Generous upper bound on a compiled block
+#define JIT_MAX_EXITS 			(JIT_MAX_BLOCK_LENGTH * 3 + 2)
+
+/*
+ * A compiled block. It runs at least once and goes round again while it loops back on
+ * itself and the budget allows, returning the number of instructions executed.
+ */
+typedef unsigned long (*CompiledBlock)(CPUState *state, unsigned long budget);
+
+/**
+ * Everything we know about a block starting at a given address.
+ */
+typedef struct {
+	unsigned short start;		/** Address of the first instruction */
+	unsigned short bank;		/** ROM bank the block was found in */
+	unsigned short first_page;	/** First code page the compiled code covers */
+	unsigned short last_page;	/** Last code page the compiled code covers */
+	unsigned char valid;		/** Set while code holds an up to date translation */
+	unsigned char length;		/** Instructions in the compiled block */
+	unsigned char service_point;	/** Ends with an instruction which ends a block */
+	unsigned int heat;			/** Times the block has been interpreted */
+	CompiledBlock code;			/** The translation */
+} JitBlock;
+
+static JitBlock jit_blocks[JIT_CACHE_SIZE];
+
+JitStats jit_stats;
+unsigned int jit_threshold = JIT_DEFAULT_THRESHOLD;
+
+static void invalidate_jit_page(unsigned short page);
+static int compile_block(JitBlock *block);
+static void discard_compiled_code();
+
+/**
+ * /brief Finds the record for the block starting at an address.
+ *
+ * A record left by a different block in the same slot is replaced.
+ *
+ * @param address: Address of the first instruction.
+ *
+ * @return The block's record.
+ */
+static JitBlock* find_jit_block(unsigned short address) {
+	unsigned short bank = bank_of(address);
+	JitBlock *block = &jit_blocks[(address ^ (bank << 7)) & (JIT_CACHE_SIZE - 1)];
+
+	if (block->start != address || block->bank != bank) {
+		block->start = address;
+		block->bank = bank;
+		block->valid = 0;
+		block->heat = 0;
+	}
+
+	return block;
+}
+
+/**
+ * /brief Interprets instructions up to the end of a block.
+ *
+ * @param state: The CPU we are running.
+ * @param remaining: Most instructions we may execute.
+ *
+ * @return The number of instructions executed.
+ */
+static unsigned long interpret_block(CPUState *state, unsigned long remaining) {
+	unsigned long executed = 0;
+	unsigned char opcode;
+
+	do {
+		opcode = read_byte(state->PC);
+		execute_instruction(state);
+		++executed;
+	} while (!ends_block(opcode) && executed < remaining && executed < JIT_MAX_BLOCK_LENGTH);
+
+	if (ends_block(opcode)) {
+		check_interrupts(state);
+	}
+
+	jit_stats.interpreted_executed += executed;
+	return executed;
+}
+
+/**
+ * /brief Runs the block at the programme counter, compiled if possible.
+ *
+ * Compiles the block first if it has become hot. Compiled blocks run all or nothing, so
+ * when fewer instructions remain than the block holds it is interpreted instead. Every
+ * pass but the last runs the block through, so a compiled block has reached its end (and
+ * a service point if it ends with a jump) when it returns a multiple of its length. The
+ * instruction after an EI is run on its own instead, see run_ei_window.
+ *
+ * @param state: The CPU we are running.
+ * @param remaining: Most instructions we may execute.
+ *
+ * @return The number of instructions executed.
+ */
+static unsigned long run_block(CPUState *state, unsigned long remaining) {
+	JitBlock *block;
+	unsigned long executed = run_ei_window(state, remaining);
+
+	if (executed != 0) {
+		return executed;
+	}
+
+	block = find_jit_block(state->PC);
+
+	if (!block->valid && block->heat++ >= jit_threshold) {
+		compile_block(block);
+	}
+
+	if (block->valid && block->length <= remaining) {
+		materialise_flags(&state->F);		// Compiled code works on F itself
+		executed = block->code(state, remaining);
+		jit_stats.compiled_executed += executed;
+		if (block->service_point && executed % block->length == 0) {
+			check_interrupts(state);
+		}
+		return executed;
+	}
+
+	return interpret_block(state, remaining);
+}
+
+/**
+ * /brief Runs the CPU for a set number of instructions, compiling hot blocks as it goes.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions_jit(CPUState *state, unsigned long instruction_count) {
+	unsigned long executed = 0;
+
+	while (executed < instruction_count) {
+		executed += run_block(state, instruction_count - executed);
+		if (state->halted) {
+			executed += sleep_while_halted(state, instruction_count - executed);
+		}
+	}
+
+	return executed;
+}
+
+/*** LOCKSTEP ***/
+
+static CPUState shadow_state;
+static InterruptController shadow_interrupts;
+static unsigned char *shadow_memory = NULL;
+static unsigned char *shadow_cart_ram = NULL;
+static MemoryMap shadow_map;
+
+/**
+ * /brief Prints the instructions the block ran and the registers of both machines side by
+ * side, then aborts.
+ *
+ * @param state: The machine the JIT is running.
+ * @param block_start: Where the offending block started.
+ * @param executed: How many instructions the block ran.
+ * @param address: First address whose contents differ. -1 if memory agrees.
+ * @param ram_offset: First offset into the cart's RAM whose contents differ. -1 if it agrees.
+ */
+static void lockstep_mismatch(CPUState *state, unsigned short block_start, unsigned long executed, int address,
+		int ram_offset) {
+	unsigned short instruction = block_start;
+	unsigned long i;
+	char text[DISASSEMBLY_MAX];
+
+	fprintf(stderr, "LOCKSTEP MISMATCH: block at %04X, %lu instructions\n", block_start, executed);
+	for (i = 0; i < executed; i++) {
+		unsigned char bytes[3] = {read_byte(instruction), read_byte(instruction + 1), read_byte(instruction + 2)};
+		unsigned short length = disassemble(bytes, instruction, text, sizeof(text));
+		fprintf(stderr, "\t%04X: %s\n", instruction, text);
+		instruction += length;
+	}
+	fprintf(stderr, "\t\tAF   BC   DE   HL   SP   PC   IME Cycles\n");
+	fprintf(stderr, "\tJIT:\t%04X %04X %04X %04X %04X %04X %u   %lu\n",
+		state->AF, state->BC, state->DE, state->HL, state->SP, state->PC, interrupt_controller.master_enable,
+		state->cycles);
+	fprintf(stderr, "\tTable:\t%04X %04X %04X %04X %04X %04X %u   %lu\n",
+		shadow_state.AF, shadow_state.BC, shadow_state.DE, shadow_state.HL, shadow_state.SP, shadow_state.PC,
+		shadow_interrupts.master_enable, shadow_state.cycles);
+	if (address >= 0) {
+		fprintf(stderr, "\tMemory at %04X: JIT %02X, Table %02X\n",
+			address, memory_space[address], shadow_memory[address]);
+	}
+	if (ram_offset >= 0) {
+		fprintf(stderr, "\tCart RAM at %05X: JIT %02X, Table %02X\n",
+			ram_offset, cart_ram[ram_offset], shadow_cart_ram[ram_offset]);
+	}
+	abort();
+}
+
+/**
+ * /brief Runs the JIT and the table core in lockstep, aborting as soon as they disagree.
+ *
+ * The table core runs on a private copy of the registers, interrupt controller, memory, cart
+ * RAM and memory map, taken on entry. After each block the JIT runs, the table core runs the same
+ * number of instructions and every register, IME, the cycle count, every byte of memory
+ * and every byte of cart RAM is compared.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions_jit_lockstep(CPUState *state, unsigned long instruction_count) {
+	unsigned char *memory = memory_space;
+	unsigned char *ram = cart_ram;
+	unsigned long executed = 0;
+
+	if (shadow_memory == NULL) {
+		shadow_memory = malloc(MEMORY_SPACE_SIZE);
+	}
+	memcpy(shadow_memory, memory, MEMORY_SPACE_SIZE);
+	if (ram != NULL) {
+		shadow_cart_ram = realloc(shadow_cart_ram, cart_ram_size);
+		memcpy(shadow_cart_ram, ram, cart_ram_size);
+	}
+	shadow_map = memory_map;
+	rebase_memory_map(&shadow_map, memory, shadow_memory, MEMORY_SPACE_SIZE);
+	rebase_memory_map(&shadow_map, ram, shadow_cart_ram, cart_ram_size);
+	shadow_state = *state;
+	shadow_interrupts = interrupt_controller;
+
+	while (executed < instruction_count) {
+		unsigned short block_start = state->PC;
+		unsigned long chunk = run_block(state, instruction_count - executed);
+		InterruptController interrupts = interrupt_controller;
+		MemoryMap map = memory_map;
+		int address;
+		int offset;
+
+		memory_space = shadow_memory;
+		cart_ram = ram == NULL ? NULL : shadow_cart_ram;
+		memory_map = shadow_map;
+		interrupt_controller = shadow_interrupts;
+		run_instructions(&shadow_state, chunk);
+		shadow_interrupts = interrupt_controller;
+		interrupt_controller = interrupts;
+		shadow_map = memory_map;
+		memory_map = map;
+		cart_ram = ram;
+		memory_space = memory;
+
+		materialise_flags(&state->F);
+		materialise_flags(&shadow_state.F);
+		if (state->AF != shadow_state.AF || state->BC != shadow_state.BC || state->DE != shadow_state.DE ||
+				state->HL != shadow_state.HL || state->SP != shadow_state.SP || state->PC != shadow_state.PC ||
+				state->cycles != shadow_state.cycles || interrupt_controller.master_enable != shadow_interrupts.master_enable) {
+			lockstep_mismatch(state, block_start, chunk, -1, -1);
+		}
+		if (memcmp(memory, shadow_memory, MEMORY_SPACE_SIZE) != 0) {
+			for (address = 0; memory[address] == shadow_memory[address]; address++);
+			lockstep_mismatch(state, block_start, chunk, address, -1);
+		}
+		if (ram != NULL && memcmp(ram, shadow_cart_ram, cart_ram_size) != 0) {
+			for (offset = 0; ram[offset] == shadow_cart_ram[offset]; offset++);
+			lockstep_mismatch(state, block_start, chunk, -1, offset);
+		}
+
+		executed += chunk;
+	}
+
+	return executed;
+}
+
+/*** INVALIDATION ***/
+
+/**
+ * /brief Throws away every compiled block covering a code page.
+ *
+ * Called by write_byte. The machine code itself stays in the buffer until the next flush.
+ *
+ * @param page: The code page that was written to.
+ */
+static void invalidate_jit_page(unsigned short page) {
+	int i;
+
+	for (i = 0; i < JIT_CACHE_SIZE; i++) {
+		JitBlock *block = &jit_blocks[i];
+		if (block->valid && block->first_page <= page && page <= block->last_page) {
+			block->valid = 0;
+			block->heat = 0;
+			++jit_stats.invalidations;
+		}
+	}
+
+	code_pages[page] = 0;
+}
+
+/*** CODE GENERATION ***/
+
+#ifdef JIT_X86_64
+
+// Host registers, numbered as x86 encodes them
+enum {
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+#define STATE_REGISTER 		RBP
+#define GUEST_A 			R8
+#define GUEST_F 			R9
+#define NO_REGISTER 		-1
+
+// Host register for each register operand, in the order opcodes encode them (B C D E H L (HL) A)
+static const int operand_registers[8] = {R10, R11, R12, R13, R14, R15, NO_REGISTER, GUEST_A};
+
+// Every guest register kept in a host register, with where it lives in CPUState
+static const struct {
+	int host;
+	unsigned char offset;
+} mapped_registers[] = {
+	{GUEST_A, offsetof(CPUState, A)}, {GUEST_F, offsetof(CPUState, F)},
+	{R10, offsetof(CPUState, B)}, {R11, offsetof(CPUState, C)},
+	{R12, offsetof(CPUState, D)}, {R13, offsetof(CPUState, E)},
+	{R14, offsetof(CPUState, H)}, {R15, offsetof(CPUState, L)},
+};
+
+#define MAPPED_REGISTER_COUNT (sizeof(mapped_registers) / sizeof(mapped_registers[0]))
+
+// x86 group 1 opcode extension for each Game Boy ALU operation (ADD ADC SUB SBC AND XOR OR CP)
+static const int alu_extensions[8] = {0, 2, 5, 3, 4, 6, 1, 7};
+
+// LAHF leaves SF ZF 0 AF 0 PF 1 CF in AH. This maps that to the Game Boy's Z, H and C
+static unsigned char lahf_to_flags[256];
+
+static unsigned char *code_buffer = NULL;
+static unsigned char *cursor = NULL;
+static int code_buffer_failed = 0;
+
+static unsigned char *exit_sites[JIT_MAX_EXITS];
+static int exit_count;
+
+static unsigned char *block_body;		// Where the block starts over when it loops
+static unsigned short block_start;
+
+/**
+ * The instruction being compiled, along with what the fallback needs to run it.
+ */
+typedef struct {
+	unsigned char opcode;
+	unsigned short operand;
+	unsigned short next_pc;		/** Address of the following instruction */
+	OpcodeHandler execute;		/** Adapter to fall back on */
+	int executed;				/** Instructions completed once this one is done */
+	unsigned int cycles;		/** Cycles they take, branches not taken */
+	JitBlock *block;
+} JitInstruction;
+
+/**
+ * Jumps to the fallback taken when a memory access can't be done natively.
+ */
+typedef struct {
+	unsigned char *sites[3];
+	int count;
+} SlowPath;
+
+/** EMITTERS **/
+
+static void emit_byte(unsigned char byte) {
+	*cursor++ = byte;
+}
+
+static void emit_u16(unsigned short value) {
+	memcpy(cursor, &value, sizeof(value));
+	cursor += sizeof(value);
+}
+
+static void emit_u32(unsigned int value) {
+	memcpy(cursor, &value, sizeof(value));
+	cursor += sizeof(value);
+}
+
+static void emit_u64(unsigned long value) {
+	memcpy(cursor, &value, sizeof(value));
+	cursor += sizeof(value);
+}
+
+/**
+ * /brief Emits a REX prefix. We always emit one so byte registers are never AH - BH.
+ */
+static void emit_rex(int wide, int reg, int index, int base) {
+	emit_byte(0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3));
+}
+
+static void emit_opcode(unsigned int opcode) {
+	if (opcode > 0xFF) {
+		emit_byte(opcode >> 8);
+	}
+	emit_byte(opcode & 0xFF);
+}
+
+/**
+ * /brief Emits an instruction between two registers (or a register and an opcode extension).
+ */
+static void emit_register_op(unsigned int opcode, int wide, int reg, int rm) {
+	emit_rex(wide, reg, 0, rm);
+	emit_opcode(opcode);
+	emit_byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/**
+ * /brief Emits an instruction between a register and a field of CPUState.
+ */
+static void emit_state_op(unsigned int opcode, int reg, unsigned char offset) {
+	emit_rex(0, reg, 0, STATE_REGISTER);
+	emit_opcode(opcode);
+	emit_byte(0x40 | ((reg & 7) << 3) | (STATE_REGISTER & 7));
+	emit_byte(offset);
+}
+
+/**
+ * /brief Emits an instruction between a register and the byte at [base + index].
+ */
+static void emit_indexed_op(unsigned int opcode, int reg, int base, int index) {
+	emit_rex(0, reg, index, base);
+	emit_opcode(opcode);
+	emit_byte(0x04 | ((reg & 7) << 3));
+	emit_byte(((index & 7) << 3) | (base & 7));
+}
+
+static void emit_move_immediate(int reg, unsigned int value) {
+	emit_rex(0, 0, 0, reg);
+	emit_byte(0xB8 | (reg & 7));
+	emit_u32(value);
+}
+
+static void emit_move_pointer(int reg, const void *pointer) {
+	emit_rex(1, 0, 0, reg);
+	emit_byte(0xB8 | (reg & 7));
+	emit_u64((unsigned long) pointer);
+}
+
+/**
+ * /brief Emits a 32 bit group 1 operation (add, or, and, sub, xor, cmp ...) with an immediate.
+ */
+static void emit_immediate_op(int extension, int reg, unsigned int value) {
+	emit_register_op(0x81, 0, extension, reg);
+	emit_u32(value);
+}
+
+static void emit_shift(int extension, int reg, unsigned char amount) {
+	emit_register_op(0xC1, 0, extension, reg);
+	emit_byte(amount);
+}
+
+/**
+ * /brief Emits a jump with a 32 bit displacement to be filled in later.
+ *
+ * @return Where the displacement goes.
+ */
+static unsigned char* emit_jump(unsigned int opcode) {
+	emit_opcode(opcode);
+	emit_u32(0);
+	return cursor - 4;
+}
+
+static void patch_jump(unsigned char *site, unsigned char *target) {
+	int displacement = target - (site + 4);
+	memcpy(site, &displacement, sizeof(displacement));
+}
+
+/** BUILDING BLOCKS **/
+
+static void emit_spill_registers() {
+	unsigned int i;
+	for (i = 0; i < MAPPED_REGISTER_COUNT; i++) {
+		emit_state_op(0x88, mapped_registers[i].host, mapped_registers[i].offset);
+	}
+}
+
+static void emit_reload_registers() {
+	unsigned int i;
+	for (i = 0; i < MAPPED_REGISTER_COUNT; i++) {
+		emit_state_op(0x0FB6, mapped_registers[i].host, mapped_registers[i].offset);
+	}
+}
+
+static void emit_store_pc(unsigned short address) {
+	emit_byte(0x66);
+	emit_byte(0xC7);
+	emit_byte(0x40 | (STATE_REGISTER & 7));
+	emit_byte(offsetof(CPUState, PC));
+	emit_u16(address);
+}
+
+/**
+ * /brief Leaves the block, reporting how many instructions were executed on this pass.
+ *
+ * The stack holds the remaining budget at [rsp] and the instructions executed on earlier
+ * passes at [rsp + 8]. A jump back to the start of the block goes straight round again
+ * while at least another full pass fits in the budget and no interrupt is pending.
+ *
+ * @param executed: Instructions executed on this pass by the time we leave.
+ * @param cycles: Cycles those instructions took.
+ * @param pc: Where execution continues. -1 if the PC has already been stored.
+ */
+static void emit_exit(int executed, unsigned int cycles, int pc) {
+	unsigned char *skip;
+
+	emit_byte(0x48); emit_byte(0x81); emit_byte(0x40 | (STATE_REGISTER & 7));		// add qword [rbp + cycles], cycles
+	emit_byte(offsetof(CPUState, cycles));
+	emit_u32(cycles);
+
+	if (pc == block_start) {
+		emit_byte(0x48); emit_byte(0x81); emit_byte(0x44); emit_byte(0x24); emit_byte(0x08);	// add [rsp + 8], executed
+		emit_u32(executed);
+		emit_byte(0x48); emit_byte(0x81); emit_byte(0x2C); emit_byte(0x24);		// sub [rsp], executed
+		emit_u32(executed);
+		emit_move_pointer(RAX, &interrupt_controller.pending);
+		emit_byte(0x80);	// cmp byte [rax], 0
+		emit_byte(0x38);
+		emit_byte(0x00);
+		emit_byte(0x75);	// jne over the loop
+		emit_byte(0);
+		skip = cursor;
+		emit_byte(0x48); emit_byte(0x81); emit_byte(0x3C); emit_byte(0x24);		// cmp [rsp], executed
+		emit_u32(executed);
+		patch_jump(emit_jump(0x0F83), block_body);								// jae
+		skip[-1] = cursor - skip;
+		executed = 0;
+	}
+
+	if (pc >= 0) {
+		emit_store_pc(pc);
+	}
+	emit_move_immediate(RAX, executed);
+	exit_sites[exit_count++] = emit_jump(0xE9);
+}
+
+/**
+ * /brief Runs an instruction by calling its adapter.
+ *
+ * The registers are written back beforehand and reloaded afterwards. Should the adapter
+ * write over the block we are in, the block is left straight away.
+ */
+static void emit_interpreter_call(const JitInstruction *instruction) {
+	unsigned char *skip;
+
+	emit_spill_registers();
+	emit_store_pc(instruction->next_pc);
+	emit_register_op(0x89, 1, STATE_REGISTER, RDI);
+	emit_move_immediate(RSI, instruction->operand);
+	emit_move_pointer(RAX, instruction->execute);
+	emit_byte(0xFF);	// call rax
+	emit_byte(0xD0);
+#ifdef LAZY_FLAGS
+	// The adapter may have left F owing an update. F is the first byte of the state
+	emit_register_op(0x89, 1, STATE_REGISTER, RDI);
+	emit_move_pointer(RAX, materialise_flags);
+	emit_byte(0xFF);	// call rax
+	emit_byte(0xD0);
+#endif
+	emit_reload_registers();
+
+	emit_move_pointer(RAX, &instruction->block->valid);
+	emit_byte(0x80);	// cmp byte [rax], 0
+	emit_byte(0x38);
+	emit_byte(0x00);
+	emit_byte(0x75);	// jne over the exit
+	emit_byte(0);
+	skip = cursor;
+	emit_exit(instruction->executed, instruction->cycles, -1);
+	skip[-1] = cursor - skip;
+}
+
+/**
+ * /brief Rebuilds F from the host flags after an 8 bit operation.
+ */
+static void emit_capture_flags(int destination) {
+	emit_byte(0x9F);	// lahf
+	emit_byte(0x0F);	// movzx eax, ah
+	emit_byte(0xB6);
+	emit_byte(0xC4);
+	emit_move_pointer(RDX, lahf_to_flags);
+	emit_indexed_op(0x0FB6, destination, RDX, RAX);
+}
+
+static void emit_pair_to_eax(int high, int low) {
+	emit_register_op(0x89, 0, high, RAX);
+	emit_shift(4, RAX, 8);
+	emit_register_op(0x09, 0, low, RAX);
+}
+
+static void emit_eax_to_pair(int high, int low) {
+	emit_register_op(0x0FB6, 0, low, RAX);
+	emit_shift(5, RAX, 8);
+	emit_register_op(0x0FB6, 0, high, RAX);
+}
+
+/**
+ * /brief Looks the address in eax up in one of memory_map's tables, leaving where its page
+ * lives in rcx and the offset into the page in rdx.
+ */
+static void emit_page_lookup(unsigned char **table) {
+	emit_register_op(0x89, 0, RAX, RCX);
+	emit_shift(5, RCX, MEMORY_PAGE_SHIFT);
+	emit_move_pointer(RDX, table);
+	emit_rex(1, RCX, RCX, RDX);		// mov rcx, [rdx + rcx * 8]
+	emit_byte(0x8B);
+	emit_byte(0x04 | (RCX << 3));
+	emit_byte(0xC0 | (RCX << 3) | RDX);
+	emit_register_op(0x0FB6, 0, RDX, RAX);
+}
+
+/**
+ * /brief Reads the byte at the address in eax into a register. Every page can be read natively.
+ */
+static void emit_read(int destination) {
+	emit_page_lookup(memory_map.read);
+	emit_indexed_op(0x0FB6, destination, RCX, RDX);
+}
+
+/**
+ * /brief Checks the address in eax can be written natively. If so, it goes to [rcx + rdx].
+ */
+static void emit_write_check(SlowPath *slow) {
+	slow->count = 0;
+	emit_page_lookup(memory_map.write);
+	emit_register_op(0x85, 1, RCX, RCX);
+	slow->sites[slow->count++] = emit_jump(0x0F84);		// je
+}
+
+/**
+ * /brief Emits the fallback for a memory access, after the native version.
+ */
+static void emit_slow_path(SlowPath *slow, const JitInstruction *instruction) {
+	unsigned char *done = emit_jump(0xE9);
+	int i;
+
+	for (i = 0; i < slow->count; i++) {
+		patch_jump(slow->sites[i], cursor);
+	}
+	emit_interpreter_call(instruction);
+	patch_jump(done, cursor);
+}
+
+/**
+ * /brief Emits an ALU operation on A. source is a host register, or NO_REGISTER for value.
+ */
+static void emit_alu(int operation, int source, unsigned char value) {
+	int extension = alu_extensions[operation];
+
+	if (operation == 1 || operation == 3) {
+		emit_register_op(0x0FBA, 0, 4, GUEST_F);	// bt r9d, 4 puts the Game Boy's carry in CF
+		emit_byte(CARRY_FLAG_POS);
+	}
+
+	if (source == NO_REGISTER) {
+		emit_register_op(0x80, 0, extension, GUEST_A);
+		emit_byte(value);
+	}
+	else {
+		emit_register_op(extension << 3, 0, source, GUEST_A);
+	}
+
+	emit_capture_flags(GUEST_F);
+	switch (operation) {
+		case 2: case 3: case 7: 	// SUB, SBC, CP
+			emit_immediate_op(1, GUEST_F, 0x40);
+			break;
+		case 4: 					// AND
+			emit_immediate_op(4, GUEST_F, 0x80);
+			emit_immediate_op(1, GUEST_F, 0x20);
+			break;
+		case 5: case 6:				// XOR, OR
+			emit_immediate_op(4, GUEST_F, 0x80);
+			break;
+	}
+}
+
+/**
+ * /brief Emits an 8 bit INC or DEC. The carry flag is left alone.
+ */
+static void emit_increment(int reg, int decrement) {
+	emit_register_op(0xFE, 0, decrement, reg);
+	emit_capture_flags(RCX);
+	emit_immediate_op(4, RCX, 0xA0);
+	emit_immediate_op(4, GUEST_F, 0x10);
+	emit_register_op(0x09, 0, RCX, GUEST_F);
+	if (decrement) {
+		emit_immediate_op(1, GUEST_F, 0x40);
+	}
+}
+
+/**
+ * /brief Emits a conditional jump to target, falling through to next otherwise.
+ */
+static void emit_conditional_exit(const JitInstruction *instruction, unsigned short target) {
+	static const unsigned char masks[4] = {0x80, 0x80, 0x10, 0x10};		// NZ Z NC C
+	int condition = (instruction->opcode >> 3) & 3;
+	unsigned char *not_taken;
+
+	emit_register_op(0xF7, 0, 0, GUEST_F);	// test r9d, mask
+	emit_u32(masks[condition]);
+	not_taken = emit_jump((condition & 1) ? 0x0F84 : 0x0F85);
+	emit_exit(instruction->executed, instruction->cycles + primary_cycles_taken[instruction->opcode], target);
+	patch_jump(not_taken, cursor);
+	emit_exit(instruction->executed, instruction->cycles, instruction->next_pc);
+}
+
+/**
+ * /brief Emits a single instruction.
+ *
+ * @return 1 if the instruction was emitted natively, 0 if it calls its adapter.
+ */
+static int emit_instruction(const JitInstruction *instruction) {
+	unsigned char opcode = instruction->opcode;
+	unsigned short operand = instruction->operand;
+	int destination = operand_registers[(opcode >> 3) & 7];
+	int source = operand_registers[opcode & 7];
+	SlowPath slow;
+
+	// LD r,r' and the (HL) forms
+	if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+		if (destination != NO_REGISTER && source != NO_REGISTER) {
+			emit_register_op(0x89, 0, source, destination);
+		}
+		else if (source == NO_REGISTER) {
+			emit_pair_to_eax(R14, R15);
+			emit_read(destination);
+		}
+		else {
+			emit_pair_to_eax(R14, R15);
+			emit_write_check(&slow);
+			emit_indexed_op(0x88, source, RCX, RDX);
+			emit_slow_path(&slow, instruction);
+		}
+		return 1;
+	}
+
+	// ALU operations on A
+	if (opcode >= 0x80 && opcode < 0xC0) {
+		if (source == NO_REGISTER) {
+			emit_pair_to_eax(R14, R15);
+			emit_read(RCX);
+			emit_alu((opcode >> 3) & 7, RCX, 0);
+		}
+		else {
+			emit_alu((opcode >> 3) & 7, source, 0);
+		}
+		return 1;
+	}
+	if ((opcode & 0xC7) == 0xC6) {
+		emit_alu((opcode >> 3) & 7, NO_REGISTER, operand);
+		return 1;
+	}
+
+	// LD r,n / INC r / DEC r
+	if (opcode < 0x40 && destination != NO_REGISTER) {
+		switch (opcode & 0x07) {
+			case 0x06:
+				emit_move_immediate(destination, operand);
+				return 1;
+			case 0x04:
+			case 0x05:
+				emit_increment(destination, opcode & 1);
+				return 1;
+		}
+	}
+
+	switch (opcode) {
+		case 0x00:	// NOP
+			return 1;
+
+		case 0x36:	// LD (HL),n
+			emit_pair_to_eax(R14, R15);
+			emit_write_check(&slow);
+			emit_indexed_op(0xC6, 0, RCX, RDX);
+			emit_byte(operand);
+			emit_slow_path(&slow, instruction);
+			return 1;
+
+		case 0x01: case 0x11: case 0x21:	// LD rr,nn
+			destination = operand_registers[(opcode >> 3) & 6];
+			emit_move_immediate(destination, operand >> 8);
+			emit_move_immediate(operand_registers[((opcode >> 3) & 6) + 1], operand & 0xFF);
+			return 1;
+
+		case 0x03: case 0x13: case 0x23:	// INC rr
+		case 0x0B: case 0x1B: case 0x2B:	// DEC rr
+			destination = operand_registers[(opcode >> 3) & 6];
+			source = operand_registers[((opcode >> 3) & 6) + 1];
+			emit_pair_to_eax(destination, source);
+			emit_immediate_op((opcode & 0x08) ? 5 : 0, RAX, 1);
+			emit_eax_to_pair(destination, source);
+			return 1;
+
+		case 0x02: case 0x12:	// LD (BC),A / LD (DE),A
+			emit_pair_to_eax(operand_registers[(opcode >> 3) & 6], operand_registers[((opcode >> 3) & 6) + 1]);
+			emit_write_check(&slow);
+			emit_indexed_op(0x88, GUEST_A, RCX, RDX);
+			emit_slow_path(&slow, instruction);
+			return 1;
+
+		case 0x0A: case 0x1A:	// LD A,(BC) / LD A,(DE)
+			emit_pair_to_eax(operand_registers[(opcode >> 3) & 6], operand_registers[((opcode >> 3) & 6) + 1]);
+			emit_read(GUEST_A);
+			return 1;
+
+		case 0x22: case 0x32:	// LD (HL+),A / LD (HL-),A
+			emit_pair_to_eax(R14, R15);
+			emit_write_check(&slow);
+			emit_indexed_op(0x88, GUEST_A, RCX, RDX);
+			emit_immediate_op(opcode == 0x22 ? 0 : 5, RAX, 1);
+			emit_eax_to_pair(R14, R15);
+			emit_slow_path(&slow, instruction);
+			return 1;
+
+		case 0x2A: case 0x3A:	// LD A,(HL+) / LD A,(HL-)
+			emit_pair_to_eax(R14, R15);
+			emit_read(GUEST_A);
+			emit_immediate_op(opcode == 0x2A ? 0 : 5, RAX, 1);
+			emit_eax_to_pair(R14, R15);
+			return 1;
+
+		case 0xEA:	// LD (nn),A
+			emit_move_immediate(RAX, operand);
+			emit_write_check(&slow);
+			emit_indexed_op(0x88, GUEST_A, RCX, RDX);
+			emit_slow_path(&slow, instruction);
+			return 1;
+
+		case 0xFA:	// LD A,(nn)
+			emit_move_immediate(RAX, operand);
+			emit_read(GUEST_A);
+			return 1;
+
+		case 0x18:	// JR n
+			emit_exit(instruction->executed, instruction->cycles, instruction->next_pc + (signed char) operand);
+			return 1;
+
+		case 0x20: case 0x28: case 0x30: case 0x38:	// JR cc,n
+			emit_conditional_exit(instruction, instruction->next_pc + (signed char) operand);
+			return 1;
+
+		case 0xC3:	// JP nn
+			emit_exit(instruction->executed, instruction->cycles, operand);
+			return 1;
+
+		case 0xC2: case 0xCA: case 0xD2: case 0xDA:	// JP cc,nn
+			emit_conditional_exit(instruction, operand);
+			return 1;
+	}
+
+	// Everything else, LDH and friends included, goes through the interpreter
+	emit_interpreter_call(instruction);
+	if (ends_block(opcode)) {
+		emit_exit(instruction->executed, instruction->cycles, -1);
+	}
+	return 0;
+}
+
+/**
+ * /brief Maps in the executable buffer and fills in the flag table, the first time round.
+ *
+ * @return 1 if we're good to compile. 0 if executable memory isn't available.
+ */
+static int prepare_code_buffer() {
+	int i;
+
+	if (code_buffer != NULL) {
+		return 1;
+	}
+	if (code_buffer_failed) {
+		return 0;
+	}
+
+	code_buffer = mmap(NULL, JIT_CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (code_buffer == MAP_FAILED) {
+		perror("Unable to map memory for the JIT. Interpreting instead");
+		code_buffer = NULL;
+		code_buffer_failed = 1;
+		return 0;
+	}
+	cursor = code_buffer;
+
+	for (i = 0; i < 256; i++) {
+		lahf_to_flags[i] = (((i >> 6) & 1) << ZERO_FLAG_POS) | (((i >> 4) & 1) << HALF_CARRY_FLAG_POS) |
+			((i & 1) << CARRY_FLAG_POS);
+	}
+
+	return 1;
+}
+
+/**
+ * /brief Translates a block into machine code.
+ *
+ * The block runs up to the first instruction which ends a block, JIT_MAX_BLOCK_LENGTH
+ * instructions or the edge of a 16KB region, whichever comes first.
+ *
+ * @param block: The block to compile. Its start and bank are filled in.
+ *
+ * @return 1 on success, 0 if the block has to stay interpreted.
+ */
+static int compile_block(JitBlock *block) {
+	unsigned char *entry;
+	unsigned short address = block->start;
+	unsigned short page;
+	JitInstruction instruction;
+
+	if (!prepare_code_buffer()) {
+		return 0;
+	}
+	if (cursor + JIT_MAX_BLOCK_BYTES > code_buffer + JIT_CODE_BUFFER_SIZE) {
+		JitBlock saved = *block;
+		discard_compiled_code();
+		*block = saved;
+		++jit_stats.flushes;
+	}
+
+	entry = cursor;
+	exit_count = 0;
+
+	// Prologue: save the callee saved registers and make room for the budget, keeping
+	// the stack 16 byte aligned
+	emit_byte(0x53);				// push rbx
+	emit_byte(0x55);				// push rbp
+	emit_byte(0x41); emit_byte(0x54);	// push r12
+	emit_byte(0x41); emit_byte(0x55);	// push r13
+	emit_byte(0x41); emit_byte(0x56);	// push r14
+	emit_byte(0x41); emit_byte(0x57);	// push r15
+	emit_byte(0x48); emit_byte(0x83); emit_byte(0xEC); emit_byte(0x18);	// sub rsp, 24
+	emit_byte(0x48); emit_byte(0x89); emit_byte(0x34); emit_byte(0x24);	// mov [rsp], rsi
+	emit_byte(0x48); emit_byte(0xC7); emit_byte(0x44); emit_byte(0x24); emit_byte(0x08);	// mov qword [rsp + 8], 0
+	emit_u32(0);
+	emit_register_op(0x89, 1, RDI, STATE_REGISTER);
+	emit_reload_registers();
+	block_body = cursor;
+	block_start = block->start;
+
+	instruction.block = block;
+	instruction.executed = 0;
+	instruction.cycles = 0;
+	do {
+		const Opcode *entry_opcode;
+
+		instruction.opcode = read_byte(address);
+		entry_opcode = &primary_opcodes[instruction.opcode];
+		if (instruction.opcode == 0xCB) {
+			instruction.operand = read_byte(address + 1);
+			instruction.execute = cb_opcodes[instruction.operand].execute;
+		}
+		else {
+			instruction.operand = fetch_operand(address, entry_opcode->length);
+			instruction.execute = entry_opcode->execute;
+		}
+		instruction.cycles += instruction_cycles(address);
+		address += entry_opcode->length;
+		instruction.next_pc = address;
+		++instruction.executed;
+
+		jit_stats.native_instructions += emit_instruction(&instruction);
+	} while (!ends_block(instruction.opcode) && instruction.executed < JIT_MAX_BLOCK_LENGTH &&
+			((address + 2) & 0xC000) == (block->start & 0xC000) && address > block->start);
+
+	if (!ends_block(instruction.opcode)) {
+		emit_exit(instruction.executed, instruction.cycles, address);
+	}
+
+	// Epilogue: every exit comes through here
+	while (exit_count > 0) {
+		patch_jump(exit_sites[--exit_count], cursor);
+	}
+	emit_byte(0x48); emit_byte(0x03); emit_byte(0x44); emit_byte(0x24); emit_byte(0x08);	// add rax, [rsp + 8]
+	emit_spill_registers();
+	emit_byte(0x48); emit_byte(0x83); emit_byte(0xC4); emit_byte(0x18);	// add rsp, 24
+	emit_byte(0x41); emit_byte(0x5F);	// pop r15
+	emit_byte(0x41); emit_byte(0x5E);	// pop r14
+	emit_byte(0x41); emit_byte(0x5D);	// pop r13
+	emit_byte(0x41); emit_byte(0x5C);	// pop r12
+	emit_byte(0x5D);				// pop rbp
+	emit_byte(0x5B);				// pop rbx
+	emit_byte(0xC3);				// ret
+
+	block->code = (CompiledBlock) entry;
+	block->length = instruction.executed;
+	block->service_point = ends_block(instruction.opcode);
+	block->first_page = block->start >> CODE_PAGE_SHIFT;
+	block->last_page = (unsigned short) (address - 1) >> CODE_PAGE_SHIFT;
+	for (page = block->first_page; page <= block->last_page; page++) {
+		flag_code_page(page);
+	}
+	code_page_written = invalidate_jit_page;
+	block->valid = 1;
+
+	++jit_stats.blocks_compiled;
+	jit_stats.instructions_compiled += block->length;
+	return 1;
+}
+
+/**
+ * /brief Forgets every block and starts the code buffer afresh.
+ */
+static void discard_compiled_code() {
+	memset(jit_blocks, 0, sizeof(jit_blocks));
+	memset(code_pages, 0, sizeof(code_pages));
+	cursor = code_buffer;
+}
+
+#else
+
+static int compile_block(JitBlock *block) {
+	return 0;
+}
+
+static void discard_compiled_code() {
+	memset(jit_blocks, 0, sizeof(jit_blocks));
+}
+
+#endif // JIT_X86_64
+
+/**
+ * /brief Throws away every compiled block and the statistics gathered so far.
+ *
+ * Needed whenever memory is changed behind write_byte's back, e.g. when loading a ROM.
+ */
+void flush_jit() {
+	discard_compiled_code();
+	memset(&jit_stats, 0, sizeof(jit_stats));
+}
+
+/**
+ * /brief Prints how the recompiler has done so far.
+ */
+void print_jit_stats() {
+	JitStats *stats = &jit_stats;
+	unsigned long total = stats->compiled_executed + stats->interpreted_executed;
+
+	printf("JIT:\n");
+	printf("\tBlocks compiled: %lu\n", stats->blocks_compiled);
+	printf("\tAverage block length: %.2f\n",
+		stats->blocks_compiled ? (double) stats->instructions_compiled / stats->blocks_compiled : 0.0);
+	printf("\tNatively compiled instructions: %.2f%%\n",
+		stats->instructions_compiled ? 100.0 * stats->native_instructions / stats->instructions_compiled : 0.0);
+	printf("\tInstructions run compiled: %.4f%%\n", total ? 100.0 * stats->compiled_executed / total : 0.0);
+	printf("\tInvalidations: %lu\n", stats->invalidations);
+	printf("\tCode buffer flushes: %lu\n", stats->flushes);
+}
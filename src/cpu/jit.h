@@ -0,0 +1,40 @@
+/**
+ * A header file for the dynamic recompiler, which turns hot blocks of Game Boy code
+ * into x86-64 machine code.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "register.h"
+
+#define JIT_CACHE_SIZE 			4096			// Number of blocks tracked. Must be a power of two
+#define JIT_MAX_BLOCK_LENGTH 	64				// Most instructions compiled into a single block
+#define JIT_CODE_BUFFER_SIZE 	(4 << 20)		// Bytes of executable memory for compiled blocks
+#define JIT_DEFAULT_THRESHOLD 	16				// Times a block is interpreted before it is compiled
+
+/**
+ * Running totals for tuning the recompiler.
+ */
+typedef struct {
+	unsigned long blocks_compiled;			/** Blocks turned into machine code */
+	unsigned long instructions_compiled;	/** Instructions in all of those blocks */
+	unsigned long native_instructions;		/** Instructions handled natively rather than by calling an adapter */
+	unsigned long compiled_executed;		/** Instructions run from compiled blocks */
+	unsigned long interpreted_executed;		/** Instructions run by the interpreter */
+	unsigned long invalidations;			/** Compiled blocks thrown away because their code was written to */
+	unsigned long flushes;					/** Times the code buffer filled up and everything was thrown away */
+} JitStats;
+
+extern JitStats jit_stats;
+extern unsigned int jit_threshold;		// Tests set this to 0 to compile everything on sight
+
+// See jit.c for more thorough explination of these functions
+void flush_jit();
+unsigned long run_instructions_jit(CPUState *state, unsigned long instruction_count);
+unsigned long run_instructions_jit_lockstep(CPUState *state, unsigned long instruction_count);
+void print_jit_stats();
+
+#endif // JIT_H
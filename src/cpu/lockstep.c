@@ -0,0 +1,243 @@
+/**
+ * This module contains the lockstep harness: it runs any core from cores.c with a second,
+ * the reference, alongside on a copy of the machine, and stops the moment they disagree.
+ *
+ * The machine is more than the CPUState. Memory, the cart's RAM and the map onto them, the
+ * interrupt controller, the ROM bank and the code page flags (along with whoever set them)
+ * are all globals, so the harness keeps a second set for the reference and swaps them in
+ * around each of its runs. Each core keeps any caches of its own, so the two can be any pair
+ * of different cores. The registers of the cart's bank controller are the exception: both
+ * machines make the same writes to them, so they agree again by the end of each step.
+ * The cart's ROM is never written, so both machines share it.
+ *
+ * The core runs a step of up to step instructions, then the reference runs however many
+ * the core actually did. Every register, HALT, IME, the cycle count and every byte of
+ * memory and cart RAM is then compared. A step of 1 checks every instruction; the block based cores
+ * only get to run blocks when given more than that to do.
+ *
+ * Memory is compared outright rather than through a hash of what was written. The JIT and
+ * the aot core store to RAM without going through write_byte, so there is no one place
+ * every write passes, and comparing 64KB is cheap next to the time it takes to find out
+ * which instruction went wrong any other way.
+ *
+ * On a disagreement the last few steps are disassembled, both sets of registers printed
+ * and every differing byte of memory listed.
+ *
+ * run_instructions_jit_lockstep in jit.c is a version of this for the JIT alone, checking
+ * after each block the JIT compiles.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lockstep.h"
+#include "instructions.h"
+#include "interrupts.h"
+#include "disassembler.h"
+#include "../memory/memory.h"
+
+/*
+ * Everything outside the CPUState a core reads or changes.
+ */
+typedef struct {
+	unsigned char *memory;
+	unsigned char *cart_ram;
+	MemoryMap map;
+	InterruptController interrupts;
+	unsigned short rom_bank;
+	unsigned char code_pages[CODE_PAGE_COUNT];
+	void (*code_page_written)(unsigned short page);
+} Machine;
+
+/**
+ * /brief Puts the running machine aside and brings in another.
+ *
+ * @param running: Where to keep the machine being swapped out.
+ * @param next: The machine to swap in.
+ */
+static void swap_machine(Machine *running, const Machine *next) {
+	running->memory = memory_space;
+	running->cart_ram = cart_ram;
+	running->map = memory_map;
+	running->interrupts = interrupt_controller;
+	running->rom_bank = current_rom_bank;
+	memcpy(running->code_pages, code_pages, sizeof(code_pages));
+	running->code_page_written = code_page_written;
+
+	memory_space = next->memory;
+	cart_ram = next->cart_ram;
+	memory_map = next->map;
+	interrupt_controller = next->interrupts;
+	current_rom_bank = next->rom_bank;
+	memcpy(code_pages, next->code_pages, sizeof(code_pages));
+	code_page_written = next->code_page_written;
+}
+
+/**
+ * /brief Checks two CPUs agree on everything a program could see.
+ *
+ * @return 1 if they do. 0 otherwise.
+ */
+static int same_state(CPUState *state, CPUState *reference_state, const Machine *machine, const Machine *reference) {
+	materialise_flags(&state->F);
+	materialise_flags(&reference_state->F);
+
+	return state->AF == reference_state->AF && state->BC == reference_state->BC && state->DE == reference_state->DE &&
+		state->HL == reference_state->HL && state->SP == reference_state->SP && state->PC == reference_state->PC &&
+		state->halted == reference_state->halted && state->cycles == reference_state->cycles &&
+		machine->interrupts.master_enable == reference->interrupts.master_enable;
+}
+
+/**
+ * /brief Reads a byte the way the machine sees it, through its memory map.
+ */
+static unsigned char machine_byte(const Machine *machine, unsigned short address) {
+	return machine->map.read[address >> MEMORY_PAGE_SHIFT][address & MEMORY_PAGE_MASK];
+}
+
+/**
+ * /brief Prints one side's registers as a row of the table in report_divergence.
+ */
+static void print_side(const char *name, const CPUState *state, const Machine *machine) {
+	fprintf(stderr, "\t%-12s %04X %04X %04X %04X %04X %04X %u   %u      %lu\n", name,
+		state->AF, state->BC, state->DE, state->HL, state->SP, state->PC,
+		machine->interrupts.master_enable, state->halted, state->cycles);
+}
+
+/**
+ * /brief Prints where the two cores disagree.
+ *
+ * @param core: The core under test.
+ * @param reference: The core it is checked against.
+ * @param state, machine: The core's side.
+ * @param reference_state, reference_machine: The reference's side.
+ * @param history: Where each of the last LOCKSTEP_HISTORY steps started, by step number.
+ * @param steps: Steps run, up to and including the one that disagreed.
+ * @param executed: Instructions run in those steps.
+ */
+static void report_divergence(const Core *core, const Core *reference, CPUState *state, const Machine *machine,
+		CPUState *reference_state, const Machine *reference_machine, const unsigned short *history,
+		unsigned long steps, unsigned long executed) {
+	char text[DISASSEMBLY_MAX];
+	int i, differences = 0;
+
+	fprintf(stderr, "LOCKSTEP DIVERGENCE: %s and %s disagree after %lu instructions\n", core->name, reference->name, executed);
+
+	fprintf(stderr, "\tSteps leading up to it, the last disagreeing:\n");
+	for (i = steps < LOCKSTEP_HISTORY ? steps : LOCKSTEP_HISTORY; i > 0; i--) {
+		unsigned short address = history[(steps - i) % LOCKSTEP_HISTORY];
+		unsigned char bytes[3] = {machine_byte(reference_machine, address), machine_byte(reference_machine, address + 1),
+			machine_byte(reference_machine, address + 2)};
+
+		disassemble(bytes, address, text, sizeof(text));
+		fprintf(stderr, "\t\t%04X: %s\n", address, text);
+	}
+
+	fprintf(stderr, "\t             AF   BC   DE   HL   SP   PC   IME Halted Cycles\n");
+	print_side(core->name, state, machine);
+	print_side(reference->name, reference_state, reference_machine);
+
+	for (i = 0; i < MEMORY_SPACE_SIZE; i++) {
+		if (machine->memory[i] == reference_machine->memory[i]) {
+			continue;
+		}
+		if (differences++ == 0) {
+			fprintf(stderr, "\tMemory (%s, %s):\n", core->name, reference->name);
+		}
+		if (differences <= LOCKSTEP_DIFFERENCES) {
+			fprintf(stderr, "\t\t%04X: %02X %02X\n", i, machine->memory[i], reference_machine->memory[i]);
+		}
+	}
+	for (i = 0; machine->cart_ram != NULL && i < cart_ram_size; i++) {
+		if (machine->cart_ram[i] == reference_machine->cart_ram[i]) {
+			continue;
+		}
+		if (differences++ == 0) {
+			fprintf(stderr, "\tMemory (%s, %s):\n", core->name, reference->name);
+		}
+		if (differences <= LOCKSTEP_DIFFERENCES) {
+			fprintf(stderr, "\t\tCart RAM %05X: %02X %02X\n", i, machine->cart_ram[i], reference_machine->cart_ram[i]);
+		}
+	}
+	if (differences > LOCKSTEP_DIFFERENCES) {
+		fprintf(stderr, "\t\t... %d bytes differ in all\n", differences);
+	}
+}
+
+/**
+ * /brief Runs a core for a set number of instructions, checking it against another as it goes.
+ *
+ * The reference starts from a copy of the registers, memory and so on as they are on entry.
+ * Stops at the end of the first step after which they disagree.
+ *
+ * @param core: The core under test. Runs on state and the machine as it stands.
+ * @param reference: The core to check it against.
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ * @param step: How many instructions to run between checks.
+ * @param diverged: Set to 1 if the cores disagreed, 0 otherwise.
+ *
+ * @return The number of instructions the core actually executed.
+ */
+unsigned long run_lockstep(const Core *core, const Core *reference, CPUState *state, unsigned long instruction_count,
+		unsigned long step, int *diverged) {
+	Machine machine, reference_machine;
+	CPUState reference_state = *state;
+	unsigned short history[LOCKSTEP_HISTORY];
+	unsigned long executed = 0, steps = 0;
+
+	reference_machine.memory = malloc(MEMORY_SPACE_SIZE);
+	if (reference_machine.memory == NULL) {
+		fprintf(stderr, "ILLEGAL OPERATION: Out of memory for the lockstep reference\n");
+		abort();
+	}
+	memcpy(reference_machine.memory, memory_space, MEMORY_SPACE_SIZE);
+	reference_machine.cart_ram = NULL;
+	if (cart_ram != NULL) {
+		reference_machine.cart_ram = malloc(cart_ram_size);
+		if (reference_machine.cart_ram == NULL) {
+			fprintf(stderr, "ILLEGAL OPERATION: Out of memory for the lockstep reference\n");
+			abort();
+		}
+		memcpy(reference_machine.cart_ram, cart_ram, cart_ram_size);
+	}
+	reference_machine.map = memory_map;
+	rebase_memory_map(&reference_machine.map, memory_space, reference_machine.memory, MEMORY_SPACE_SIZE);
+	rebase_memory_map(&reference_machine.map, cart_ram, reference_machine.cart_ram, cart_ram_size);
+	reference_machine.interrupts = interrupt_controller;
+	reference_machine.rom_bank = current_rom_bank;
+	memset(reference_machine.code_pages, 0, sizeof(reference_machine.code_pages));
+	reference_machine.code_page_written = NULL;
+
+	*diverged = 0;
+	while (executed < instruction_count) {
+		unsigned long chunk = step < instruction_count - executed ? step : instruction_count - executed;
+
+		history[steps++ % LOCKSTEP_HISTORY] = state->PC;
+
+		chunk = core->run(state, chunk);
+		executed += chunk;
+
+		swap_machine(&machine, &reference_machine);
+		reference->run(&reference_state, chunk);
+		swap_machine(&reference_machine, &machine);
+
+		if (!same_state(state, &reference_state, &machine, &reference_machine) ||
+				memcmp(memory_space, reference_machine.memory, MEMORY_SPACE_SIZE) != 0 ||
+				(cart_ram != NULL && memcmp(cart_ram, reference_machine.cart_ram, cart_ram_size) != 0)) {
+			report_divergence(core, reference, state, &machine, &reference_state, &reference_machine, history, steps, executed);
+			*diverged = 1;
+			break;
+		}
+		if (chunk == 0) {
+			break;		// The core can't go any further
+		}
+	}
+
+	free(reference_machine.memory);
+	free(reference_machine.cart_ram);
+	return executed;
+}
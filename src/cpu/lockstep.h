@@ -0,0 +1,20 @@
+/**
+ * A header file for the lockstep harness, which runs one core checked against another.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef LOCKSTEP_H
+#define LOCKSTEP_H
+
+#include "register.h"
+#include "cores.h"
+
+#define LOCKSTEP_HISTORY 		8		// Steps disassembled when the cores disagree
+#define LOCKSTEP_DIFFERENCES 	16		// Differing bytes of memory printed when they disagree
+
+// See lockstep.c for more thorough explination of these functions
+unsigned long run_lockstep(const Core *core, const Core *reference, CPUState *state, unsigned long instruction_count,
+	unsigned long step, int *diverged);
+
+#endif // LOCKSTEP_H
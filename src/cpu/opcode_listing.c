@@ -0,0 +1,77 @@
+/**
+ * Writes out a listing of every opcode from the opcode lists in opcodes.h: its mnemonic,
+ * length, cycles, effect on the flags and the adapter that runs it.
+ *
+ * Run at build time by `make listing`. It takes the place of the lists of opcodes that
+ * used to sit above each function in instructions.c, which were kept by hand and had
+ * drifted. The output goes to stdout.
+ *
+ * Usage: opcode_listing > opcodes.txt
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "opcodes.h"
+
+typedef struct {
+	const char *adapter;
+	unsigned char length;
+	unsigned char cycles;
+	unsigned char taken;
+	const char *flags;
+	const char *mnemonic;
+} ListingEntry;
+
+#define LISTING_ENTRY(code, adapter, length, cycles, taken, flags, mnemonic) \
+	[code] = {#adapter, length, cycles, taken, flags, mnemonic},
+
+static const ListingEntry primary_listing[256] = {
+	PRIMARY_OPCODES(LISTING_ENTRY)
+};
+
+static const ListingEntry cb_listing[256] = {
+	CB_OPCODES(LISTING_ENTRY)
+};
+
+void print_listing(const char *prefix, const ListingEntry *listing);
+
+int main() {
+	printf("Generated by opcode_listing from the opcode lists in opcodes.h. Do not edit!\n\n");
+	printf("%-8s %-16s %-6s %-8s %-6s %s\n", "Opcode", "Mnemonic", "Length", "Cycles", "ZNHC", "Adapter");
+
+	print_listing("", primary_listing);
+	printf("%-8s %-16s %-6u %-8s %-6s %s\n", "CB", "PREFIX CB", 2, "-", "----", "(see below)");
+	print_listing("CB ", cb_listing);
+	return 0;
+}
+
+/**
+ * /brief Prints one line for each opcode in a list.
+ *
+ * Conditional branches show their cycles as not taken/taken.
+ *
+ * @param prefix: Goes before each opcode, "CB " for the prefixed ones.
+ * @param listing: The 256 entries. Gaps (the CB prefix) are skipped.
+ */
+void print_listing(const char *prefix, const ListingEntry *listing) {
+	char opcode[8], cycles[8];
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		const ListingEntry *entry = &listing[i];
+		if (entry->mnemonic == NULL) {
+			continue;
+		}
+
+		snprintf(opcode, sizeof(opcode), "%s%02X", prefix, i);
+		if (entry->taken) {
+			snprintf(cycles, sizeof(cycles), "%u/%u", entry->cycles, entry->cycles + entry->taken);
+		}
+		else {
+			snprintf(cycles, sizeof(cycles), "%u", entry->cycles);
+		}
+		printf("%-8s %-16s %-6u %-8s %-6s %s\n", opcode, entry->mnemonic, entry->length, cycles, entry->flags, entry->adapter);
+	}
+}
@@ -0,0 +1,753 @@
+/**
+ * A header file containing the adapters which tie each Z80-GB opcode to the handler
+ * in instructions.c that implements it, along with the master lists of opcodes.
+ *
+ * The adapters live here (rather than in dispatch.c) so that every core can see their
+ * bodies and inline them. The opcode lists are X-macros: each core supplies a macro
+ * taking (opcode, adapter, length, cycles, taken, flags, mnemonic) and the list expands
+ * it once per opcode. They are the one description of the instruction set: dispatch.c
+ * builds its tables from them, threaded.c and pinned.c their jump labels, cycle_tables.c
+ * the cycle tables, disassembler.c its text and opcode_listing.c the opcode listing.
+ *
+ *	cycles:   Clock cycles taken, 0xCB prefix included. The not taken case for branches.
+ *	taken:    What a conditional branch costs on top of cycles when taken. 0 otherwise.
+ *	flags:    Effect on Z, N, H and C in turn: the flag itself where it depends on the
+ *	          result, '0' or '1' where it is always reset or set and '-' where it is left alone.
+ *	mnemonic: Operands as in Pan Docs: n8 and n16 are immediates, a8 and a16 addresses,
+ *	          e8 a signed offset. disassembler.c fills them in.
+ *
+ * As noted in instructions.c, there is not a 1-to-1 relationship between handler and
+ * opcode. So each opcode gets a tiny adapter which supplies the handler with the
+ * registers and operands that opcode implies (e.g. 0x80 is add_register with B).
+ * By the time an adapter is called the programme counter already points at the next 
+ * instruction.
+ *
+ * A few opcodes have Z80-GB behaviour that the shared handlers don't capture on their
+ * own (e.g. INC/DEC leave the carry alone, RLCA always resets Z). Those adapters patch
+ * up the flags after calling the handler rather than forking the handler.
+ *
+ * HALT and STOP don't return until the CPU is woken: they leave the programme counter on
+ * themselves, so whichever core is running comes straight back to them. Each trip counts
+ * as an instruction. A core which checks state->halted can use sleep_while_halted
+ * (see idle.c) to skip the trips up to the next hardware event instead.
+ *
+ * DI, EI and RETI go through the interrupt controller in interrupts.c, which owns IME.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "../util.h"
+#include "register.h"
+#include "instructions.h"
+#include "dispatch.h"
+#include "cycle_tables.h"
+#include "interrupts.h"
+#include "../memory/memory.h"
+
+/*** ADAPTER GENERATORS ***/
+
+// Most opcodes come in families of 8 which differ only in the register they touch
+// (B, C, D, E, H, L, (HL), A). These macros stamp out an adapter for each member.
+
+// Leaves the carry flag as it was before the handler ran.
+#define PRESERVE_CARRY(state, handler_call) { \
+	Register8 old_carry = carry_flag_set(&(state)->F) != 0; \
+	handler_call; \
+	keep_carry_flag(&(state)->F, old_carry); \
+}
+
+#define LOAD_ADAPTER(destination, source) \
+	static inline void ld_##destination##_##source(CPUState *state, unsigned short operand) { \
+		load_register(&state->destination, &state->source); \
+	}
+
+#define LOAD_ADAPTERS(destination) \
+	LOAD_ADAPTER(destination, B) \
+	LOAD_ADAPTER(destination, C) \
+	LOAD_ADAPTER(destination, D) \
+	LOAD_ADAPTER(destination, E) \
+	LOAD_ADAPTER(destination, H) \
+	LOAD_ADAPTER(destination, L) \
+	LOAD_ADAPTER(destination, A) \
+	static inline void ld_##destination##_HL(CPUState *state, unsigned short operand) { \
+		load_register_indirect_source(&state->destination, &state->HL); \
+	} \
+	static inline void ld_HL_##destination(CPUState *state, unsigned short operand) { \
+		load_register_indirect_destination(&state->HL, &state->destination); \
+	} \
+	static inline void ld_##destination##_n(CPUState *state, unsigned short operand) { \
+		load_immediate_byte(&state->destination, operand); \
+	} \
+	static inline void inc_##destination(CPUState *state, unsigned short operand) { \
+		PRESERVE_CARRY(state, increment_register(&state->destination, &state->F)); \
+	} \
+	static inline void dec_##destination(CPUState *state, unsigned short operand) { \
+		PRESERVE_CARRY(state, decrement_register(&state->destination, &state->F)); \
+	}
+
+#define ALU_ADAPTER(name, handler, source) \
+	static inline void name##_##source(CPUState *state, unsigned short operand) { \
+		handler(&state->A, &state->source, &state->F); \
+	}
+
+#define ALU_ADAPTERS(name, register_handler, immediate_handler, indirect_handler) \
+	ALU_ADAPTER(name, register_handler, B) \
+	ALU_ADAPTER(name, register_handler, C) \
+	ALU_ADAPTER(name, register_handler, D) \
+	ALU_ADAPTER(name, register_handler, E) \
+	ALU_ADAPTER(name, register_handler, H) \
+	ALU_ADAPTER(name, register_handler, L) \
+	ALU_ADAPTER(name, register_handler, A) \
+	static inline void name##_HL(CPUState *state, unsigned short operand) { \
+		indirect_handler(&state->A, &state->HL, &state->F); \
+	} \
+	static inline void name##_n(CPUState *state, unsigned short operand) { \
+		immediate_handler(&state->A, operand, &state->F); \
+	}
+
+#define CB_ADAPTER(name, handler, target) \
+	static inline void name##_##target(CPUState *state, unsigned short operand) { \
+		handler(&state->target, &state->F); \
+	}
+
+#define CB_ADAPTERS(name, register_handler, indirect_handler) \
+	CB_ADAPTER(name, register_handler, B) \
+	CB_ADAPTER(name, register_handler, C) \
+	CB_ADAPTER(name, register_handler, D) \
+	CB_ADAPTER(name, register_handler, E) \
+	CB_ADAPTER(name, register_handler, H) \
+	CB_ADAPTER(name, register_handler, L) \
+	CB_ADAPTER(name, register_handler, A) \
+	static inline void name##_HL(CPUState *state, unsigned short operand) { \
+		indirect_handler(&state->HL, &state->F); \
+	}
+
+#define BIT_ADAPTER(bit, target) \
+	static inline void bit_##bit##_##target(CPUState *state, unsigned short operand) { \
+		test_bit_register(&state->target, bit, &state->F); \
+	} \
+	static inline void res_##bit##_##target(CPUState *state, unsigned short operand) { \
+		reset_bit_register(&state->target, bit); \
+	} \
+	static inline void set_##bit##_##target(CPUState *state, unsigned short operand) { \
+		set_bit_register(&state->target, bit); \
+	}
+
+#define BIT_ADAPTERS(bit) \
+	BIT_ADAPTER(bit, B) \
+	BIT_ADAPTER(bit, C) \
+	BIT_ADAPTER(bit, D) \
+	BIT_ADAPTER(bit, E) \
+	BIT_ADAPTER(bit, H) \
+	BIT_ADAPTER(bit, L) \
+	BIT_ADAPTER(bit, A) \
+	static inline void bit_##bit##_HL(CPUState *state, unsigned short operand) { \
+		test_bit_indirect(&state->HL, bit, &state->F); \
+	} \
+	static inline void res_##bit##_HL(CPUState *state, unsigned short operand) { \
+		reset_bit_indirect(&state->HL, bit); \
+	} \
+	static inline void set_##bit##_HL(CPUState *state, unsigned short operand) { \
+		set_bit_indirect(&state->HL, bit); \
+	}
+
+#define REGISTER_PAIR_ADAPTERS(pair) \
+	static inline void ld_##pair##_nn(CPUState *state, unsigned short operand) { \
+		load_immediate_short(&state->pair, operand); \
+	} \
+	static inline void inc_##pair(CPUState *state, unsigned short operand) { \
+		increment_register_16(&state->pair); \
+	} \
+	static inline void dec_##pair(CPUState *state, unsigned short operand) { \
+		decrement_register_16(&state->pair); \
+	} \
+	static inline void add_HL_##pair(CPUState *state, unsigned short operand) { \
+		indirect_register_add(&state->HL, &state->pair, &state->F); \
+	}
+
+#define STACK_ADAPTERS(pair) \
+	static inline void push_##pair(CPUState *state, unsigned short operand) { \
+		push(&state->SP, &state->pair); \
+	} \
+	static inline void pop_##pair(CPUState *state, unsigned short operand) { \
+		pop(&state->SP, &state->pair); \
+	}
+
+// The jump and call handlers expect addresses as they sit in the instruction stream
+// (they convert with to_little_endian themselves) so we swap the operand back for them.
+// A branch taken costs more than one falling through, which the adapter charges for.
+#define CONDITIONAL_ADAPTERS(condition, jp_opcode, jr_opcode, call_opcode, ret_opcode, \
+		jump_handler, relative_handler, call_handler, return_handler) \
+	static inline void jp_##condition(CPUState *state, unsigned short operand) { \
+		if (jump_handler(&state->PC, to_little_endian(operand), &state->F)) { \
+			state->cycles += primary_cycles_taken[jp_opcode]; \
+		} \
+	} \
+	static inline void jr_##condition(CPUState *state, unsigned short operand) { \
+		if (relative_handler(&state->PC, operand, &state->F)) { \
+			state->cycles += primary_cycles_taken[jr_opcode]; \
+		} \
+	} \
+	static inline void call_##condition(CPUState *state, unsigned short operand) { \
+		if (call_handler(&state->SP, &state->PC, to_little_endian(operand), &state->F)) { \
+			state->cycles += primary_cycles_taken[call_opcode]; \
+		} \
+	} \
+	static inline void ret_##condition(CPUState *state, unsigned short operand) { \
+		if (return_handler(&state->SP, &state->PC, &state->F)) { \
+			state->cycles += primary_cycles_taken[ret_opcode]; \
+		} \
+	}
+
+#define RESTART_ADAPTER(vector) \
+	static inline void rst_##vector(CPUState *state, unsigned short operand) { \
+		restart(&state->SP, &state->PC, 0x##vector); \
+	}
+
+/*** ADAPTERS ***/
+
+LOAD_ADAPTERS(B)
+LOAD_ADAPTERS(C)
+LOAD_ADAPTERS(D)
+LOAD_ADAPTERS(E)
+LOAD_ADAPTERS(H)
+LOAD_ADAPTERS(L)
+LOAD_ADAPTERS(A)
+
+ALU_ADAPTERS(add, add_register, add_immediate, add_indirect)
+ALU_ADAPTERS(adc, add_register_with_carry, add_immediate_with_carry, add_indirect_with_carry)
+ALU_ADAPTERS(sub, subtract_register, subtract_immediate, subtract_indirect)
+ALU_ADAPTERS(sbc, subtract_register_with_carry, subtract_immediate_with_carry, subtract_indirect_with_carry)
+ALU_ADAPTERS(and, bitwise_and_register, bitwise_and_immediate, bitwise_and_indirect)
+ALU_ADAPTERS(xor, bitwise_xor_register, bitwise_xor_immediate, bitwise_xor_indirect)
+ALU_ADAPTERS(or, bitwise_or_register, bitwise_or_immediate, bitwise_or_indirect)
+ALU_ADAPTERS(cp, compare_register, compare_immediate, compare_indirect)
+
+CB_ADAPTERS(rlc, rotate_register_left_carry_archive, rotate_indirect_left_carry_archive)
+CB_ADAPTERS(rrc, rotate_register_right_carry_archive, rotate_indirect_right_carry_archive)
+CB_ADAPTERS(rl, rotate_register_left_through_carry, rotate_indirect_left_through_carry)
+CB_ADAPTERS(rr, rotate_register_right_through_carry, rotate_indirect_right_through_carry)
+CB_ADAPTERS(sla, shift_register_left, shift_indirect_left)
+CB_ADAPTERS(sra, arithmetic_shift_register_right, arithmetic_shift_indirect_right)
+CB_ADAPTERS(swap, swap_nibble_register, swap_nibble_indirect)
+CB_ADAPTERS(srl, logical_shift_register_right, logical_shift_indirect_right)
+
+BIT_ADAPTERS(0)
+BIT_ADAPTERS(1)
+BIT_ADAPTERS(2)
+BIT_ADAPTERS(3)
+BIT_ADAPTERS(4)
+BIT_ADAPTERS(5)
+BIT_ADAPTERS(6)
+BIT_ADAPTERS(7)
+
+REGISTER_PAIR_ADAPTERS(BC)
+REGISTER_PAIR_ADAPTERS(DE)
+REGISTER_PAIR_ADAPTERS(HL)
+REGISTER_PAIR_ADAPTERS(SP)
+
+STACK_ADAPTERS(BC)
+STACK_ADAPTERS(DE)
+STACK_ADAPTERS(HL)
+
+CONDITIONAL_ADAPTERS(NZ, 0xC2, 0x20, 0xC4, 0xC0, jump_zero_reset, jump_relative_zero_reset, call_zero_reset, return_zero_reset)
+CONDITIONAL_ADAPTERS(Z, 0xCA, 0x28, 0xCC, 0xC8, jump_zero_set, jump_relative_zero_set, call_zero_set, return_zero_set)
+CONDITIONAL_ADAPTERS(NC, 0xD2, 0x30, 0xD4, 0xD0, jump_carry_reset, jump_relative_carry_reset, call_carry_reset, return_carry_reset)
+CONDITIONAL_ADAPTERS(C, 0xDA, 0x38, 0xDC, 0xD8, jump_carry_set, jump_relative_carry_set, call_carry_set, return_carry_set)
+
+RESTART_ADAPTER(00)
+RESTART_ADAPTER(08)
+RESTART_ADAPTER(10)
+RESTART_ADAPTER(18)
+RESTART_ADAPTER(20)
+RESTART_ADAPTER(28)
+RESTART_ADAPTER(30)
+RESTART_ADAPTER(38)
+
+// The odds and ends that don't come in families.
+
+static inline void nop(CPUState *state, unsigned short operand) {
+	// Riveting stuff.
+}
+
+/*
+ * HALT sleeps until an interrupt is requested and enabled, whether or not IME lets it be
+ * serviced. Should one already be waiting with IME clear the CPU doesn't halt, but it does
+ * fail to move the programme counter past the next opcode: that byte is read twice (the
+ * HALT bug). We run the instruction that comes of that here, as part of the HALT. An EI
+ * yet to take effect counts as IME set.
+ */
+static inline void halt(CPUState *state, unsigned short operand) {
+	if (!interrupt_requested()) {
+		state->halted = 1;
+		state->PC -= 1;		// Stay on the HALT
+	}
+	else if (state->halted) {
+		state->halted = 0;
+	}
+	else if (!interrupt_controller.master_enable && !interrupt_controller.enable_delay) {
+		unsigned char opcode = read_byte(state->PC);
+		const Opcode *bugged = &primary_opcodes[opcode];
+		unsigned short bugged_operand = fetch_operand(state->PC - 1, bugged->length);
+		state->cycles += opcode == 0xCB ? cb_cycles[opcode] : primary_cycles[opcode];		// 0xCB is its own CB opcode
+		state->PC += bugged->length - 1;
+		bugged->execute(state, bugged_operand);
+	}
+}
+
+/*
+ * STOP sleeps until a button is pressed. Without a joypad, a requested joypad interrupt
+ * stands in for the press. IE doesn't come into it.
+ */
+static inline void stop(CPUState *state, unsigned short operand) {
+	if (read_byte(INTERRUPT_FLAG_ADDRESS) & INTERRUPT_JOYPAD) {
+		state->halted = 0;
+	}
+	else {
+		state->halted = 1;
+		state->PC -= 2;		// Stay on the STOP
+	}
+}
+
+static inline void di(CPUState *state, unsigned short operand) {
+	disable_interrupts();
+}
+
+static inline void ei(CPUState *state, unsigned short operand) {
+	enable_interrupts_delayed();
+}
+
+static inline void illegal_opcode(CPUState *state, unsigned short operand) {
+	// The real hardware locks up on these. We'd rather know about it.
+	fprintf(stderr, "ILLEGAL OPERATION: Illegal opcode %X at %X\n", read_byte(state->PC - 1), state->PC - 1);
+	abort();
+}
+
+static inline void ld_HL_n(CPUState *state, unsigned short operand) {
+	Register8 value = operand;
+	load_register_indirect_destination(&state->HL, &value);
+}
+
+static inline void inc_HL_indirect(CPUState *state, unsigned short operand) {
+	PRESERVE_CARRY(state, increment_register_indirect(&state->HL, &state->F));
+}
+
+static inline void dec_HL_indirect(CPUState *state, unsigned short operand) {
+	PRESERVE_CARRY(state, decrement_register_indirect(&state->HL, &state->F));
+}
+
+static inline void ld_BC_A(CPUState *state, unsigned short operand) {
+	load_register_indirect_destination(&state->BC, &state->A);
+}
+
+static inline void ld_DE_A(CPUState *state, unsigned short operand) {
+	load_register_indirect_destination(&state->DE, &state->A);
+}
+
+static inline void ld_A_BC(CPUState *state, unsigned short operand) {
+	load_register_indirect_source(&state->A, &state->BC);
+}
+
+static inline void ld_A_DE(CPUState *state, unsigned short operand) {
+	load_register_indirect_source(&state->A, &state->DE);
+}
+
+static inline void ldi_HL_A(CPUState *state, unsigned short operand) {
+	write_accumulator_increment_address_register(&state->HL, &state->A);
+}
+
+static inline void ldd_HL_A(CPUState *state, unsigned short operand) {
+	write_accumulator_decrement_address_register(&state->HL, &state->A);
+}
+
+static inline void ldi_A_HL(CPUState *state, unsigned short operand) {
+	load_accumulator_increment_address_register(&state->A, &state->HL);
+}
+
+static inline void ldd_A_HL(CPUState *state, unsigned short operand) {
+	load_accumulator_decrement_address_register(&state->A, &state->HL);
+}
+
+static inline void ld_nn_A(CPUState *state, unsigned short operand) {
+	write_accumulator_to_address(operand, &state->A);
+}
+
+static inline void ld_A_nn(CPUState *state, unsigned short operand) {
+	load_accumulator_from_address(&state->A, operand);
+}
+
+static inline void ldh_n_A(CPUState *state, unsigned short operand) {
+	write_to_io_port_n(operand, &state->A);
+}
+
+static inline void ldh_A_n(CPUState *state, unsigned short operand) {
+	load_from_io_port_n(&state->A, operand);
+}
+
+static inline void ld_C_indirect_A(CPUState *state, unsigned short operand) {
+	write_to_io_port_c(&state->C, &state->A);
+}
+
+static inline void ld_A_C_indirect(CPUState *state, unsigned short operand) {
+	load_from_io_port_c(&state->A, &state->C);
+}
+
+static inline void ld_nn_SP(CPUState *state, unsigned short operand) {
+	write_stack_pointer_to_address(&state->SP, operand);
+}
+
+static inline void ld_SP_HL(CPUState *state, unsigned short operand) {
+	load_stack_pointer(&state->SP, &state->HL);
+}
+
+static inline void add_SP_n(CPUState *state, unsigned short operand) {
+	load_stack_pointer_offset(&state->SP, (signed char) operand, &state->F);
+}
+
+static inline void ld_HL_SP_n(CPUState *state, unsigned short operand) {
+	// Same arithmetic as ADD SP, n but the result lands in HL.
+	Register16 stack_pointer = state->SP;
+	load_stack_pointer_offset(&stack_pointer, (signed char) operand, &state->F);
+	state->HL = stack_pointer;
+}
+
+// Unlike their CB counterparts, the accumulator rotates always reset Z.
+static inline void rlca(CPUState *state, unsigned short operand) {
+	rotate_register_left_carry_archive(&state->A, &state->F);
+	state->F &= ~0x80;
+}
+
+static inline void rrca(CPUState *state, unsigned short operand) {
+	rotate_register_right_carry_archive(&state->A, &state->F);
+	state->F &= ~0x80;
+}
+
+static inline void rla(CPUState *state, unsigned short operand) {
+	rotate_register_left_through_carry(&state->A, &state->F);
+	state->F &= ~0x80;
+}
+
+static inline void rra(CPUState *state, unsigned short operand) {
+	rotate_register_right_through_carry(&state->A, &state->F);
+	state->F &= ~0x80;
+}
+
+static inline void daa(CPUState *state, unsigned short operand) {
+	decimal_adjust_accumulator(&state->A, &state->F);
+}
+
+static inline void cpl(CPUState *state, unsigned short operand) {
+	complement_accumulator(&state->A, &state->F);
+}
+
+static inline void scf(CPUState *state, unsigned short operand) {
+	set_carry_flag(&state->F);
+}
+
+static inline void ccf(CPUState *state, unsigned short operand) {
+	complement_carry_flag(&state->F);
+}
+
+static inline void jr(CPUState *state, unsigned short operand) {
+	jump_relative_pos(&state->PC, operand);
+}
+
+static inline void jp(CPUState *state, unsigned short operand) {
+	jump_unconditional(&state->PC, to_little_endian(operand));
+}
+
+static inline void jp_HL(CPUState *state, unsigned short operand) {
+	jump_indirect(&state->PC, &state->HL);
+}
+
+static inline void call_nn(CPUState *state, unsigned short operand) {
+	call(&state->SP, &state->PC, to_little_endian(operand));
+}
+
+static inline void ret(CPUState *state, unsigned short operand) {
+	return_unconditional(&state->SP, &state->PC);
+}
+
+static inline void reti(CPUState *state, unsigned short operand) {
+	return_unconditional(&state->SP, &state->PC);
+	enable_interrupts();
+}
+
+// F has to be up to date before it goes on the stack
+static inline void push_AF(CPUState *state, unsigned short operand) {
+	materialise_flags(&state->F);
+	push(&state->SP, &state->AF);
+}
+
+static inline void pop_AF_masked(CPUState *state, unsigned short operand) {
+	discard_pending_flags(&state->F);
+	pop(&state->SP, &state->AF);
+	state->F &= 0xF0;		// The lower nibble of F doesn't exist in hardware
+}
+
+/*** OPCODE LISTS ***/
+
+// Rows of 8 opcodes in B, C, D, E, H, L, (HL), A order. REGISTER_ROW_0 covers 
+// opcodes 0xN0 to 0xN7 while REGISTER_ROW_8 covers 0xN8 to 0xNF. The (HL) forms go to
+// memory, hence their cycle count of their own.
+#define REGISTER_ROW_0(X, high, prefix, mnemonic, length, cycles, hl_cycles, flags) \
+	X(0x##high##0, prefix##_B, length, cycles, 0, flags, mnemonic "B") \
+	X(0x##high##1, prefix##_C, length, cycles, 0, flags, mnemonic "C") \
+	X(0x##high##2, prefix##_D, length, cycles, 0, flags, mnemonic "D") \
+	X(0x##high##3, prefix##_E, length, cycles, 0, flags, mnemonic "E") \
+	X(0x##high##4, prefix##_H, length, cycles, 0, flags, mnemonic "H") \
+	X(0x##high##5, prefix##_L, length, cycles, 0, flags, mnemonic "L") \
+	X(0x##high##6, prefix##_HL, length, hl_cycles, 0, flags, mnemonic "(HL)") \
+	X(0x##high##7, prefix##_A, length, cycles, 0, flags, mnemonic "A")
+
+#define REGISTER_ROW_8(X, high, prefix, mnemonic, length, cycles, hl_cycles, flags) \
+	X(0x##high##8, prefix##_B, length, cycles, 0, flags, mnemonic "B") \
+	X(0x##high##9, prefix##_C, length, cycles, 0, flags, mnemonic "C") \
+	X(0x##high##A, prefix##_D, length, cycles, 0, flags, mnemonic "D") \
+	X(0x##high##B, prefix##_E, length, cycles, 0, flags, mnemonic "E") \
+	X(0x##high##C, prefix##_H, length, cycles, 0, flags, mnemonic "H") \
+	X(0x##high##D, prefix##_L, length, cycles, 0, flags, mnemonic "L") \
+	X(0x##high##E, prefix##_HL, length, hl_cycles, 0, flags, mnemonic "(HL)") \
+	X(0x##high##F, prefix##_A, length, cycles, 0, flags, mnemonic "A")
+
+// Every primary opcode except the 0xCB prefix, which each core handles itself.
+#define PRIMARY_OPCODES(X) \
+	X(0x00, nop, 1, 4, 0, "----", "NOP") \
+	X(0x01, ld_BC_nn, 3, 12, 0, "----", "LD BC,n16") \
+	X(0x02, ld_BC_A, 1, 8, 0, "----", "LD (BC),A") \
+	X(0x03, inc_BC, 1, 8, 0, "----", "INC BC") \
+	X(0x04, inc_B, 1, 4, 0, "Z0H-", "INC B") \
+	X(0x05, dec_B, 1, 4, 0, "Z1H-", "DEC B") \
+	X(0x06, ld_B_n, 2, 8, 0, "----", "LD B,n8") \
+	X(0x07, rlca, 1, 4, 0, "000C", "RLCA") \
+	X(0x08, ld_nn_SP, 3, 20, 0, "----", "LD (a16),SP") \
+	X(0x09, add_HL_BC, 1, 8, 0, "-0HC", "ADD HL,BC") \
+	X(0x0A, ld_A_BC, 1, 8, 0, "----", "LD A,(BC)") \
+	X(0x0B, dec_BC, 1, 8, 0, "----", "DEC BC") \
+	X(0x0C, inc_C, 1, 4, 0, "Z0H-", "INC C") \
+	X(0x0D, dec_C, 1, 4, 0, "Z1H-", "DEC C") \
+	X(0x0E, ld_C_n, 2, 8, 0, "----", "LD C,n8") \
+	X(0x0F, rrca, 1, 4, 0, "000C", "RRCA") \
+	\
+	X(0x10, stop, 2, 4, 0, "----", "STOP") \
+	X(0x11, ld_DE_nn, 3, 12, 0, "----", "LD DE,n16") \
+	X(0x12, ld_DE_A, 1, 8, 0, "----", "LD (DE),A") \
+	X(0x13, inc_DE, 1, 8, 0, "----", "INC DE") \
+	X(0x14, inc_D, 1, 4, 0, "Z0H-", "INC D") \
+	X(0x15, dec_D, 1, 4, 0, "Z1H-", "DEC D") \
+	X(0x16, ld_D_n, 2, 8, 0, "----", "LD D,n8") \
+	X(0x17, rla, 1, 4, 0, "000C", "RLA") \
+	X(0x18, jr, 2, 12, 0, "----", "JR e8") \
+	X(0x19, add_HL_DE, 1, 8, 0, "-0HC", "ADD HL,DE") \
+	X(0x1A, ld_A_DE, 1, 8, 0, "----", "LD A,(DE)") \
+	X(0x1B, dec_DE, 1, 8, 0, "----", "DEC DE") \
+	X(0x1C, inc_E, 1, 4, 0, "Z0H-", "INC E") \
+	X(0x1D, dec_E, 1, 4, 0, "Z1H-", "DEC E") \
+	X(0x1E, ld_E_n, 2, 8, 0, "----", "LD E,n8") \
+	X(0x1F, rra, 1, 4, 0, "000C", "RRA") \
+	\
+	X(0x20, jr_NZ, 2, 8, 4, "----", "JR NZ,e8") \
+	X(0x21, ld_HL_nn, 3, 12, 0, "----", "LD HL,n16") \
+	X(0x22, ldi_HL_A, 1, 8, 0, "----", "LD (HL+),A") \
+	X(0x23, inc_HL, 1, 8, 0, "----", "INC HL") \
+	X(0x24, inc_H, 1, 4, 0, "Z0H-", "INC H") \
+	X(0x25, dec_H, 1, 4, 0, "Z1H-", "DEC H") \
+	X(0x26, ld_H_n, 2, 8, 0, "----", "LD H,n8") \
+	X(0x27, daa, 1, 4, 0, "Z-0C", "DAA") \
+	X(0x28, jr_Z, 2, 8, 4, "----", "JR Z,e8") \
+	X(0x29, add_HL_HL, 1, 8, 0, "-0HC", "ADD HL,HL") \
+	X(0x2A, ldi_A_HL, 1, 8, 0, "----", "LD A,(HL+)") \
+	X(0x2B, dec_HL, 1, 8, 0, "----", "DEC HL") \
+	X(0x2C, inc_L, 1, 4, 0, "Z0H-", "INC L") \
+	X(0x2D, dec_L, 1, 4, 0, "Z1H-", "DEC L") \
+	X(0x2E, ld_L_n, 2, 8, 0, "----", "LD L,n8") \
+	X(0x2F, cpl, 1, 4, 0, "-11-", "CPL") \
+	\
+	X(0x30, jr_NC, 2, 8, 4, "----", "JR NC,e8") \
+	X(0x31, ld_SP_nn, 3, 12, 0, "----", "LD SP,n16") \
+	X(0x32, ldd_HL_A, 1, 8, 0, "----", "LD (HL-),A") \
+	X(0x33, inc_SP, 1, 8, 0, "----", "INC SP") \
+	X(0x34, inc_HL_indirect, 1, 12, 0, "Z0H-", "INC (HL)") \
+	X(0x35, dec_HL_indirect, 1, 12, 0, "Z1H-", "DEC (HL)") \
+	X(0x36, ld_HL_n, 2, 12, 0, "----", "LD (HL),n8") \
+	X(0x37, scf, 1, 4, 0, "-001", "SCF") \
+	X(0x38, jr_C, 2, 8, 4, "----", "JR C,e8") \
+	X(0x39, add_HL_SP, 1, 8, 0, "-0HC", "ADD HL,SP") \
+	X(0x3A, ldd_A_HL, 1, 8, 0, "----", "LD A,(HL-)") \
+	X(0x3B, dec_SP, 1, 8, 0, "----", "DEC SP") \
+	X(0x3C, inc_A, 1, 4, 0, "Z0H-", "INC A") \
+	X(0x3D, dec_A, 1, 4, 0, "Z1H-", "DEC A") \
+	X(0x3E, ld_A_n, 2, 8, 0, "----", "LD A,n8") \
+	X(0x3F, ccf, 1, 4, 0, "-00C", "CCF") \
+	\
+	REGISTER_ROW_0(X, 4, ld_B, "LD B,", 1, 4, 8, "----") \
+	REGISTER_ROW_8(X, 4, ld_C, "LD C,", 1, 4, 8, "----") \
+	REGISTER_ROW_0(X, 5, ld_D, "LD D,", 1, 4, 8, "----") \
+	REGISTER_ROW_8(X, 5, ld_E, "LD E,", 1, 4, 8, "----") \
+	REGISTER_ROW_0(X, 6, ld_H, "LD H,", 1, 4, 8, "----") \
+	REGISTER_ROW_8(X, 6, ld_L, "LD L,", 1, 4, 8, "----") \
+	X(0x70, ld_HL_B, 1, 8, 0, "----", "LD (HL),B") \
+	X(0x71, ld_HL_C, 1, 8, 0, "----", "LD (HL),C") \
+	X(0x72, ld_HL_D, 1, 8, 0, "----", "LD (HL),D") \
+	X(0x73, ld_HL_E, 1, 8, 0, "----", "LD (HL),E") \
+	X(0x74, ld_HL_H, 1, 8, 0, "----", "LD (HL),H") \
+	X(0x75, ld_HL_L, 1, 8, 0, "----", "LD (HL),L") \
+	X(0x76, halt, 1, 4, 0, "----", "HALT") \
+	X(0x77, ld_HL_A, 1, 8, 0, "----", "LD (HL),A") \
+	REGISTER_ROW_8(X, 7, ld_A, "LD A,", 1, 4, 8, "----") \
+	\
+	REGISTER_ROW_0(X, 8, add, "ADD A,", 1, 4, 8, "Z0HC") \
+	REGISTER_ROW_8(X, 8, adc, "ADC A,", 1, 4, 8, "Z0HC") \
+	REGISTER_ROW_0(X, 9, sub, "SUB ", 1, 4, 8, "Z1HC") \
+	REGISTER_ROW_8(X, 9, sbc, "SBC A,", 1, 4, 8, "Z1HC") \
+	REGISTER_ROW_0(X, A, and, "AND ", 1, 4, 8, "Z010") \
+	REGISTER_ROW_8(X, A, xor, "XOR ", 1, 4, 8, "Z000") \
+	REGISTER_ROW_0(X, B, or, "OR ", 1, 4, 8, "Z000") \
+	REGISTER_ROW_8(X, B, cp, "CP ", 1, 4, 8, "Z1HC") \
+	\
+	X(0xC0, ret_NZ, 1, 8, 12, "----", "RET NZ") \
+	X(0xC1, pop_BC, 1, 12, 0, "----", "POP BC") \
+	X(0xC2, jp_NZ, 3, 12, 4, "----", "JP NZ,a16") \
+	X(0xC3, jp, 3, 16, 0, "----", "JP a16") \
+	X(0xC4, call_NZ, 3, 12, 12, "----", "CALL NZ,a16") \
+	X(0xC5, push_BC, 1, 16, 0, "----", "PUSH BC") \
+	X(0xC6, add_n, 2, 8, 0, "Z0HC", "ADD A,n8") \
+	X(0xC7, rst_00, 1, 16, 0, "----", "RST 00") \
+	X(0xC8, ret_Z, 1, 8, 12, "----", "RET Z") \
+	X(0xC9, ret, 1, 16, 0, "----", "RET") \
+	X(0xCA, jp_Z, 3, 12, 4, "----", "JP Z,a16") \
+	X(0xCC, call_Z, 3, 12, 12, "----", "CALL Z,a16") \
+	X(0xCD, call_nn, 3, 24, 0, "----", "CALL a16") \
+	X(0xCE, adc_n, 2, 8, 0, "Z0HC", "ADC A,n8") \
+	X(0xCF, rst_08, 1, 16, 0, "----", "RST 08") \
+	\
+	X(0xD0, ret_NC, 1, 8, 12, "----", "RET NC") \
+	X(0xD1, pop_DE, 1, 12, 0, "----", "POP DE") \
+	X(0xD2, jp_NC, 3, 12, 4, "----", "JP NC,a16") \
+	X(0xD3, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xD4, call_NC, 3, 12, 12, "----", "CALL NC,a16") \
+	X(0xD5, push_DE, 1, 16, 0, "----", "PUSH DE") \
+	X(0xD6, sub_n, 2, 8, 0, "Z1HC", "SUB n8") \
+	X(0xD7, rst_10, 1, 16, 0, "----", "RST 10") \
+	X(0xD8, ret_C, 1, 8, 12, "----", "RET C") \
+	X(0xD9, reti, 1, 16, 0, "----", "RETI") \
+	X(0xDA, jp_C, 3, 12, 4, "----", "JP C,a16") \
+	X(0xDB, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xDC, call_C, 3, 12, 12, "----", "CALL C,a16") \
+	X(0xDD, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xDE, sbc_n, 2, 8, 0, "Z1HC", "SBC A,n8") \
+	X(0xDF, rst_18, 1, 16, 0, "----", "RST 18") \
+	\
+	X(0xE0, ldh_n_A, 2, 12, 0, "----", "LDH (a8),A") \
+	X(0xE1, pop_HL, 1, 12, 0, "----", "POP HL") \
+	X(0xE2, ld_C_indirect_A, 1, 8, 0, "----", "LD (C),A") \
+	X(0xE3, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xE4, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xE5, push_HL, 1, 16, 0, "----", "PUSH HL") \
+	X(0xE6, and_n, 2, 8, 0, "Z010", "AND n8") \
+	X(0xE7, rst_20, 1, 16, 0, "----", "RST 20") \
+	X(0xE8, add_SP_n, 2, 16, 0, "00HC", "ADD SP,e8") \
+	X(0xE9, jp_HL, 1, 4, 0, "----", "JP (HL)") \
+	X(0xEA, ld_nn_A, 3, 16, 0, "----", "LD (a16),A") \
+	X(0xEB, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xEC, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xED, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xEE, xor_n, 2, 8, 0, "Z000", "XOR n8") \
+	X(0xEF, rst_28, 1, 16, 0, "----", "RST 28") \
+	\
+	X(0xF0, ldh_A_n, 2, 12, 0, "----", "LDH A,(a8)") \
+	X(0xF1, pop_AF_masked, 1, 12, 0, "ZNHC", "POP AF") \
+	X(0xF2, ld_A_C_indirect, 1, 8, 0, "----", "LD A,(C)") \
+	X(0xF3, di, 1, 4, 0, "----", "DI") \
+	X(0xF4, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xF5, push_AF, 1, 16, 0, "----", "PUSH AF") \
+	X(0xF6, or_n, 2, 8, 0, "Z000", "OR n8") \
+	X(0xF7, rst_30, 1, 16, 0, "----", "RST 30") \
+	X(0xF8, ld_HL_SP_n, 2, 12, 0, "00HC", "LD HL,SP+e8") \
+	X(0xF9, ld_SP_HL, 1, 8, 0, "----", "LD SP,HL") \
+	X(0xFA, ld_A_nn, 3, 16, 0, "----", "LD A,(a16)") \
+	X(0xFB, ei, 1, 4, 0, "----", "EI") \
+	X(0xFC, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xFD, illegal_opcode, 1, 4, 0, "----", "ILLEGAL") \
+	X(0xFE, cp_n, 2, 8, 0, "Z1HC", "CP n8") \
+	X(0xFF, rst_38, 1, 16, 0, "----", "RST 38")
+
+// Every CB opcode is two bytes long: the prefix and the opcode itself.
+#define CB_OPCODES(X) \
+	REGISTER_ROW_0(X, 0, rlc, "RLC ", 2, 8, 16, "Z00C") \
+	REGISTER_ROW_8(X, 0, rrc, "RRC ", 2, 8, 16, "Z00C") \
+	REGISTER_ROW_0(X, 1, rl, "RL ", 2, 8, 16, "Z00C") \
+	REGISTER_ROW_8(X, 1, rr, "RR ", 2, 8, 16, "Z00C") \
+	REGISTER_ROW_0(X, 2, sla, "SLA ", 2, 8, 16, "Z00C") \
+	REGISTER_ROW_8(X, 2, sra, "SRA ", 2, 8, 16, "Z00C") \
+	REGISTER_ROW_0(X, 3, swap, "SWAP ", 2, 8, 16, "Z000") \
+	REGISTER_ROW_8(X, 3, srl, "SRL ", 2, 8, 16, "Z00C") \
+	\
+	REGISTER_ROW_0(X, 4, bit_0, "BIT 0,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_8(X, 4, bit_1, "BIT 1,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_0(X, 5, bit_2, "BIT 2,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_8(X, 5, bit_3, "BIT 3,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_0(X, 6, bit_4, "BIT 4,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_8(X, 6, bit_5, "BIT 5,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_0(X, 7, bit_6, "BIT 6,", 2, 8, 12, "Z01-") \
+	REGISTER_ROW_8(X, 7, bit_7, "BIT 7,", 2, 8, 12, "Z01-") \
+	\
+	REGISTER_ROW_0(X, 8, res_0, "RES 0,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, 8, res_1, "RES 1,", 2, 8, 16, "----") \
+	REGISTER_ROW_0(X, 9, res_2, "RES 2,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, 9, res_3, "RES 3,", 2, 8, 16, "----") \
+	REGISTER_ROW_0(X, A, res_4, "RES 4,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, A, res_5, "RES 5,", 2, 8, 16, "----") \
+	REGISTER_ROW_0(X, B, res_6, "RES 6,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, B, res_7, "RES 7,", 2, 8, 16, "----") \
+	\
+	REGISTER_ROW_0(X, C, set_0, "SET 0,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, C, set_1, "SET 1,", 2, 8, 16, "----") \
+	REGISTER_ROW_0(X, D, set_2, "SET 2,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, D, set_3, "SET 3,", 2, 8, 16, "----") \
+	REGISTER_ROW_0(X, E, set_4, "SET 4,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, E, set_5, "SET 5,", 2, 8, 16, "----") \
+	REGISTER_ROW_0(X, F, set_6, "SET 6,", 2, 8, 16, "----") \
+	REGISTER_ROW_8(X, F, set_7, "SET 7,", 2, 8, 16, "----")
+
+/*** STORES ***/
+
+/**
+ * /brief Whether an opcode may store to memory anywhere a cart could hear it.
+ *
+ * A store to the cart's ROM or RAM area goes to its bank controller, and the MBC3's clock
+ * reads the cycle count when it's latched or set. Cores keeping their cycles in a local
+ * write them back before these. LDH and LD (C),A only reach the I/O ports and HRAM, so they
+ * aren't counted. Every test folds away where the opcode is a constant.
+ */
+static inline int may_store(unsigned char opcode) {
+	switch (opcode) {
+		case 0x02: case 0x12: case 0x22: case 0x32: 			// LD (BC),A, LD (DE),A, LD (HL+),A, LD (HL-),A
+		case 0x08: case 0xEA: 									// LD (a16),SP, LD (a16),A
+		case 0x34: case 0x35: case 0x36: 						// INC (HL), DEC (HL), LD (HL),n8
+		case 0x70: case 0x71: case 0x72: case 0x73: 			// LD (HL),r
+		case 0x74: case 0x75: case 0x77:
+		case 0xC5: case 0xD5: case 0xE5: case 0xF5: 			// PUSH
+		case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: 	// CALL
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: 			// RST
+		case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * /brief Whether a CB prefixed opcode stores to memory: any on (HL) bar BIT.
+ */
+static inline int cb_may_store(unsigned char opcode) {
+	return (opcode & 0x07) == 0x06 && (opcode & 0xC0) != 0x40;
+}
+
+#endif // OPCODES_H
@@ -0,0 +1,252 @@
+/**
+ * This module contains the register pinned core: the threaded interpreter again, only
+ * working on a copy of the registers local to the run loop rather than the CPUState
+ * initialise_registers handed out.
+ *
+ * The handlers in instructions.c take pointers into the CPUState, so in the threaded core
+ * every register access is a load or store through state, which the compiler must assume
+ * any write to memory_space could have changed. Here the registers are copied into a local
+ * on the way in and written back on the way out. The local's address never leaves the
+ * function, so stores to memory can't touch it.
+ *
+ * The compiler won't split the local into host registers by itself (the unions giving AF
+ * and friends both 8 and 16 bit views put it off), so the programme counter, which every
+ * instruction reads and writes, is held in a variable of its own. It is only copied into
+ * the local around the instructions which end a block, the only ones to look at it. Doing
+ * so took Tetris from 220 to 420-480 million instructions per second on the machine this
+ * was written on. The cycle count gets the same treatment, as only a branch taken adds to
+ * it from inside an adapter.
+ *
+ * Anything which might look at the CPUState itself gets the registers written back first:
+ * HALT and STOP (whose HALT bug runs an instruction through the opcode tables, and which
+ * may sleep), taking an interrupt and the end of the slice. A store may reach the cart,
+ * whose clock reads the cycle count, so the instructions which may store write back just
+ * the cycles (see may_store in opcodes.h).
+ *
+ * run_cycles is the entry point for a scheduler: run until so many cycles have gone by,
+ * say how many were used.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <limits.h>
+
+#include "pinned.h"
+#include "dispatch.h"
+#include "opcodes.h"
+#include "idle.h"
+#include "block_cache.h"
+#include "cycle_tables.h"
+#include "interrupts.h"
+#include "profile.h"
+
+#ifdef __GNUC__
+
+// Fetching an operand, by instruction length.
+#define FETCH_OPERAND_1(address) 0
+#define FETCH_OPERAND_2(address) read_byte((address) + 1)
+#define FETCH_OPERAND_3(address) (read_byte((address) + 1) | (read_byte((address) + 2) << 8))
+
+#define PRIMARY_LABEL(code, adapter, length, cost, taken, flags, mnemonic) [code] = &&primary_##code,
+#define CB_LABEL(code, adapter, length, cost, taken, flags, mnemonic) [code] = &&cb_##code,
+
+#define DISPATCH() { \
+	if (remaining == 0 || cycles >= cycle_limit) { \
+		goto done; \
+	} \
+	--remaining; \
+	goto *primary_labels[read_byte(pc)]; \
+}
+
+// Only the instructions which end a block (and illegal_opcode, to report where it was)
+// look at the programme counter or cycle count in the CPUState. Both tests fold away.
+#define PRIMARY_BODY(code, adapter, length, cost, taken, flags, mnemonic) \
+	primary_##code: \
+		PROFILE_INSTRUCTION(pc, code, cycles); \
+		operand = FETCH_OPERAND_##length(pc); \
+		pc += length; \
+		cycles += cost; \
+		if (may_store(code)) { \
+			machine->cycles = cycles; \
+		} \
+		if (ends_block(code) || adapter == illegal_opcode) { \
+			state->PC = pc; \
+			state->cycles = cycles; \
+			adapter(state, operand); \
+			if (ends_block(code) && interrupt_controller.pending) { \
+				*machine = registers; \
+				service_interrupts(machine); \
+				if (code == 0xFB) { \
+					remaining -= run_ei_window(machine, remaining); \
+				} \
+				registers = *machine; \
+			} \
+			pc = state->PC; \
+			cycles = state->cycles; \
+		} \
+		else { \
+			adapter(state, operand); \
+		} \
+		DISPATCH();
+
+#define CB_BODY(code, adapter, length, cost, taken, flags, mnemonic) \
+	cb_##code: \
+		PROFILE_CB(code); \
+		cycles += cost; \
+		if (cb_may_store(code)) { \
+			machine->cycles = cycles; \
+		} \
+		adapter(state, code); \
+		DISPATCH();
+
+// Runs an adapter on the CPUState itself, with the registers written back around it. A
+// sleep is cut short at the cycle limit as well as the instruction count.
+#define UNPINNED(code, adapter, length) { \
+	PROFILE_INSTRUCTION(pc, code, cycles); \
+	registers.PC = pc + length; \
+	registers.cycles = cycles + primary_cycles[code]; \
+	*machine = registers; \
+	adapter(machine, 0); \
+	check_interrupts(machine); \
+	remaining -= sleep_while_halted(machine, sleep_budget(remaining, machine->cycles, cycle_limit, primary_cycles[code])); \
+	registers = *machine; \
+	pc = registers.PC; \
+	cycles = registers.cycles; \
+}
+
+/**
+ * /brief Works out how many instructions a halted CPU may sleep for.
+ *
+ * @param remaining: Instructions left in the budget.
+ * @param cycles: Cycles gone by so far.
+ * @param cycle_limit: Cycle count to stop at.
+ * @param cost: Cycles each instruction slept takes.
+ *
+ * @return The smaller of remaining and the instructions it takes to reach cycle_limit.
+ */
+static inline unsigned long sleep_budget(unsigned long remaining, unsigned long cycles, unsigned long cycle_limit, unsigned int cost) {
+	unsigned long until_limit;
+
+	if (cycles >= cycle_limit) {
+		return 0;
+	}
+	until_limit = (cycle_limit - cycles) / cost + ((cycle_limit - cycles) % cost != 0);
+	return until_limit < remaining ? until_limit : remaining;
+}
+
+/**
+ * /brief Runs the CPU with the registers pinned until it runs out of either budget.
+ *
+ * @param machine: The CPU we are running.
+ * @param instruction_count: Most instructions to execute.
+ * @param cycle_limit: Cycle count to stop at. Instructions aren't split, so it may be
+ * 		passed by a few cycles.
+ *
+ * @return The number of instructions actually executed.
+ */
+__attribute__((flatten))
+static unsigned long run_pinned(CPUState *machine, unsigned long instruction_count, unsigned long cycle_limit) {
+	static const void *primary_labels[256] = {
+		PRIMARY_OPCODES(PRIMARY_LABEL)
+		[0xCB] = &&prefix_cb,
+		[0x10] = &&unpinned_stop,
+		[0x76] = &&unpinned_halt,
+	};
+	static const void *cb_labels[256] = {
+		CB_OPCODES(CB_LABEL)
+	};
+
+	unsigned long remaining = instruction_count - run_ei_window(machine, instruction_count);
+	CPUState registers = *machine;
+	CPUState *const state = &registers;
+	unsigned short pc = registers.PC;
+	unsigned long cycles = registers.cycles;
+	unsigned short operand;
+
+	DISPATCH();
+
+	PRIMARY_OPCODES(PRIMARY_BODY)
+
+	prefix_cb:
+		PROFILE_INSTRUCTION(pc, 0xCB, cycles);
+		operand = read_byte(pc + 1);
+		pc += 2;
+		goto *cb_labels[operand];
+
+	CB_OPCODES(CB_BODY)
+
+	unpinned_halt:
+		UNPINNED(0x76, halt, 1);
+		DISPATCH();
+
+	unpinned_stop:
+		UNPINNED(0x10, stop, 2);
+		DISPATCH();
+
+	done:
+		registers.PC = pc;
+		registers.cycles = cycles;
+		*machine = registers;
+		return instruction_count - remaining;
+}
+
+#else
+
+static unsigned long run_pinned(CPUState *machine, unsigned long instruction_count, unsigned long cycle_limit) {
+	unsigned long executed = 0;
+
+	while (executed < instruction_count && machine->cycles < cycle_limit) {
+		executed += run_instructions(machine, 1);
+	}
+	return executed;
+}
+
+#endif // __GNUC__
+
+/**
+ * /brief Runs the CPU for a set number of instructions with the registers pinned.
+ *
+ * Behaves exactly like run_instructions in dispatch.c.
+ *
+ * @param machine: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions_pinned(CPUState *machine, unsigned long instruction_count) {
+	return run_pinned(machine, instruction_count, ULONG_MAX);
+}
+
+/**
+ * /brief Runs the CPU with the registers pinned until it runs out of either budget.
+ *
+ * Instructions aren't split, so the run ends with the first instruction to reach the cycle
+ * limit and may pass it by a few cycles.
+ *
+ * @param machine: The CPU we are running.
+ * @param instruction_count: Most instructions to execute.
+ * @param cycle_limit: Cycle count to stop at.
+ *
+ * @return The number of instructions actually executed.
+ */
+unsigned long run_instructions_pinned_until(CPUState *machine, unsigned long instruction_count, unsigned long cycle_limit) {
+	return run_pinned(machine, instruction_count, cycle_limit);
+}
+
+/**
+ * /brief Runs the CPU for a slice of time.
+ *
+ * Instructions aren't split, so the slice ends with the first instruction to reach the
+ * budget and may run a little over. The caller should take the overrun out of the next slice.
+ *
+ * @param machine: The CPU we are running.
+ * @param budget: Cycles (T-states, 4.19MHz) to run for.
+ *
+ * @return The number of cycles actually used.
+ */
+unsigned long run_cycles(CPUState *machine, unsigned long budget) {
+	unsigned long start = machine->cycles;
+
+	run_pinned(machine, ULONG_MAX, start + budget);
+	return machine->cycles - start;
+}
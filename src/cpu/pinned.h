@@ -0,0 +1,18 @@
+/**
+ * A header file for the register pinned core, which runs the CPU for a budget of cycles
+ * with the registers held in locals.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef PINNED_H
+#define PINNED_H
+
+#include "register.h"
+
+// See pinned.c for more thorough explination of these functions
+unsigned long run_cycles(CPUState *machine, unsigned long budget);
+unsigned long run_instructions_pinned(CPUState *machine, unsigned long instruction_count);
+unsigned long run_instructions_pinned_until(CPUState *machine, unsigned long instruction_count, unsigned long cycle_limit);
+
+#endif // PINNED_H
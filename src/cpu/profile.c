@@ -0,0 +1,209 @@
+/**
+ * This module contains the execution profile kept by PROFILE_COUNTS builds.
+ *
+ * The interpreters (the table, threaded and pinned cores) count every instruction as they
+ * run it: by opcode, CB prefixed opcodes separately, and by (bank, address). The cached,
+ * JIT and aot cores only count what they hand to the table core, so profile with one of
+ * the interpreters. Instructions skipped over by idle loop detection or slept through on
+ * HALT aren't counted, as they were never run.
+ *
+ * Counts for switchable ROM are kept per bank, in tables allocated the first time an
+ * instruction in that bank runs. Everything else shares one table by address.
+ *
+ * At exit the front end writes the counts out as CSV, for sorting and plotting along with
+ * other ROMs, and prints the top few of each for a quick look.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifdef PROFILE_COUNTS
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "profile.h"
+#include "dispatch.h"
+#include "disassembler.h"
+
+#define BANK_SIZE 	0x4000
+
+unsigned long profile_opcode_counts[256];
+unsigned long profile_cb_counts[256];
+unsigned long profile_pc_counts[MEMORY_SPACE_SIZE];
+unsigned long *profile_banked_counts[PROFILE_MAX_BANKS];
+
+/**
+ * One line of the report.
+ */
+typedef struct {
+	unsigned long count;
+	unsigned short bank;
+	unsigned short key;		/** Opcode, or address */
+	unsigned char prefixed;	/** 1 for a CB opcode */
+} ProfileEntry;
+
+/**
+ * /brief Finds the counter for an instruction in switchable ROM.
+ *
+ * @param bank: The bank mapped in. Banks past PROFILE_MAX_BANKS wrap round.
+ * @param address: Where the instruction sits, 0x4000 - 0x7FFF.
+ *
+ * @return The counter, allocating the bank's table if need be.
+ */
+unsigned long *profile_banked_counter(unsigned short bank, unsigned short address) {
+	unsigned long **counts = &profile_banked_counts[bank % PROFILE_MAX_BANKS];
+
+	if (*counts == NULL) {
+		*counts = calloc(BANK_SIZE, sizeof(unsigned long));
+		if (*counts == NULL) {
+			fprintf(stderr, "ILLEGAL OPERATION: Out of memory profiling bank %u\n", bank);
+			abort();
+		}
+	}
+	return &(*counts)[address - BANK_SIZE];
+}
+
+/**
+ * /brief Writes the counts out as <prefix>_opcodes.csv and <prefix>_pcs.csv.
+ *
+ * Opcodes are listed in full, run or not. Addresses only if they were run.
+ *
+ * @param prefix: Start of the file names.
+ */
+void write_profile_csv(const char *prefix) {
+	char name[FILENAME_MAX];
+	FILE *file;
+	int i, bank;
+
+	snprintf(name, sizeof(name), "%s_opcodes.csv", prefix);
+	file = fopen(name, "w");
+	if (file == NULL) {
+		perror(name);
+		return;
+	}
+	fprintf(file, "opcode,mnemonic,count\n");
+	for (i = 0; i < 256; i++) {
+		fprintf(file, "%02X,\"%s\",%lu\n", i, primary_opcodes[i].mnemonic, profile_opcode_counts[i]);
+	}
+	for (i = 0; i < 256; i++) {
+		fprintf(file, "CB %02X,\"%s\",%lu\n", i, cb_opcodes[i].mnemonic, profile_cb_counts[i]);
+	}
+	fclose(file);
+
+	snprintf(name, sizeof(name), "%s_pcs.csv", prefix);
+	file = fopen(name, "w");
+	if (file == NULL) {
+		perror(name);
+		return;
+	}
+	fprintf(file, "bank,address,count\n");
+	for (i = 0; i < MEMORY_SPACE_SIZE; i++) {
+		if (profile_pc_counts[i]) {
+			fprintf(file, "0,%04X,%lu\n", i, profile_pc_counts[i]);
+		}
+	}
+	for (bank = 0; bank < PROFILE_MAX_BANKS; bank++) {
+		for (i = 0; profile_banked_counts[bank] != NULL && i < BANK_SIZE; i++) {
+			if (profile_banked_counts[bank][i]) {
+				fprintf(file, "%d,%04X,%lu\n", bank, BANK_SIZE + i, profile_banked_counts[bank][i]);
+			}
+		}
+	}
+	fclose(file);
+}
+
+/**
+ * /brief Orders report entries by count, largest first.
+ */
+static int compare_entries(const void *a, const void *b) {
+	unsigned long first = ((const ProfileEntry *) a)->count, second = ((const ProfileEntry *) b)->count;
+
+	return (first < second) - (first > second);
+}
+
+/**
+ * /brief Prints the most run opcodes, CB prefixed ones included.
+ *
+ * @param top: How many to print.
+ */
+static void print_top_opcodes(int top) {
+	ProfileEntry entries[512];
+	unsigned long total = 0;
+	int i, count = 0;
+
+	for (i = 0; i < 256; i++) {
+		if (profile_opcode_counts[i] && i != 0xCB) {
+			entries[count++] = (ProfileEntry) {profile_opcode_counts[i], 0, i, 0};
+		}
+		if (profile_cb_counts[i]) {
+			entries[count++] = (ProfileEntry) {profile_cb_counts[i], 0, i, 1};
+		}
+		total += profile_opcode_counts[i];
+	}
+	qsort(entries, count, sizeof(ProfileEntry), compare_entries);
+
+	printf("\tHottest opcodes (of %lu instructions):\n", total);
+	for (i = 0; i < count && i < top; i++) {
+		const Opcode *opcode = entries[i].prefixed ? &cb_opcodes[entries[i].key] : &primary_opcodes[entries[i].key];
+		printf("\t\t%s%02X  %-16s %12lu %6.2f%%\n", entries[i].prefixed ? "CB " : "   ", entries[i].key,
+			opcode->mnemonic, entries[i].count, 100.0 * entries[i].count / total);
+	}
+}
+
+/**
+ * /brief Prints the most run addresses, along with what's there.
+ *
+ * Only bank 0 and the bank mapped in now can be disassembled, the others aren't in memory.
+ *
+ * @param top: How many to print.
+ */
+static void print_top_addresses(int top) {
+	ProfileEntry *entries;
+	unsigned long total = 0;
+	char text[DISASSEMBLY_MAX];
+	int i, bank, count = 0;
+
+	entries = malloc((MEMORY_SPACE_SIZE + PROFILE_MAX_BANKS * BANK_SIZE) * sizeof(ProfileEntry));
+	if (entries == NULL) {
+		return;
+	}
+	for (i = 0; i < MEMORY_SPACE_SIZE; i++) {
+		if (profile_pc_counts[i]) {
+			entries[count++] = (ProfileEntry) {profile_pc_counts[i], 0, i, 0};
+			total += profile_pc_counts[i];
+		}
+	}
+	for (bank = 0; bank < PROFILE_MAX_BANKS; bank++) {
+		for (i = 0; profile_banked_counts[bank] != NULL && i < BANK_SIZE; i++) {
+			if (profile_banked_counts[bank][i]) {
+				entries[count++] = (ProfileEntry) {profile_banked_counts[bank][i], bank, BANK_SIZE + i, 0};
+				total += profile_banked_counts[bank][i];
+			}
+		}
+	}
+	qsort(entries, count, sizeof(ProfileEntry), compare_entries);
+
+	printf("\tHottest addresses (bank:address):\n");
+	for (i = 0; i < count && i < top; i++) {
+		text[0] = '\0';
+		if (entries[i].bank == 0 || entries[i].bank == current_rom_bank) {
+			disassemble_at(entries[i].key, text, sizeof(text));
+		}
+		printf("\t\t%03X:%04X  %-16s %12lu %6.2f%%\n", entries[i].bank, entries[i].key, text,
+			entries[i].count, 100.0 * entries[i].count / total);
+	}
+	free(entries);
+}
+
+/**
+ * /brief Prints the most run opcodes and addresses.
+ *
+ * @param top: How many of each to print.
+ */
+void print_profile_report(int top) {
+	printf("Execution profile:\n");
+	print_top_opcodes(top);
+	print_top_addresses(top);
+}
+
+#endif // PROFILE_COUNTS
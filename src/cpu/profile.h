@@ -0,0 +1,65 @@
+/**
+ * A header file for the execution profile: how many times each opcode, and the
+ * instruction at each (bank, address), was run.
+ *
+ * Only built with PROFILE_COUNTS (`make PROFILE_COUNTS=1`). Otherwise the hooks below
+ * expand to nothing and the cores are exactly as they would be without them.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#define PROFILE_CSV_PREFIX 	"profile"	// Written to profile_opcodes.csv and profile_pcs.csv
+#define PROFILE_TOP_N 		20			// Lines in each part of the report
+#define PROFILE_MAX_BANKS 	512			// As many ROM banks as any cart has
+
+#ifdef PROFILE_COUNTS
+
+#include "block_cache.h"
+#include "call_graph.h"
+
+extern unsigned long profile_opcode_counts[256];
+extern unsigned long profile_cb_counts[256];
+extern unsigned long profile_pc_counts[MEMORY_SPACE_SIZE];	// Everywhere but switchable ROM
+extern unsigned long *profile_banked_counts[PROFILE_MAX_BANKS];	// Switchable ROM, by bank
+
+// See profile.c for more thorough explination of these functions
+unsigned long *profile_banked_counter(unsigned short bank, unsigned short address);
+void write_profile_csv(const char *prefix);
+void print_profile_report(int top);
+
+/**
+ * /brief Counts an instruction about to be run, and charges the call graph for the last.
+ *
+ * @param address: Where the instruction sits.
+ * @param opcode: Its first byte. CB prefixed instructions count as 0xCB here and as their
+ * 		own opcode through PROFILE_CB.
+ * @param cycles: Cycle count before the instruction is charged for.
+ */
+static inline void profile_instruction(unsigned short address, unsigned char opcode, unsigned long cycles) {
+	unsigned short bank = bank_of(address);
+
+	call_graph_charge(cycles);
+
+	++profile_opcode_counts[opcode];
+	if (bank == 0) {
+		++profile_pc_counts[address];
+	}
+	else {
+		++*profile_banked_counter(bank, address);
+	}
+}
+
+#define PROFILE_INSTRUCTION(address, opcode, cycles) 	profile_instruction(address, opcode, cycles)
+#define PROFILE_CB(opcode) 						(++profile_cb_counts[opcode])
+
+#else
+
+#define PROFILE_INSTRUCTION(address, opcode, cycles) 	((void) 0)
+#define PROFILE_CB(opcode) 						((void) 0)
+
+#endif // PROFILE_COUNTS
+
+#endif // PROFILE_H
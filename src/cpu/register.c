@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include "register.h"
+#include "instructions.h"
 
 /**
  * /brief Initialises CPU state
@@ -31,6 +32,24 @@ CPUState* initialise_registers() {
 	return new_state;
 }
 
+/**
+ * /brief Puts the registers in the state the boot ROM leaves them in.
+ *
+ * We don't run the boot ROM (Nintendo's logo scroll) ourselves, so when starting a 
+ * cartridge the registers have to look as though it has just finished. These are the
+ * values the original DMG hands over to the cartridge with at 0x100.
+ *
+ * @param system_state: The registers we are setting up.
+ */
+void load_post_boot_state(CPUState *system_state) {
+	system_state->AF = 0x01B0;
+	system_state->BC = 0x0013;
+	system_state->DE = 0x00D8;
+	system_state->HL = 0x014D;
+	system_state->SP = 0xFFFE;
+	system_state->PC = 0x100;
+}
+
 /**
  * /brief Prints the current values of the registers
  * 
@@ -44,11 +63,13 @@ void print_registers(CPUState* system_state) {
 	time(&raw_time);	// Acquiring the current time!
 	time_info = localtime(&raw_time);
 
+	materialise_flags(&system_state->F);		// F may still be owed an update
 	printf("CPU State @ Time: %s", asctime(time_info));				// Gives context to the print out.	
 	printf("\tA: %X\tF: %X\n", (system_state->A), (system_state->F));
 	printf("\tB: %X\tC: %X\n", (system_state->B), (system_state->C));
 	printf("\tD: %X\tE: %X\n", (system_state->D), (system_state->E));
 	printf("\tH: %X\tL: %X\n", (system_state->H), (system_state->L));
 	printf("\tStack Pointer; %X\n", (system_state->SP));
-	printf("\tProgramme Counter: %X\n\n", (system_state->PC));
+	printf("\tProgramme Counter: %X\n", (system_state->PC));
+	printf("\tCycles: %lu\n\n", (system_state->cycles));
 } 
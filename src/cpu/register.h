@@ -18,12 +18,36 @@
 #define HALF_CARRY_FLAG_POS		5
 #define CARRY_FLAG_POS 			4
 
+// Kinds of flag update that can be left pending when built with LAZY_FLAGS.
+#define FLAGS_SETTLED 			0		// F holds the real flags
+#define FLAGS_ADD 				1		// F is the result of set_flags_add
+#define FLAGS_SUB 				2		// F is the result of set_flags_sub
+#define FLAGS_AND 				3		// Z from the result, H set, everything else reset
+#define FLAGS_LOGIC 			4		// Z from the result, everything else reset (OR, XOR)
+#define FLAGS_KEEP_CARRY 		0x80	// Or'd onto ADD/SUB by INC/DEC. The carry is the old C flag
+
 // Some typedefs for cleanliness. 
 // Pay close attention to how a register is a pointer 
 // to a value, not the value it self. 
 typedef unsigned char Register8;	
 typedef unsigned short Register16;	
 
+#ifdef LAZY_FLAGS
+#include <stddef.h>
+
+/*
+ * When built with LAZY_FLAGS the ALU does not work out F after every operation.
+ * It records what it did here instead and F is only worked out when something
+ * actually looks at it (see materialise_flags in instructions.c).
+ */
+typedef struct {
+	unsigned char operation;	// One of the FLAGS_ kinds above
+	Register8 result;			// What the accumulator ended up holding
+	Register8 operand;			// What the accumulator held before the operation
+	unsigned char carry;		// Carry fed into the operation, or the carry to keep
+} PendingFlags;
+#endif
+
 /* 
  * This union allows us to easily handle two 
  * associated 8 bit registers within the Gameboy to 
@@ -32,51 +56,69 @@ typedef unsigned short Register16;
  * For the time being, I've opted to use direct storage of 
  * values as opposed to using pointers as it results in a 
  * more compact and... hopefully easy to use structure. 
+ *
+ * Note: The host we run on is little endian, so the lower byte of each
+ * pair has to come first in the struct for the 16 bit view to read as 
+ * the Game Boy expects (e.g. HL == (H << 8) | L).
  */
 typedef struct {
 
 	// Defining the general purpose registers
 	union {
 		struct {
-			Register8 A;	// In this case, A is the upper byte, F is the lower byte
 			Register8 F;	// Do not directly access F.
+			Register8 A;	// In this case, A is the upper byte, F is the lower byte
 		};
 		Register16 AF;
 	};
 
 	union {
 		struct {
-			Register8 B;
 			Register8 C;
+			Register8 B;
 		};
 		Register16 BC;
 	};
 
 	union {
 		struct {
-			Register8 D;
 			Register8 E;
+			Register8 D;
 		};
 		Register16 DE;
 	};
 
 	union {
 		struct {
-			Register8 H;
 			Register8 L;
+			Register8 H;
 		};
 		Register16 HL;		// HL is often used as a 16 bit register for indirect addressing and such
 	};
 
 	Register16 SP;			// The stack pointer
 	Register16 PC;			// The programme counter
+
+	unsigned char halted;					// Sat on a HALT or STOP waiting to be woken
+	unsigned long cycles;					// T-cycles run since power on. Only ever goes up
+
+#ifdef LAZY_FLAGS
+	PendingFlags pending_flags;		// The last flag update, if F hasn't caught up with it yet
+#endif
 	
 } CPUState;
 
+#ifdef LAZY_FLAGS
+// The handlers only get a pointer to F, which always sits inside a CPUState.
+#define PENDING_FLAGS(flags) \
+	(&((CPUState *) ((char *) (flags) - offsetof(CPUState, F)))->pending_flags)
+#endif
+
 
 //And some functions. See register.c for definitions!
 
 CPUState* initialise_registers();
+void load_post_boot_state(CPUState* system_state);
 void print_registers(CPUState* system_state);
 
 
@@ -0,0 +1,151 @@
+/**
+ * This module contains an alternative to the run loop in dispatch.c: a threaded
+ * interpreter built on GCC's labels as values (computed goto).
+ *
+ * Rather than calling each adapter through a function pointer from one shared loop, every
+ * opcode gets its own label with the adapter's body inlined into it. Each of those bodies
+ * ends by fetching the next opcode and jumping straight to its label, so there are 256+
+ * indirect jumps for the branch predictor to learn rather than a single shared one. Built
+ * with link time optimisation, the handlers in instructions.c are inlined all the way down.
+ *
+ * Both cores are generated from the same opcode lists in opcodes.h, so they can't drift
+ * apart. Compilers without labels as values get the plain loop instead.
+ *
+ * Each body adds its opcode's cycles to a local count, which goes into the CPU state once
+ * the run is over, or before any instruction which may store to memory or ends a block, so
+ * a cart's clock sees the time as it is (see may_store in opcodes.h). Branches taken are
+ * charged by the adapters as usual. The bodies of the instructions which end a block check
+ * for interrupts, the others don't have to.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "threaded.h"
+#include "dispatch.h"
+#include "opcodes.h"
+#include "idle.h"
+#include "cycle_tables.h"
+#include "interrupts.h"
+#include "block_cache.h"
+#include "profile.h"
+
+#ifdef __GNUC__
+
+// Fetching an operand, by instruction length.
+#define FETCH_OPERAND_1(address) 0
+#define FETCH_OPERAND_2(address) read_byte((address) + 1)
+#define FETCH_OPERAND_3(address) (read_byte((address) + 1) | (read_byte((address) + 2) << 8))
+
+#define PRIMARY_LABEL(code, adapter, length, cost, taken, flags, mnemonic) [code] = &&primary_##code,
+#define CB_LABEL(code, adapter, length, cost, taken, flags, mnemonic) [code] = &&cb_##code,
+
+// Every body finishes by dispatching the next instruction itself.
+#define DISPATCH() { \
+	if (remaining == 0) { \
+		goto done; \
+	} \
+	--remaining; \
+	goto *primary_labels[read_byte(state->PC)]; \
+}
+
+#define PRIMARY_BODY(code, adapter, length, cost, taken, flags, mnemonic) \
+	primary_##code: \
+		PROFILE_INSTRUCTION(state->PC, code, state->cycles + cycles); \
+		operand = FETCH_OPERAND_##length(state->PC); \
+		state->PC += length; \
+		cycles += cost; \
+		if (may_store(code) || ends_block(code)) { \
+			state->cycles += cycles; \
+			cycles = 0; \
+		} \
+		adapter(state, operand); \
+		if (ends_block(code)) { \
+			check_interrupts(state); \
+			if (code == 0xFB) { \
+				remaining -= run_ei_window(state, remaining); \
+			} \
+		} \
+		DISPATCH();
+
+// The prefix has already been consumed by the time we land here.
+#define CB_BODY(code, adapter, length, cost, taken, flags, mnemonic) \
+	cb_##code: \
+		PROFILE_CB(code); \
+		cycles += cost; \
+		if (cb_may_store(code)) { \
+			state->cycles += cycles; \
+			cycles = 0; \
+		} \
+		adapter(state, code); \
+		DISPATCH();
+
+/**
+ * /brief Runs the CPU for a set number of instructions using the threaded core.
+ *
+ * Behaves exactly like run_instructions in dispatch.c, just faster. As there, a CB
+ * prefixed instruction counts as a single instruction.
+ *
+ * @param state: The CPU we are running.
+ * @param instruction_count: How many instructions to execute.
+ *
+ * @return The number of instructions actually executed.
+ */
+__attribute__((flatten))
+unsigned long run_instructions_threaded(CPUState *state, unsigned long instruction_count) {
+	static const void *primary_labels[256] = {
+		PRIMARY_OPCODES(PRIMARY_LABEL)
+		[0xCB] = &&prefix_cb,
+		[0x10] = &&sleep_stop,
+		[0x76] = &&sleep_halt,
+	};
+	static const void *cb_labels[256] = {
+		CB_OPCODES(CB_LABEL)
+	};
+
+	unsigned long remaining = instruction_count - run_ei_window(state, instruction_count);
+	unsigned long cycles = 0;
+	unsigned short operand;
+
+	DISPATCH();
+
+	PRIMARY_OPCODES(PRIMARY_BODY)
+
+	prefix_cb:
+		PROFILE_INSTRUCTION(state->PC, 0xCB, state->cycles + cycles);
+		operand = read_byte(state->PC + 1);
+		state->PC += 2;
+		goto *cb_labels[operand];
+
+	CB_OPCODES(CB_BODY)
+
+	// HALT and STOP get bodies of their own, so a halted CPU can sleep
+	sleep_halt:
+		PROFILE_INSTRUCTION(state->PC, 0x76, state->cycles + cycles);
+		state->PC += 1;
+		cycles += primary_cycles[0x76];
+		halt(state, 0);
+		check_interrupts(state);
+		remaining -= sleep_while_halted(state, remaining);
+		DISPATCH();
+
+	sleep_stop:
+		PROFILE_INSTRUCTION(state->PC, 0x10, state->cycles + cycles);
+		state->PC += 2;
+		cycles += primary_cycles[0x10];
+		stop(state, 0);
+		check_interrupts(state);
+		remaining -= sleep_while_halted(state, remaining);
+		DISPATCH();
+
+	done:
+		state->cycles += cycles;
+		return instruction_count;
+}
+
+#else
+
+unsigned long run_instructions_threaded(CPUState *state, unsigned long instruction_count) {
+	return run_instructions(state, instruction_count);
+}
+
+#endif // __GNUC__
@@ -0,0 +1,15 @@
+/**
+ * A header file for the threaded (computed goto) interpreter core.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef THREADED_H
+#define THREADED_H
+
+#include "register.h"
+
+// See threaded.c for more thorough explination of these functions
+unsigned long run_instructions_threaded(CPUState *state, unsigned long instruction_count);
+
+#endif // THREADED_H
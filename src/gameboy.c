@@ -0,0 +1,271 @@
+/*
+ * Game Boy (working title)
+ * An emulator for a Game Boy.
+ *
+ * The headless front end. Loads a cartridge, runs the CPU for a set number of
+ * instructions and reports how quickly it managed it. For the time being there is
+ * no screen, so throughput is the only thing worth reporting!
+ *
+ * Usage: gameboy [-c core] [-l reference core [-s step] | -f frames] [-b save file] [-t clock]
+ * 		<rom file> [instruction count]
+ *
+ * The core defaults to DEFAULT_CORE, which can be overridden at build time. With -l it is
+ * checked against the reference core every step instructions (1 unless given) and stops
+ * at the first point they disagree, see cpu/lockstep.c. With -f it runs that many frames
+ * with scripted buttons pressed instead, and reports them against a real Game Boy, see
+ * benchmark.c. With -b the cart's battery backed RAM and clock are loaded from the save
+ * file, if it's there, and written back to it at the end, see memory/save.c. -t picks where
+ * a cart's clock gets the time: "emulated" (the default) from the CPU's cycle count, so runs
+ * do the same every time, or "host" from the host's clock. There's no motor to drive on a
+ * rumble cart, so how often the game turned it on is reported instead. Built with PROFILE_COUNTS it also
+ * writes out how often each opcode and address was run, and where the game spent its cycles
+ * by function, see cpu/profile.c and cpu/call_graph.c.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#include "cpu/register.h"
+#include "cpu/cores.h"
+#include "cpu/lockstep.h"
+#include "cpu/profile.h"
+#include "memory/memory.h"
+#include "memory/joypad.h"
+#include "memory/cart.h"
+#include "memory/mapper.h"
+#include "memory/mbc3.h"
+#include "memory/save.h"
+#include "benchmark.h"
+
+#define DEFAULT_INSTRUCTION_COUNT 	100000000
+
+#ifndef DEFAULT_CORE
+	#define DEFAULT_CORE 			"threaded"
+#endif
+
+unsigned char *memory_space = NULL;
+unsigned long rumble_count = 0;
+
+void print_usage(const char *programme_name);
+void count_rumble(int motor_on);
+double elapsed_seconds(struct timespec *start, struct timespec *end);
+long peak_resident_kilobytes();
+
+int main(int argc, char *argv[]) {
+	const Core *core = find_core(DEFAULT_CORE);
+	const Core *reference = NULL;
+	unsigned long step = 1, frame_count = 0;
+	const char *save_file = NULL;
+	int clock_source = RTC_SOURCE_EMULATED;
+	int option, diverged = 0;
+
+	while ((option = getopt(argc, argv, "c:l:s:f:b:t:")) != -1) {
+		switch (option) {
+			case 'c':
+			case 'l':
+				if (find_core(optarg) == NULL) {
+					fprintf(stderr, "Unknown core: %s\n", optarg);
+					print_usage(argv[0]);
+					exit(1);
+				}
+				if (option == 'c') {
+					core = find_core(optarg);
+				}
+				else {
+					reference = find_core(optarg);
+				}
+				break;
+			case 's':
+				step = strtoul(optarg, NULL, 10);
+				if (step == 0) {
+					fprintf(stderr, "The lockstep step must be at least 1 instruction\n");
+					exit(1);
+				}
+				break;
+			case 'f':
+				frame_count = strtoul(optarg, NULL, 10);
+				if (frame_count == 0) {
+					fprintf(stderr, "The benchmark must run at least 1 frame\n");
+					exit(1);
+				}
+				break;
+			case 'b':
+				save_file = optarg;
+				break;
+			case 't':
+				if (strcmp(optarg, "emulated") == 0) {
+					clock_source = RTC_SOURCE_EMULATED;
+				}
+				else if (strcmp(optarg, "host") == 0) {
+					clock_source = RTC_SOURCE_HOST;
+				}
+				else {
+					fprintf(stderr, "Unknown clock: %s\n", optarg);
+					print_usage(argv[0]);
+					exit(1);
+				}
+				break;
+			default:
+				print_usage(argv[0]);
+				exit(1);
+		}
+	}
+
+	if (argc - optind < 1 || argc - optind > 2) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+	if (frame_count != 0 && (reference != NULL || argc - optind == 2)) {
+		fprintf(stderr, "-f runs a number of frames, not instructions, and can't be run in lockstep\n");
+		print_usage(argv[0]);
+		exit(1);
+	}
+	if (reference == core) {
+		fprintf(stderr, "Can't run the %s core in lockstep with itself\n", core->name);
+		exit(1);
+	}
+
+	unsigned long instruction_count = DEFAULT_INSTRUCTION_COUNT;
+	if (argc - optind == 2) {
+		instruction_count = strtoul(argv[optind + 1], NULL, 10);
+	}
+
+	memory_space = calloc(MEMORY_SPACE_SIZE, sizeof(unsigned char));
+	CartMetaData *cart_data = load_rom(argv[optind], memory_space);
+	if (cart_data == NULL) {
+		exit(2);		// load_rom has said why
+	}
+	print_cart_metadata(cart_data);
+
+	const Mapper *mapper = find_mapper(cart_data->cart_type);
+	if (mapper == NULL) {
+		fprintf(stderr, "The emulator has no mapper for %s's cart (%s, type 0x%02X), so can't run it yet\n",
+			cart_data->game_name, cart_type_name(cart_data->cart_type), cart_data->cart_type);
+		exit(1);
+	}
+	map_memory();
+
+	CPUState *state = initialise_registers();
+	load_post_boot_state(state);
+
+	MapperOptions mapper_options = {&state->cycles, clock_source, count_rumble};
+	insert_cart(mapper, cart_data, &mapper_options);
+	if (save_file != NULL && !cart_has_battery(cart_data->cart_type)) {
+		fprintf(stderr, "The cart has no battery, so there's nothing to save\n");
+		save_file = NULL;
+	}
+	if (save_file != NULL) {
+		load_save(save_file, mapper);
+	}
+#ifdef PROFILE_COUNTS
+	load_symbols(argv[optind]);
+#endif
+
+	reset_joypad();
+
+	struct timespec start, end;
+	unsigned long executed, frames = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (frame_count != 0) {
+		frames = run_frames(core, state, frame_count, &executed);
+	}
+	else {
+		executed = reference == NULL ? core->run(state, instruction_count) :
+			run_lockstep(core, reference, state, instruction_count, step, &diverged);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	double seconds = elapsed_seconds(&start, &end);
+	if (frame_count != 0) {
+		printf("\nRan %lu frames (%lu instructions) in %.3f seconds on the %s core\n", frames, executed, seconds, core->name);
+		printf("\t%.1f frames per second, %.2fx real time\n", frames / seconds, frames / seconds / FRAME_RATE);
+		printf("\tPeak resident set %ld KB\n", peak_resident_kilobytes());
+	}
+	else {
+		printf("\nExecuted %lu instructions in %.3f seconds on the %s core\n", executed, seconds, core->name);
+	}
+	if (reference != NULL) {
+		printf("\t%s the %s core, checked every %lu instructions\n", diverged ? "Disagreed with" : "In lockstep with",
+			reference->name, step);
+	}
+	printf("\t%.2f million instructions per second\n", executed / seconds / 1e6);
+	if (cart_has_rumble(cart_data->cart_type)) {
+		printf("\tRumble motor turned on %lu times\n", rumble_count);
+	}
+	printf("\n");
+	print_registers(state);
+	if (core->print_stats != NULL) {
+		core->print_stats();
+	}
+#ifdef PROFILE_COUNTS
+	write_profile_csv(PROFILE_CSV_PREFIX);
+	write_call_graph(PROFILE_CSV_PREFIX);
+	print_profile_report(PROFILE_TOP_N);
+#endif
+
+	if (save_file != NULL) {
+		write_save(save_file, mapper);
+	}
+
+	free(state);
+	free_cart_metadata(cart_data);
+	free(memory_space);
+	return diverged;
+}
+
+/**
+ * /brief Prints how to use the programme, along with the available cores.
+ *
+ * @param programme_name: What the programme was invoked as.
+ */
+void print_usage(const char *programme_name) {
+	int i;
+
+	fprintf(stderr, "Usage: %s [-c core] [-l reference core [-s step] | -f frames] [-b save file] [-t emulated|host]\n"
+		"\t<rom file> [instruction count]\n", programme_name);
+	fprintf(stderr, "Cores (default %s):\n", DEFAULT_CORE);
+	for (i = 0; i < core_count; i++) {
+		fprintf(stderr, "\t%-10s %s\n", cores[i].name, cores[i].description);
+	}
+}
+
+/**
+ * /brief Counts the times a rumble cart turns its motor on, standing in for the motor.
+ *
+ * @param motor_on: Whether the motor was turned on or off.
+ */
+void count_rumble(int motor_on) {
+	if (motor_on) {
+		rumble_count++;
+	}
+}
+
+/**
+ * /brief Works out the time elapsed between two readings of the clock.
+ *
+ * @param start: Reading taken before the work.
+ * @param end: Reading taken after the work.
+ *
+ * @return Seconds elapsed between the two.
+ */
+double elapsed_seconds(struct timespec *start, struct timespec *end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/**
+ * /brief The most memory the programme has had resident at once.
+ *
+ * @return Peak resident set size in kilobytes.
+ */
+long peak_resident_kilobytes() {
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss;
+}
@@ -11,22 +11,29 @@
 #include "cart.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static unsigned char *map_rom_file(FILE *rom_file, int rom_size, int file_size, int *mapped);
+static int has_no_controller(unsigned char cart_type);
 
 /**
  * /brief Loads a ROM into the Game Boy's memory space. 
  * 
  * Loads the ROM file located at the given file location into the 
- * memory space for the Game Boy. For the time being, this function
- * assumes no funny business concerning the size of the ROM. Basically, 
- * we expect the entire game to fit in the perscribed 32KB space. If, for some reason
- * it is larger, then we will only read the first 32 kb.
+ * memory space for the Game Boy. The whole ROM is put in the metadata's rom, however
+ * big, see map_rom_file. A cart with no bank controller is copied into the memory space
+ * as well, as it fits in the 32KB there. Carts with banks are left to their bank
+ * controller, which maps the banks it picks straight out of rom.
+ *
+ * Whether the emulator can run the cart is for its mapper to say, see mapper.c. Only a
+ * cart that can't be read at all is turned away here.
  *
  * @param file_location: Location of the ROM file on disk.
  * @param memory_space: Pointer to the array used to represent the Game Boy's memory.
  *	The values will be updated in place and not explicitly returned. This IS C afterall!
  *
- * @return Number of elements successfully read from the rom... or the error code of the 
- *  read operation
+ * @return The cart's metadata, with its ROM. NULL if it couldn't be loaded, having said why.
  */
 CartMetaData* load_rom(const char *file_location, unsigned char *memory_space) {
 	CartMetaData *cart_data;
@@ -40,7 +47,7 @@ CartMetaData* load_rom(const char *file_location, unsigned char *memory_space) {
 	FILE *rom_file = fopen(file_location, "rb");
 	if (rom_file == NULL) {
 		perror("Error Opening File");
-		exit(2);
+		return NULL;
 	}	
 
 	// Since behaviour depends upon the type of cart we're emulating, we have to know 
@@ -52,24 +59,71 @@ CartMetaData* load_rom(const char *file_location, unsigned char *memory_space) {
 	// We don't actually need the contents of the cart. Just the metadata should suffice for now.
 	cart_data = read_cart_metadata(rom_file);
 
-	//TODO: Implement Alternative Cart Types Here!
-	// For the time being we're only going to impliment 32KB ROM only carts like Tetris. 
-	// NOTE: The cart type for the ROM only cart is 0x00.
-	if (!cart_data->cart_type) {
-		perror("The emulator does not currently have support for fancy pants cartridges. Come back later!");
-		exit(3);
+	if (cart_data->rom_size < ROM_BANK_SIZE * 2 || (has_no_controller(cart_data->cart_type) && cart_data->rom_size > ROM_BANK_SIZE * 2)) {
+		fprintf(stderr, "The ROM's header gives a size it can't have\n");
+		fclose(rom_file);
+		free_cart_metadata(cart_data);
+		return NULL;
+	}
+
+	// If we have a usable cart, map or read the lot.
+	cart_data->rom = map_rom_file(rom_file, cart_data->rom_size, file_size, &cart_data->rom_mapped);
+	fclose(rom_file);
+
+	if (has_no_controller(cart_data->cart_type)) {
+		memcpy(memory_space, cart_data->rom, cart_data->rom_size);
 	}
-	// If we have a usable cart, copy data into memory. 
-	fseek(rom_file, 0, SEEK_SET);
-	unsigned bytes_read = fread(memory_space, sizeof(unsigned char), cart_data->rom_size, rom_file);
 
 	#ifdef VERBOSE
-		printf("Read %d bytes from the ROM", bytes_read);
+		printf("%s %d bytes of ROM", cart_data->rom_mapped ? "Mapped" : "Read", cart_data->rom_size);
 	#endif
 
 	return cart_data;
 }
 
+/**
+ * /brief Puts the whole of a ROM file in memory.
+ *
+ * The file is mapped rather than read, so nothing comes off the disk until the game reads
+ * a bank, and a bank it never picks never does. That matters for the biggest carts, of up
+ * to 8MB. Every emulator running the same ROM shares the one copy in the page cache too.
+ * The mapping is read only, as the memory map never writes to ROM.
+ *
+ * A file shorter than its header says can't be mapped, as reading past its end would fault.
+ * It's read in instead, the rest left blank. As is any file the system won't map.
+ *
+ * @param rom_file: The ROM file, open.
+ * @param rom_size: Size of the ROM in bytes, as its header gives it.
+ * @param file_size: Size of the file in bytes.
+ * @param mapped: Set to 1 if the file was mapped, 0 if it was read in.
+ *
+ * @return The ROM, rom_size bytes of it.
+ */
+static unsigned char *map_rom_file(FILE *rom_file, int rom_size, int file_size, int *mapped) {
+	unsigned char *rom;
+
+	if (file_size >= rom_size) {
+		rom = mmap(NULL, rom_size, PROT_READ, MAP_PRIVATE, fileno(rom_file), 0);
+		if (rom != MAP_FAILED) {
+			*mapped = 1;
+			return rom;
+		}
+	}
+
+	*mapped = 0;
+	rom = calloc(rom_size, sizeof(unsigned char));
+	fseek(rom_file, 0, SEEK_SET);
+	fread(rom, sizeof(unsigned char), rom_size, rom_file);
+	return rom;
+}
+
+/**
+ * /brief Whether a cart is only ROM, and maybe RAM, with nothing to pick banks.
+ */
+static int has_no_controller(unsigned char cart_type) {
+	return cart_type == ROM_ONLY || cart_type == ROM_RAM || cart_type == ROM_RAM_BATTERY;
+}
+
 /**
  * /brief Reads metadata from the catridge ROM.
  *
@@ -114,11 +168,18 @@ CartMetaData* read_cart_metadata(FILE *rom_file) {
 	fread(rom_size_ptr, sizeof(unsigned char), 1, rom_file);
 	fread(ram_size_ptr, sizeof(unsigned char), 1, rom_file);
 
+	// And the checksums, which tell one ROM from another
+	unsigned char checksums[3] = {0};
+	fseek(rom_file, HEADER_CHECKSUM_ADDRESS, SEEK_SET);
+	fread(checksums, sizeof(unsigned char), 3, rom_file);
+
 	// Assigning the values to the struct
 	cart_data->game_name 		= cart_name;
 	cart_data->cart_type 		= *cart_type_ptr;
 	cart_data->colour_gb_flag 	= *colour_gb_ptr == COLOUR_GB_FLAG;	
 	cart_data->super_gb_flag    = *super_gb_ptr == SUPER_GB_FLAG;
+	cart_data->header_checksum 	= checksums[0];
+	cart_data->global_checksum 	= (checksums[1] << 8) | checksums[2];
 
 	// The bytes indicating RAM and ROM size do not directly communicate
 	// the size of memory banks. The following functions will get at that.
@@ -141,8 +202,8 @@ CartMetaData* read_cart_metadata(FILE *rom_file) {
  * /brief Gets the size of the ROM on Cartridge
  *
  * Returns the size of ROM on cartridge. The mapping is pretty straight forward
- * If the byte is between 0-6 then it's 2^(n+1) banks of ROM with each bank being 
- * 16KB of memory. 
+ * If the byte is between 0-8 then it's 2^(n+1) banks of ROM with each bank being 
+ * 16KB of memory. (i.e. 32KB << n)
  * For byte values other than 0-6 there's no real pattern, one can use:
  * http://marc.rawer.de/Gameboy/Docs/GBCPUman.pdf p. 12 as a reference.
  * Banks are still 16KB of memory though!
@@ -152,8 +213,8 @@ CartMetaData* read_cart_metadata(FILE *rom_file) {
  * @return The size of ROM in bytes.
  */
 int get_rom_size(unsigned char rom_byte) {
-	if (rom_byte <= 6) {
-		return (2 << (rom_byte + 1)) * ROM_BANK_SIZE;
+	if (rom_byte <= 8) {
+		return (2 << rom_byte) * ROM_BANK_SIZE;
 	}
 	else if (rom_byte == 0x52) {
 		return 72 * ROM_BANK_SIZE;
@@ -185,18 +246,104 @@ int get_ram_size(unsigned char ram_byte) {
 		case 0	:
 			return 0;
 		case 1	:
-			return 2000;	// 2KB RAM
+			return 0x800;	// 2KB RAM
 		case 2	: 
-			return 8000;	// 8KB RAM
+			return 0x2000;	// 8KB RAM
 		case 3	:
-			return 32000;	// 32KB RAM
+			return 0x8000;	// 32KB RAM
 		case 4	:
-			return 128000;	// 128KB ram
+			return 0x20000;	// 128KB ram
 		default :
 			return -1;		// Faulty RAM read.
 	}
 }
 
+/**
+ * /brief Whether a cart keeps its RAM, or clock, going on a battery.
+ *
+ * @param cart_type: The cart type from the header.
+ *
+ * @return 1 if it does. 0 otherwise.
+ */
+int cart_has_battery(unsigned char cart_type) {
+	switch (cart_type) {
+		case ROM_MBC1_RAM_BATT:
+		case ROM_MBC2_BATTERY:
+		case ROM_RAM_BATTERY:
+		case ROM_MMM01_SRAM_BATT:
+		case ROM_MBC3_TIMER_BATT:
+		case ROM_MBC3_TIMER_RAM_BATT:
+		case ROM_MBC3_RAM_BATT:
+		case ROM_MBC5_RAM_BATT:
+		case ROM_MBC5_RUMBLE_SRAM_BATT:
+		case ROM_HUDSON_HUC1:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * /brief Whether a cart has a real time clock.
+ *
+ * @param cart_type: The cart type from the header.
+ *
+ * @return 1 if it does. 0 otherwise.
+ */
+int cart_has_clock(unsigned char cart_type) {
+	return cart_type == ROM_MBC3_TIMER_BATT || cart_type == ROM_MBC3_TIMER_RAM_BATT;
+}
+
+/**
+ * /brief Whether a cart has a rumble motor.
+ *
+ * @param cart_type: The cart type from the header.
+ *
+ * @return 1 if it does. 0 otherwise.
+ */
+int cart_has_rumble(unsigned char cart_type) {
+	return cart_type == ROM_MBC5_RUMBLE || cart_type == ROM_MBC5_RUMBLE_SRAM || cart_type == ROM_MBC5_RUMBLE_SRAM_BATT;
+}
+
+/**
+ * /brief Names the hardware on a type of cart.
+ *
+ * @param cart_type: The cart type from the header.
+ *
+ * @return The bank controller and whatever else the cart has, for messages.
+ */
+const char *cart_type_name(unsigned char cart_type) {
+	switch (cart_type) {
+		case ROM_ONLY: 					return "ROM only";
+		case ROM_MBC1: 					return "MBC1";
+		case ROM_MBC1_RAM: 				return "MBC1+RAM";
+		case ROM_MBC1_RAM_BATT: 		return "MBC1+RAM+battery";
+		case ROM_MBC2: 					return "MBC2";
+		case ROM_MBC2_BATTERY: 			return "MBC2+battery";
+		case ROM_RAM: 					return "ROM+RAM";
+		case ROM_RAM_BATTERY: 			return "ROM+RAM+battery";
+		case ROM_MMM01: 				return "MMM01";
+		case ROM_MMM01_SRAM: 			return "MMM01+RAM";
+		case ROM_MMM01_SRAM_BATT: 		return "MMM01+RAM+battery";
+		case ROM_MBC3_TIMER_BATT: 		return "MBC3+timer+battery";
+		case ROM_MBC3_TIMER_RAM_BATT: 	return "MBC3+timer+RAM+battery";
+		case ROM_MBC3: 					return "MBC3";
+		case ROM_MBC3_RAM: 				return "MBC3+RAM";
+		case ROM_MBC3_RAM_BATT: 		return "MBC3+RAM+battery";
+		case ROM_MBC5: 					return "MBC5";
+		case ROM_MBC5_RAM: 				return "MBC5+RAM";
+		case ROM_MBC5_RAM_BATT: 		return "MBC5+RAM+battery";
+		case ROM_MBC5_RUMBLE: 			return "MBC5+rumble";
+		case ROM_MBC5_RUMBLE_SRAM: 		return "MBC5+rumble+RAM";
+		case ROM_MBC5_RUMBLE_SRAM_BATT: return "MBC5+rumble+RAM+battery";
+		case ROM_POCKET_CAMERA: 		return "Pocket Camera";
+		case ROM_BANDAI_TAMA5: 			return "Bandai TAMA5";
+		case ROM_HUDSON_HUC3: 			return "HuC3";
+		case ROM_HUDSON_HUC1: 			return "HuC1+RAM+battery";
+		default: 						return "unknown";
+	}
+}
+
 /**
  * /brief Pretty Prints the cart metadata. 
  *
@@ -206,7 +353,7 @@ int get_ram_size(unsigned char ram_byte) {
  */
 void print_cart_metadata(CartMetaData *cart_data) {
 	printf("\n\n%s\n", cart_data->game_name);
-	printf("\tCart Type: %x\n", cart_data->cart_type);
+	printf("\tCart Type: %x (%s)\n", cart_data->cart_type, cart_type_name(cart_data->cart_type));
 	printf("\tRam Size: %d\n", cart_data->ram_size);
 	printf("\tRom Size: %d\n", cart_data->rom_size);
 	printf("\tSuper GB: %d\tColour GB: %d\n", cart_data->super_gb_flag, cart_data->colour_gb_flag);
@@ -222,5 +369,11 @@ void print_cart_metadata(CartMetaData *cart_data) {
  */
 void free_cart_metadata(CartMetaData *cart_data) {
 	free(cart_data->game_name);
+	if (cart_data->rom_mapped) {
+		munmap(cart_data->rom, cart_data->rom_size);
+	}
+	else {
+		free(cart_data->rom);
+	}
 	free(cart_data);
 }
\ No newline at end of file
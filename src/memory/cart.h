@@ -20,13 +20,18 @@
 #define CART_TYPE_ADDRESS 			0x147
 #define ROM_SIZE_ADDRESS 			0x148
 #define RAM_SIZE_ADDRESS 			0x149
+#define HEADER_CHECKSUM_ADDRESS		0x14D
+#define GLOBAL_CHECKSUM_ADDRESS		0x14E	// Two bytes, big endian
+
+#define ENTRY_POINT_ADDRESS 		0x100	// Where execution starts after the boot ROM
 
 #define NAME_LENGTH 				0x11
 
 #define COLOUR_GB_FLAG 				0x80 	// If 0x80, the cart is for GBC
 #define SUPER_GB_FLAG 				0x03 	// If 0x01, cart has Super GB features
 
-#define ROM_BANK_SIZE 				16000	// Each bank of ROM is 16 KB
+#define ROM_BANK_SIZE 				0x4000	// Each bank of ROM is 16 KB
+#define RAM_BANK_SIZE 				0x2000	// Each bank of RAM is 8 KB
 
 // Cart types!
 #define ROM_ONLY 					0x00
@@ -68,6 +73,10 @@ typedef struct {
 	int rom_size; 			/** Size of ROM module on the cart in bytes */
 	unsigned char super_gb_flag;	/** Indicates whether there are special super game boy functions */
 	unsigned char colour_gb_flag;	/** Indicates whether the game is for the GBC. */
+	unsigned char header_checksum;	/** Checksum over the header bytes 0x134 - 0x14C */
+	unsigned short global_checksum;	/** Sum of every byte in the ROM bar these two */
+	unsigned char *rom;				/** The whole ROM, banks back to back. Only filled in by load_rom */
+	int rom_mapped;					/** Whether rom is the ROM file mapped into memory, rather than read in */
 } CartMetaData;
 
 // Some functions. See comments in rom.c for definitions
@@ -75,7 +84,11 @@ CartMetaData* load_rom(const char *file_location, unsigned char *memory_space);
 CartMetaData* read_cart_metadata(FILE *rom_file);
 int get_rom_size(unsigned char rom_byte);
 int get_ram_size(unsigned char ram_byre);
+int cart_has_battery(unsigned char cart_type);
+int cart_has_clock(unsigned char cart_type);
+int cart_has_rumble(unsigned char cart_type);
+const char *cart_type_name(unsigned char cart_type);
 void print_cart_metadata(CartMetaData *cart_data);
-void free_cart_metadata(CartMetaData *cart_data)
+void free_cart_metadata(CartMetaData *cart_data);
 
 #endif // CART_H
\ No newline at end of file
@@ -0,0 +1,59 @@
+/**
+ * This module contains the joypad.
+ *
+ * Rather than work P1 out on every read, the low nibble in memory is kept up to date
+ * instead: write_byte calls update_joypad when the game picks a row, and set_joypad_buttons
+ * does when the buttons change. Reads of P1 are then plain reads of memory like any other.
+ *
+ * Pressing a button requests the joypad interrupt.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "joypad.h"
+#include "memory.h"
+
+static unsigned char held_buttons = 0;		// JOYPAD_ bits, 1 for held
+
+/**
+ * /brief Works out the low nibble of P1 from the rows picked and the buttons held.
+ *
+ * Called by write_byte whenever P1 is written.
+ */
+void update_joypad() {
+	unsigned char select = memory_space[JOYPAD_ADDRESS] & JOYPAD_SELECT_MASK;
+	unsigned char held = 0;
+
+	if (!(select & JOYPAD_SELECT_DIRECTIONS)) {
+		held |= held_buttons & 0x0F;
+	}
+	if (!(select & JOYPAD_SELECT_ACTIONS)) {
+		held |= held_buttons >> 4;
+	}
+
+	memory_space[JOYPAD_ADDRESS] = JOYPAD_UNUSED_BITS | select | (~held & 0x0F);
+}
+
+/**
+ * /brief Sets which buttons are held, requesting the joypad interrupt if any were just pressed.
+ *
+ * @param buttons: JOYPAD_ bits of the buttons held.
+ */
+void set_joypad_buttons(unsigned char buttons) {
+	unsigned char pressed = buttons & ~held_buttons;
+
+	held_buttons = buttons;
+	update_joypad();
+	if (pressed) {
+		write_byte(INTERRUPT_FLAG_ADDRESS, read_byte(INTERRUPT_FLAG_ADDRESS) | INTERRUPT_JOYPAD);
+	}
+}
+
+/**
+ * /brief Lets go of every button, leaving P1 as it is at power on with both rows picked.
+ */
+void reset_joypad() {
+	held_buttons = 0;
+	memory_space[JOYPAD_ADDRESS] = 0;
+	update_joypad();
+}
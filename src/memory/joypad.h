@@ -0,0 +1,34 @@
+/**
+ * A header file for the joypad: which buttons are held, and the P1 register games read
+ * them through.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef JOYPAD_H
+#define JOYPAD_H
+
+#define JOYPAD_ADDRESS 			0xFF00	// P1: picks a row of buttons, then reads it back
+
+// P1 bits. A row is picked by writing 0 to its bit, a button is held while its bit reads 0
+#define JOYPAD_SELECT_DIRECTIONS 	0x10
+#define JOYPAD_SELECT_ACTIONS 		0x20
+#define JOYPAD_SELECT_MASK 			0x30
+#define JOYPAD_UNUSED_BITS 			0xC0	// Always read as 1
+
+// Buttons, as passed to set_joypad_buttons. Directions in the low nibble, as P1 has them
+#define JOYPAD_RIGHT 	0x01
+#define JOYPAD_LEFT 	0x02
+#define JOYPAD_UP 		0x04
+#define JOYPAD_DOWN 	0x08
+#define JOYPAD_A 		0x10
+#define JOYPAD_B 		0x20
+#define JOYPAD_SELECT 	0x40
+#define JOYPAD_START 	0x80
+
+// See joypad.c for more thorough explination of these functions
+void update_joypad();
+void set_joypad_buttons(unsigned char buttons);
+void reset_joypad();
+
+#endif // JOYPAD_H
@@ -0,0 +1,92 @@
+/**
+ * This module keeps the list of mappers the emulator can put a cart in with, one for each
+ * family of bank controller, and picks the one a cart's type calls for.
+ *
+ * Nothing here is on the path reads and writes take. A mapper sets up the memory map and
+ * from then on memory is read and written straight through it, whatever the cart. A mapper
+ * only hears about writes to ROM, or to cart RAM it left unmapped, through cart_written.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "mapper.h"
+#include "memory.h"
+#include "mbc1.h"
+#include "mbc2.h"
+#include "mbc3.h"
+#include "mbc5.h"
+
+/**
+ * /brief Puts a cart with no bank controller in.
+ *
+ * Its ROM has already been copied into the memory space by load_rom. Any RAM it has sits
+ * at 0xA000 - 0xBFFF for good. Without RAM that's left as the map had it.
+ *
+ * @param cart_data: The cart, with its ROM loaded by load_rom.
+ * @param options: Not needed.
+ */
+static void insert_rom_only(CartMetaData *cart_data, const MapperOptions *options) {
+	insert_cart_ram(cart_data->ram_size);
+	if (cart_ram != NULL) {
+		map_bank(CART_RAM_BASE, RAM_BANK_SIZE, cart_ram, cart_ram);
+	}
+}
+
+static const Mapper rom_only_mapper = {"ROM only", insert_rom_only, ignore_cart_write, NULL, NULL};
+static const Mapper mbc1_mapper = {"MBC1", insert_mbc1, mbc1_write, NULL, NULL};
+static const Mapper mbc2_mapper = {"MBC2", insert_mbc2, mbc2_write, NULL, restore_mbc2};
+static const Mapper mbc3_mapper = {"MBC3", insert_mbc3, mbc3_write, save_mbc3, restore_mbc3};
+static const Mapper mbc5_mapper = {"MBC5", insert_mbc5, mbc5_write, NULL, NULL};
+
+/**
+ * /brief Looks up the mapper for a type of cart.
+ *
+ * @param cart_type: The cart type from the header.
+ *
+ * @return The mapper, or NULL if the emulator has none for that type.
+ */
+const Mapper* find_mapper(unsigned char cart_type) {
+	switch (cart_type) {
+		case ROM_ONLY:
+		case ROM_RAM:
+		case ROM_RAM_BATTERY:
+			return &rom_only_mapper;
+		case ROM_MBC1:
+		case ROM_MBC1_RAM:
+		case ROM_MBC1_RAM_BATT:
+			return &mbc1_mapper;
+		case ROM_MBC2:
+		case ROM_MBC2_BATTERY:
+			return &mbc2_mapper;
+		case ROM_MBC3_TIMER_BATT:
+		case ROM_MBC3_TIMER_RAM_BATT:
+		case ROM_MBC3:
+		case ROM_MBC3_RAM:
+		case ROM_MBC3_RAM_BATT:
+			return &mbc3_mapper;
+		case ROM_MBC5:
+		case ROM_MBC5_RAM:
+		case ROM_MBC5_RAM_BATT:
+		case ROM_MBC5_RUMBLE:
+		case ROM_MBC5_RUMBLE_SRAM:
+		case ROM_MBC5_RUMBLE_SRAM_BATT:
+			return &mbc5_mapper;
+		default:
+			return NULL;		// MMM01, HuC1, HuC3, TAMA5 and the Pocket Camera among others
+	}
+}
+
+/**
+ * /brief Puts a cart in with its mapper, as it is at power on.
+ *
+ * The memory map should already be set up by map_memory. From here on writes to the cart
+ * go to the mapper.
+ *
+ * @param mapper: The mapper find_mapper gave for the cart.
+ * @param cart_data: The cart, with its ROM loaded by load_rom.
+ * @param options: What the mapper can hook into.
+ */
+void insert_cart(const Mapper *mapper, CartMetaData *cart_data, const MapperOptions *options) {
+	mapper->insert(cart_data, options);
+	cart_written = mapper->write;
+}
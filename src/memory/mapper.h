@@ -0,0 +1,41 @@
+/**
+ * A header file for mappers, the bank controllers carts are built around, so the front end
+ * (and the tests) can put in whichever one a cart has.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <stdio.h>
+
+#include "cart.h"
+
+/*
+ * Told whenever a rumble cart's motor is turned on or off.
+ */
+typedef void (*RumbleHandler)(int motor_on);
+
+/*
+ * What the front end has for a mapper to hook into. Each takes only what it needs.
+ */
+typedef struct {
+	const unsigned long *cycles;	/** The CPU's cycle count, for a clock keeping emulated time */
+	int clock_source;				/** Where a clock gets the time from, RTC_SOURCE_EMULATED or RTC_SOURCE_HOST */
+	RumbleHandler rumble;			/** Told when a rumble motor turns on or off. May be NULL */
+} MapperOptions;
+
+typedef struct {
+	const char *name;			/** The bank controller, for messages */
+	void (*insert)(CartMetaData *cart_data, const MapperOptions *options);	/** Puts the cart in, as at power on */
+	void (*write)(unsigned short address, unsigned char byte);	/** Takes writes to ROM, and to cart RAM with nothing mapped */
+	int (*save)(FILE *save_file);		/** Writes what it keeps past the cart's RAM to a save. May be NULL */
+	int (*restore)(FILE *save_file);	/** Reads it back, once the RAM has been. May be NULL */
+} Mapper;
+
+// See mapper.c for more thorough explination of these functions
+const Mapper* find_mapper(unsigned char cart_type);
+void insert_cart(const Mapper *mapper, CartMetaData *cart_data, const MapperOptions *options);
+
+#endif // MAPPER_H
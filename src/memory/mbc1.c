@@ -0,0 +1,101 @@
+/**
+ * This module contains the MBC1, the bank controller found in most of the early carts,
+ * Super Mario Land's among them.
+ *
+ * The game picks banks by writing to its ROM, which the memory map hands here through
+ * cart_written. The whole ROM sits in the cart's image and its RAM in cart_ram, so picking
+ * a bank only points that bank's pages of the memory map into one or the other. Nothing
+ * is copied, and a region whose bank hasn't changed is left as it is.
+ *
+ * BANK1 gives the low 5 bits of the ROM bank at 0x4000 - 0x7FFF, 0 picking 1. BANK2 gives
+ * two bits more. In mode 0 they only go to that ROM bank. In mode 1 they pick the RAM bank
+ * too, and on carts of 1MB or more the ROM bank at 0x0000 - 0x3FFF, as those carts wire
+ * BANK2 to the ROM's top address lines either way. Bank numbers past the end of the ROM or
+ * RAM wrap around, as the address lines for them aren't there.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "mbc1.h"
+#include "memory.h"
+
+static unsigned char *rom = NULL;
+static unsigned int rom_banks;
+static unsigned int ram_banks;
+
+static unsigned char ram_enabled = 0;
+static unsigned char bank1 = 1;
+static unsigned char bank2 = 0;
+static unsigned char mode = 0;
+
+/**
+ * /brief Maps in the banks the registers pick.
+ */
+static void map_banks() {
+	unsigned int high_bank = ((bank2 << MBC1_BANK2_SHIFT) | bank1) % rom_banks;
+	unsigned int low_bank = mode ? (bank2 << MBC1_BANK2_SHIFT) % rom_banks : 0;
+	unsigned char *ram = NULL;
+
+	if (ram_enabled && cart_ram != NULL) {
+		ram = cart_ram + (mode ? bank2 % ram_banks : 0) * RAM_BANK_SIZE;
+	}
+
+	current_rom_bank = high_bank;
+	map_bank(0, ROM_BANK_SIZE, rom + low_bank * ROM_BANK_SIZE, NULL);
+	map_bank(SWITCHABLE_ROM_BASE, ROM_BANK_SIZE, rom + high_bank * ROM_BANK_SIZE, NULL);
+	map_bank(CART_RAM_BASE, RAM_BANK_SIZE, ram, ram);
+}
+
+/**
+ * /brief Puts an MBC1 cart in, as it is at power on.
+ *
+ * The memory map should already be set up by map_memory. Gives the cart its RAM, if it has
+ * any, and maps in the first banks.
+ *
+ * @param cart_data: The cart, with its ROM loaded by load_rom.
+ * @param options: Not needed.
+ */
+void insert_mbc1(CartMetaData *cart_data, const MapperOptions *options) {
+	rom = cart_data->rom;
+	rom_banks = cart_data->rom_size / ROM_BANK_SIZE;
+
+	insert_cart_ram(cart_data->ram_size);
+	ram_banks = cart_ram_size > 0 ? cart_ram_size / RAM_BANK_SIZE : 1;
+
+	ram_enabled = 0;
+	bank1 = 1;
+	bank2 = 0;
+	mode = 0;
+	map_banks();
+}
+
+/**
+ * /brief Takes a write to the cart, setting whichever register it lands on.
+ *
+ * Called by write_byte for writes to ROM, and to the cart's RAM while it's turned off.
+ *
+ * @param address: The address written to
+ * @param byte: The byte written
+ */
+void mbc1_write(unsigned short address, unsigned char byte) {
+	if (address >= ROM_AREA_END) {
+		return;		// RAM that's turned off
+	}
+
+	if (address < MBC1_RAM_ENABLE_END) {
+		ram_enabled = (byte & 0x0F) == MBC1_RAM_ENABLE_VALUE;
+	}
+	else if (address < MBC1_BANK1_END) {
+		bank1 = byte & MBC1_BANK1_MASK;
+		if (bank1 == 0) {
+			bank1 = 1;
+		}
+	}
+	else if (address < MBC1_BANK2_END) {
+		bank2 = byte & MBC1_BANK2_MASK;
+	}
+	else {
+		mode = byte & 1;
+	}
+	map_banks();
+}
@@ -0,0 +1,27 @@
+/**
+ * A header file for the MBC1, the bank controller found in most of the early carts.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef MBC1_H
+#define MBC1_H
+
+#include "mapper.h"
+
+// MBC1 registers, each taking writes anywhere in its range of ROM
+#define MBC1_RAM_ENABLE_END 	0x2000	// 0x0A in the low nibble turns the RAM on
+#define MBC1_BANK1_END 			0x4000	// Low 5 bits of the ROM bank. 0 picks 1
+#define MBC1_BANK2_END 			0x6000	// 2 more bits, for the ROM bank or the RAM bank
+#define MBC1_MODE_END 			0x8000	// Banking mode
+
+#define MBC1_RAM_ENABLE_VALUE 	0x0A
+#define MBC1_BANK1_MASK 		0x1F
+#define MBC1_BANK2_MASK 		0x03
+#define MBC1_BANK2_SHIFT 		5		// Where BANK2 sits in the ROM bank number
+
+// See mbc1.c for more thorough explination of these functions
+void insert_mbc1(CartMetaData *cart_data, const MapperOptions *options);
+void mbc1_write(unsigned short address, unsigned char byte);
+
+#endif // MBC1_H
@@ -0,0 +1,111 @@
+/**
+ * This module contains the MBC2, a bank controller with 512 half bytes of RAM built in.
+ *
+ * Up to 16 ROM banks are picked just as with the MBC1 (see mbc1.c), by pointing pages of
+ * the memory map into the cart's image. Both registers sit in 0x0000 - 0x3FFF, told apart
+ * by bit 8 of the address written to.
+ *
+ * The RAM is only 512 bytes, which the cart repeats through 0xA000 - 0xBFFF, and only
+ * the low half of each byte is there. It's kept with the top half already set, as that's
+ * how it reads, so each 512 bytes of the area is mapped straight onto it for reading.
+ * Writes have that half set too, so they come here through cart_written instead.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "mbc2.h"
+#include "memory.h"
+
+static unsigned char *rom = NULL;
+static unsigned int rom_banks;
+
+static unsigned char ram_enabled = 0;
+static unsigned char rom_bank = 1;
+
+/**
+ * /brief Maps in the banks the registers pick.
+ */
+static void map_banks() {
+	unsigned int address;
+
+	current_rom_bank = rom_bank % rom_banks;
+	map_bank(0, ROM_BANK_SIZE, rom, NULL);
+	map_bank(SWITCHABLE_ROM_BASE, ROM_BANK_SIZE, rom + current_rom_bank * ROM_BANK_SIZE, NULL);
+	for (address = CART_RAM_BASE; address < CART_RAM_END; address += MBC2_RAM_SIZE) {
+		map_bank(address, MBC2_RAM_SIZE, ram_enabled ? cart_ram : NULL, NULL);
+	}
+}
+
+/**
+ * /brief Puts an MBC2 cart in, as it is at power on.
+ *
+ * The memory map should already be set up by map_memory. Gives the cart its RAM, which
+ * every MBC2 has whatever the header says, and maps in the first banks.
+ *
+ * @param cart_data: The cart, with its ROM loaded by load_rom.
+ * @param options: Not needed.
+ */
+void insert_mbc2(CartMetaData *cart_data, const MapperOptions *options) {
+	rom = cart_data->rom;
+	rom_banks = cart_data->rom_size / ROM_BANK_SIZE;
+
+	insert_cart_ram(0);
+	cart_ram = malloc(MBC2_RAM_SIZE);
+	cart_ram_size = MBC2_RAM_SIZE;
+	memset(cart_ram, MBC2_RAM_UNUSED_BITS, MBC2_RAM_SIZE);
+
+	ram_enabled = 0;
+	rom_bank = 1;
+	map_banks();
+}
+
+/**
+ * /brief Takes a write to the cart, setting whichever register it lands on.
+ *
+ * Called by write_byte for writes to ROM, and to the cart's RAM, which is never mapped
+ * for writing.
+ *
+ * @param address: The address written to
+ * @param byte: The byte written
+ */
+void mbc2_write(unsigned short address, unsigned char byte) {
+	if (address >= CART_RAM_BASE) {
+		if (ram_enabled) {
+			cart_ram[address & (MBC2_RAM_SIZE - 1)] = byte | MBC2_RAM_UNUSED_BITS;
+		}
+		return;
+	}
+	if (address >= MBC2_REGISTER_END) {
+		return;		// Nothing there
+	}
+
+	if (address & MBC2_ROM_BANK_SELECT) {
+		rom_bank = byte & MBC2_ROM_BANK_MASK;
+		if (rom_bank == 0) {
+			rom_bank = 1;
+		}
+	}
+	else {
+		ram_enabled = (byte & 0x0F) == MBC2_RAM_ENABLE_VALUE;
+	}
+	map_banks();
+}
+
+/**
+ * /brief Tidies up RAM loaded from a save, as other emulators don't all set the top halves.
+ *
+ * @param save_file: The save, read up to the end of the RAM. Nothing more is read.
+ *
+ * @return 1, as there's nothing that can be missing.
+ */
+int restore_mbc2(FILE *save_file) {
+	unsigned int i;
+
+	for (i = 0; i < cart_ram_size; i++) {
+		cart_ram[i] |= MBC2_RAM_UNUSED_BITS;
+	}
+	return 1;
+}
@@ -0,0 +1,26 @@
+/**
+ * A header file for the MBC2, the bank controller with its own half bytes of RAM.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef MBC2_H
+#define MBC2_H
+
+#include "mapper.h"
+
+// Both MBC2 registers take writes anywhere in 0x0000 - 0x3FFF. Bit 8 of the address picks which
+#define MBC2_REGISTER_END 		0x4000
+#define MBC2_ROM_BANK_SELECT 	0x0100	// Set for the ROM bank, clear for turning the RAM on
+#define MBC2_RAM_ENABLE_VALUE 	0x0A
+#define MBC2_ROM_BANK_MASK 		0x0F	// 4 bits of ROM bank. 0 picks 1
+
+#define MBC2_RAM_SIZE 			0x200	// 512 half bytes, over and over through 0xA000 - 0xBFFF
+#define MBC2_RAM_UNUSED_BITS 	0xF0	// The top half of each byte isn't there, so reads as 1s
+
+// See mbc2.c for more thorough explination of these functions
+void insert_mbc2(CartMetaData *cart_data, const MapperOptions *options);
+void mbc2_write(unsigned short address, unsigned char byte);
+int restore_mbc2(FILE *save_file);
+
+#endif // MBC2_H
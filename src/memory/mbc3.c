@@ -0,0 +1,337 @@
+/**
+ * This module contains the MBC3, the bank controller with a real time clock, found in
+ * Pokemon Gold and Silver among others.
+ *
+ * Banks are picked just as with the MBC1 (see mbc1.c), by pointing pages of the memory map
+ * into the cart's image or cart_ram. The ROM bank has 7 bits and there is only the one
+ * banking mode.
+ *
+ * The clock is never ticked. It keeps an epoch instead: the time, from its source, at which
+ * it would have read 0 days 00:00:00. The seconds, minutes, hours and days are only worked
+ * out from that when the game latches the clock or writes one of its registers. Reads get
+ * the latched copy, as on the real thing, so no work is done for them. The source is either
+ * the CPU's cycle count, so a run sees the same times whatever the host is doing, or the
+ * host's clock. Halting the clock keeps the time it showed instead, and setting a register
+ * moves the epoch so the clock reads what was set.
+ *
+ * A picked clock register is read through a bank's worth of its latched value, so reads
+ * go through the memory map like any other. Writes to it come here through cart_written.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "mbc3.h"
+#include "memory.h"
+
+#define SECONDS_PER_MINUTE 	60
+#define SECONDS_PER_HOUR 	3600
+#define SECONDS_PER_DAY 	86400
+#define RTC_DAYS 			512		// Days the day counter holds
+
+static unsigned char *rom = NULL;
+static unsigned int rom_banks;
+static unsigned int ram_banks;
+static int has_clock;
+
+static unsigned char ram_enabled = 0;
+static unsigned char rom_bank = 1;
+static unsigned char ram_select = 0;		// RAM bank, or clock register
+static unsigned char last_latch_write = 0xFF;
+
+static const unsigned long *cycle_count = NULL;
+static int source = RTC_SOURCE_EMULATED;
+static long long epoch = 0;					// In the source's ticks
+static long long halted_seconds = 0;		// What the clock shows while halted
+static unsigned char halted = 0;
+static unsigned char day_carry = 0;
+static unsigned char latched[RTC_REGISTER_COUNT];
+
+static unsigned char register_bank[RAM_BANK_SIZE];	// The picked clock register, over and over
+
+/**
+ * /brief The time now, from the clock's source.
+ */
+static long long now() {
+	return source == RTC_SOURCE_HOST ? (long long) time(NULL) : (long long) *cycle_count;
+}
+
+/**
+ * /brief How many of the source's ticks make a second.
+ */
+static long long ticks_per_second() {
+	return source == RTC_SOURCE_HOST ? 1 : CPU_CLOCK_RATE;
+}
+
+/**
+ * /brief Works out the seconds on the clock from the epoch.
+ *
+ * Past 511 days the day counter goes round and sets its carry, so the epoch is moved on
+ * by as many times 512 days.
+ *
+ * @return Seconds since the clock read 0 days 00:00:00.
+ */
+static long long clock_seconds() {
+	long long seconds;
+
+	if (halted) {
+		return halted_seconds;
+	}
+
+	seconds = (now() - epoch) / ticks_per_second();
+	if (seconds >= (long long) RTC_DAYS * SECONDS_PER_DAY) {
+		long long wraps = seconds / ((long long) RTC_DAYS * SECONDS_PER_DAY);
+
+		epoch += wraps * RTC_DAYS * SECONDS_PER_DAY * ticks_per_second();
+		seconds -= wraps * RTC_DAYS * SECONDS_PER_DAY;
+		day_carry = 1;
+	}
+	return seconds;
+}
+
+/**
+ * /brief Sets the clock to read a number of seconds from now on.
+ */
+static void set_clock_seconds(long long seconds) {
+	halted_seconds = seconds;
+	epoch = now() - seconds * ticks_per_second();
+}
+
+/**
+ * /brief Splits a number of seconds into the clock's registers, along with its flags.
+ */
+static void seconds_to_registers(long long seconds, unsigned char *registers) {
+	long long days = seconds / SECONDS_PER_DAY;
+
+	registers[RTC_SECONDS - RTC_SECONDS] = seconds % SECONDS_PER_MINUTE;
+	registers[RTC_MINUTES - RTC_SECONDS] = seconds / SECONDS_PER_MINUTE % 60;
+	registers[RTC_HOURS - RTC_SECONDS] = seconds / SECONDS_PER_HOUR % 24;
+	registers[RTC_DAYS_LOW - RTC_SECONDS] = days & 0xFF;
+	registers[RTC_DAYS_HIGH - RTC_SECONDS] = ((days >> 8) & RTC_DAY_HIGH_BIT) | (halted ? RTC_HALT : 0) |
+		(day_carry ? RTC_DAY_CARRY : 0);
+}
+
+/**
+ * /brief Adds up the clock's registers into a number of seconds. The flags are left out.
+ */
+static long long registers_to_seconds(const unsigned char *registers) {
+	long long days = registers[RTC_DAYS_LOW - RTC_SECONDS] |
+		((registers[RTC_DAYS_HIGH - RTC_SECONDS] & RTC_DAY_HIGH_BIT) << 8);
+
+	return days * SECONDS_PER_DAY + registers[RTC_HOURS - RTC_SECONDS] * SECONDS_PER_HOUR +
+		registers[RTC_MINUTES - RTC_SECONDS] * SECONDS_PER_MINUTE + registers[RTC_SECONDS - RTC_SECONDS];
+}
+
+/**
+ * /brief Fills the clock register bank with the latched value of the picked register.
+ */
+static void fill_register_bank() {
+	if (ram_select >= RTC_SECONDS && ram_select <= RTC_DAYS_HIGH) {
+		memset(register_bank, latched[ram_select - RTC_SECONDS], sizeof(register_bank));
+	}
+}
+
+/**
+ * /brief Maps in the banks the registers pick.
+ */
+static void map_banks() {
+	unsigned char *read = NULL, *write = NULL;
+
+	if (!ram_enabled) {
+		// Open bus
+	}
+	else if (ram_select < RTC_SECONDS) {
+		if (cart_ram != NULL) {
+			read = write = cart_ram + (ram_select % ram_banks) * RAM_BANK_SIZE;
+		}
+	}
+	else if (has_clock && ram_select <= RTC_DAYS_HIGH) {
+		read = register_bank;
+	}
+
+	current_rom_bank = rom_bank % rom_banks;
+	map_bank(0, ROM_BANK_SIZE, rom, NULL);
+	map_bank(SWITCHABLE_ROM_BASE, ROM_BANK_SIZE, rom + current_rom_bank * ROM_BANK_SIZE, NULL);
+	map_bank(CART_RAM_BASE, RAM_BANK_SIZE, read, write);
+}
+
+/**
+ * /brief Puts an MBC3 cart in, as it is at power on.
+ *
+ * The memory map should already be set up by map_memory. Gives the cart its RAM, if it has
+ * any, starts its clock at 0 days 00:00:00 and maps in the first banks.
+ *
+ * @param cart_data: The cart, with its ROM loaded by load_rom.
+ * @param options: Its clock_source says where the clock gets the time from. With
+ * 	RTC_SOURCE_EMULATED the clock keeps time by its cycles.
+ */
+void insert_mbc3(CartMetaData *cart_data, const MapperOptions *options) {
+	rom = cart_data->rom;
+	rom_banks = cart_data->rom_size / ROM_BANK_SIZE;
+	has_clock = cart_has_clock(cart_data->cart_type);
+
+	insert_cart_ram(cart_data->ram_size);
+	ram_banks = cart_ram_size > 0 ? cart_ram_size / RAM_BANK_SIZE : 1;
+
+	cycle_count = options->cycles;
+	source = options->clock_source;
+	halted = 0;
+	day_carry = 0;
+	set_clock_seconds(0);
+	memset(latched, 0, sizeof(latched));
+
+	ram_enabled = 0;
+	rom_bank = 1;
+	ram_select = 0;
+	last_latch_write = 0xFF;
+	map_banks();
+}
+
+/**
+ * /brief Sets one of the clock's registers, leaving the rest showing what they did.
+ */
+static void write_clock_register(unsigned char reg, unsigned char byte) {
+	static const unsigned char masks[RTC_REGISTER_COUNT] = {0x3F, 0x3F, 0x1F, 0xFF, RTC_DAY_HIGH_BIT | RTC_HALT | RTC_DAY_CARRY};
+	unsigned char registers[RTC_REGISTER_COUNT];
+
+	seconds_to_registers(clock_seconds(), registers);
+	registers[reg - RTC_SECONDS] = byte & masks[reg - RTC_SECONDS];
+
+	halted = (registers[RTC_DAYS_HIGH - RTC_SECONDS] & RTC_HALT) != 0;
+	day_carry = (registers[RTC_DAYS_HIGH - RTC_SECONDS] & RTC_DAY_CARRY) != 0;
+	set_clock_seconds(registers_to_seconds(registers));
+}
+
+/**
+ * /brief Takes a write to the cart, setting whichever register it lands on.
+ *
+ * Called by write_byte for writes to ROM, and to the cart's RAM area while no RAM is
+ * mapped in there, which is where the clock's registers are written.
+ *
+ * @param address: The address written to
+ * @param byte: The byte written
+ */
+void mbc3_write(unsigned short address, unsigned char byte) {
+	if (address >= ROM_AREA_END) {
+		if (ram_enabled && has_clock && ram_select >= RTC_SECONDS && ram_select <= RTC_DAYS_HIGH) {
+			write_clock_register(ram_select, byte);
+		}
+		return;
+	}
+
+	if (address < MBC3_RAM_ENABLE_END) {
+		ram_enabled = (byte & 0x0F) == MBC3_RAM_ENABLE_VALUE;
+	}
+	else if (address < MBC3_ROM_BANK_END) {
+		rom_bank = byte & MBC3_ROM_BANK_MASK;
+		if (rom_bank == 0) {
+			rom_bank = 1;
+		}
+	}
+	else if (address < MBC3_RAM_BANK_END) {
+		ram_select = byte;
+		fill_register_bank();
+	}
+	else {
+		if (last_latch_write == 0 && byte == 1 && has_clock) {
+			seconds_to_registers(clock_seconds(), latched);
+			fill_register_bank();
+		}
+		last_latch_write = byte;
+		return;
+	}
+	map_banks();
+}
+
+/**
+ * /brief Writes the clock into the RTC_SAVE_SIZE bytes it takes in a save file.
+ *
+ * @param saved: Where to write it.
+ */
+void save_mbc3_clock(unsigned char *saved) {
+	unsigned char registers[RTC_REGISTER_COUNT];
+	long long host_time = time(NULL);
+	int i, j;
+
+	seconds_to_registers(clock_seconds(), registers);
+	memset(saved, 0, RTC_SAVE_SIZE);
+	for (i = 0; i < RTC_REGISTER_COUNT; i++) {
+		saved[i * 4] = registers[i];
+		saved[(RTC_REGISTER_COUNT + i) * 4] = latched[i];
+	}
+	for (j = 0; j < 8; j++) {
+		saved[RTC_REGISTER_COUNT * 8 + j] = host_time >> (j * 8);
+	}
+}
+
+/**
+ * /brief Sets the clock to what a save file held.
+ *
+ * Keeping host time, the clock has run on since the save was written unless it was
+ * halted. Keeping emulated time, it carries on from exactly where it was, so runs from
+ * the same save see the same times.
+ *
+ * @param saved: The RTC_SAVE_SIZE bytes of clock from the save file.
+ */
+void load_mbc3_clock(const unsigned char *saved) {
+	unsigned char registers[RTC_REGISTER_COUNT];
+	long long seconds, saved_at = 0;
+	int i, j;
+
+	for (i = 0; i < RTC_REGISTER_COUNT; i++) {
+		registers[i] = saved[i * 4];
+		latched[i] = saved[(RTC_REGISTER_COUNT + i) * 4];
+	}
+	for (j = 0; j < 8; j++) {
+		saved_at |= (long long) saved[RTC_REGISTER_COUNT * 8 + j] << (j * 8);
+	}
+
+	halted = (registers[RTC_DAYS_HIGH - RTC_SECONDS] & RTC_HALT) != 0;
+	day_carry = (registers[RTC_DAYS_HIGH - RTC_SECONDS] & RTC_DAY_CARRY) != 0;
+	seconds = registers_to_seconds(registers);
+	if (source == RTC_SOURCE_HOST && !halted && time(NULL) > saved_at) {
+		seconds += time(NULL) - saved_at;
+	}
+	set_clock_seconds(seconds);
+	clock_seconds();		// Carries the day counter if the time away took it past 511
+	fill_register_bank();
+}
+
+/**
+ * /brief Writes the clock to a save, after the cart's RAM. Carts without one write nothing.
+ *
+ * @param save_file: The save, written up to the end of the RAM.
+ *
+ * @return 1 if it was written. 0 otherwise.
+ */
+int save_mbc3(FILE *save_file) {
+	unsigned char saved[RTC_SAVE_SIZE];
+
+	if (!has_clock) {
+		return 1;
+	}
+	save_mbc3_clock(saved);
+	return fwrite(saved, sizeof(unsigned char), RTC_SAVE_SIZE, save_file) == RTC_SAVE_SIZE;
+}
+
+/**
+ * /brief Reads the clock back from a save, after the cart's RAM.
+ *
+ * @param save_file: The save, read up to the end of the RAM.
+ *
+ * @return 1 if the clock was there, or the cart has none. 0 if the clock is left as it was.
+ */
+int restore_mbc3(FILE *save_file) {
+	unsigned char saved[RTC_SAVE_SIZE];
+
+	if (!has_clock) {
+		return 1;
+	}
+	if (fread(saved, sizeof(unsigned char), RTC_SAVE_SIZE, save_file) != RTC_SAVE_SIZE) {
+		return 0;
+	}
+	load_mbc3_clock(saved);
+	return 1;
+}
@@ -0,0 +1,51 @@
+/**
+ * A header file for the MBC3, the bank controller with a real time clock.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef MBC3_H
+#define MBC3_H
+
+#include "mapper.h"
+
+// MBC3 registers, each taking writes anywhere in its range of ROM
+#define MBC3_RAM_ENABLE_END 	0x2000	// 0x0A in the low nibble turns the RAM and clock on
+#define MBC3_ROM_BANK_END 		0x4000	// 7 bits of ROM bank. 0 picks 1
+#define MBC3_RAM_BANK_END 		0x6000	// RAM bank 0 - 3, or a clock register 0x08 - 0x0C
+#define MBC3_LATCH_END 			0x8000	// Writing 0 then 1 latches the clock
+
+#define MBC3_RAM_ENABLE_VALUE 	0x0A
+#define MBC3_ROM_BANK_MASK 		0x7F
+
+// Clock registers, as picked through 0x4000 - 0x5FFF
+#define RTC_SECONDS 			0x08
+#define RTC_MINUTES 			0x09
+#define RTC_HOURS 				0x0A
+#define RTC_DAYS_LOW 			0x0B	// Low 8 bits of the day counter
+#define RTC_DAYS_HIGH 			0x0C	// Bit 8 of the day counter, along with the flags below
+#define RTC_REGISTER_COUNT 		5
+
+#define RTC_DAY_HIGH_BIT 		0x01
+#define RTC_HALT 				0x40	// Stops the clock
+#define RTC_DAY_CARRY 			0x80	// Set when the day counter goes past 511, until cleared
+
+#define CPU_CLOCK_RATE 			4194304	// Cycles a second
+
+// Where the clock gets the time from
+#define RTC_SOURCE_EMULATED 	0	// The CPU's cycle count, so every run sees the same times
+#define RTC_SOURCE_HOST 		1	// The host's clock, as a real cart would
+
+// The clock's part of a save file: the registers and the latched registers, 4 bytes each,
+// then the host time it was saved at in 8. Laid out as most emulators do
+#define RTC_SAVE_SIZE 			48
+
+// See mbc3.c for more thorough explination of these functions
+void insert_mbc3(CartMetaData *cart_data, const MapperOptions *options);
+void mbc3_write(unsigned short address, unsigned char byte);
+void save_mbc3_clock(unsigned char *saved);
+void load_mbc3_clock(const unsigned char *saved);
+int save_mbc3(FILE *save_file);
+int restore_mbc3(FILE *save_file);
+
+#endif // MBC3_H
@@ -0,0 +1,122 @@
+/**
+ * This module contains the MBC5, the bank controller for carts of up to 8MB of ROM and
+ * 128KB of RAM, and the one rumble carts are built around.
+ *
+ * Banks are picked just as with the MBC1 (see mbc1.c), by pointing pages of the memory map
+ * into the cart's image or cart_ram. The ROM bank has 9 bits, written in two halves, and
+ * unlike the earlier controllers bank 0 can be mapped in at 0x4000 - 0x7FFF. There is only
+ * the one banking mode.
+ *
+ * Carts this big are the reason load_rom maps the ROM file rather than reading it: only the
+ * banks the game picks are ever read from disk.
+ *
+ * On rumble carts the top bit of the RAM bank drives the motor instead. The front end is
+ * told through the RumbleHandler in the options it put the cart in with, only when the motor changes, as
+ * games write the register far more often than that.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include "mbc5.h"
+#include "memory.h"
+
+static unsigned char *rom = NULL;
+static unsigned int rom_banks;
+static unsigned int ram_banks;
+static int has_rumble;
+static RumbleHandler rumble_changed = NULL;
+
+static unsigned char ram_enabled = 0;
+static unsigned short rom_bank = 1;
+static unsigned char ram_bank = 0;
+static unsigned char motor_on = 0;
+
+/**
+ * /brief Maps in the banks the registers pick.
+ */
+static void map_banks() {
+	unsigned char *ram = NULL;
+
+	if (ram_enabled && cart_ram != NULL) {
+		ram = cart_ram + (ram_bank % ram_banks) * RAM_BANK_SIZE;
+	}
+
+	current_rom_bank = rom_bank % rom_banks;
+	map_bank(0, ROM_BANK_SIZE, rom, NULL);
+	map_bank(SWITCHABLE_ROM_BASE, ROM_BANK_SIZE, rom + current_rom_bank * ROM_BANK_SIZE, NULL);
+	map_bank(CART_RAM_BASE, RAM_BANK_SIZE, ram, ram);
+}
+
+/**
+ * /brief Puts an MBC5 cart in, as it is at power on.
+ *
+ * The memory map should already be set up by map_memory. Gives the cart its RAM, if it has
+ * any, and maps in the first banks.
+ *
+ * @param cart_data: The cart, with its ROM loaded by load_rom.
+ * @param options: Its rumble is told when the motor of a rumble cart turns on or off.
+ */
+void insert_mbc5(CartMetaData *cart_data, const MapperOptions *options) {
+	rom = cart_data->rom;
+	rom_banks = cart_data->rom_size / ROM_BANK_SIZE;
+	has_rumble = cart_has_rumble(cart_data->cart_type);
+	rumble_changed = options->rumble;
+
+	insert_cart_ram(cart_data->ram_size);
+	ram_banks = cart_ram_size > 0 ? cart_ram_size / RAM_BANK_SIZE : 1;
+
+	ram_enabled = 0;
+	rom_bank = 1;
+	ram_bank = 0;
+	motor_on = 0;
+	map_banks();
+}
+
+/**
+ * /brief Turns the motor of a rumble cart on or off, telling the front end if it changed.
+ */
+static void set_motor(unsigned char on) {
+	if (on != motor_on) {
+		motor_on = on;
+		if (rumble_changed != NULL) {
+			rumble_changed(on);
+		}
+	}
+}
+
+/**
+ * /brief Takes a write to the cart, setting whichever register it lands on.
+ *
+ * Called by write_byte for writes to ROM, and to the cart's RAM while it's turned off.
+ *
+ * @param address: The address written to
+ * @param byte: The byte written
+ */
+void mbc5_write(unsigned short address, unsigned char byte) {
+	if (address >= ROM_AREA_END) {
+		return;		// RAM that's turned off
+	}
+
+	if (address < MBC5_RAM_ENABLE_END) {
+		ram_enabled = byte == MBC5_RAM_ENABLE_VALUE;
+	}
+	else if (address < MBC5_ROM_BANK_LOW_END) {
+		rom_bank = (rom_bank & 0x100) | byte;
+	}
+	else if (address < MBC5_ROM_BANK_HIGH_END) {
+		rom_bank = (rom_bank & 0xFF) | ((byte & MBC5_ROM_BANK_HIGH_MASK) << 8);
+	}
+	else if (address < MBC5_RAM_BANK_END) {
+		if (has_rumble) {
+			ram_bank = byte & MBC5_RUMBLE_RAM_MASK;
+			set_motor((byte & MBC5_RUMBLE_MOTOR) != 0);
+		}
+		else {
+			ram_bank = byte & MBC5_RAM_BANK_MASK;
+		}
+	}
+	else {
+		return;		// Nothing there
+	}
+	map_banks();
+}
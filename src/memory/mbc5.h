@@ -0,0 +1,28 @@
+/**
+ * A header file for the MBC5, the bank controller for the biggest carts, rumble carts among them.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef MBC5_H
+#define MBC5_H
+
+#include "mapper.h"
+
+// MBC5 registers, each taking writes anywhere in its range of ROM
+#define MBC5_RAM_ENABLE_END 	0x2000	// 0x0A turns the RAM on. Anything else turns it off
+#define MBC5_ROM_BANK_LOW_END 	0x3000	// Low 8 bits of the ROM bank. 0 picks 0
+#define MBC5_ROM_BANK_HIGH_END 	0x4000	// Bit 8 of the ROM bank
+#define MBC5_RAM_BANK_END 		0x6000	// RAM bank 0 - 15, with the motor on rumble carts
+
+#define MBC5_RAM_ENABLE_VALUE 	0x0A
+#define MBC5_ROM_BANK_HIGH_MASK 0x01
+#define MBC5_RAM_BANK_MASK 		0x0F
+#define MBC5_RUMBLE_RAM_MASK 	0x07	// Rumble carts only have the 3 low bits for the RAM bank
+#define MBC5_RUMBLE_MOTOR 		0x08	// As the 4th drives the motor
+
+// See mbc5.c for more thorough explination of these functions
+void insert_mbc5(CartMetaData *cart_data, const MapperOptions *options);
+void mbc5_write(unsigned short address, unsigned char byte);
+
+#endif // MBC5_H
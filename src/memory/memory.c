@@ -2,24 +2,52 @@
  * This module contains functions and other resources useful for interfacing with the system's 
  * memory.
  *
+ * Every access goes through memory_map, one entry per 256 byte page. Reads are always
+ * a lookup and an offset, so map_memory must be called before anything is read. Writes
+ * needing more than that (the I/O ports, the cart's registers, echo RAM, pages holding
+ * cached code) have a NULL entry and take the slow path here.
+ *
  * Authors: Rocky Petkov
  */
 
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "memory.h"
+#include "joypad.h"
+#include "cart.h"
+#include "../cpu/interrupts.h"
+
+unsigned short current_rom_bank = 1;
+unsigned char code_pages[CODE_PAGE_COUNT];
+void (*code_page_written)(unsigned short page) = 0;
+void (*cart_written)(unsigned short address, unsigned char byte) = 0;
+MemoryMap memory_map;
+unsigned char *cart_ram = NULL;
+unsigned int cart_ram_size = 0;
+
+static void write_unmapped(unsigned short address, unsigned char byte) __attribute__((noinline));
+static int page_holds_code(unsigned short page);
+static int is_cart_address(unsigned short address);
+static void forget_code_on_page(unsigned short page);
+
+static unsigned char open_bus[1 << MEMORY_PAGE_SHIFT];	// Read where nothing is mapped
 
 /**
  * /brief Reads a byte of memory from the supplied address
  *
  * Reads a byte of memory from the supplied address. This function will not pay heed 
  * to whether the request is legal or even advisable, so it is best to ensure this in the
- * calling environment. 
+ * calling environment. The I/O ports are kept up to date in memory by whatever changes
+ * them, so every page can be read straight from the host.
  * 
  * @param address: Address of where the byte we wish to read
  * 
  * @return: The value stored at the supplied address.
  */
 unsigned char read_byte(unsigned short address) {
-	return memory_space[address];
+	return memory_map.read[address >> MEMORY_PAGE_SHIFT][address & MEMORY_PAGE_MASK];
 }
 
 /**
@@ -27,11 +55,235 @@ unsigned char read_byte(unsigned short address) {
  *
  * Writes a byte to memory at the supplied address. This function
  * pays no heed to whether the request is legal or advidable, so it is 
- * best to ensure legality within the calling environment
+ * best to ensure legality within the calling environment. Mapped pages are
+ * written straight to the host, the rest are left to write_unmapped.
  *
  * @param address: The address we wish to write the byte to
  * @param byte: The byte we wish to write to memory
  */
 void write_byte(unsigned short address, unsigned char byte) {
-	memory_space[address] = byte;
-}
\ No newline at end of file
+	unsigned char *page = memory_map.write[address >> MEMORY_PAGE_SHIFT];
+
+	if (page != NULL) {
+		page[address & MEMORY_PAGE_MASK] = byte;
+		return;
+	}
+	write_unmapped(address, byte);
+}
+
+/**
+ * /brief Writes a byte to a page the memory map doesn't let through.
+ *
+ * Once a cartridge is in, writes to its ROM go to cart_written instead of memory, as do
+ * writes to its RAM while none is mapped in. Writes
+ * to echo RAM go to the work RAM it mirrors. If the write lands on a page holding cached
+ * code, whoever cached it is told, and the page goes back in the map once none is left.
+ * Writes to IF and IE are passed on to the interrupt controller, writes to P1 to the joypad.
+ * Kept out of line so write_byte stays small enough to inline everywhere.
+ *
+ * @param address: The address we wish to write the byte to
+ * @param byte: The byte we wish to write to memory
+ */
+static void write_unmapped(unsigned short address, unsigned char byte) {
+	unsigned short page = address >> MEMORY_PAGE_SHIFT;
+	unsigned char *writable = memory_map.writable[page];
+
+	if (writable == NULL && is_cart_address(address) && cart_written != NULL) {
+		cart_written(address, byte);
+		return;
+	}
+	if (address >= ECHO_RAM_BASE && address < ECHO_RAM_END) {
+		write_byte(address - ECHO_RAM_OFFSET, byte);
+		return;
+	}
+
+	if (writable != NULL) {
+		writable[address & MEMORY_PAGE_MASK] = byte;
+	}
+	else {
+		memory_space[address] = byte;
+	}
+	if (code_pages[address >> CODE_PAGE_SHIFT]) {
+		code_page_written(address >> CODE_PAGE_SHIFT);
+	}
+
+	if (writable != NULL) {
+		if (!page_holds_code(page)) {
+			memory_map.write[page] = writable;
+		}
+	}
+	else if (address == INTERRUPT_FLAG_ADDRESS || address == INTERRUPT_ENABLE_ADDRESS) {
+		update_interrupts_pending();
+	}
+	else if (address == JOYPAD_ADDRESS) {
+		update_joypad();
+	}
+}
+
+/**
+ * /brief Whether any code page within a memory page has code cached on it.
+ */
+static int page_holds_code(unsigned short page) {
+	int first = page << (MEMORY_PAGE_SHIFT - CODE_PAGE_SHIFT);
+	int i;
+
+	for (i = first; i < first + (1 << (MEMORY_PAGE_SHIFT - CODE_PAGE_SHIFT)); i++) {
+		if (code_pages[i]) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/**
+ * /brief Tells whoever cached code within a memory page to throw it away.
+ */
+static void forget_code_on_page(unsigned short page) {
+	int first = page << (MEMORY_PAGE_SHIFT - CODE_PAGE_SHIFT);
+	int i;
+
+	for (i = first; i < first + (1 << (MEMORY_PAGE_SHIFT - CODE_PAGE_SHIFT)); i++) {
+		if (code_pages[i]) {
+			code_page_written(i);
+		}
+	}
+}
+
+/**
+ * /brief Whether an address belongs to the cartridge, its ROM or its RAM.
+ */
+static int is_cart_address(unsigned short address) {
+	return address < ROM_AREA_END || (address >= CART_RAM_BASE && address < CART_RAM_END);
+}
+
+/**
+ * /brief Flags a code page as holding cached code, so writes to it are noticed.
+ *
+ * The memory page it sits in is taken out of the map for writes, and goes back in once
+ * a write finds no code left on it.
+ *
+ * @param page: The code page to flag.
+ */
+void flag_code_page(unsigned short page) {
+	code_pages[page] = 1;
+	memory_map.write[page >> (MEMORY_PAGE_SHIFT - CODE_PAGE_SHIFT)] = NULL;
+}
+
+/**
+ * /brief Points a run of memory pages at host memory.
+ *
+ * Code cached from a page is thrown away when the page is pointed elsewhere, as it no
+ * longer holds that code. Switchable ROM is the exception: code caches tell its banks
+ * apart by current_rom_bank, so a bank switch there costs nothing more than the pointers.
+ *
+ * @param first_page: The first memory page to map.
+ * @param count: How many pages to map.
+ * @param read: Where the first page is read from, the rest following on. NULL for open bus, which reads as 0xFF.
+ * @param write: Where the first page is written to, likewise.
+ */
+void map_pages(unsigned short first_page, unsigned short count, unsigned char *read, unsigned char *write) {
+	unsigned short page;
+
+	for (page = first_page; page < first_page + count; page++) {
+		unsigned int offset = (page - first_page) << MEMORY_PAGE_SHIFT;
+
+		if (page_holds_code(page) && (page < SWITCHABLE_ROM_BASE >> MEMORY_PAGE_SHIFT || page >= ROM_AREA_END >> MEMORY_PAGE_SHIFT)) {
+			forget_code_on_page(page);
+		}
+		memory_map.read[page] = read == NULL ? open_bus : read + offset;
+		memory_map.writable[page] = write == NULL ? NULL : write + offset;
+		memory_map.write[page] = page_holds_code(page) ? NULL : memory_map.writable[page];
+	}
+}
+
+/**
+ * /brief Points a bank's worth of pages at host memory, unless they already are.
+ *
+ * For bank controllers, which always map a bank's pages together, so its first page
+ * stands for the rest. Games pick the bank they already have more often than not.
+ *
+ * @param address: Where the bank starts in the address space.
+ * @param size: The bank's size in bytes.
+ * @param read: Where the bank is read from. NULL for open bus.
+ * @param write: Where the bank is written to. NULL to send writes to cart_written.
+ */
+void map_bank(unsigned short address, unsigned int size, unsigned char *read, unsigned char *write) {
+	unsigned short page = address >> MEMORY_PAGE_SHIFT;
+
+	if (memory_map.writable[page] != write || memory_map.read[page] != (read == NULL ? open_bus : read)) {
+		map_pages(page, size >> MEMORY_PAGE_SHIFT, read, write);
+	}
+}
+
+/**
+ * /brief Gives the cart fresh RAM, cleared, in place of any it had.
+ *
+ * Carts with 2KB still get a whole bank, as they answer over all 8KB of it.
+ *
+ * @param ram_size: The size of the cart's RAM in bytes, as its header gives it. 0 for none.
+ */
+void insert_cart_ram(int ram_size) {
+	free(cart_ram);
+	cart_ram = NULL;
+	cart_ram_size = 0;
+	if (ram_size > 0) {
+		cart_ram_size = ram_size < RAM_BANK_SIZE ? RAM_BANK_SIZE : ram_size;
+		cart_ram = calloc(cart_ram_size, sizeof(unsigned char));
+	}
+}
+
+/**
+ * /brief Maps the address space onto memory_space the way a cart with no banks wants it.
+ *
+ * ROM is read only, writes to it going to cart_written. Echo RAM reads the work RAM
+ * it mirrors. The page with the I/O ports, HRAM and IE is read directly but written
+ * through the slow path, as writing the ports has side effects.
+ */
+void map_memory() {
+	memset(open_bus, 0xFF, sizeof(open_bus));
+	map_pages(0, ROM_AREA_END >> MEMORY_PAGE_SHIFT, memory_space, NULL);
+	map_pages(ROM_AREA_END >> MEMORY_PAGE_SHIFT, (ECHO_RAM_BASE - ROM_AREA_END) >> MEMORY_PAGE_SHIFT,
+		memory_space + ROM_AREA_END, memory_space + ROM_AREA_END);
+	map_pages(ECHO_RAM_BASE >> MEMORY_PAGE_SHIFT, (ECHO_RAM_END - ECHO_RAM_BASE) >> MEMORY_PAGE_SHIFT,
+		memory_space + ECHO_RAM_BASE - ECHO_RAM_OFFSET, NULL);
+	map_pages(ECHO_RAM_END >> MEMORY_PAGE_SHIFT, 1, memory_space + ECHO_RAM_END, memory_space + ECHO_RAM_END);
+	map_pages(IO_PORT_MEMORY_BASE >> MEMORY_PAGE_SHIFT, 1, memory_space + IO_PORT_MEMORY_BASE, NULL);
+}
+
+/**
+ * /brief Moves every entry of a memory map pointing into one copy of memory to another.
+ *
+ * For running a second machine, e.g. a lockstep reference, on its own copy of memory_space
+ * and cart_ram. Entries pointing anywhere else are left as they are.
+ *
+ * @param map: The map to move.
+ * @param from: The memory it points into.
+ * @param to: The memory to point it into instead.
+ * @param size: How many bytes from and to each hold.
+ */
+void rebase_memory_map(MemoryMap *map, const unsigned char *from, unsigned char *to, unsigned int size) {
+	unsigned char **tables[] = {map->read, map->write, map->writable};
+	int table, page;
+
+	for (table = 0; table < 3; table++) {
+		for (page = 0; page < MEMORY_PAGE_COUNT; page++) {
+			unsigned char *entry = tables[table][page];
+
+			if (entry != NULL && entry >= from && entry < from + size) {
+				tables[table][page] = to + (entry - from);
+			}
+		}
+	}
+}
+
+/**
+ * /brief Throws away a write to the cart.
+ *
+ * What cart_written is set to for carts with nothing there to write to. Games write
+ * to 0x2000 to pick a bank whether the cart has banks or not.
+ *
+ * @param address: The address written to
+ * @param byte: The byte written
+ */
+void ignore_cart_write(unsigned short address, unsigned char byte) {
+}
@@ -8,13 +8,83 @@
 #ifndef MEMORY_H
 #define MEMORY_H
 
+#define ROM_AREA_END 0x8000				// Everything below is the cartridge's ROM
+#define SWITCHABLE_ROM_BASE 0x4000		// 0x4000 - 0x7FFF holds whichever ROM bank is picked
+#define CART_RAM_BASE 0xA000			// 0xA000 - 0xBFFF is the cartridge's RAM, if it has any
+#define CART_RAM_END 0xC000
+#define ECHO_RAM_BASE 0xE000			// 0xE000 - 0xFDFF mirrors work RAM at 0xC000 - 0xDDFF
+#define ECHO_RAM_END 0xFE00
+#define ECHO_RAM_OFFSET 0x2000
 #define IO_PORT_MEMORY_BASE 0xFF00
+#define INTERRUPT_FLAG_ADDRESS 		0xFF0F	// IF: interrupts requested by the hardware
+#define INTERRUPT_ENABLE_ADDRESS 	0xFFFF	// IE: interrupts the game wants to hear about
+#define MEMORY_SPACE_SIZE 	0x10000		// The full 16 bit address space
+
+/*
+ * Memory is split into 64 byte code pages for the benefit of anything caching decoded
+ * instructions. Pages small enough to keep the I/O ports and HRAM apart.
+ */
+#define CODE_PAGE_SHIFT 6
+#define CODE_PAGE_COUNT (0x10000 >> CODE_PAGE_SHIFT)
+
+/*
+ * Reads and writes go through a table of 256 byte memory pages, each pointing at where
+ * that page of the address space lives in the host. Every page can be read directly. A NULL
+ * write entry means the page needs more than a plain store, the I/O ports or the cart's
+ * registers say, and sends it down the slow path in memory.c.
+ *
+ * write is the table in use. writable is what write holds for a page when no code is cached
+ * on it: pages holding cached code are taken out of write so their writes can be noticed.
+ */
+#define MEMORY_PAGE_SHIFT 8
+#define MEMORY_PAGE_MASK 0xFF
+#define MEMORY_PAGE_COUNT (MEMORY_SPACE_SIZE >> MEMORY_PAGE_SHIFT)
+
+typedef struct {
+	unsigned char *read[MEMORY_PAGE_COUNT];
+	unsigned char *write[MEMORY_PAGE_COUNT];
+	unsigned char *writable[MEMORY_PAGE_COUNT];
+} MemoryMap;
+
+// Bits of IF and IE, highest priority first
+#define INTERRUPT_VBLANK 	0x01
+#define INTERRUPT_STAT 		0x02
+#define INTERRUPT_TIMER 	0x04
+#define INTERRUPT_SERIAL 	0x08
+#define INTERRUPT_JOYPAD 	0x10
+#define INTERRUPT_MASK 		0x1F
 
 extern unsigned char *memory_space;		// We'd like access to system memory. It might be useful
+extern unsigned short current_rom_bank;	// The ROM bank mapped in at 0x4000 - 0x7FFF
+extern MemoryMap memory_map;			// Empty until map_memory, which must come before any read
+extern unsigned char *cart_ram;			// Every bank of the cart's RAM back to back. NULL if it has none
+extern unsigned int cart_ram_size;
+
+/*
+ * Pages flagged in code_pages hold code somebody has cached. Writing to one calls
+ * code_page_written with the page number so they can throw that code away.
+ */
+extern unsigned char code_pages[CODE_PAGE_COUNT];
+extern void (*code_page_written)(unsigned short page);
+
+/*
+ * Writes to the cart's ROM, or to its RAM where the map has nothing to write to, are handed
+ * to cart_written rather than stored, if set. That's where a cart's bank controller sees
+ * them. It's left unset until a cartridge is loaded so the tests can treat it all as plain
+ * memory.
+ */
+extern void (*cart_written)(unsigned short address, unsigned char byte);
 
 
 // See memory.c for more thorough explination of these functions 
 unsigned char read_byte(unsigned short address);
 void write_byte(unsigned short address, unsigned char byte);
+void ignore_cart_write(unsigned short address, unsigned char byte);
+void map_memory();
+void map_pages(unsigned short first_page, unsigned short count, unsigned char *read, unsigned char *write);
+void rebase_memory_map(MemoryMap *map, const unsigned char *from, unsigned char *to, unsigned int size);
+void flag_code_page(unsigned short page);
+void map_bank(unsigned short address, unsigned int size, unsigned char *read, unsigned char *write);
+void insert_cart_ram(int ram_size);
 
 #endif
\ No newline at end of file
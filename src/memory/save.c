@@ -0,0 +1,76 @@
+/**
+ * This module contains save files: what a cart keeps going on its battery, kept between
+ * runs of the emulator.
+ *
+ * A save file is the cart's RAM, every bank back to back, followed by whatever else the
+ * cart's mapper keeps, such as the RTC_SAVE_SIZE bytes of an MBC3's clock. That's how most
+ * emulators lay them out, so saves can be taken from one to the other.
+ *
+ * Nothing is saved unless asked for, so runs without a save file always start from a
+ * freshly inserted cart and do the same as each other.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+
+#include "save.h"
+#include "memory.h"
+
+/**
+ * /brief Loads a cart's RAM, and whatever else its mapper keeps, from a save file, if there is one.
+ *
+ * Call once the cart has been inserted. A save shorter than it should be only fills in
+ * as much as it has.
+ *
+ * @param file_location: Location of the save file on disk.
+ * @param mapper: The mapper the cart was inserted with.
+ *
+ * @return 1 if a save was loaded. 0 if there was none, leaving the cart as it was.
+ */
+int load_save(const char *file_location, const Mapper *mapper) {
+	FILE *save_file = fopen(file_location, "rb");
+
+	if (save_file == NULL) {
+		return 0;
+	}
+
+	if (fread(cart_ram, sizeof(unsigned char), cart_ram_size, save_file) != cart_ram_size) {
+		fprintf(stderr, "The save file %s is shorter than the cart's RAM\n", file_location);
+	}
+	else if (mapper->restore != NULL && !mapper->restore(save_file)) {
+		fprintf(stderr, "The save file %s is missing what the %s keeps past the RAM\n", file_location, mapper->name);
+	}
+
+	fclose(save_file);
+	return 1;
+}
+
+/**
+ * /brief Writes a cart's RAM, and whatever else its mapper keeps, to a save file.
+ *
+ * @param file_location: Location of the save file on disk. Replaced if it's there.
+ * @param mapper: The mapper the cart was inserted with.
+ *
+ * @return 1 if it was written. 0 otherwise.
+ */
+int write_save(const char *file_location, const Mapper *mapper) {
+	int written = 1;
+	FILE *save_file = fopen(file_location, "wb");
+
+	if (save_file == NULL) {
+		perror("Error Opening Save File");
+		return 0;
+	}
+
+	written &= fwrite(cart_ram, sizeof(unsigned char), cart_ram_size, save_file) == cart_ram_size;
+	if (mapper->save != NULL) {
+		written &= mapper->save(save_file);
+	}
+	written &= fclose(save_file) == 0;
+
+	if (!written) {
+		perror("Error Writing Save File");
+	}
+	return written;
+}
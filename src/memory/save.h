@@ -0,0 +1,16 @@
+/**
+ * A header file for save files, which keep a cart's battery backed RAM and clock between runs.
+ *
+ * Authors: Rocky Petkov
+ */
+
+#ifndef SAVE_H
+#define SAVE_H
+
+#include "mapper.h"
+
+// See save.c for more thorough explination of these functions
+int load_save(const char *file_location, const Mapper *mapper);
+int write_save(const char *file_location, const Mapper *mapper);
+
+#endif // SAVE_H
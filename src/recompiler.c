@@ -0,0 +1,438 @@
+/*
+ * Game Boy (working title)
+ * An emulator for a Game Boy.
+ *
+ * The ahead of time recompiler. Walks a cartridge from its entry point and interrupt
+ * vectors, following every jump, call and restart it can work out, and writes out C which
+ * calls the opcode adapters (and so the handlers in instructions.c) directly. Built into
+ * the emulator that C becomes the aot core, see cpu/aot.c.
+ *
+ * Every address control can arrive at gets a label. Jumps whose destination is known go
+ * straight to the label, anything else (returns, JP (HL), conditional branches we can't
+ * predict) goes back through a table of labels indexed by address. Should the programme
+ * counter land somewhere that wasn't recompiled, e.g. the target of a JP (HL) through a
+ * jump table, or code copied into RAM, the generated code hands back to the interpreter.
+ * The addresses the interpreter ends up running most are reported by the aot core and can
+ * be fed back in with -e.
+ *
+ * Each block adds the cycles its instructions take to the CPU state as it starts, giving
+ * back whatever it didn't get round to if it leaves early. Branches taken are charged by
+ * the adapters. A block ending with a jump (or anything else ending a block) checks for
+ * interrupts before going on, and goes through the table of labels if one was taken.
+ * After an EI the table hands back to the aot core, which interprets the instruction
+ * following it, so IME is set straight after that one as in every other core.
+ *
+ * Only 32KB ROM only carts are recompiled in full. For anything bigger, only bank 0 is
+ * recompiled as the code in 0x4000 - 0x7FFF depends on the bank mapped in.
+ *
+ * Usage: recompiler [-e address]... <rom file> > rom.c
+ *
+ * Authors: Rocky Petkov
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cpu/opcodes.h"
+#include "cpu/block_cache.h"
+#include "cpu/disassembler.h"
+#include "memory/cart.h"
+
+#define ROM_ONLY_SIZE 		0x8000		// A cart this size or smaller has no banks to switch
+
+// Restart and interrupt vectors
+#define INTERRUPT_VECTOR_START 		0x40
+#define INTERRUPT_VECTOR_END 		0x60
+#define INTERRUPT_VECTOR_SPACING 	0x08
+
+/**
+ * What the recompiler needs to know about an opcode: the name of its adapter so it can
+ * be called from the generated code. The comments alongside come from the disassembler.
+ */
+typedef struct {
+	const char *adapter;		/** Name of the adapter in opcodes.h */
+	unsigned char length;		/** Length of the instruction in bytes */
+} OpcodeName;
+
+#define NAME_ENTRY(code, adapter, length, cycles, taken, flags, mnemonic) [code] = {#adapter, length},
+
+static const OpcodeName primary_names[256] = {
+	PRIMARY_OPCODES(NAME_ENTRY)
+	[0xCB] = {NULL, 2},
+};
+
+static const OpcodeName cb_names[256] = {
+	CB_OPCODES(NAME_ENTRY)
+};
+
+unsigned char rom[ROM_ONLY_SIZE + 2];			// Room for the operands of an instruction right at the end
+unsigned int code_limit;						// Recompile 0x0000 up to here
+unsigned char is_target[ROM_ONLY_SIZE];			// Control can arrive here from elsewhere
+unsigned char is_walked[ROM_ONLY_SIZE];			// Already followed from here
+unsigned char is_code[ROM_ONLY_SIZE + 2];			// Part of an instruction we recompiled
+unsigned short worklist[2 * ROM_ONLY_SIZE];		// Every address once, plus whatever came in with -e
+unsigned int worklist_length;
+
+int is_illegal(unsigned char opcode);
+void add_target(unsigned int address);
+void walk_from(unsigned short address);
+int jump_target(unsigned short address, unsigned short next, unsigned char opcode);
+int writes_memory(unsigned short address);
+void write_block(unsigned short start, unsigned int *instruction_total);
+unsigned int rom_cycles(unsigned int address);
+void write_goto(unsigned int address, const char *indent);
+void print_usage(const char *programme_name);
+
+int main(int argc, char *argv[]) {
+	unsigned int address, block_count = 0, instruction_total = 0;
+	int option;
+
+	while ((option = getopt(argc, argv, "e:")) != -1) {
+		switch (option) {
+			case 'e':
+				address = strtoul(optarg, NULL, 16);
+				if (address < ROM_ONLY_SIZE) {
+					worklist[worklist_length++] = address;		// Checked against code_limit once we know the ROM
+				}
+				break;
+			default:
+				print_usage(argv[0]);
+				exit(1);
+		}
+	}
+
+	if (argc - optind != 1) {
+		print_usage(argv[0]);
+		exit(1);
+	}
+
+	FILE *rom_file = fopen(argv[optind], "rb");
+	if (rom_file == NULL) {
+		perror("Error Opening File");
+		exit(2);
+	}
+	CartMetaData *cart_data = read_cart_metadata(rom_file);
+	fseek(rom_file, 0, SEEK_SET);
+	fread(rom, sizeof(unsigned char), ROM_ONLY_SIZE, rom_file);
+	fclose(rom_file);
+
+	code_limit = cart_data->rom_size > 0 && cart_data->rom_size <= ROM_ONLY_SIZE ? ROM_ONLY_SIZE : ROM_BANK_SIZE;
+
+	// Work out everywhere control can get to
+	for (address = 0; address < worklist_length; address++) {
+		if (worklist[address] >= code_limit) {
+			worklist[address--] = worklist[--worklist_length];
+		}
+	}
+	add_target(ENTRY_POINT_ADDRESS);
+	for (address = INTERRUPT_VECTOR_START; address <= INTERRUPT_VECTOR_END; address += INTERRUPT_VECTOR_SPACING) {
+		add_target(address);
+	}
+	while (worklist_length > 0) {
+		walk_from(worklist[--worklist_length]);
+	}
+
+	// Now write it all out
+	printf("/*\n * Generated by recompiler from %s. Do not edit!\n */\n\n", cart_data->game_name);
+	printf("#include \"aot.h\"\n#include \"opcodes.h\"\n\n");
+	printf("unsigned long aot_run_compiled(CPUState *state, unsigned long budget) {\n");
+	printf("\tstatic const void *entries[0x%04X] = {\n", code_limit);
+	for (address = 0; address < code_limit; address++) {
+		if (is_target[address]) {
+			printf("\t\t[0x%04X] = &&block_%04X,\n", address, address);
+			++block_count;
+		}
+	}
+	printf("\t};\n\tunsigned long remaining = budget;\n\n");
+	printf("dispatch:\n");
+	printf("\tif (interrupt_controller.enable_delay) {\n\t\tgoto leave;\n\t}\n");		// The instruction after EI is interpreted
+	printf("\tif (state->PC < 0x%04X && entries[state->PC] != NULL) {\n\t\tgoto *entries[state->PC];\n\t}\n", code_limit);
+	printf("\tgoto leave;\n");
+
+	for (address = 0; address < code_limit; address++) {
+		if (is_target[address]) {
+			write_block(address, &instruction_total);
+		}
+	}
+
+	printf("\nleave:\n\treturn budget - remaining;\n}\n\n");
+
+	printf("const unsigned char aot_code_pages[CODE_PAGE_COUNT] = {\n");
+	for (address = 0; address < code_limit; address++) {
+		if (is_code[address] && (address == 0 || !is_code[address - 1] ||
+				(address >> CODE_PAGE_SHIFT) != ((address - 1) >> CODE_PAGE_SHIFT))) {
+			printf("\t[0x%03X] = 1,\n", address >> CODE_PAGE_SHIFT);
+		}
+	}
+	printf("};\n\n");
+
+	printf("const AotRom aot_rom = {\"%s\", 0x%02X, 0x%04X, %u, %u};\n",
+		cart_data->game_name, cart_data->header_checksum, cart_data->global_checksum, block_count, instruction_total);
+
+	fprintf(stderr, "Recompiled %u blocks, %u instructions from %s\n", block_count, instruction_total, cart_data->game_name);
+	free_cart_metadata(cart_data);
+	return 0;
+}
+
+/**
+ * /brief Whether an opcode doesn't exist. Nothing after one of those is worth recompiling.
+ *
+ * @param opcode: The primary opcode.
+ *
+ * @return 1 if the opcode is illegal. 0 otherwise.
+ */
+int is_illegal(unsigned char opcode) {
+	return primary_names[opcode].adapter != NULL && strcmp(primary_names[opcode].adapter, "illegal_opcode") == 0;
+}
+
+/**
+ * /brief Marks an address as somewhere control arrives, and queues it to be followed.
+ *
+ * @param address: The address. Ignored if it falls outside the recompiled ROM.
+ */
+void add_target(unsigned int address) {
+	if (address >= code_limit || is_target[address]) {
+		return;
+	}
+	is_target[address] = 1;
+	worklist[worklist_length++] = address;
+}
+
+/**
+ * /brief Follows straight line code from an address, queueing up everywhere it can go.
+ *
+ * @param address: Where to start.
+ */
+void walk_from(unsigned short address) {
+	unsigned char opcode;
+
+	is_target[address] = 1;
+	do {
+		if (is_walked[address]) {
+			return;			// Someone has been down here before us
+		}
+		is_walked[address] = 1;
+
+		opcode = rom[address];
+		unsigned short next = address + primary_names[opcode].length;
+		int target = jump_target(address, next, opcode);
+
+		memset(&is_code[address], 1, next - address);
+
+		if (target >= 0) {
+			add_target(target);
+		}
+		if (ends_block(opcode)) {
+			// Whatever doesn't unconditionally leave may carry on to the next instruction
+			if (opcode != 0x18 && opcode != 0xC3 && opcode != 0xE9 && opcode != 0xC9 && opcode != 0xD9) {
+				add_target(next);
+			}
+			return;
+		}
+		if (is_illegal(opcode)) {
+			return;
+		}
+		address = next;
+	} while (address < code_limit);
+}
+
+/**
+ * /brief Works out where a jump, call or restart goes, when that can be known.
+ *
+ * @param address: Address of the instruction.
+ * @param next: Address of the instruction after it.
+ * @param opcode: The instruction.
+ *
+ * @return The destination. -1 if it isn't a jump or the destination depends on the registers.
+ */
+int jump_target(unsigned short address, unsigned short next, unsigned char opcode) {
+	switch (opcode) {
+		case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: 	// JR
+			return (unsigned short) (next + (signed char) rom[address + 1]);
+		case 0xC2: case 0xC3: case 0xCA: case 0xD2: case 0xDA: 	// JP
+		case 0xC4: case 0xCC: case 0xCD: case 0xD4: case 0xDC: 	// CALL
+			return rom[address + 1] | (rom[address + 2] << 8);
+		case 0xC7: case 0xCF: case 0xD7: case 0xDF: 			// RST
+		case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+			return opcode & 0x38;
+		default:
+			return -1;
+	}
+}
+
+/**
+ * /brief Whether an instruction can write to memory, and so possibly over recompiled code.
+ *
+ * @param address: Address of the instruction.
+ *
+ * @return 1 if it might. 0 otherwise.
+ */
+int writes_memory(unsigned short address) {
+	unsigned char opcode = rom[address];
+
+	if (opcode == 0xCB) {
+		// Everything on (HL) bar BIT writes its answer back
+		unsigned char cb_opcode = rom[address + 1];
+		return (cb_opcode & 0x07) == 0x06 && (cb_opcode < 0x40 || cb_opcode >= 0x80);
+	}
+
+	switch (opcode) {
+		case 0x02: case 0x12: case 0x22: case 0x32: 			// LD (BC), (DE), (HL+), (HL-)
+		case 0x08: case 0x34: case 0x35: case 0x36: 			// LD (nn),SP  INC/DEC (HL)  LD (HL),n
+		case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x75: case 0x77:
+		case 0xE0: case 0xE2: case 0xEA: 						// LDH (n),A  LD (C),A  LD (nn),A
+		case 0xC5: case 0xD5: case 0xE5: case 0xF5: 			// PUSH
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+/**
+ * /brief The cost of the instruction at an address in the ROM, branches not taken.
+ *
+ * @param address: Address of the instruction.
+ *
+ * @return T-cycles it takes, see cycle_tables.h.
+ */
+unsigned int rom_cycles(unsigned int address) {
+	if (rom[address] == 0xCB) {
+		return cb_cycles[rom[address + 1]];
+	}
+	return primary_cycles[rom[address]];
+}
+
+/**
+ * /brief Writes out the C for the block of instructions starting at an address.
+ *
+ * The block runs to the first instruction which ends a block, or up to the next address
+ * somebody else jumps to. On entry it checks there is enough of the budget left to run
+ * it whole and that nothing has written over it.
+ *
+ * @param start: Address of the first instruction.
+ * @param instruction_total: Running count of instructions written.
+ */
+void write_block(unsigned short start, unsigned int *instruction_total) {
+	unsigned int address = start, length = 0, page, done = 0, cycles = 0, cycles_done = 0;
+	unsigned char opcode;
+
+	// First work out how long the block is
+	do {
+		opcode = rom[address];
+		cycles += rom_cycles(address);
+		address += primary_names[opcode].length;
+		++length;
+	} while (!ends_block(opcode) && !is_illegal(opcode) && address < code_limit && !is_target[address]);
+
+	printf("\nblock_%04X:\n", start);
+	printf("\tif (remaining < %u", length);
+	for (page = start >> CODE_PAGE_SHIFT; page <= (address - 1) >> CODE_PAGE_SHIFT; page++) {
+		printf(" || aot_dirty_pages[0x%03X]", page);
+	}
+	printf(") {\n\t\tgoto leave;\n\t}\n\tremaining -= %u;\n\tstate->cycles += %u;\n", length, cycles);
+
+	address = start;
+	while (done < length) {
+		unsigned short next;
+		char text[DISASSEMBLY_MAX];
+		opcode = rom[address];
+		next = address + primary_names[opcode].length;
+		disassemble(&rom[address], address, text, sizeof(text));
+
+		if (opcode == 0xCB) {
+			unsigned char cb_opcode = rom[address + 1];
+			printf("\tstate->PC = 0x%04X; %s(state, 0x%02X);\t\t// %s\n",
+				next, cb_names[cb_opcode].adapter, cb_opcode, text);
+		}
+		else {
+			unsigned short operand = 0;
+			if (primary_names[opcode].length == 2) {
+				operand = rom[address + 1];
+			}
+			else if (primary_names[opcode].length == 3) {
+				operand = rom[address + 1] | (rom[address + 2] << 8);
+			}
+			printf("\tstate->PC = 0x%04X; %s(state, 0x%04X);\t\t// %s\n",
+				next, primary_names[opcode].adapter, operand, text);
+		}
+
+		++done;
+		cycles_done += rom_cycles(address);
+		if (done < length && writes_memory(address)) {
+			// Leave straight away if that wrote over recompiled code
+			printf("\tif (aot_code_written) {\n\t\tremaining += %u;\n\t\tstate->cycles -= %u;\n\t\tgoto leave;\n\t}\n",
+				length - done, cycles - cycles_done);
+		}
+		address = next;
+	}
+	*instruction_total += length;
+
+	if (ends_block(opcode)) {
+		printf("\tif (interrupt_controller.pending) {\n\t\tservice_interrupts(state);\n\t\tgoto dispatch;\n\t}\n");
+	}
+
+	// Then where to go next
+	int target = jump_target(address - primary_names[opcode].length, address, opcode);
+	if (!ends_block(opcode)) {
+		if (is_illegal(opcode)) {
+			printf("\tgoto leave;\n");
+		}
+		else {
+			write_goto(address, "\t");
+		}
+	}
+	else if (target >= 0) {
+		if (opcode == 0x18 || opcode == 0xC3 || opcode == 0xCD || (opcode & 0xC7) == 0xC7) {
+			write_goto(target, "\t");	// Unconditional
+		}
+		else {
+			printf("\tif (state->PC == 0x%04X) {\n", target);
+			write_goto(target, "\t\t");
+			printf("\t}\n");
+			write_goto(address, "\t");
+		}
+	}
+	else if (opcode == 0xE9 || opcode == 0xC9 || opcode == 0xD9) {
+		printf("\tgoto dispatch;\n");	// JP (HL), RET and RETI could go anywhere
+	}
+	else if (opcode == 0xC0 || opcode == 0xC8 || opcode == 0xD0 || opcode == 0xD8) {
+		printf("\tif (state->PC != 0x%04X) {\n\t\tgoto dispatch;\n\t}\n", address);
+		write_goto(address, "\t");
+	}
+	else if (opcode == 0x76 || opcode == 0x10) {
+		// Still halted, or the HALT bug ran the next instruction along
+		printf("\tif (state->PC != 0x%04X) {\n\t\tgoto dispatch;\n\t}\n", address);
+		write_goto(address, "\t");
+	}
+	else {
+		write_goto(address, "\t");	// DI and EI carry on
+	}
+}
+
+/**
+ * /brief Writes out a jump to the block at an address.
+ *
+ * @param address: Where to go. If it wasn't recompiled we go back through dispatch, which
+ * 		will hand over to the interpreter.
+ * @param indent: Tabs to put in front.
+ */
+void write_goto(unsigned int address, const char *indent) {
+	if (address < code_limit && is_target[address]) {
+		printf("%sgoto block_%04X;\n", indent, address);
+	}
+	else {
+		printf("%sgoto dispatch;\n", indent);
+	}
+}
+
+/**
+ * /brief Prints how to use the programme.
+ *
+ * @param programme_name: What the programme was invoked as.
+ */
+void print_usage(const char *programme_name) {
+	fprintf(stderr, "Usage: %s [-e address]... <rom file> > rom.c\n", programme_name);
+	fprintf(stderr, "\t-e address: Extra entry point in hex, e.g. the target of a JP (HL)\n");
+}
@@ -6,6 +6,7 @@
  */
 
 #include "util.h"
+#include "./cpu/instructions.h"
 
 
 
@@ -30,6 +31,12 @@ unsigned short to_little_endian(unsigned short big_endian_number) {
  * @returns: Non Zero if zero flag is set. Zero otherwise.
  */
 int zero_flag_set(Register8 *flags) {
+#ifdef LAZY_FLAGS
+    PendingFlags *pending = PENDING_FLAGS(flags);
+    if (pending->operation != FLAGS_SETTLED) {
+        return pending->result == 0;
+    }
+#endif
     return *flags & 0x80;
 }
 
@@ -41,6 +48,7 @@ int zero_flag_set(Register8 *flags) {
  * @returns: Non Zero if negagive flag is set. Zero otherwise.
  */
 int negative_flag_set(Register8 *flags) {
+    materialise_flags(flags);
     return *flags & 0x40;
 }
 
@@ -52,6 +60,7 @@ int negative_flag_set(Register8 *flags) {
  * @returns: Non Zero if half-carry flag is set. Zero otherwise.
  */
 int half_carry_flag_set(Register8 *flags) {
+    materialise_flags(flags);
     return *flags & 0x20;
 }
 
@@ -63,5 +72,21 @@ int half_carry_flag_set(Register8 *flags) {
  * @returns: Non Zero if carry flag is set. Zero otherwise.
  */
 int carry_flag_set(Register8 *flags) {
+#ifdef LAZY_FLAGS
+    // The carry can be had straight from the pending operation, no need to work out all of F
+    PendingFlags *pending = PENDING_FLAGS(flags);
+    switch (pending->operation) {
+        case FLAGS_ADD:
+            return pending->result < pending->operand || (pending->carry && pending->result == pending->operand);
+        case FLAGS_SUB:
+            return pending->result > pending->operand || (pending->carry && pending->result == pending->operand);
+        case FLAGS_AND:
+        case FLAGS_LOGIC:
+            return 0;
+        case FLAGS_ADD | FLAGS_KEEP_CARRY:
+        case FLAGS_SUB | FLAGS_KEEP_CARRY:
+            return pending->carry;
+    }
+#endif
     return *flags & 0x10;
 }
\ No newline at end of file